@@ -0,0 +1,72 @@
+#! /usr/bin/python3
+
+import unittest
+import sys
+
+sys.path.append('../util')
+from iwd import IWD
+from iwd import PSKAgent
+from iwd import NetworkType
+
+class Test(unittest.TestCase):
+
+    #
+    # More clients than the AP's anti-clogging threshold connect at the
+    # same time, so some of them only get in after echoing a token.
+    #
+    def connect_all(self, wd, ssid):
+        ap, *clients = wd.list_devices(9)
+
+        ap.start_ap(ssid)
+
+        psk_agent = PSKAgent(['secret123'] * len(clients))
+        wd.register_psk_agent(psk_agent)
+
+        networks = []
+
+        for dev in clients:
+            network = dev.get_ordered_network(ssid, full_scan=True)
+            self.assertEqual(network.type, NetworkType.psk)
+            networks.append(network)
+
+        for n in networks:
+            n.network_object.connect(wait=False)
+
+        for dev in clients:
+            condition = 'obj.state == DeviceState.connected'
+            wd.wait_for_object_condition(dev, condition)
+
+            # Both modes must end up using SAE, not fall back to the PSK
+            diagnostics = dev.get_diagnostics()
+            self.assertEqual(diagnostics['Security'], 'WPA3-Personal')
+
+        for dev in clients:
+            dev.disconnect()
+
+        for n in networks:
+            condition = 'not obj.connected'
+            wd.wait_for_object_condition(n.network_object, condition)
+
+        wd.unregister_psk_agent(psk_agent)
+
+        ap.stop_ap()
+
+    def test_sae_only(self):
+        IWD.copy_to_ap('TestAP-SAE.ap')
+
+        wd = IWD(True)
+
+        self.connect_all(wd, 'TestAP-SAE')
+
+    def test_sae_transition(self):
+        IWD.copy_to_ap('TestAP-Mixed.ap')
+
+        wd = IWD(True)
+
+        self.connect_all(wd, 'TestAP-Mixed')
+
+    def tearDown(self):
+        IWD.clear_storage()
+
+if __name__ == '__main__':
+    unittest.main(exit=True)
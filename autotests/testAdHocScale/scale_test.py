@@ -0,0 +1,71 @@
+#!/usr/bin/python3
+
+import unittest
+import sys
+import time
+
+sys.path.append('../util')
+from iwd import IWD
+
+NUM_PEERS = 51
+
+class Test(unittest.TestCase):
+
+    def join(self, wd, dev, others):
+        start = time.time()
+
+        adhoc = dev.start_adhoc("AdHocScale", "secret123")
+
+        condition = 'obj.started == True'
+        wd.wait_for_object_condition(adhoc, condition)
+
+        condition = 'len(obj.connected_peers) == %u' % len(others)
+        wd.wait_for_object_condition(adhoc, condition, max_wait=60)
+
+        elapsed = time.time() - start
+
+        stats = adhoc.get_peer_statistics()
+        self.assertEqual(len(stats), len(others))
+
+        for peer in stats:
+            self.assertTrue(peer['Authenticated'])
+            self.assertIn('JoinTime', peer)
+
+        return adhoc, elapsed
+
+    def test_join_scaling(self):
+        wd = IWD(True)
+
+        devices = wd.list_devices(NUM_PEERS + 1)
+        joined = []
+        times = []
+
+        for dev in devices:
+            adhoc, elapsed = self.join(wd, dev, joined)
+            joined.append(dev)
+            times.append(elapsed)
+
+        #
+        # Each new peer has to complete a pair of handshakes with every
+        # existing peer, so the time to join grows with the network size.
+        # Make sure it does not grow faster than linearly: the last ten
+        # joins, with ~5x as many existing peers as the first ten, should
+        # take no more than ~10x as long on average.
+        #
+        first = sum(times[1:11]) / 10
+        last = sum(times[-10:]) / 10
+
+        print('Average join time: first %.3fs, last %.3fs' % (first, last))
+
+        self.assertLessEqual(last, max(first, 0.1) * 10)
+
+    @classmethod
+    def setUpClass(cls):
+        pass
+
+    @classmethod
+    def tearDownClass(cls):
+        IWD.clear_storage()
+
+if __name__ == '__main__':
+    unittest.main(exit=True)
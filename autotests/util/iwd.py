@@ -41,6 +41,7 @@ IWD_P2P_PEER_INTERFACE =        'net.connman.iwd.p2p.Peer'
 IWD_P2P_SERVICE_MANAGER_INTERFACE = 'net.connman.iwd.p2p.ServiceManager'
 IWD_P2P_WFD_INTERFACE =         'net.connman.iwd.p2p.Display'
 IWD_STATION_DEBUG_INTERFACE =   'net.connman.iwd.StationDebug'
+IWD_STATION_DIAGNOSTIC_INTERFACE = 'net.connman.iwd.StationDiagnostic'
 IWD_DPP_INTERFACE =             'net.connman.iwd.DeviceProvisioning'
 IWD_DPP_PKEX_INTERFACE =        'net.connman.iwd.SharedCodeDeviceProvisioning'
 IWD_SHARED_CODE_AGENT_INTERFACE = 'net.connman.iwd.SharedCodeAgent'
@@ -260,6 +261,9 @@ class AdHocDevice(IWDDBusAbstract):
     def connected_peers(self):
         return self._properties['ConnectedPeers']
 
+    def get_peer_statistics(self):
+        return self._iface.GetPeerStatistics()
+
 class StationDebug(IWDDBusAbstract):
     '''
         Class represents net.connman.iwd.StationDebug
@@ -676,6 +680,13 @@ class Device(IWDDBusAbstract):
 
         self._wait_for_async_op()
 
+    def get_diagnostics(self):
+        '''Return the diagnostics of the current connection as a dict,
+           e.g. the negotiated 'Security' and 'PairwiseCipher'.
+        '''
+        return self._iface.GetDiagnostics(
+                            dbus_interface=IWD_STATION_DIAGNOSTIC_INTERFACE)
+
     def get_ordered_networks(self, scan_if_needed = True, full_scan = False, list = []):
         '''Return the list of networks found in the most recent
            scan, sorted by their user interface importance
@@ -106,9 +106,10 @@ static void display_ad_hoc_inline(const char *margin, const void *data)
 	if (!identity)
 		return;
 
-	display("%s%-*s%-*s\n", margin,
-			20, identity,
-			8, get_started_tostr(ad_hoc));
+	display_structured_row("Name", identity,
+				"Started", get_started_tostr(ad_hoc), NULL);
+	display_table_row(margin, 2, 20, identity,
+				8, get_started_tostr(ad_hoc));
 }
 
 static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
@@ -119,6 +120,7 @@ static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
 
 	display_table_header("Devices in Ad-Hoc Mode", MARGIN "%-*s  %-*s",
 				20, "Name", 8, "Started");
+	display_structured_table(IWD_AD_HOC_INTERFACE);
 
 	if (!match) {
 		display("No devices in Ad-Hoc mode available.\n");
@@ -185,6 +185,10 @@ static void display_adapter_inline(const char *margin, const void *data)
 {
 	const struct adapter *adapter = data;
 
+	display_structured_row("Name", adapter->name,
+				"Powered", get_powered_tostr(adapter),
+				"Vendor", adapter->vendor,
+				"Model", adapter->model, NULL);
 	display_table_row(margin, 4, 8, adapter->name ? : "-",
 				8, get_powered_tostr(adapter),
 				20, adapter->vendor ? : "-",
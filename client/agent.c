@@ -72,7 +72,11 @@ static struct l_dbus_message *agent_error(struct l_dbus_message *message,
 {
 	display_error(text);
 
-	if (!command_is_interactive_mode()) {
+	/*
+	 * In batch mode the canceled request fails the method call that
+	 * needed the agent, which ends the current command.
+	 */
+	if (!command_is_interactive_mode() && !command_is_batch_mode()) {
 		command_set_exit_status(EXIT_FAILURE);
 
 		l_main_quit();
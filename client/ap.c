@@ -260,6 +260,8 @@ static void display_ap_inline(const char *margin, const void *data)
 	if (!identity)
 		return;
 
+	display_structured_row("Name", identity,
+				"Started", get_started_tostr(ap), NULL);
 	display_table_row(margin, 2, 20, identity, 8, get_started_tostr(ap));
 }
 
@@ -272,6 +274,7 @@ static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
 
 	display_table_header("Devices in Access Point Mode",
 				MARGIN "%-*s  %-*s", 20, "Name", 8, "Started");
+	display_structured_table(IWD_ACCESS_POINT_INTERFACE);
 
 	if (!match) {
 		display("No devices in access point mode available.\n");
@@ -364,6 +367,7 @@ static void ap_get_diagnostics_callback(struct l_dbus_message *message,
 		sprintf(client_num, "STA %u", idx++);
 		display_table_header("", MARGIN "%-*s  %-*s  %-*s", 8, client_num,
 					20, "Property", 20, "Value");
+		display_structured_object(IWD_AP_DIAGNOSTIC_INTERFACE);
 		diagnostic_display(&iter, MARGIN, 20, 20);
 		display_table_footer();
 	}
@@ -443,6 +447,9 @@ static void ap_display_network(struct l_dbus_message_iter *iter,
 {
 	const char *key;
 	struct l_dbus_message_iter variant;
+	const char *name = NULL;
+	const char *type = NULL;
+	char signal[7] = "";
 
 	while (l_dbus_message_iter_next_entry(iter, &key, &variant)) {
 		const char *s;
@@ -452,11 +459,14 @@ static void ap_display_network(struct l_dbus_message_iter *iter,
 			if (!l_dbus_message_iter_get_variant(&variant, "s", &s))
 				goto parse_error;
 
+			if (!strcmp(key, "Name"))
+				name = s;
+			else
+				type = s;
+
 			display_table_row(margin, 2, name_width, key,
 						value_width, s);
 		} else if (!strcmp(key, "SignalStrength")) {
-			char signal[7];
-
 			if (!l_dbus_message_iter_get_variant(&variant, "n", &n))
 				goto parse_error;
 
@@ -467,6 +477,8 @@ static void ap_display_network(struct l_dbus_message_iter *iter,
 		}
 	}
 
+	display_structured_row("Name", name, "Type", type,
+				"SignalStrength", signal, NULL);
 	return;
 
 parse_error:
@@ -489,6 +501,7 @@ static void ap_get_networks_callback(struct l_dbus_message *message,
 
 	display_table_header("Networks", "            %-*s  %-*s",
 					20, "Property", 20, "Value");
+	display_structured_table(IWD_NETWORK_INTERFACE);
 	while (l_dbus_message_iter_next_entry(&array, &iter)) {
 		ap_display_network(&iter, "            ", 20, 20);
 		display("\n");
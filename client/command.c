@@ -27,6 +27,7 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
 #include <ell/ell.h>
 #include <readline/readline.h>
@@ -41,6 +42,10 @@ static bool interactive_mode;
 static struct command_noninteractive {
 	char **argv;
 	int argc;
+	/* Commands are read line by line from here in batch mode */
+	FILE *batch_input;
+	char **batch_argv;
+	bool running : 1;
 } command_noninteractive;
 
 struct command_option {
@@ -85,6 +90,7 @@ bool command_needs_no_agent(void)
 static enum cmd_status cmd_version(const char *entity,
 						char **argv, int argc)
 {
+	display_structured_property("Version", VERSION);
 	display("IWD version %s\n", VERSION);
 
 	return CMD_STATUS_DONE;
@@ -421,20 +427,16 @@ static void execute_cmd(const char *family, const char *entity,
 		goto error;
 
 	if (status == CMD_STATUS_DONE && !interactive_mode) {
-		l_main_quit();
+		command_noninteractive_done(true);
 
 		return;
 	}
 
-	if (!interactive_mode)
-		return;
-
-	if (cmd->refreshable)
-		display_refresh_timeout_set();
-
 	return;
 
 error:
+	display_refresh_failed();
+
 	switch (status) {
 	case CMD_STATUS_INVALID_ARGS:
 		display("Invalid command. Use the following pattern:\n");
@@ -463,9 +465,7 @@ error:
 		return;
 
 failure:
-	exit_status = EXIT_FAILURE;
-
-	l_main_quit();
+	command_noninteractive_done(false);
 }
 
 static bool match_cmd(const char *family, const char *param,
@@ -541,18 +541,34 @@ static void list_commands(const char *command_family,
 	}
 }
 
+static const struct {
+	const char *option;
+	const char *desc;
+} cmd_options[] = {
+	{ COMMAND_OPTION_USERNAME, "Provide username" },
+	{ COMMAND_OPTION_PASSWORD, "Provide password" },
+	{ COMMAND_OPTION_PASSPHRASE, "Provide passphrase" },
+	{ COMMAND_OPTION_DONTASK, "Don't ask for missing credentials" },
+	{ "batch <file>", "Read commands from file, or stdin if '-'" },
+	{ "format <text|json|kv>", "Output format" },
+	{ "help", "Display help" },
+	{ }
+};
+
 static void list_cmd_options(void)
 {
-	display(MARGIN "--%-*s  %s\n", 48, COMMAND_OPTION_USERNAME,
-					"Provide username");
-	display(MARGIN "--%-*s  %s\n", 48, COMMAND_OPTION_PASSWORD,
-					"Provide password");
-	display(MARGIN "--%-*s  %s\n", 48, COMMAND_OPTION_PASSPHRASE,
-					"Provide passphrase");
-	display(MARGIN "--%-*s  %s\n", 48, COMMAND_OPTION_DONTASK,
-					"Don't ask for missing\n"
-					"\t\t\t\t\t\t      credentials");
-	display(MARGIN "--%-*s  %s\n", 48, "help", "Display help");
+	size_t i;
+
+	for (i = 0; cmd_options[i].option; i++) {
+		_auto_(l_free) char *option =
+				l_strdup_printf("--%s", cmd_options[i].option);
+
+		display_structured_row("Option", option,
+					"Description", cmd_options[i].desc,
+					NULL);
+		display_table_row(MARGIN, 2, 50, option,
+					30, cmd_options[i].desc);
+	}
 }
 
 static void list_cmd_families(void)
@@ -563,13 +579,25 @@ static void list_cmd_families(void)
 							entry = entry->next) {
 		const struct command_family *family = entry->data;
 
-		display("\n%s:\n", family->caption);
+		if (display_get_format() == DISPLAY_FORMAT_TEXT)
+			display("\n%s:\n", family->caption);
+
 		list_commands(family->name, family->command_list);
 	}
 }
 
 static void command_display_help(void)
 {
+	if (display_get_format() != DISPLAY_FORMAT_TEXT) {
+		display_structured_object("Help");
+		display_structured_property("Version", VERSION);
+		display_structured_table("Options");
+		list_cmd_options();
+		display_structured_table("Commands");
+		list_cmd_families();
+		return;
+	}
+
 	display("\n");
 	display_table_header("iwctl version " VERSION, MARGIN "%-*s",
 								5, "Usage");
@@ -617,14 +645,12 @@ void command_process_prompt(char **argv, int argc)
 
 	if (!interactive_mode) {
 		if (command_match_misc_commands(argv, argc)) {
-			exit_status = EXIT_SUCCESS;
-			goto quit;
+			command_noninteractive_done(true);
+			return;
 		}
 
 		display_error("Invalid command\n");
-		exit_status = EXIT_FAILURE;
-quit:
-		l_main_quit();
+		command_noninteractive_done(false);
 		return;
 	}
 
@@ -636,15 +662,105 @@ quit:
 	display_error("Invalid command\n");
 }
 
+static void command_noninteractive_begin(const char *line)
+{
+	if (display_get_format() != DISPLAY_FORMAT_TEXT)
+		display_structured_begin(line);
+
+	command_noninteractive.running = true;
+}
+
+static void command_noninteractive_run(char **argv, int argc)
+{
+	_auto_(l_free) char *line = l_strjoinv(argv, ' ');
+
+	command_noninteractive_begin(line);
+	command_process_prompt(argv, argc);
+}
+
+static void command_batch_next(void *user_data)
+{
+	_auto_(l_free) char *line = NULL;
+	size_t len = 0;
+	int argc;
+
+	l_strv_free(l_steal_ptr(command_noninteractive.batch_argv));
+
+	while (getline(&line, &len, command_noninteractive.batch_input) >= 0) {
+		char *cmd = l_strstrip(line);
+
+		if (*cmd == '\0' || *cmd == '#')
+			continue;
+
+		command_noninteractive.batch_argv = l_parse_args(cmd, &argc);
+		if (!command_noninteractive.batch_argv) {
+			command_noninteractive_begin(cmd);
+			display_error("Invalid command\n");
+			command_noninteractive_done(false);
+			return;
+		}
+
+		command_noninteractive_run(command_noninteractive.batch_argv,
+									argc);
+		return;
+	}
+
+	l_main_quit();
+}
+
+/*
+ * Called once the current non-interactive command has completed.  In batch
+ * mode the next command is started from idle so that the callback which
+ * completed this one has fully unwound first.
+ */
+void command_noninteractive_done(bool success)
+{
+	if (!success)
+		exit_status = EXIT_FAILURE;
+
+	if (!command_noninteractive.running) {
+		if (!command_noninteractive.batch_input)
+			l_main_quit();
+
+		return;
+	}
+
+	command_noninteractive.running = false;
+
+	if (display_get_format() != DISPLAY_FORMAT_TEXT) {
+		_auto_(l_free) char *out = display_structured_end(success);
+
+		fputs(out, stdout);
+		fflush(stdout);
+	}
+
+	if (!command_noninteractive.batch_input) {
+		l_main_quit();
+		return;
+	}
+
+	l_idle_oneshot(command_batch_next, NULL, NULL);
+}
+
 void command_noninteractive_trigger(void)
 {
+	if (command_noninteractive.batch_input) {
+		command_batch_next(NULL);
+		return;
+	}
+
 	if (!command_noninteractive.argc)
 		return;
 
-	command_process_prompt(command_noninteractive.argv,
+	command_noninteractive_run(command_noninteractive.argv,
 						command_noninteractive.argc);
 }
 
+bool command_is_batch_mode(void)
+{
+	return command_noninteractive.batch_input != NULL;
+}
+
 bool command_is_interactive_mode(void)
 {
 	return interactive_mode;
@@ -675,10 +791,43 @@ static const struct option command_opts[] = {
 	{ COMMAND_OPTION_PASSWORD,	required_argument, NULL, 'p' },
 	{ COMMAND_OPTION_PASSPHRASE,	required_argument, NULL, 'P' },
 	{ COMMAND_OPTION_DONTASK,	no_argument,	   NULL, 'd' },
+	{ "batch",			required_argument, NULL, 'b' },
+	{ "format",			required_argument, NULL, 'f' },
 	{ "help",			no_argument,	   NULL, 'h' },
 	{ }
 };
 
+static bool command_set_format(const char *format)
+{
+	if (!strcmp(format, "text"))
+		display_set_format(DISPLAY_FORMAT_TEXT);
+	else if (!strcmp(format, "json"))
+		display_set_format(DISPLAY_FORMAT_JSON);
+	else if (!strcmp(format, "kv"))
+		display_set_format(DISPLAY_FORMAT_KEY_VALUE);
+	else
+		return false;
+
+	return true;
+}
+
+static bool command_open_batch(const char *path)
+{
+	if (!strcmp(path, "-")) {
+		command_noninteractive.batch_input = stdin;
+		return true;
+	}
+
+	command_noninteractive.batch_input = fopen(path, "re");
+	if (!command_noninteractive.batch_input) {
+		fprintf(stderr, "Failed to open %s: %s\n", path,
+							strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
 extern struct command_family_desc __start___command[];
 extern struct command_family_desc __stop___command[];
 
@@ -700,7 +849,8 @@ bool command_init(char **argv, int argc)
 	for (;;) {
 		struct command_option *option;
 
-		opt = getopt_long(argc, argv, "u:p:P:dh", command_opts, NULL);
+		opt = getopt_long(argc, argv, "u:p:P:db:f:h", command_opts,
+									NULL);
 
 		switch (opt) {
 		case 'u':
@@ -733,8 +883,27 @@ bool command_init(char **argv, int argc)
 
 			l_queue_push_tail(command_options, option);
 
+			break;
+		case 'b':
+			if (command_noninteractive.batch_input ||
+					!command_open_batch(optarg)) {
+				exit_status = EXIT_FAILURE;
+
+				return true;
+			}
+
+			break;
+		case 'f':
+			if (!command_set_format(optarg)) {
+				fprintf(stderr, "Unknown format: %s\n", optarg);
+				exit_status = EXIT_FAILURE;
+
+				return true;
+			}
+
 			break;
 		case 'h':
+			display_set_format(DISPLAY_FORMAT_TEXT);
 			command_display_help();
 
 			l_main_quit();
@@ -753,6 +922,18 @@ options_parsed:
 	argv += optind;
 	argc -= optind;
 
+	if (command_noninteractive.batch_input) {
+		if (argc > 0) {
+			fprintf(stderr, "Commands can't be combined with "
+								"--batch\n");
+			exit_status = EXIT_FAILURE;
+
+			return true;
+		}
+
+		return false;
+	}
+
 	if (argc < 1) {
 		interactive_mode = true;
 		return false;
@@ -780,4 +961,11 @@ void command_exit(void)
 
 	l_queue_destroy(command_options, command_options_destroy);
 	command_options = NULL;
+
+	if (command_noninteractive.batch_input &&
+			command_noninteractive.batch_input != stdin)
+		fclose(command_noninteractive.batch_input);
+
+	command_noninteractive.batch_input = NULL;
+	l_strv_free(l_steal_ptr(command_noninteractive.batch_argv));
 }
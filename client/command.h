@@ -69,7 +69,9 @@ char *command_entity_arg_completion(const char *text, int state,
 void command_process_prompt(char **argv, int argc);
 
 void command_noninteractive_trigger(void);
+void command_noninteractive_done(bool success);
 bool command_is_interactive_mode(void);
+bool command_is_batch_mode(void);
 int command_get_exit_status(void);
 void command_set_exit_status(int status);
 
@@ -70,6 +70,7 @@ void proxy_properties_display_inline(const struct proxy_interface *proxy,
 
 		str = properties[i].tostr(data);
 
+		display_structured_property(properties[i].name, str);
 		display_table_row(MARGIN, 3, 8, properties[i].is_read_write ?
 				COLOR_BOLDGRAY("       *") : "",
 				name_column_width, properties[i].name,
@@ -95,6 +96,7 @@ void proxy_properties_display(const struct proxy_interface *proxy,
 	if (!proxy->type->properties)
 		return;
 
+	display_structured_object(proxy->type->interface);
 	proxy_properties_display_header(caption, margin, name_column_width,
 					value_column_width);
 
@@ -337,8 +339,8 @@ static void proxy_callback(struct l_dbus_message *message, void *user_data)
 		return;
 
 	if (l_dbus_message_get_error(message, &name, &text)) {
-		command_set_exit_status(EXIT_FAILURE);
-		goto quit;
+		command_noninteractive_done(false);
+		return;
 	}
 
 	proxy = callback_data->user_data;
@@ -346,8 +348,7 @@ static void proxy_callback(struct l_dbus_message *message, void *user_data)
 			!strcmp(proxy->type->interface, IWD_DAEMON_INTERFACE))
 		return;
 
-quit:
-	l_main_quit();
+	command_noninteractive_done(true);
 }
 
 bool proxy_property_set(const struct proxy_interface *proxy, const char *name,
@@ -430,7 +431,7 @@ static bool interface_match_by_type_name(const void *a, const void *b)
 	return !strcmp(type->interface, interface);
 }
 
-struct proxy_interface *proxy_interface_find(const char *interface,
+static struct proxy_interface *proxy_interface_lookup(const char *interface,
 							const char *path)
 {
 	const struct l_queue_entry *entry;
@@ -454,6 +455,22 @@ struct proxy_interface *proxy_interface_find(const char *interface,
 	return NULL;
 }
 
+/*
+ * The lookups below are how commands get to the objects they display, so
+ * they also tell the auto-refresh which signals can change the output.
+ * Signal handling uses proxy_interface_lookup() directly.
+ */
+struct proxy_interface *proxy_interface_find(const char *interface,
+							const char *path)
+{
+	if (!interface || !path)
+		return NULL;
+
+	display_refresh_watch(NULL, path);
+
+	return proxy_interface_lookup(interface, path);
+}
+
 struct l_queue *proxy_interface_find_all(const char *interface,
 					proxy_property_match_func_t function,
 					const void *value)
@@ -464,6 +481,8 @@ struct l_queue *proxy_interface_find_all(const char *interface,
 	if (!interface)
 		return NULL;
 
+	display_refresh_watch(interface, NULL);
+
 	for (entry = l_queue_get_entries(proxy_interfaces); entry;
 							entry = entry->next) {
 		struct proxy_interface *proxy = entry->data;
@@ -512,11 +531,13 @@ static void properties_changed_callback(struct l_dbus_message *message,
 	if (!path)
 		return;
 
-	proxy = proxy_interface_find(interface, path);
+	proxy = proxy_interface_lookup(interface, path);
 	if (!proxy)
 		return;
 
 	interface_update_properties(proxy, &changed, &invalidated);
+
+	display_refresh_notify(interface, path);
 }
 
 static bool is_ignorable(const char *interface)
@@ -558,11 +579,13 @@ static void proxy_interfaces_update_properties(const char *path,
 		if (!interface_type)
 			continue;
 
-		proxy = proxy_interface_find(interface_type->interface, path);
+		proxy = proxy_interface_lookup(interface_type->interface, path);
 		if (!proxy)
 			continue;
 
 		interface_update_properties(proxy, &properties, NULL);
+
+		display_refresh_notify(interface, path);
 	}
 }
 
@@ -591,7 +614,7 @@ static void proxy_interface_create(const char *path,
 			continue;
 		}
 
-		proxy = proxy_interface_find(interface_type->interface, path);
+		proxy = proxy_interface_lookup(interface_type->interface, path);
 
 		if (proxy)
 			continue;
@@ -677,6 +700,8 @@ void proxy_interface_display_list(const char *interface)
 {
 	const struct l_queue_entry *entry;
 
+	display_structured_table(interface);
+
 	for (entry = l_queue_get_entries(proxy_interfaces); entry;
 							entry = entry->next) {
 		const struct proxy_interface *proxy = entry->data;
@@ -728,7 +753,7 @@ static void interfaces_removed_callback(struct l_dbus_message *message,
 		return;
 
 	while (l_dbus_message_iter_next_entry(&interfaces, &interface)) {
-		proxy = proxy_interface_find(interface, path);
+		proxy = proxy_interface_lookup(interface, path);
 
 		if (!proxy)
 			continue;
@@ -736,6 +761,8 @@ static void interfaces_removed_callback(struct l_dbus_message *message,
 		l_queue_remove(proxy_interfaces, proxy);
 
 		proxy_interface_destroy(proxy);
+
+		display_refresh_notify(interface, path);
 	}
 }
 
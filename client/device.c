@@ -52,9 +52,12 @@ static void display_device(const struct proxy_interface *proxy)
 	l_free(caption);
 
 	if (device->adapter) {
+		const char *adapter_str =
+			proxy_interface_get_identity_str(device->adapter);
+
+		display_structured_property("Adapter", adapter_str);
 		display_table_row(MARGIN, 3, 8, "", 20, "Adapter", 47,
-				proxy_interface_get_identity_str(
-						device->adapter) ? : "");
+					adapter_str ? : "");
 
 	}
 
@@ -215,6 +218,11 @@ static void display_device_inline(const char *margin, const void *data)
 	else
 		adapter_str = "-";
 
+	display_structured_row("Name", device->name,
+				"Address", device->address,
+				"Powered", get_powered_tostr(device),
+				"Adapter", adapter_str,
+				"Mode", device->mode, NULL);
 	display_table_row(margin, 5, 20, device->name ? : "",
 				20, device->address ? : "",
 				10, get_powered_tostr(device),
@@ -75,6 +75,7 @@ static bool display_bitrate_100kbps(struct l_dbus_message_iter *variant,
 		return false;
 
 	sprintf(str, "%u Kbit/s", rate * 100);
+	display_structured_property(key, str);
 	display_table_row(margin, 3, 8, "", name_column_width, key, value_column_width, str);
 
 	return true;
@@ -179,6 +180,7 @@ void diagnostic_display(struct l_dbus_message_iter *dict,
 		if (map->units)
 			sprintf(display_text + bytes, " %s", map->units);
 
+		display_structured_property(key, display_text);
 		display_table_row(margin, 3, 8, "", name_column_width,
 					key, value_column_width, display_text);
 	}
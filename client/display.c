@@ -44,6 +44,9 @@
 	"\001" COLOR_GREEN("\002" "[iwd]" "\001") "\002" "# "
 #define LINE_LEN 81
 
+/* Minimum time between two signal triggered redraws */
+#define REFRESH_MIN_INTERVAL_MS 1000
+
 static struct l_signal *window_change_signal;
 static struct l_io *io;
 static char dashed_line[LINE_LEN] = { [0 ... LINE_LEN - 2] = '-' };
@@ -61,6 +64,15 @@ static struct display_refresh {
 	size_t undo_lines;
 	struct l_queue *redo_entries;
 	bool recording;
+	/* The command is (re-)running and hasn't finished its output */
+	bool redrawing;
+	/* A D-Bus signal arrived since the last redraw */
+	bool pending;
+	uint64_t last_redraw;
+	/* Interfaces and object paths the command looked up for its output */
+	struct l_queue *watched_interfaces;
+	struct l_queue *watched_paths;
+	bool watching;
 } display_refresh = { .enabled = true };
 
 struct saved_input {
@@ -68,6 +80,26 @@ struct saved_input {
 	int point;
 };
 
+/*
+ * Either a list of rows or, for an object, a single set of properties.  Rows
+ * and properties are string vectors of alternating keys and values.
+ */
+struct structured_table {
+	char *name;
+	bool is_object;
+	char **properties;
+	struct l_queue *rows;
+};
+
+/* Machine readable output collected for the current command */
+static struct display_structured {
+	enum display_format format;
+	char *command;
+	struct l_queue *tables;
+	char **messages;
+	char **errors;
+} structured;
+
 static struct saved_input *save_input(void)
 {
 	struct saved_input *input;
@@ -104,6 +136,9 @@ static void display_refresh_undo_lines(void)
 {
 	size_t num_lines = display_refresh.undo_lines;
 
+	if (!num_lines)
+		return;
+
 	printf("\033[%dA", (int) num_lines);
 
 	do {
@@ -131,8 +166,6 @@ static void display_refresh_redo_lines(void)
 
 	restore_input(input);
 	display_refresh.recording = true;
-
-	l_timeout_modify(refresh_timeout, 1);
 }
 
 void display_refresh_reset(void)
@@ -151,8 +184,13 @@ void display_refresh_reset(void)
 
 	display_refresh.undo_lines = 0;
 	display_refresh.recording = false;
+	display_refresh.redrawing = false;
+	display_refresh.pending = false;
+	display_refresh.watching = false;
 
 	l_queue_clear(display_refresh.redo_entries, l_free);
+	l_queue_clear(display_refresh.watched_interfaces, l_free);
+	l_queue_clear(display_refresh.watched_paths, l_free);
 }
 
 void display_refresh_set_cmd(const char *family, const char *entity,
@@ -170,6 +208,16 @@ void display_refresh_set_cmd(const char *family, const char *entity,
 
 		display_refresh.cmd = cmd;
 
+		if (!display_refresh.redo_entries) {
+			display_refresh.redo_entries = l_queue_new();
+			display_refresh.watched_interfaces = l_queue_new();
+			display_refresh.watched_paths = l_queue_new();
+		}
+
+		l_queue_clear(display_refresh.watched_interfaces, l_free);
+		l_queue_clear(display_refresh.watched_paths, l_free);
+		display_refresh.watching = true;
+
 		l_strfreev(display_refresh.argv);
 		display_refresh.argc = argc;
 
@@ -182,6 +230,8 @@ void display_refresh_set_cmd(const char *family, const char *entity,
 
 		display_refresh.recording = false;
 		display_refresh.undo_lines = 0;
+		display_refresh.redrawing = true;
+		display_refresh.pending = false;
 
 		return;
 	}
@@ -226,6 +276,124 @@ void display_refresh_set_cmd(const char *family, const char *entity,
 	}
 }
 
+static void timeout_callback(struct l_timeout *timeout, void *user_data)
+{
+	struct saved_input *input;
+	enum cmd_status status;
+
+	if (!display_refresh.enabled || !display_refresh.cmd)
+		return;
+
+	display_refresh.pending = false;
+	display_refresh.redrawing = true;
+	display_refresh.watching = true;
+
+	input = save_input();
+	display_refresh_undo_lines();
+	restore_input(input);
+
+	display_refresh.recording = false;
+	status = display_refresh.cmd->function(display_refresh.entity,
+						display_refresh.argv,
+						display_refresh.argc);
+
+	if (status != CMD_STATUS_TRIGGERED && status != CMD_STATUS_DONE)
+		display_refresh_failed();
+}
+
+/*
+ * Re-run the command once something changed, but no sooner than
+ * REFRESH_MIN_INTERVAL_MS after the previous redraw and never while the
+ * previous output is still being produced.
+ */
+static void display_refresh_schedule(void)
+{
+	uint64_t elapsed_ms;
+	unsigned int delay_ms = 1;
+
+	if (!display_refresh.pending || display_refresh.redrawing ||
+			!display_refresh.enabled || !display_refresh.cmd)
+		return;
+
+	elapsed_ms = l_time_diff(display_refresh.last_redraw,
+						l_time_now()) / L_USEC_PER_MSEC;
+	if (elapsed_ms < REFRESH_MIN_INTERVAL_MS)
+		delay_ms = REFRESH_MIN_INTERVAL_MS - elapsed_ms;
+
+	if (refresh_timeout)
+		l_timeout_modify_ms(refresh_timeout, delay_ms);
+	else
+		refresh_timeout = l_timeout_create_ms(delay_ms,
+							timeout_callback,
+							NULL, NULL);
+}
+
+static bool display_refresh_str_match(const void *a, const void *b)
+{
+	return !strcmp(a, b);
+}
+
+void display_refresh_watch(const char *interface, const char *path)
+{
+	struct l_queue *watched = path ? display_refresh.watched_paths :
+					display_refresh.watched_interfaces;
+	const char *str = path ?: interface;
+
+	if (!display_refresh.watching || !str)
+		return;
+
+	if (l_queue_find(watched, display_refresh_str_match, str))
+		return;
+
+	l_queue_push_tail(watched, l_strdup(str));
+}
+
+/*
+ * A signal affects the output if it comes from an object under one of the
+ * watched paths, or from any object with one of the watched interfaces.
+ */
+static bool display_refresh_is_watched(const char *interface,
+							const char *path)
+{
+	const struct l_queue_entry *entry;
+
+	/* The command looked nothing up, e.g. it failed early */
+	if (l_queue_isempty(display_refresh.watched_interfaces) &&
+			l_queue_isempty(display_refresh.watched_paths))
+		return true;
+
+	if (interface && l_queue_find(display_refresh.watched_interfaces,
+					display_refresh_str_match, interface))
+		return true;
+
+	if (!path)
+		return false;
+
+	for (entry = l_queue_get_entries(display_refresh.watched_paths); entry;
+							entry = entry->next) {
+		const char *watched = entry->data;
+		size_t len = strlen(watched);
+
+		if (!strncmp(path, watched, len) &&
+				(path[len] == '\0' || path[len] == '/'))
+			return true;
+	}
+
+	return false;
+}
+
+void display_refresh_notify(const char *interface, const char *path)
+{
+	if (!display_refresh.cmd || !command_is_interactive_mode())
+		return;
+
+	if (!display_refresh_is_watched(interface, path))
+		return;
+
+	display_refresh.pending = true;
+	display_refresh_schedule();
+}
+
 static void display_refresh_check_feasibility(void)
 {
 	const struct winsize ws;
@@ -245,45 +413,38 @@ static void display_refresh_check_feasibility(void)
 		display_refresh.enabled = false;
 	} else {
 		display_refresh.enabled = true;
+		display_refresh_schedule();
 	}
 }
 
-static void display_refresh_check_applicability(void)
+/* The output is complete, whether the command succeeded or not */
+static void display_refresh_redraw_done(void)
 {
-	if (display_refresh.enabled && display_refresh.cmd)
-		display_refresh_redo_lines();
-	else if (display_refresh.cmd)
-		display_refresh_timeout_set();
+	display_refresh.redrawing = false;
+	display_refresh.watching = false;
+	display_refresh.last_redraw = l_time_now();
+	display_refresh_schedule();
 }
 
-static void timeout_callback(struct l_timeout *timeout, void *user_data)
+/*
+ * Failures that reach display_error() end the redraw there, this covers
+ * commands that fail without printing an error.
+ */
+void display_refresh_failed(void)
 {
-	struct saved_input *input;
-
-	if (!display_refresh.enabled || !display_refresh.cmd) {
-		if (display_refresh.cmd)
-			display_refresh_timeout_set();
+	if (display_refresh.redrawing)
+		display_refresh_redraw_done();
+}
 
+static void display_refresh_check_applicability(void)
+{
+	if (!display_refresh.cmd)
 		return;
-	}
 
-	input = save_input();
-	display_refresh_undo_lines();
-	restore_input(input);
+	if (display_refresh.enabled)
+		display_refresh_redo_lines();
 
-	display_refresh.recording = false;
-	display_refresh.cmd->function(display_refresh.entity,
-						display_refresh.argv,
-						display_refresh.argc);
-}
-
-void display_refresh_timeout_set(void)
-{
-	if (refresh_timeout)
-		l_timeout_modify(refresh_timeout, 1);
-	else
-		refresh_timeout = l_timeout_create(1, timeout_callback,
-							NULL, NULL);
+	display_refresh_redraw_done();
 }
 
 static void display_text(const char *text)
@@ -303,6 +464,376 @@ static void display_text(const char *text)
 		l_queue_push_tail(display_refresh.redo_entries, l_strdup(text));
 }
 
+/* Strips colors, readline markers and surrounding whitespace */
+static char *structured_clean(const char *text)
+{
+	struct l_string *buf = l_string_new(strlen(text) + 1);
+	char *ret;
+	const char *start;
+	const char *end;
+
+	while (*text) {
+		if (*text == 0x1b) {
+			while (*text && *text != 'm')
+				text++;
+
+			if (*text)
+				text++;
+
+			continue;
+		}
+
+		if (*text != '\001' && *text != '\002')
+			l_string_append_c(buf, *text);
+
+		text++;
+	}
+
+	ret = l_string_unwrap(buf);
+
+	for (start = ret; l_ascii_isspace(*start); start++)
+		;
+
+	for (end = start + strlen(start); end > start &&
+					l_ascii_isspace(end[-1]); end--)
+		;
+
+	memmove(ret, start, end - start);
+	ret[end - start] = '\0';
+
+	return ret;
+}
+
+static void structured_table_free(void *data)
+{
+	struct structured_table *table = data;
+
+	l_free(table->name);
+	l_strv_free(table->properties);
+	l_queue_destroy(table->rows, (l_queue_destroy_func_t) l_strv_free);
+	l_free(table);
+}
+
+static struct structured_table *structured_table_new(const char *name,
+							bool is_object)
+{
+	struct structured_table *table = l_new(struct structured_table, 1);
+
+	table->name = l_strdup(name);
+	table->is_object = is_object;
+	table->rows = l_queue_new();
+
+	if (!structured.tables)
+		structured.tables = l_queue_new();
+
+	l_queue_push_tail(structured.tables, table);
+
+	return table;
+}
+
+/*
+ * The display_structured_* calls are how command handlers describe their
+ * output for the JSON and key=value formats.  They are no-ops in text mode,
+ * where display_table_* and display() are used instead and ignored
+ * otherwise.  Names and keys should be stable, D-Bus names where possible.
+ */
+void display_structured_table(const char *name)
+{
+	if (structured.format == DISPLAY_FORMAT_TEXT)
+		return;
+
+	structured_table_new(name, false);
+}
+
+void display_structured_object(const char *name)
+{
+	if (structured.format == DISPLAY_FORMAT_TEXT)
+		return;
+
+	structured_table_new(name, true);
+}
+
+/* Takes NULL-terminated key, value pairs, NULL values become "" */
+void display_structured_row(const char *key, const char *value, ...)
+{
+	struct structured_table *table = l_queue_peek_tail(structured.tables);
+	char **row;
+	va_list args;
+
+	if (structured.format == DISPLAY_FORMAT_TEXT)
+		return;
+
+	if (!table || table->is_object)
+		table = structured_table_new("", false);
+
+	row = l_new(char *, 1);
+
+	va_start(args, value);
+
+	while (key) {
+		row = l_strv_append(row, key);
+		row = l_strv_append(row, value ? : "");
+
+		key = va_arg(args, const char *);
+		if (key)
+			value = va_arg(args, const char *);
+	}
+
+	va_end(args);
+
+	l_queue_push_tail(table->rows, row);
+}
+
+void display_structured_property(const char *key, const char *value)
+{
+	struct structured_table *table = l_queue_peek_tail(structured.tables);
+
+	if (structured.format == DISPLAY_FORMAT_TEXT)
+		return;
+
+	if (!table || !table->is_object)
+		table = structured_table_new("", true);
+
+	table->properties = l_strv_append(table->properties, key);
+	table->properties = l_strv_append(table->properties, value ? : "");
+}
+
+static void structured_text(char ***list, const char *text)
+{
+	char *clean = structured_clean(text);
+
+	if (*clean)
+		*list = l_strv_append(*list, clean);
+
+	l_free(clean);
+}
+
+void display_set_format(enum display_format format)
+{
+	structured.format = format;
+}
+
+enum display_format display_get_format(void)
+{
+	return structured.format;
+}
+
+void display_structured_begin(const char *command)
+{
+	l_free(structured.command);
+	structured.command = l_strdup(command);
+}
+
+static void json_append_string(struct l_string *buf, const char *str)
+{
+	l_string_append_c(buf, '"');
+
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			l_string_append_printf(buf, "\\%c", *str);
+		else if ((unsigned char) *str < 0x20)
+			l_string_append_printf(buf, "\\u%04x", *str);
+		else
+			l_string_append_c(buf, *str);
+	}
+
+	l_string_append_c(buf, '"');
+}
+
+static void json_append_pair(struct l_string *buf, bool first,
+				const char *key, const char *value)
+{
+	if (!first)
+		l_string_append_c(buf, ',');
+
+	json_append_string(buf, key);
+	l_string_append_c(buf, ':');
+	json_append_string(buf, value);
+}
+
+static void json_append_strv(struct l_string *buf, const char *key,
+				char **strv)
+{
+	unsigned int i;
+
+	if (!strv)
+		return;
+
+	l_string_append_printf(buf, ",\"%s\":[", key);
+
+	for (i = 0; strv[i]; i++) {
+		if (i)
+			l_string_append_c(buf, ',');
+
+		json_append_string(buf, strv[i]);
+	}
+
+	l_string_append_c(buf, ']');
+}
+
+/* Appends an object holding the key, value pairs in @strv */
+static void json_append_map(struct l_string *buf, char **strv)
+{
+	unsigned int i;
+
+	l_string_append_c(buf, '{');
+
+	for (i = 0; strv && strv[i] && strv[i + 1]; i += 2)
+		json_append_pair(buf, i == 0, strv[i], strv[i + 1]);
+
+	l_string_append_c(buf, '}');
+}
+
+static void structured_render_json(struct l_string *buf, bool success)
+{
+	const struct l_queue_entry *entry;
+
+	l_string_append(buf, "{\"command\":");
+	json_append_string(buf, structured.command ? : "");
+	l_string_append_printf(buf, ",\"success\":%s",
+					success ? "true" : "false");
+
+	if (structured.tables)
+		l_string_append(buf, ",\"tables\":[");
+
+	for (entry = l_queue_get_entries(structured.tables); entry;
+							entry = entry->next) {
+		struct structured_table *table = entry->data;
+		const struct l_queue_entry *row_entry;
+
+		if (entry != l_queue_get_entries(structured.tables))
+			l_string_append_c(buf, ',');
+
+		l_string_append(buf, "{\"name\":");
+		json_append_string(buf, table->name);
+
+		if (table->is_object) {
+			l_string_append(buf, ",\"properties\":");
+			json_append_map(buf, table->properties);
+			l_string_append_c(buf, '}');
+			continue;
+		}
+
+		l_string_append(buf, ",\"rows\":[");
+
+		for (row_entry = l_queue_get_entries(table->rows); row_entry;
+						row_entry = row_entry->next) {
+			if (row_entry != l_queue_get_entries(table->rows))
+				l_string_append_c(buf, ',');
+
+			json_append_map(buf, row_entry->data);
+		}
+
+		l_string_append(buf, "]}");
+	}
+
+	if (structured.tables)
+		l_string_append_c(buf, ']');
+
+	json_append_strv(buf, "messages", structured.messages);
+	json_append_strv(buf, "errors", structured.errors);
+
+	l_string_append(buf, "}\n");
+}
+
+static void kv_append_pair(struct l_string *buf, const char *key,
+				const char *value)
+{
+	l_string_append_printf(buf, "%s=\"", key);
+
+	for (; *value; value++) {
+		if (*value == '"' || *value == '\\')
+			l_string_append_c(buf, '\\');
+
+		if (*value == '\n')
+			l_string_append(buf, "\\n");
+		else
+			l_string_append_c(buf, *value);
+	}
+
+	l_string_append_c(buf, '"');
+}
+
+static void kv_append_strv(struct l_string *buf, const char *key,
+				char **strv)
+{
+	for (; strv && *strv; strv++) {
+		kv_append_pair(buf, key, *strv);
+		l_string_append_c(buf, '\n');
+	}
+}
+
+/*
+ * A table="name" line followed by one line of key="value" pairs per row, or
+ * an object="name" line followed by one key="value" line per property.  Each
+ * command's block ends with a blank line.
+ */
+static void structured_render_kv(struct l_string *buf, bool success)
+{
+	const struct l_queue_entry *entry;
+
+	kv_append_pair(buf, "command", structured.command ? : "");
+	l_string_append_c(buf, '\n');
+
+	for (entry = l_queue_get_entries(structured.tables); entry;
+							entry = entry->next) {
+		struct structured_table *table = entry->data;
+		const struct l_queue_entry *row_entry;
+		char **strv;
+
+		kv_append_pair(buf, table->is_object ? "object" : "table",
+				table->name);
+		l_string_append_c(buf, '\n');
+
+		for (strv = table->properties; strv && strv[0] && strv[1];
+								strv += 2) {
+			kv_append_pair(buf, strv[0], strv[1]);
+			l_string_append_c(buf, '\n');
+		}
+
+		for (row_entry = l_queue_get_entries(table->rows); row_entry;
+						row_entry = row_entry->next) {
+			for (strv = row_entry->data; strv[0] && strv[1];
+								strv += 2) {
+				if (strv != row_entry->data)
+					l_string_append_c(buf, ' ');
+
+				kv_append_pair(buf, strv[0], strv[1]);
+			}
+
+			l_string_append_c(buf, '\n');
+		}
+	}
+
+	kv_append_strv(buf, "message", structured.messages);
+	kv_append_strv(buf, "error", structured.errors);
+
+	l_string_append_printf(buf, "success=%s\n\n",
+					success ? "true" : "false");
+}
+
+/*
+ * Renders everything displayed since display_structured_begin() and resets
+ * the collected state for the next command.
+ */
+char *display_structured_end(bool success)
+{
+	struct l_string *buf = l_string_new(512);
+
+	if (structured.format == DISPLAY_FORMAT_JSON)
+		structured_render_json(buf, success);
+	else
+		structured_render_kv(buf, success);
+
+	l_free(l_steal_ptr(structured.command));
+	l_queue_destroy(l_steal_ptr(structured.tables),
+						structured_table_free);
+	l_strv_free(l_steal_ptr(structured.messages));
+	l_strv_free(l_steal_ptr(structured.errors));
+
+	return l_string_unwrap(buf);
+}
+
 void display(const char *fmt, ...)
 {
 	va_list args;
@@ -312,18 +843,31 @@ void display(const char *fmt, ...)
 	text = l_strdup_vprintf(fmt, args);
 	va_end(args);
 
-	display_text(text);
+	if (structured.format != DISPLAY_FORMAT_TEXT)
+		structured_text(&structured.messages, text);
+	else
+		display_text(text);
 
 	l_free(text);
 }
 
 void display_error(const char *error)
 {
-	char *text = l_strdup_printf(COLOR_RED("%s\n"), error);
+	char *text;
+
+	if (structured.format != DISPLAY_FORMAT_TEXT) {
+		structured_text(&structured.errors, error);
+		return;
+	}
+
+	text = l_strdup_printf(COLOR_RED("%s\n"), error);
 
 	display_text(text);
 
 	l_free(text);
+
+	/* A command that fails won't print the table footer */
+	display_refresh_failed();
 }
 
 static char get_flasher(void)
@@ -346,6 +890,10 @@ void display_table_header(const char *caption, const char *fmt, ...)
 	int caption_pos =
 		(int) ((sizeof(dashed_line) - 1) / 2 + strlen(caption) / 2);
 
+	/* Handlers describe tables with display_structured_* instead */
+	if (structured.format != DISPLAY_FORMAT_TEXT)
+		return;
+
 	text = l_strdup_printf("%*s" COLOR_BOLDGRAY("%*c") "\n",
 				caption_pos, caption,
 				LINE_LEN - 2 - caption_pos,
@@ -373,6 +921,9 @@ void display_table_header(const char *caption, const char *fmt, ...)
 
 void display_table_footer(void)
 {
+	if (structured.format != DISPLAY_FORMAT_TEXT)
+		return;
+
 	display_text("\n");
 
 	display_refresh_check_applicability();
@@ -542,6 +1093,9 @@ void display_table_row(const char *margin, unsigned int ncolumns, ...)
 	struct table_entry entries[ncolumns];
 	va_list va;
 
+	if (structured.format != DISPLAY_FORMAT_TEXT)
+		return;
+
 	memset(&entries[0], 0, sizeof(entries));
 
 	va_start(va, ncolumns);
@@ -612,6 +1166,8 @@ void display_command_line(const char *command_family, const struct command *cmd)
 				cmd->arg ? " " : "",
 				cmd->arg ? : "");
 
+	display_structured_row("Command", cmd_line,
+				"Description", cmd->desc, NULL);
 	display_table_row(MARGIN, 2, 50, cmd_line, 30, cmd->desc);
 
 	l_free(cmd_line);
@@ -907,8 +1463,6 @@ void display_init(void)
 	const char *data_home;
 	char *data_path;
 
-	display_refresh.redo_entries = l_queue_new();
-
 	stifle_history(24);
 
 	data_home = getenv("XDG_DATA_HOME");
@@ -971,6 +1525,11 @@ void display_exit(void)
 	refresh_timeout = NULL;
 
 	l_queue_destroy(display_refresh.redo_entries, l_free);
+	display_refresh.redo_entries = NULL;
+	l_queue_destroy(display_refresh.watched_interfaces, l_free);
+	display_refresh.watched_interfaces = NULL;
+	l_queue_destroy(display_refresh.watched_paths, l_free);
+	display_refresh.watched_paths = NULL;
 
 	rl_callback_handler_remove();
 
@@ -32,6 +32,12 @@ struct command_family;
 #define CLEAR_SCREEN		"\x1b[2J"
 #define MARGIN			"  "
 
+enum display_format {
+	DISPLAY_FORMAT_TEXT = 0,
+	DISPLAY_FORMAT_JSON,
+	DISPLAY_FORMAT_KEY_VALUE,
+};
+
 void display(const char *format, ...)
 		__attribute__((format(printf, 1, 2)));
 void display_table_header(const char *caption, const char *fmt, ...)
@@ -42,7 +48,19 @@ void display_error(const char *error);
 void display_command_line(const char *command_family,
 						const struct command *cmd);
 
-void display_refresh_timeout_set(void);
+void display_set_format(enum display_format format);
+enum display_format display_get_format(void);
+void display_structured_begin(const char *command);
+char *display_structured_end(bool success);
+void display_structured_table(const char *name);
+void display_structured_object(const char *name);
+void display_structured_row(const char *key, const char *value, ...)
+		__attribute__((sentinel));
+void display_structured_property(const char *key, const char *value);
+
+void display_refresh_watch(const char *interface, const char *path);
+void display_refresh_notify(const char *interface, const char *path);
+void display_refresh_failed(void);
 void display_refresh_reset(void);
 void display_refresh_set_cmd(const char *family, const char *entity,
 					const struct command *cmd,
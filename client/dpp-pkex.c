@@ -68,7 +68,8 @@ static void display_pkex_inline(const char *margin, const void *data)
 	if (!identity)
 		return;
 
-	display("%s%-*s\n", margin, 20, identity);
+	display_structured_row("Name", identity, NULL);
+	display_table_row(margin, 1, 20, identity);
 }
 
 static void check_errors_method_callback(struct l_dbus_message *message,
@@ -85,6 +86,7 @@ static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
 
 	display_table_header("DPP-PKEX-capable Devices",
 				MARGIN "%-*s", 20, "Name");
+	display_structured_table(IWD_DPP_PKEX_INTERFACE);
 
 	if (!match) {
 		display("No DPP-PKEX-capable devices available\n");
@@ -196,7 +196,8 @@ static void display_dpp_inline(const char *margin, const void *data)
 	if (!identity)
 		return;
 
-	display("%s%-*s\n", margin, 20, identity);
+	display_structured_row("Name", identity, NULL);
+	display_table_row(margin, 1, 20, identity);
 }
 
 static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
@@ -206,6 +207,7 @@ static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
 		proxy_interface_find_all(IWD_DPP_INTERFACE, NULL, NULL);
 
 	display_table_header("DPP-capable Devices", MARGIN "%-*s", 20, "Name");
+	display_structured_table(IWD_DPP_INTERFACE);
 
 	if (!match) {
 		display("No DPP-capable devices available\n");
@@ -209,6 +209,11 @@ static void known_network_display_inline(const char *margin, const void *data)
 		l_strdup(format_iso8601(network->last_connected,
 						"%b %e, %l:%M %p"));
 
+	display_structured_row("Name", network->name,
+				"Type", network->type,
+				"Hidden", network->hidden ? "yes" : "no",
+				"LastConnectedTime", network->last_connected,
+				NULL);
 	display_table_row(margin, 4, 32, network->name, 11, network->type,
 			9, get_hidden_tostr(network),
 			19, last_connected ? : "-");
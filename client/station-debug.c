@@ -182,18 +182,23 @@ static uint32_t get_i32(struct l_dbus_message_iter *variant)
 	return i32;
 }
 
-static void display_bss(struct bss *bss)
+static void display_bss(const char *ssid, struct bss *bss)
 {
-	char row[128];
-
-	sprintf(row, "%s%-*s  %s  %-*i  %-*u  %-*i  %02x%02x%02x",
-		MARGIN MARGIN, 4, "", bss->addr, 4, bss->rssi,
-		6, bss->frequency, 8, bss->rank,
-		bss->mde[0], bss->mde[1], bss->mde[2]);
-
-	display("%s\n", row);
-
-	return;
+	char rssi[8];
+	char frequency[12];
+	char rank[12];
+	char mde[8];
+
+	sprintf(rssi, "%i", bss->rssi);
+	sprintf(frequency, "%u", bss->frequency);
+	sprintf(rank, "%i", bss->rank);
+	sprintf(mde, "%02x%02x%02x", bss->mde[0], bss->mde[1], bss->mde[2]);
+
+	display_structured_row("SSID", ssid, "BSSID", bss->addr,
+				"RSSI", rssi, "Frequency", frequency,
+				"Rank", rank, "MDE", mde, NULL);
+	display_table_row(MARGIN MARGIN, 6, 4, "", 17, bss->addr, 4, rssi,
+				6, frequency, 8, rank, 10, mde);
 }
 
 static void get_networks_method_callback(struct l_dbus_message *message,
@@ -219,6 +224,7 @@ static void get_networks_method_callback(struct l_dbus_message *message,
 				"%s%-*s  %-*s  %-*s  %-*s  %-*s  %-*s  %-*s",
 				"", 2, "", 4, "SSID", 17, "BSSID", 4, "RSSI",
 				6, "Freq", 8, "Rank", 10, "MDE");
+	display_structured_table(IWD_STATION_DEBUG_INTERFACE);
 
 	while (l_dbus_message_iter_next_entry(&iter, &key, &array)) {
 		struct network *network = l_new(struct network, 1);
@@ -247,7 +253,7 @@ static void get_networks_method_callback(struct l_dbus_message *message,
 					get_byte_array(&variant, bss->mde, 3);
 			}
 
-			display_bss(bss);
+			display_bss(network->ssid, bss);
 
 			l_queue_push_tail(network->bss_list, bss);
 		}
@@ -156,6 +156,8 @@ static void display_addresses(const char *device_name)
 	if (getifaddrs(&ifa) == -1)
 		return;
 
+	display_structured_table("Addresses");
+
 	for (cur = ifa; cur; cur = cur->ifa_next) {
 		if (cur->ifa_addr == NULL)
 			continue;
@@ -175,6 +177,8 @@ static void display_addresses(const char *device_name)
 				continue;
 
 			have_address = true;
+			display_structured_row("Family", "IPv6",
+						"Address", addrstr, NULL);
 			display_table_row(MARGIN, 3, 8, "", 20,
 						"IPv6 address", 47, addrstr);
 		} else if (cur->ifa_addr->sa_family == AF_INET) {
@@ -186,6 +190,8 @@ static void display_addresses(const char *device_name)
 				continue;
 
 			have_address = true;
+			display_structured_row("Family", "IPv4",
+						"Address", addrstr, NULL);
 			display_table_row(MARGIN, 3, 8, "", 20, "IPv4 address", 47, addrstr);
 		}
 	}
@@ -213,6 +219,8 @@ static void display_station(const char *device_name,
 	l_free(caption);
 
 	if (station->connected_network) {
+		display_structured_property("ConnectedNetwork",
+				network_get_name(station->connected_network));
 		display_table_row(MARGIN, 3, 8, "", 20, "Connected network",
 			47, network_get_name(station->connected_network));
 
@@ -238,6 +246,10 @@ static void display_station_inline(const char *margin, const void *data)
 	if (!identity)
 		return;
 
+	display_structured_row("Name", identity,
+				"State", station->state,
+				"Scanning", station->scanning ? "yes" : "no",
+				NULL);
 	display_table_row(margin, 3, 20, identity, 15, station->state ? : "",
 				8, station->scanning ? "scanning" : "");
 }
@@ -251,6 +263,7 @@ static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
 	display_table_header("Devices in Station Mode",
 				MARGIN "%-*s  %-*s  %-*s",
 				20, "Name", 15, "State", 8, "Scanning");
+	display_structured_table(IWD_STATION_INTERFACE);
 
 	if (!match) {
 		display("No devices in Station mode available.\n");
@@ -427,6 +440,7 @@ static void ordered_networks_display(struct l_queue *ordered_networks)
 	display_table_header("Available networks", "%s%-*s  %-*s  %-*s  %*s",
 					MARGIN, 2, "", 32, "Network name",
 					18, "Security", 6, "Signal");
+	display_structured_table(IWD_NETWORK_INTERFACE);
 
 	if (!l_queue_length(ordered_networks)) {
 		display("No networks available\n");
@@ -442,6 +456,16 @@ static void ordered_networks_display(struct l_queue *ordered_networks)
 				network_get_proxy(network->network_path);
 		const char *network_name = network_get_name(network_i);
 		const char *network_type = network_get_type(network_i);
+		char signal[7];
+
+		/* In 100 * dBm, as returned by GetOrderedNetworks */
+		snprintf(signal, sizeof(signal), "%d",
+						network->signal_strength);
+		display_structured_row("Name", network_name,
+				"Type", network_type,
+				"Connected", network_is_connected(network_i) ?
+						"yes" : "no",
+				"SignalStrength", signal, NULL);
 
 		if (!strcmp(network_type, "wep"))
 			network_type = "wep (unsupported)";
@@ -567,6 +591,7 @@ static void hidden_access_points_display(struct l_queue *access_points)
 
 	display_table_header("Available hidden APs", MARGIN "%-*s  %-*s  %*s",
 				20, "Address", 10, "Security", 6, "Signal");
+	display_structured_table("HiddenAccessPoints");
 
 	if (l_queue_isempty(access_points)) {
 		display("No hidden APs are available.\n");
@@ -579,6 +604,12 @@ static void hidden_access_points_display(struct l_queue *access_points)
 							entry = entry->next) {
 		const struct hidden_access_point *ap = entry->data;
 		L_AUTO_FREE_VAR(char *, dbms) = NULL;
+		char signal[7];
+
+		snprintf(signal, sizeof(signal), "%d", ap->signal_strength);
+		display_structured_row("Address", ap->address,
+					"Type", ap->type,
+					"SignalStrength", signal, NULL);
 
 		if (display_signal_as_dbms)
 			dbms = l_strdup_printf("%d", ap->signal_strength);
@@ -684,6 +715,7 @@ static void get_diagnostics_callback(struct l_dbus_message *message,
 		goto done;
 	}
 
+	display_structured_object(IWD_STATION_DIAGNOSTIC_INTERFACE);
 	diagnostic_display(&iter, MARGIN, 20, 47);
 
 done:
@@ -764,6 +796,8 @@ static enum cmd_status cmd_get_bsses(const char *device_name,
 		if (!bss_i)
 			continue;
 
+		display_structured_object(IWD_BSS_INTERFACE);
+		display_structured_property("Path", path);
 		display_table_row(MARGIN, 1, strlen(path), path);
 		proxy_properties_display_inline(bss_i, MARGIN, 10, 18);
 		display_table_row(MARGIN, 1, 1, "");
@@ -78,7 +78,8 @@ static void display_wsc_inline(const char *margin, const void *data)
 	if (!identity)
 		return;
 
-	display("%s%-*s\n", margin, 20, identity);
+	display_structured_row("Name", identity, NULL);
+	display_table_row(margin, 1, 20, identity);
 }
 
 static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
@@ -88,6 +89,7 @@ static enum cmd_status cmd_list(const char *device_name, char **argv, int argc)
 		proxy_interface_find_all(IWD_WSC_INTERFACE, NULL, NULL);
 
 	display_table_header("WSC-capable Devices", MARGIN "%-*s", 20, "Name");
+	display_structured_table(IWD_WSC_INTERFACE);
 
 	if (!match) {
 		display("No WSC-capable devices available\n");
@@ -30,6 +30,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <getopt.h>
 #include <signal.h>
 #include <unistd.h>
@@ -627,6 +628,9 @@ static int process_pcap(struct pcap *pcap, const struct nlmon_config *config)
 {
 	struct nlmon *nlmon = NULL;
 	struct timeval tv;
+	struct timespec start, end;
+	unsigned int packets = 0;
+	double elapsed;
 	uint8_t *buf;
 	uint32_t snaplen, len, real_len;
 
@@ -642,6 +646,8 @@ static int process_pcap(struct pcap *pcap, const struct nlmon_config *config)
 
 	nlmon = nlmon_create(0, config);
 
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
 	while (pcap_read(pcap, &tv, buf, snaplen, &len, &real_len)) {
 		uint16_t arphrd_type;
 		uint16_t proto_type;
@@ -660,6 +666,7 @@ static int process_pcap(struct pcap *pcap, const struct nlmon_config *config)
 		pkt_type = l_get_be16(buf);
 		arphrd_type = l_get_be16(buf + 2);
 		proto_type = l_get_be16(buf + 14);
+		packets++;
 
 		switch (arphrd_type) {
 		case ARPHRD_ETHER:
@@ -688,8 +695,18 @@ static int process_pcap(struct pcap *pcap, const struct nlmon_config *config)
 		}
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
 	nlmon_destroy(nlmon);
 
+	if (config->decode_only) {
+		elapsed = (end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec) / 1e9;
+		fprintf(stderr, "Decoded %u packets in %.3f seconds "
+				"(%.0f packets/s)\n", packets, elapsed,
+				elapsed > 0 ? packets / elapsed : 0);
+	}
+
 	free(buf);
 
 	return EXIT_SUCCESS;
@@ -726,6 +743,7 @@ static void usage(void)
 		"\t-y, --nowiphy          Don't show 'New Wiphy' output\n"
 		"\t-s, --noscan           Don't show scan result output\n"
 		"\t-e, --noies            Don't show IEs except SSID\n"
+		"\t-d, --decode-only      Decode PCAP without printing\n"
 		"\t-h, --help             Show help options\n");
 }
 
@@ -739,6 +757,7 @@ static const struct option main_options[] = {
 	{ "nowiphy",   no_argument,       NULL, 'y' },
 	{ "noscan",    no_argument,       NULL, 's' },
 	{ "noies",     no_argument,       NULL, 'e' },
+	{ "decode-only", no_argument,     NULL, 'd' },
 	{ "version",   no_argument,       NULL, 'v' },
 	{ "help",      no_argument,       NULL, 'h' },
 	{ }
@@ -754,7 +773,7 @@ int main(int argc, char *argv[])
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "r:w:a:i:nvhyse",
+		opt = getopt_long(argc, argv, "r:w:a:i:nvhysed",
 						main_options, NULL);
 		if (opt < 0)
 			break;
@@ -785,6 +804,9 @@ int main(int argc, char *argv[])
 		case 'e':
 			config.noies = true;
 			break;
+		case 'd':
+			config.decode_only = true;
+			break;
 		case 'v':
 			printf("%s\n", VERSION);
 			return EXIT_SUCCESS;
@@ -806,6 +828,11 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (config.decode_only && !reader_path) {
+		fprintf(stderr, "Decode only requires a PCAP file to read\n");
+		return EXIT_FAILURE;
+	}
+
 	if (!l_main_init())
 		return EXIT_FAILURE;
 
@@ -819,7 +846,17 @@ int main(int argc, char *argv[])
 	if (reader_path) {
 		struct pcap *pcap;
 
-		open_pager();
+		/*
+		 * Most output is skipped entirely, anything printed directly
+		 * is discarded so only decoding is measured.
+		 */
+		if (config.decode_only) {
+			if (!freopen("/dev/null", "w", stdout)) {
+				exit_status = EXIT_FAILURE;
+				goto done;
+			}
+		} else
+			open_pager();
 
 		pcap = pcap_open(reader_path);
 		if (!pcap) {
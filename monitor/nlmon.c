@@ -159,6 +159,70 @@ struct attr_entry {
 static void print_attributes(int indent, const struct attr_entry *table,
 						const void *buf, uint32_t len);
 
+/* Direct lookup of an attribute table's entries by attribute type */
+struct attr_index {
+	uint16_t max_attr;
+	const struct attr_entry *entries[];
+};
+
+static struct l_hashmap *attr_indexes = NULL;
+
+static struct attr_index *attr_index_build(const struct attr_entry *table)
+{
+	struct attr_index *index;
+	uint16_t max_attr = 0;
+	int i;
+
+	for (i = 0; table[i].str; i++)
+		if (table[i].attr > max_attr)
+			max_attr = table[i].attr;
+
+	index = l_malloc(sizeof(struct attr_index) +
+			(max_attr + 1) * sizeof(const struct attr_entry *));
+	index->max_attr = max_attr;
+	memset(index->entries, 0,
+			(max_attr + 1) * sizeof(const struct attr_entry *));
+
+	/* Keep the first entry for an attribute, as a table scan would */
+	for (i = 0; table[i].str; i++)
+		if (!index->entries[table[i].attr])
+			index->entries[table[i].attr] = &table[i];
+
+	return index;
+}
+
+/*
+ * Each table is indexed the first time it is used and kept until the
+ * monitor is destroyed, so lookups no longer scan the table for every
+ * attribute.
+ */
+static const struct attr_entry *attr_index_lookup(
+					const struct attr_entry *table,
+					uint16_t attr)
+{
+	struct attr_index *index;
+
+	if (!attr_indexes)
+		attr_indexes = l_hashmap_new();
+
+	index = l_hashmap_lookup(attr_indexes, table);
+	if (!index) {
+		index = attr_index_build(table);
+		l_hashmap_insert(attr_indexes, table, index);
+	}
+
+	if (attr > index->max_attr)
+		return NULL;
+
+	return index->entries[attr];
+}
+
+static void attr_indexes_free(void)
+{
+	l_hashmap_destroy(attr_indexes, l_free);
+	attr_indexes = NULL;
+}
+
 struct flag_names {
 	uint16_t flag;
 	const char *name;
@@ -185,6 +249,7 @@ static void nlmon_req_free(void *data)
 }
 
 static time_t time_offset = ((time_t) -1);
+static bool decode_only = false;
 
 static inline void update_time_offset(const struct timeval *tv)
 {
@@ -194,6 +259,8 @@ static inline void update_time_offset(const struct timeval *tv)
 
 #define print_indent(indent, color1, prefix, title, color2, fmt, args...) \
 do { \
+	if (decode_only) \
+		break; \
 	printf("%*c%s%s%s%s" fmt "%s\n", (indent), ' ', \
 		use_color() ? (color1) : "", prefix, title, \
 		use_color() ? (color2) : "", ## args, \
@@ -224,6 +291,9 @@ static void print_packet(const struct timeval *tv, char ident,
 	char line[256], ts_str[64];
 	int n, ts_len = 0, ts_pos = 0, len = 0, pos = 0;
 
+	if (decode_only)
+		return;
+
 	if (tv) {
 		if (use_color()) {
 			n = sprintf(ts_str + ts_pos, "%s", COLOR_TIMESTAMP);
@@ -2618,7 +2688,6 @@ static void print_ie(unsigned int level, const char *label,
 					const void *data, uint16_t size)
 {
 	struct ie_tlv_iter iter;
-	int i;
 
 	print_attr(level, "%s: len %u", label, size);
 
@@ -2626,14 +2695,8 @@ static void print_ie(unsigned int level, const char *label,
 
 	while (ie_tlv_iter_next(&iter)) {
 		uint16_t tag = ie_tlv_iter_get_tag(&iter);
-		struct attr_entry *entry = NULL;
-
-		for (i = 0; ie_entry[i].str; i++) {
-			if (ie_entry[i].attr == tag) {
-				entry = &ie_entry[i];
-				break;
-			}
-		}
+		const struct attr_entry *entry =
+				attr_index_lookup(ie_entry, tag);
 
 		if (cur_nlmon && cur_nlmon->noies && tag != IE_TYPE_SSID)
 			continue;
@@ -3321,7 +3384,6 @@ static void print_wsc_wfa_ext_attributes(unsigned int level, const char *label,
 						const void *data, uint16_t size)
 {
 	struct wsc_wfa_ext_iter iter;
-	int i;
 
 	print_attr(level, "%s: len %u", label, size);
 
@@ -3331,14 +3393,8 @@ static void print_wsc_wfa_ext_attributes(unsigned int level, const char *label,
 		uint8_t type = wsc_wfa_ext_iter_get_type(&iter);
 		uint8_t len = wsc_wfa_ext_iter_get_length(&iter);
 		const void *attr = wsc_wfa_ext_iter_get_data(&iter);
-		struct attr_entry *entry = NULL;
-
-		for (i = 0; wsc_wfa_ext_attr_entry[i].str; i++) {
-			if (wsc_wfa_ext_attr_entry[i].attr == type) {
-				entry = &wsc_wfa_ext_attr_entry[i];
-				break;
-			}
-		}
+		const struct attr_entry *entry =
+				attr_index_lookup(wsc_wfa_ext_attr_entry, type);
 
 		if (entry && entry->function)
 			entry->function(level + 1, entry->str, attr, len);
@@ -3476,7 +3532,6 @@ static void print_wsc_attributes(unsigned int level, const char *label,
 					const void *data, uint16_t size)
 {
 	struct wsc_attr_iter iter;
-	int i;
 
 	print_attr(level, "%s: len %u", label, size);
 
@@ -3486,14 +3541,8 @@ static void print_wsc_attributes(unsigned int level, const char *label,
 		uint16_t type = wsc_attr_iter_get_type(&iter);
 		uint16_t len = wsc_attr_iter_get_length(&iter);
 		const void *attr = wsc_attr_iter_get_data(&iter);
-		struct attr_entry *entry = NULL;
-
-		for (i = 0; wsc_attr_entry[i].str; i++) {
-			if (wsc_attr_entry[i].attr == type) {
-				entry = &wsc_attr_entry[i];
-				break;
-			}
-		}
+		const struct attr_entry *entry =
+				attr_index_lookup(wsc_attr_entry, type);
 
 		if (entry && entry->function)
 			entry->function(level + 1, entry->str, attr, len);
@@ -4160,7 +4209,6 @@ static void print_p2p_attributes(unsigned int level, const char *label,
 					const void *data, uint16_t size)
 {
 	struct p2p_attr_iter iter;
-	int i;
 
 	print_attr(level, "%s: len %u", label, size);
 
@@ -4170,14 +4218,8 @@ static void print_p2p_attributes(unsigned int level, const char *label,
 		uint16_t type = p2p_attr_iter_get_type(&iter);
 		uint16_t len = p2p_attr_iter_get_length(&iter);
 		const void *attr = p2p_attr_iter_get_data(&iter);
-		struct attr_entry *entry = NULL;
-
-		for (i = 0; p2p_attr_entry[i].str; i++) {
-			if (p2p_attr_entry[i].attr == type) {
-				entry = &p2p_attr_entry[i];
-				break;
-			}
-		}
+		const struct attr_entry *entry =
+				attr_index_lookup(p2p_attr_entry, type);
 
 		if (entry && entry->function)
 			entry->function(level + 1, entry->str, attr, len);
@@ -4426,7 +4468,6 @@ static void print_wfd_subelements(unsigned int level, const char *label,
 					const void *data, uint16_t size)
 {
 	struct wfd_subelem_iter iter;
-	int i;
 
 	print_attr(level, "%s: len %u", label, size);
 
@@ -4436,14 +4477,8 @@ static void print_wfd_subelements(unsigned int level, const char *label,
 		uint16_t type = wfd_subelem_iter_get_type(&iter);
 		uint16_t len = wfd_subelem_iter_get_length(&iter);
 		const void *attr = wfd_subelem_iter_get_data(&iter);
-		struct attr_entry *entry = NULL;
-
-		for (i = 0; wfd_subelem_entry[i].str; i++) {
-			if (wfd_subelem_entry[i].attr == type) {
-				entry = &wfd_subelem_entry[i];
-				break;
-			}
-		}
+		const struct attr_entry *entry =
+				attr_index_lookup(wfd_subelem_entry, type);
 
 		if (!entry)
 			continue;
@@ -7006,10 +7041,10 @@ static void print_attributes(int indent, const struct attr_entry *table,
 {
 	const struct nlattr *nla;
 	const char *str;
-	int i;
 
 	for (nla = buf ; NLA_OK(nla, len); nla = NLA_NEXT(nla, len)) {
 		uint16_t nla_type = nla->nla_type & NLA_TYPE_MASK;
+		const struct attr_entry *entry = NULL;
 		enum attr_type type;
 		enum attr_type array_type;
 		const struct attr_entry *nested;
@@ -7028,17 +7063,15 @@ static void print_attributes(int indent, const struct attr_entry *table,
 		array_type = ATTR_UNSPEC;
 		nested = NULL;
 
-		if (table) {
-			for (i = 0; table[i].str; i++) {
-				if (nla_type == table[i].attr) {
-					str = table[i].str;
-					type = table[i].type;
-					nested = table[i].nested;
-					array_type = table[i].array_type;
-					function = table[i].function;
-					break;
-				}
-			}
+		if (table)
+			entry = attr_index_lookup(table, nla_type);
+
+		if (entry) {
+			str = entry->str;
+			type = entry->type;
+			nested = entry->nested;
+			array_type = entry->array_type;
+			function = entry->function;
 		}
 
 		switch (type) {
@@ -7128,7 +7161,7 @@ static void print_attributes(int indent, const struct attr_entry *table,
 						NLA_PAYLOAD(nla));
 			if (array_type == ATTR_UNSPEC)
 				printf("missing type\n");
-			print_array(indent + 1, array_type, &table[i],
+			print_array(indent + 1, array_type, entry,
 					NLA_DATA(nla), NLA_PAYLOAD(nla));
 			break;
 		case ATTR_FLAG_OR_U16:
@@ -7475,6 +7508,8 @@ struct nlmon *nlmon_create(uint16_t id, const struct nlmon_config *config)
 	nlmon->noies = config->noies;
 	nlmon->read = config->read_only;
 
+	decode_only = config->decode_only;
+
 	return nlmon;
 }
 
@@ -7484,6 +7519,7 @@ void nlmon_destroy(struct nlmon *nlmon)
 		return;
 
 	l_queue_destroy(nlmon->req_list, nlmon_req_free);
+	attr_indexes_free();
 
 	l_free(nlmon);
 }
@@ -7820,19 +7856,18 @@ static void print_rtnl_attributes(int indent, const struct attr_entry *table,
 		int8_t val_s8;
 		int32_t val_s32;
 		int64_t val_s64;
+		const struct attr_entry *entry;
 		const char *str;
-		int i, payload;
+		int payload;
 
 		str = "Reserved";
 
-		for (i = 0; table[i].str; i++) {
-			if (rta_type == table[i].attr) {
-				str = table[i].str;
-				type = table[i].type;
-				function = table[i].function;
-				nested = table[i].nested;
-				break;
-			}
+		entry = attr_index_lookup(table, rta_type);
+		if (entry) {
+			str = entry->str;
+			type = entry->type;
+			function = entry->function;
+			nested = entry->nested;
 		}
 
 		payload = RTA_PAYLOAD(attr);
@@ -8535,6 +8570,7 @@ void nlmon_close(struct nlmon *nlmon)
 
 	l_hashmap_destroy(wlan_iface_list, wlan_iface_list_free);
 	wlan_iface_list = NULL;
+	attr_indexes_free();
 
 	if (nlmon->pcap)
 		pcap_close(nlmon->pcap);
@@ -31,6 +31,7 @@ struct nlmon_config {
 	bool noscan;
 	bool noies;
 	bool read_only;
+	bool decode_only;
 };
 
 struct nlmon *nlmon_open(uint16_t id, const char *pathname,
@@ -50,7 +50,9 @@ struct adhoc_state {
 	struct l_genl_family *nl80211;
 	char *ssid;
 	uint8_t pmk[32];
-	struct l_queue *sta_states;
+	struct l_hashmap *sta_states;
+	struct l_queue *gtk_waiters;
+	uint32_t gtk_query_cmd_id;
 	uint32_t sta_watch_id;
 	uint32_t netdev_watch_id;
 	unsigned int mlme_watch;
@@ -71,14 +73,43 @@ struct sta_state {
 	struct handshake_state *hs_sta;
 	struct eapol_sm *sm_a;
 	struct handshake_state *hs_auth;
-	uint32_t gtk_query_cmd_id;
+	uint64_t new_time;
+	uint64_t authenticated_time;
+	uint32_t handshake_attempts;
 	bool hs_sta_done : 1;
 	bool hs_auth_done : 1;
 	bool authenticated : 1;
+	bool gtk_waiting : 1;
 };
 
 static uint32_t netdev_watch;
 
+/*
+ * The station table is keyed by the peer address.  Use the last four octets
+ * as the hash since the OUI part is frequently shared between peers.
+ */
+static unsigned int adhoc_sta_addr_hash(const void *p)
+{
+	const uint8_t *addr = p;
+
+	return l_get_le32(addr + 2);
+}
+
+static int adhoc_sta_addr_compare(const void *a, const void *b)
+{
+	return memcmp(a, b, 6);
+}
+
+static struct l_hashmap *adhoc_sta_table_new(void)
+{
+	struct l_hashmap *table = l_hashmap_new();
+
+	l_hashmap_set_hash_function(table, adhoc_sta_addr_hash);
+	l_hashmap_set_compare_function(table, adhoc_sta_addr_compare);
+
+	return table;
+}
+
 static void adhoc_sta_free(void *data)
 {
 	struct sta_state *sta = data;
@@ -86,10 +117,6 @@ static void adhoc_sta_free(void *data)
 	if (sta->adhoc->open)
 		goto end;
 
-	if (sta->gtk_query_cmd_id)
-		l_genl_family_cancel(sta->adhoc->nl80211,
-						sta->gtk_query_cmd_id);
-
 	if (sta->sm)
 		eapol_sm_free(sta->sm);
 
@@ -108,15 +135,28 @@ end:
 
 static void adhoc_remove_sta(struct sta_state *sta)
 {
-	if (!l_queue_remove(sta->adhoc->sta_states, sta)) {
+	struct adhoc_state *adhoc = sta->adhoc;
+
+	if (l_hashmap_lookup(adhoc->sta_states, sta->addr) != sta ||
+			!l_hashmap_remove(adhoc->sta_states, sta->addr)) {
 		l_error("station %p was not found", sta);
 		return;
 	}
 
-	if (sta->gtk_query_cmd_id) {
-		l_genl_family_cancel(sta->adhoc->nl80211,
-						sta->gtk_query_cmd_id);
-		sta->gtk_query_cmd_id = 0;
+	/*
+	 * If this was the last station waiting for the GTK RSC there is no
+	 * point in keeping the query around
+	 */
+	if (sta->gtk_waiting) {
+		l_queue_remove(adhoc->gtk_waiters, sta);
+		sta->gtk_waiting = false;
+
+		if (l_queue_isempty(adhoc->gtk_waiters) &&
+				adhoc->gtk_query_cmd_id) {
+			l_genl_family_cancel(adhoc->nl80211,
+						adhoc->gtk_query_cmd_id);
+			adhoc->gtk_query_cmd_id = 0;
+		}
 	}
 
 	/* signal station has been removed */
@@ -141,7 +181,15 @@ static void adhoc_reset(struct adhoc_state *adhoc)
 	netdev_station_watch_remove(adhoc->netdev, adhoc->sta_watch_id);
 	adhoc->sta_watch_id = 0;
 
-	l_queue_destroy(adhoc->sta_states, adhoc_sta_free);
+	if (adhoc->gtk_query_cmd_id) {
+		l_genl_family_cancel(adhoc->nl80211, adhoc->gtk_query_cmd_id);
+		adhoc->gtk_query_cmd_id = 0;
+	}
+
+	l_queue_destroy(adhoc->gtk_waiters, NULL);
+	adhoc->gtk_waiters = NULL;
+
+	l_hashmap_destroy(adhoc->sta_states, adhoc_sta_free);
 	adhoc->sta_states = NULL;
 
 	adhoc->started = false;
@@ -162,13 +210,6 @@ static void adhoc_set_rsn_info(struct adhoc_state *adhoc,
 	rsn->group_cipher = adhoc->group_cipher;
 }
 
-static bool ap_sta_match_addr(const void *a, const void *b)
-{
-	const struct sta_state *sta = a;
-
-	return !memcmp(sta->addr, b, 6);
-}
-
 static void adhoc_operstate_cb(int error, uint16_t type,
 					const void *data,
 					uint32_t len, void *user_data)
@@ -222,6 +263,13 @@ static void adhoc_handshake_event(struct handshake_state *hs,
 		if ((sta->hs_auth_done && sta->hs_sta_done) &&
 				!sta->authenticated) {
 			sta->authenticated = true;
+			sta->authenticated_time = l_time_now();
+
+			l_debug("STA "MAC" authenticated in %"PRIu64" ms",
+				MAC_STR(sta->addr),
+				l_time_to_msecs(sta->authenticated_time -
+							sta->new_time));
+
 			l_dbus_property_changed(dbus_get_bus(),
 					netdev_get_path(adhoc->netdev),
 					IWD_ADHOC_INTERFACE, "ConnectedPeers");
@@ -298,6 +346,8 @@ static void adhoc_free(struct adhoc_state *adhoc)
 
 static void adhoc_start_rsna(struct sta_state *sta, const uint8_t *gtk_rsc)
 {
+	sta->handshake_attempts += 1;
+
 	sta->sm_a = adhoc_new_sm(sta, true, gtk_rsc);
 	if (!sta->sm_a) {
 		l_error("could not create authenticator state machine");
@@ -334,22 +384,63 @@ static void adhoc_gtk_op_cb(struct l_genl_msg *msg, void *user_data)
 	}
 }
 
+/*
+ * A single GET_KEY query serves every station that joined while it was in
+ * flight.  Handing out an RSC that was read slightly earlier is safe since
+ * the peers only use it as a lower bound for replay detection.
+ */
 static void adhoc_gtk_query_cb(struct l_genl_msg *msg, void *user_data)
 {
-	struct sta_state *sta = user_data;
+	struct adhoc_state *adhoc = user_data;
+	struct l_queue *waiters = adhoc->gtk_waiters;
 	const void *gtk_rsc;
+	struct sta_state *sta;
 
-	sta->gtk_query_cmd_id = 0;
+	adhoc->gtk_query_cmd_id = 0;
+	adhoc->gtk_waiters = l_queue_new();
 
 	gtk_rsc = nl80211_parse_get_key_seq(msg);
-	if (!gtk_rsc)
-		goto error;
 
-	adhoc_start_rsna(sta, gtk_rsc);
-	return;
+	l_debug("GTK RSC query done for %u stations",
+					l_queue_length(waiters));
 
-error:
-	adhoc_remove_sta(sta);
+	while ((sta = l_queue_pop_head(waiters))) {
+		sta->gtk_waiting = false;
+
+		if (!gtk_rsc) {
+			adhoc_remove_sta(sta);
+			continue;
+		}
+
+		adhoc_start_rsna(sta, gtk_rsc);
+	}
+
+	l_queue_destroy(waiters, NULL);
+}
+
+static bool adhoc_gtk_query(struct adhoc_state *adhoc, struct sta_state *sta)
+{
+	struct l_genl_msg *msg;
+
+	l_queue_push_tail(adhoc->gtk_waiters, sta);
+	sta->gtk_waiting = true;
+
+	if (adhoc->gtk_query_cmd_id)
+		return true;
+
+	msg = nl80211_build_get_key(netdev_get_ifindex(adhoc->netdev),
+					adhoc->gtk_index);
+	adhoc->gtk_query_cmd_id = l_genl_family_send(adhoc->nl80211, msg,
+							adhoc_gtk_query_cb,
+							adhoc, NULL);
+	if (!adhoc->gtk_query_cmd_id) {
+		l_genl_msg_unref(msg);
+		l_queue_remove(adhoc->gtk_waiters, sta);
+		sta->gtk_waiting = false;
+		return false;
+	}
+
+	return true;
 }
 
 static void adhoc_new_station(struct adhoc_state *adhoc, const uint8_t *mac)
@@ -357,7 +448,7 @@ static void adhoc_new_station(struct adhoc_state *adhoc, const uint8_t *mac)
 	struct sta_state *sta;
 	struct l_genl_msg *msg;
 
-	sta = l_queue_find(adhoc->sta_states, ap_sta_match_addr, mac);
+	sta = l_hashmap_lookup(adhoc->sta_states, mac);
 	if (sta) {
 		l_warn("new station event with already connected STA");
 		return;
@@ -417,8 +508,9 @@ static void adhoc_new_station(struct adhoc_state *adhoc, const uint8_t *mac)
 
 	memcpy(sta->addr, mac, 6);
 	sta->adhoc = adhoc;
+	sta->new_time = l_time_now();
 
-	l_queue_push_tail(adhoc->sta_states, sta);
+	l_hashmap_insert(adhoc->sta_states, sta->addr, sta);
 
 	l_info("new Station: "MAC" adhoc=%p", MAC_STR(mac), adhoc);
 
@@ -427,6 +519,7 @@ static void adhoc_new_station(struct adhoc_state *adhoc, const uint8_t *mac)
 		int ifindex = netdev_get_ifindex(adhoc->netdev);
 
 		sta->authenticated = true;
+		sta->authenticated_time = sta->new_time;
 
 		l_rtnl_set_linkmode_and_operstate(iwd_get_rtnl(), ifindex,
 					IF_LINK_MODE_DORMANT, IF_OPER_UP,
@@ -441,19 +534,9 @@ static void adhoc_new_station(struct adhoc_state *adhoc, const uint8_t *mac)
 
 	if (adhoc->group_cipher == IE_RSN_CIPHER_SUITE_NO_GROUP_TRAFFIC)
 		adhoc_start_rsna(sta, NULL);
-	else {
-		msg = nl80211_build_get_key(netdev_get_ifindex(adhoc->netdev),
-					adhoc->gtk_index);
-		sta->gtk_query_cmd_id = l_genl_family_send(adhoc->nl80211, msg,
-							adhoc_gtk_query_cb,
-							sta, NULL);
-		if (!sta->gtk_query_cmd_id) {
-			l_genl_msg_unref(msg);
-			l_error("Issuing GET_KEY failed");
-
-			adhoc_remove_sta(sta);
-			return;
-		}
+	else if (!adhoc_gtk_query(adhoc, sta)) {
+		l_error("Issuing GET_KEY failed");
+		adhoc_remove_sta(sta);
 	}
 }
 
@@ -461,7 +544,7 @@ static void adhoc_del_station(struct adhoc_state *adhoc, const uint8_t *mac)
 {
 	struct sta_state *sta;
 
-	sta = l_queue_find(adhoc->sta_states, ap_sta_match_addr, mac);
+	sta = l_hashmap_lookup(adhoc->sta_states, mac);
 	if (!sta) {
 		l_warn("could not find station "MAC" in list", MAC_STR(mac));
 		return;
@@ -556,7 +639,8 @@ static struct l_dbus_message *adhoc_dbus_start(struct l_dbus *dbus,
 
 	adhoc->ssid = l_strdup(ssid);
 	adhoc->pending = l_dbus_message_ref(message);
-	adhoc->sta_states = l_queue_new();
+	adhoc->sta_states = adhoc_sta_table_new();
+	adhoc->gtk_waiters = l_queue_new();
 	adhoc->ciphers = wiphy_select_cipher(wiphy, 0xffff);
 	adhoc->group_cipher = wiphy_select_cipher(wiphy, 0xffff);
 
@@ -599,7 +683,8 @@ static struct l_dbus_message *adhoc_dbus_start_open(struct l_dbus *dbus,
 
 	adhoc->ssid = l_strdup(ssid);
 	adhoc->pending = l_dbus_message_ref(message);
-	adhoc->sta_states = l_queue_new();
+	adhoc->sta_states = adhoc_sta_table_new();
+	adhoc->gtk_waiters = l_queue_new();
 	adhoc->open = true;
 
 	/* Mac/iPhone seem to require the extended capabilities field */
@@ -665,7 +750,7 @@ static struct l_dbus_message *adhoc_dbus_stop(struct l_dbus *dbus,
 	return NULL;
 }
 
-static void sta_append(void *data, void *user_data)
+static void sta_append(const void *key, void *data, void *user_data)
 {
 	struct sta_state *sta = data;
 	struct l_dbus_message_builder *builder = user_data;
@@ -688,13 +773,68 @@ static bool adhoc_property_get_peers(struct l_dbus *dbus,
 
 	l_dbus_message_builder_enter_array(builder, "s");
 
-	l_queue_foreach(adhoc->sta_states, sta_append, builder);
+	l_hashmap_foreach(adhoc->sta_states, sta_append, builder);
 
 	l_dbus_message_builder_leave_array(builder);
 
 	return true;
 }
 
+static void sta_append_statistics(const void *key, void *data,
+					void *user_data)
+{
+	struct sta_state *sta = data;
+	struct l_dbus_message_builder *builder = user_data;
+	uint64_t now = l_time_now();
+	bool authenticated = sta->authenticated;
+
+	l_dbus_message_builder_enter_array(builder, "{sv}");
+
+	dbus_append_dict_basic(builder, "Address", 's',
+				util_address_to_string(sta->addr));
+	dbus_append_dict_basic(builder, "Authenticated", 'b', &authenticated);
+	dbus_append_dict_basic(builder, "HandshakeAttempts", 'u',
+				&sta->handshake_attempts);
+
+	if (authenticated) {
+		uint32_t join_time = l_time_to_msecs(sta->authenticated_time -
+							sta->new_time);
+		uint32_t connected_time = l_time_to_secs(now -
+						sta->authenticated_time);
+
+		dbus_append_dict_basic(builder, "JoinTime", 'u', &join_time);
+		dbus_append_dict_basic(builder, "ConnectedTime", 'u',
+					&connected_time);
+	}
+
+	l_dbus_message_builder_leave_array(builder);
+}
+
+static struct l_dbus_message *adhoc_dbus_get_peer_statistics(
+						struct l_dbus *dbus,
+						struct l_dbus_message *message,
+						void *user_data)
+{
+	struct adhoc_state *adhoc = user_data;
+	struct l_dbus_message *reply;
+	struct l_dbus_message_builder *builder;
+
+	if (!adhoc->started)
+		return dbus_error_not_connected(message);
+
+	reply = l_dbus_message_new_method_return(message);
+	builder = l_dbus_message_builder_new(reply);
+
+	l_dbus_message_builder_enter_array(builder, "a{sv}");
+	l_hashmap_foreach(adhoc->sta_states, sta_append_statistics, builder);
+	l_dbus_message_builder_leave_array(builder);
+
+	l_dbus_message_builder_finalize(builder);
+	l_dbus_message_builder_destroy(builder);
+
+	return reply;
+}
+
 static bool adhoc_property_get_started(struct l_dbus *dbus,
 					struct l_dbus_message *message,
 					struct l_dbus_message_builder *builder,
@@ -715,6 +855,9 @@ static void adhoc_setup_interface(struct l_dbus_interface *interface)
 	l_dbus_interface_method(interface, "Stop", 0, adhoc_dbus_stop, "", "");
 	l_dbus_interface_method(interface, "StartOpen", 0,
 					adhoc_dbus_start_open, "", "s", "ssid");
+	l_dbus_interface_method(interface, "GetPeerStatistics", 0,
+					adhoc_dbus_get_peer_statistics,
+					"aa{sv}", "", "statistics");
 	l_dbus_interface_property(interface, "ConnectedPeers", 0, "as",
 					adhoc_property_get_peers, NULL);
 	l_dbus_interface_property(interface, "Started", 0, "b",
@@ -47,6 +47,8 @@
 #include "src/util.h"
 #include "src/eapol.h"
 #include "src/handshake.h"
+#include "src/auth-proto.h"
+#include "src/sae.h"
 #include "src/dbus.h"
 #include "src/nl80211util.h"
 #include "src/frame-xchg.h"
@@ -70,6 +72,10 @@ struct ap_state {
 	char ssid[SSID_MAX_SIZE + 1];
 	char passphrase[64];
 	uint8_t psk[32];
+	uint32_t akm_suites;
+	struct l_ecc_point *sae_pt_19;
+	struct l_ecc_point *sae_pt_20;
+	uint8_t sae_token_key[32];
 	enum band_freq band;
 	uint8_t channel;
 	struct band_chandef chandef;
@@ -80,12 +86,15 @@ struct ap_state {
 
 	unsigned int ciphers;
 	enum ie_rsn_cipher_suite group_cipher;
+	enum ie_rsn_cipher_suite group_management_cipher;
 	uint32_t beacon_interval;
 	struct l_uintset *rates;
 	uint32_t start_stop_cmd_id;
 	uint32_t mlme_watch;
 	uint8_t gtk[CRYPTO_MAX_GTK_LEN];
 	uint8_t gtk_index;
+	uint8_t igtk[CRYPTO_MAX_IGTK_LEN];
+	uint8_t igtk_index;
 	struct l_queue *wsc_pbc_probes;
 	struct l_timeout *wsc_pbc_timeout;
 	uint16_t wsc_dpid;
@@ -116,6 +125,8 @@ struct ap_state {
 	bool free_pending : 1;
 	bool scanning : 1;
 	bool supports_ht : 1;
+	bool mfpc : 1;
+	bool mfpr : 1;
 };
 
 struct sta_state {
@@ -134,6 +145,7 @@ struct sta_state {
 	struct eapol_sm *sm;
 	struct handshake_state *hs;
 	uint32_t gtk_query_cmd_id;
+	uint8_t gtk_rsc[6];
 	struct l_idle *stop_handshake_work;
 	struct l_settings *wsc_settings;
 	uint8_t wsc_uuid_e[16];
@@ -141,9 +153,15 @@ struct sta_state {
 	struct l_dhcp_lease *ip_alloc_lease;
 	bool ip_alloc_sent;
 	uint64_t rekey_time;
+	struct auth_proto *sae;
+	struct handshake_state *sae_hs;
+	struct l_timeout *sae_timeout;
+	uint8_t sae_pmk[32];
+	uint8_t sae_pmkid[16];
 
 	bool ht_support : 1;
 	bool ht_greenfield : 1;
+	bool mfp : 1;
 };
 
 struct ap_wsc_pbc_probe_record {
@@ -252,6 +270,18 @@ static void ap_stop_handshake_work(struct l_idle *idle, void *user_data)
 	ap_stop_handshake(sta);
 }
 
+static void ap_sae_free(struct sta_state *sta)
+{
+	auth_proto_free(l_steal_ptr(sta->sae));
+
+	if (sta->sae_hs) {
+		handshake_state_free(sta->sae_hs);
+		sta->sae_hs = NULL;
+	}
+
+	l_timeout_remove(l_steal_ptr(sta->sae_timeout));
+}
+
 static void ap_sta_free(void *data)
 {
 	struct sta_state *sta = data;
@@ -273,6 +303,8 @@ static void ap_sta_free(void *data)
 						sta->ip_alloc_lease);
 
 	ap_stop_handshake(sta);
+	ap_sae_free(sta);
+	explicit_bzero(sta->sae_pmk, sizeof(sta->sae_pmk));
 
 	l_free(sta);
 }
@@ -283,6 +315,10 @@ static void ap_reset(struct ap_state *ap)
 
 	explicit_bzero(ap->passphrase, sizeof(ap->passphrase));
 	explicit_bzero(ap->psk, sizeof(ap->psk));
+	explicit_bzero(ap->sae_token_key, sizeof(ap->sae_token_key));
+
+	l_ecc_point_free(l_steal_ptr(ap->sae_pt_19));
+	l_ecc_point_free(l_steal_ptr(ap->sae_pt_20));
 
 	if (ap->authorized_macs_num) {
 		l_free(ap->authorized_macs);
@@ -631,9 +667,15 @@ static void ap_drop_rsna(struct sta_state *sta)
 static void ap_set_rsn_info(struct ap_state *ap, struct ie_rsn_info *rsn)
 {
 	memset(rsn, 0, sizeof(*rsn));
-	rsn->akm_suites = IE_RSN_AKM_SUITE_PSK;
+	rsn->akm_suites = ap->akm_suites;
 	rsn->pairwise_ciphers = ap->ciphers;
 	rsn->group_cipher = ap->group_cipher;
+
+	if (ap->mfpc) {
+		rsn->mfpc = true;
+		rsn->mfpr = ap->mfpr;
+		rsn->group_management_cipher = ap->group_management_cipher;
+	}
 }
 
 static void ap_wsc_exit_pbc(struct ap_state *ap)
@@ -1272,6 +1314,23 @@ no_space:
 	return 0;
 }
 
+/*
+ * 802.11-2020 9.4.2.241: advertise SAE Hash-to-Element support when the PTs
+ * could be derived, so that SAE STAs skip the hunting-and-pecking loop
+ */
+static size_t ap_build_rsnxe(struct ap_state *ap, uint8_t *out_buf)
+{
+	if (!(ap->akm_suites & IE_RSN_AKM_SUITE_SAE_SHA256) ||
+			(!ap->sae_pt_19 && !ap->sae_pt_20))
+		return 0;
+
+	out_buf[0] = IE_TYPE_RSNX;
+	out_buf[1] = 1;
+	out_buf[2] = 1 << IE_RSNX_SAE_H2E;
+
+	return 3;
+}
+
 /* Beacon / Probe Response frame portion after the TIM IE */
 static size_t ap_build_beacon_pr_tail(struct ap_state *ap,
 					enum mpdu_management_subtype stype,
@@ -1290,6 +1349,8 @@ static size_t ap_build_beacon_pr_tail(struct ap_state *ap,
 		return 0;
 	len += 2 + out_buf[len + 1];
 
+	len += ap_build_rsnxe(ap, out_buf + len);
+
 	len += ap_write_extra_ies(ap, stype, req, req_len, out_buf + len);
 	return len;
 }
@@ -1366,7 +1427,7 @@ static uint32_t ap_send_mgmt_frame(struct ap_state *ap,
 	}))
 
 static void ap_start_handshake(struct sta_state *sta, bool use_eapol_start,
-				const uint8_t *gtk_rsc)
+				const uint8_t *gtk_rsc, const uint8_t *igtk_rsc)
 {
 	struct ap_state *ap = sta->ap;
 	const uint8_t *own_addr = netdev_get_address(ap->netdev);
@@ -1389,6 +1450,10 @@ static void ap_start_handshake(struct sta_state *sta, bool use_eapol_start,
 		handshake_state_set_gtk(sta->hs, sta->ap->gtk,
 					sta->ap->gtk_index, gtk_rsc);
 
+	if (igtk_rsc)
+		handshake_state_set_igtk(sta->hs, sta->ap->igtk,
+					sta->ap->igtk_index, igtk_rsc);
+
 	if (ap->netconfig_dhcp)
 		sta->hs->support_ip_allocation = true;
 
@@ -1493,20 +1558,66 @@ static void ap_handshake_event(struct handshake_state *hs,
 	va_end(args);
 }
 
-static void ap_start_rsna(struct sta_state *sta, const uint8_t *gtk_rsc)
+static void ap_start_rsna(struct sta_state *sta, const uint8_t *gtk_rsc,
+				const uint8_t *igtk_rsc)
 {
-	/* this handshake setup assumes PSK network */
+	uint8_t rsnxe[3];
+
 	sta->hs = netdev_handshake_state_new(sta->ap->netdev);
 	handshake_state_set_authenticator(sta->hs, true);
 	handshake_state_set_event_func(sta->hs, ap_handshake_event, sta);
 	handshake_state_set_supplicant_ie(sta->hs, sta->assoc_rsne);
-	handshake_state_set_pmk(sta->hs, sta->ap->psk, 32);
-	ap_start_handshake(sta, false, gtk_rsc);
+
+	/* The STA being MFP capable is not enough, we must be too */
+	sta->hs->mfp = sta->mfp;
+
+	if (ap_build_rsnxe(sta->ap, rsnxe))
+		handshake_state_set_authenticator_rsnxe(sta->hs, rsnxe);
+
+	/* The PMK either comes from the SAE exchange or is the PSK */
+	if (sta->hs->akm_suite == IE_RSN_AKM_SUITE_SAE_SHA256) {
+		handshake_state_set_pmk(sta->hs, sta->sae_pmk, 32);
+		handshake_state_set_pmkid(sta->hs, sta->sae_pmkid);
+	} else
+		handshake_state_set_pmk(sta->hs, sta->ap->psk, 32);
+
+	ap_start_handshake(sta, false, gtk_rsc, igtk_rsc);
+}
+
+static void ap_igtk_query_cb(struct l_genl_msg *msg, void *user_data)
+{
+	struct sta_state *sta = user_data;
+	const void *igtk_rsc;
+	uint8_t zero_igtk_rsc[6];
+	int err;
+
+	sta->gtk_query_cmd_id = 0;
+
+	err = l_genl_msg_get_error(msg);
+	if (err == -ENOTSUP)
+		goto zero_rsc;
+	else if (err < 0)
+		goto error;
+
+	igtk_rsc = nl80211_parse_get_key_seq(msg);
+	if (!igtk_rsc) {
+zero_rsc:
+		memset(zero_igtk_rsc, 0, 6);
+		igtk_rsc = zero_igtk_rsc;
+	}
+
+	ap_start_rsna(sta, sta->gtk_rsc, igtk_rsc);
+	return;
+
+error:
+	ap_del_station(sta, MMPDU_REASON_CODE_UNSPECIFIED, true);
 }
 
 static void ap_gtk_query_cb(struct l_genl_msg *msg, void *user_data)
 {
 	struct sta_state *sta = user_data;
+	struct ap_state *ap = sta->ap;
+	struct l_genl_msg *get_key;
 	const void *gtk_rsc;
 	uint8_t zero_gtk_rsc[6];
 	int err;
@@ -1526,7 +1637,25 @@ zero_rsc:
 		gtk_rsc = zero_gtk_rsc;
 	}
 
-	ap_start_rsna(sta, gtk_rsc);
+	if (!sta->mfp) {
+		ap_start_rsna(sta, gtk_rsc, NULL);
+		return;
+	}
+
+	/* Also query the IGTK's IPN for the IGTK KDE in message 3 of 4 */
+	memcpy(sta->gtk_rsc, gtk_rsc, 6);
+
+	get_key = nl80211_build_get_key(netdev_get_ifindex(ap->netdev),
+					ap->igtk_index);
+	sta->gtk_query_cmd_id = l_genl_family_send(ap->nl80211, get_key,
+							ap_igtk_query_cb,
+							sta, NULL);
+	if (!sta->gtk_query_cmd_id) {
+		l_genl_msg_unref(get_key);
+		l_error("Issuing GET_KEY failed");
+		goto error;
+	}
+
 	return;
 
 error:
@@ -1636,10 +1765,11 @@ static void ap_start_eap_wsc(struct sta_state *sta)
 	handshake_state_set_event_func(sta->hs, ap_wsc_handshake_event, sta);
 	handshake_state_set_8021x_config(sta->hs, sta->wsc_settings);
 
-	ap_start_handshake(sta, wait_for_eapol_start, NULL);
+	ap_start_handshake(sta, wait_for_eapol_start, NULL, NULL);
 }
 
-static struct l_genl_msg *ap_build_cmd_del_key(struct ap_state *ap)
+static struct l_genl_msg *ap_build_cmd_del_key(struct ap_state *ap,
+							uint8_t key_index)
 {
 	uint32_t ifindex = netdev_get_ifindex(ap->netdev);
 	struct l_genl_msg *msg;
@@ -1648,7 +1778,25 @@ static struct l_genl_msg *ap_build_cmd_del_key(struct ap_state *ap)
 
 	l_genl_msg_append_attr(msg, NL80211_ATTR_IFINDEX, 4, &ifindex);
 	l_genl_msg_enter_nested(msg, NL80211_ATTR_KEY);
-	l_genl_msg_append_attr(msg, NL80211_KEY_IDX, 1, &ap->gtk_index);
+	l_genl_msg_append_attr(msg, NL80211_KEY_IDX, 1, &key_index);
+	l_genl_msg_leave_nested(msg);
+
+	return msg;
+}
+
+/* Make the IGTK the key used for our broadcast robust management frames */
+static struct l_genl_msg *ap_build_cmd_set_default_mgmt_key(
+							struct ap_state *ap)
+{
+	uint32_t ifindex = netdev_get_ifindex(ap->netdev);
+	struct l_genl_msg *msg;
+
+	msg = l_genl_msg_new_sized(NL80211_CMD_SET_KEY, 128);
+
+	l_genl_msg_append_attr(msg, NL80211_ATTR_IFINDEX, 4, &ifindex);
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_KEY);
+	l_genl_msg_append_attr(msg, NL80211_KEY_IDX, 1, &ap->igtk_index);
+	l_genl_msg_append_attr(msg, NL80211_KEY_DEFAULT_MGMT, 0, NULL);
 	l_genl_msg_leave_nested(msg);
 
 	return msg;
@@ -1674,6 +1822,9 @@ static struct l_genl_msg *ap_build_cmd_new_station(struct sta_state *sta)
 		flags.mask |= (1 << NL80211_STA_FLAG_ASSOCIATED) |
 				(1 << NL80211_STA_FLAG_AUTHENTICATED);
 
+	if (sta->mfp)
+		flags.set |= 1 << NL80211_STA_FLAG_MFP;
+
 	msg = l_genl_msg_new_sized(NL80211_CMD_NEW_STATION, 300);
 
 	l_genl_msg_append_attr(msg, NL80211_ATTR_IFINDEX, 4, &ifindex);
@@ -1697,6 +1848,38 @@ static void ap_gtk_op_cb(struct l_genl_msg *msg, void *user_data)
 	}
 }
 
+static bool ap_install_igtk(struct ap_state *ap)
+{
+	enum crypto_cipher cipher =
+		ie_rsn_cipher_suite_to_cipher(ap->group_management_cipher);
+	int igtk_len = crypto_cipher_key_len(cipher);
+	struct l_genl_msg *msg;
+
+	/* IGTKs use key IDs 4 and 5, the GTK is in 1 */
+	l_getrandom(ap->igtk, igtk_len);
+	ap->igtk_index = 4;
+
+	msg = nl80211_build_new_key_group(netdev_get_ifindex(ap->netdev),
+						cipher, ap->igtk_index,
+						ap->igtk, igtk_len, NULL,
+						0, NULL);
+
+	if (!l_genl_family_send(ap->nl80211, msg, ap_gtk_op_cb, NULL, NULL)) {
+		l_genl_msg_unref(msg);
+		l_error("Issuing NEW_KEY failed");
+		return false;
+	}
+
+	msg = ap_build_cmd_set_default_mgmt_key(ap);
+	if (!l_genl_family_send(ap->nl80211, msg, ap_gtk_op_cb, NULL, NULL)) {
+		l_genl_msg_unref(msg);
+		l_error("Issuing SET_KEY failed");
+		return false;
+	}
+
+	return true;
+}
+
 static void ap_associate_sta_cb(struct l_genl_msg *msg, void *user_data)
 {
 	struct sta_state *sta = user_data;
@@ -1773,6 +1956,9 @@ static void ap_associate_sta_cb(struct l_genl_msg *msg, void *user_data)
 			goto error;
 		}
 
+		if (ap->mfpc && !ap_install_igtk(ap))
+			goto error;
+
 		/*
 		 * Set the flag now because any new associating STA will
 		 * just use NL80211_CMD_GET_KEY from now.
@@ -1781,7 +1967,7 @@ static void ap_associate_sta_cb(struct l_genl_msg *msg, void *user_data)
 	}
 
 	if (ap->group_cipher == IE_RSN_CIPHER_SUITE_NO_GROUP_TRAFFIC)
-		ap_start_rsna(sta, NULL);
+		ap_start_rsna(sta, NULL, NULL);
 	else {
 		msg = nl80211_build_get_key(netdev_get_ifindex(ap->netdev),
 					ap->gtk_index);
@@ -1811,7 +1997,8 @@ static void ap_associate_sta(struct ap_state *ap, struct sta_state *sta)
 	uint16_t capability = l_get_le16(&sta->capability);
 
 	if (sta->associated)
-		msg = nl80211_build_set_station_associated(ifindex, sta->addr);
+		msg = nl80211_build_set_station_associated(ifindex, sta->addr,
+								sta->mfp);
 	else
 		msg = ap_build_cmd_new_station(sta);
 
@@ -2253,15 +2440,46 @@ static void ap_assoc_reassoc(struct sta_state *sta, bool reassoc,
 			goto unsupported;
 		}
 
-		if (rsn_info.akm_suites != IE_RSN_AKM_SUITE_PSK) {
+		if (__builtin_popcount(rsn_info.akm_suites) != 1 ||
+				!(rsn_info.akm_suites & ap->akm_suites)) {
 			err = MMPDU_REASON_CODE_INVALID_AKMP;
 			goto unsupported;
 		}
 
+		/* 802.11-2020 12.4.8.5: SAE must have been Accepted first */
+		if (rsn_info.akm_suites == IE_RSN_AKM_SUITE_SAE_SHA256 &&
+				!(sta->sae && sta->sae_hs->have_pmk)) {
+			l_debug("SAE association from %s without a PMK",
+				util_address_to_string(sta->addr));
+			err = MMPDU_REASON_CODE_UNSPECIFIED;
+			goto unsupported;
+		}
+
 		if (rsn_info.group_cipher != ap->group_cipher) {
 			err = MMPDU_REASON_CODE_INVALID_GROUP_CIPHER;
 			goto unsupported;
 		}
+
+		/* 802.11-2020 12.6.3: MFP required by either side */
+		if ((ap->mfpr && !rsn_info.mfpc) ||
+				(rsn_info.mfpr && !ap->mfpc)) {
+			err = MMPDU_STATUS_CODE_ROBUST_MGMT_POLICY_VIOLATION;
+			goto unsupported;
+		}
+
+		/* WPA3 Specification v3.0 2.3: SAE is only used with MFP */
+		if (rsn_info.akm_suites == IE_RSN_AKM_SUITE_SAE_SHA256 &&
+				!rsn_info.mfpc) {
+			err = MMPDU_STATUS_CODE_ROBUST_MGMT_POLICY_VIOLATION;
+			goto unsupported;
+		}
+
+		if (rsn_info.mfpc && ap->mfpc &&
+				rsn_info.group_management_cipher !=
+				ap->group_management_cipher) {
+			err = MMPDU_STATUS_CODE_CIPHER_OUT_OF_POLICY;
+			goto unsupported;
+		}
 	}
 
 	/* 802.11-2016 11.3.5.3 j) */
@@ -2294,9 +2512,18 @@ static void ap_assoc_reassoc(struct sta_state *sta, bool reassoc,
 		sta->assoc_ies = l_memdup(ies, ies_len);
 		sta->assoc_ies_len = ies_len;
 		sta->assoc_rsne = sta->assoc_ies + (rsn - ies);
+		sta->mfp = ap->mfpc && rsn_info.mfpc;
 	} else {
 		sta->assoc_ies = NULL;
 		sta->assoc_rsne = NULL;
+		sta->mfp = false;
+	}
+
+	/* The SAE protocol instance is done, keep only its PMKSA */
+	if (rsn && rsn_info.akm_suites == IE_RSN_AKM_SUITE_SAE_SHA256) {
+		memcpy(sta->sae_pmk, sta->sae_hs->pmk, 32);
+		memcpy(sta->sae_pmkid, sta->sae_hs->pmkid, 16);
+		ap_sae_free(sta);
 	}
 
 	sta->assoc_resp_cmd_id = ap_assoc_resp(ap, sta, sta->addr, 0, reassoc,
@@ -2593,6 +2820,199 @@ static void ap_auth_reply(struct ap_state *ap, const uint8_t *dest,
 				ap_auth_reply_cb, NULL);
 }
 
+#define AP_SAE_TIMEOUT			5
+#define AP_SAE_ANTI_CLOGGING_THRESHOLD	5
+
+static void ap_sae_tx_auth(const uint8_t *data, size_t len, void *user_data)
+{
+	struct sta_state *sta = user_data;
+	struct ap_state *ap = sta->ap;
+	const uint8_t *addr = netdev_get_address(ap->netdev);
+	uint8_t mpdu_buf[sizeof(struct mmpdu_header) + 2 + len];
+	struct mmpdu_header *mpdu = (struct mmpdu_header *) mpdu_buf;
+	struct mmpdu_authentication *auth;
+
+	memset(mpdu, 0, sizeof(*mpdu));
+
+	/* Header */
+	mpdu->fc.protocol_version = 0;
+	mpdu->fc.type = MPDU_TYPE_MANAGEMENT;
+	mpdu->fc.subtype = MPDU_MANAGEMENT_SUBTYPE_AUTHENTICATION;
+	memcpy(mpdu->address_1, sta->addr, 6);	/* DA */
+	memcpy(mpdu->address_2, addr, 6);	/* SA */
+	memcpy(mpdu->address_3, addr, 6);	/* BSSID */
+
+	/* SAE builds everything from the Transaction Sequence onwards */
+	auth = (void *) mmpdu_body(mpdu);
+	auth->algorithm = L_CPU_TO_LE16(MMPDU_AUTH_ALGO_SAE);
+	memcpy((uint8_t *) auth + 2, data, len);
+
+	ap_send_mgmt_frame(ap, mpdu, (uint8_t *) auth + 2 + len - mpdu_buf,
+				ap_auth_reply_cb, NULL);
+}
+
+static void ap_sae_timeout(struct l_timeout *timeout, void *user_data)
+{
+	struct sta_state *sta = user_data;
+
+	l_debug("SAE with %s timed out", util_address_to_string(sta->addr));
+
+	ap_sae_free(sta);
+
+	if (!sta->associated)
+		ap_remove_sta(sta);
+}
+
+static unsigned int ap_sae_count_in_progress(struct ap_state *ap)
+{
+	const struct l_queue_entry *entry;
+	unsigned int count = 0;
+
+	for (entry = l_queue_get_entries(ap->sta_states); entry;
+			entry = entry->next) {
+		struct sta_state *sta = entry->data;
+
+		if (sta->sae && !sta->sae_hs->have_pmk)
+			count++;
+	}
+
+	return count;
+}
+
+static void ap_sae_new(struct sta_state *sta)
+{
+	struct ap_state *ap = sta->ap;
+	struct handshake_state *hs = netdev_handshake_state_new(ap->netdev);
+
+	handshake_state_set_authenticator(hs, true);
+	handshake_state_set_authenticator_address(hs,
+					netdev_get_address(ap->netdev));
+	handshake_state_set_supplicant_address(hs, sta->addr);
+	handshake_state_set_passphrase(hs, ap->passphrase);
+
+	if (ap->sae_pt_19)
+		handshake_state_add_ecc_sae_pt(hs, ap->sae_pt_19);
+
+	if (ap->sae_pt_20)
+		handshake_state_add_ecc_sae_pt(hs, ap->sae_pt_20);
+
+	sta->sae_hs = hs;
+	sta->sae = sae_sm_new(hs, ap_sae_tx_auth, NULL, sta);
+}
+
+/*
+ * 802.11-2020 12.4.6: once too many SAE instances are in progress require
+ * the STA to prove it can receive frames at its address.  The token is
+ * stateless, a keyed hash of the address, so a flood of spoofed Commits
+ * costs us neither memory nor ECC operations.
+ */
+static void ap_sae_require_token(struct sta_state *sta)
+{
+	struct ap_state *ap = sta->ap;
+	struct l_checksum *hmac;
+	uint8_t token[32];
+
+	hmac = l_checksum_new_hmac(L_CHECKSUM_SHA256, ap->sae_token_key,
+					sizeof(ap->sae_token_key));
+	l_checksum_update(hmac, sta->addr, 6);
+	l_checksum_get_digest(hmac, token, sizeof(token));
+	l_checksum_free(hmac);
+
+	sae_sm_require_token(sta->sae, token, sizeof(token));
+}
+
+/* 802.11-2020 12.4.8 (SAE protocol instance management) */
+static void ap_sae_auth(struct ap_state *ap, const struct mmpdu_header *hdr,
+			size_t frame_len)
+{
+	const struct mmpdu_authentication *auth = mmpdu_body(hdr);
+	uint16_t transaction = L_LE16_TO_CPU(auth->transaction_sequence);
+	const uint8_t *from = hdr->address_2;
+	struct sta_state *sta;
+	bool new_sta = false;
+	bool new_sae = false;
+	bool accepted;
+	int r;
+
+	sta = l_queue_find(ap->sta_states, ap_sta_match_addr, from);
+
+	/* A Commit after an Accepted exchange starts a new instance */
+	if (sta && sta->sae && sta->sae_hs->have_pmk && transaction == 1)
+		ap_sae_free(sta);
+
+	if (!sta || !sta->sae) {
+		unsigned int in_progress = ap_sae_count_in_progress(ap);
+
+		/* Only a Commit can create a protocol instance */
+		if (transaction != 1)
+			return;
+
+		if (!sta) {
+			sta = l_new(struct sta_state, 1);
+			memcpy(sta->addr, from, 6);
+			sta->ap = ap;
+			new_sta = true;
+		}
+
+		ap_sae_new(sta);
+		new_sae = true;
+
+		if (in_progress >= AP_SAE_ANTI_CLOGGING_THRESHOLD)
+			ap_sae_require_token(sta);
+	}
+
+	accepted = sta->sae_hs->have_pmk;
+
+	r = auth_proto_rx_authenticate(sta->sae, (const uint8_t *) hdr,
+					frame_len);
+
+	/*
+	 * A new instance that didn't move out of Nothing state (rejected,
+	 * token requested or discarded) keeps no state at all.
+	 */
+	if (new_sae && r != 0)
+		goto free_sae;
+
+	/* Anything else that isn't a silent discard ends the instance */
+	if (r > 0 || r == -ETIMEDOUT || r == -EPROTO || r == -ENOKEY) {
+		l_debug("SAE with %s failed: %i",
+			util_address_to_string(sta->addr), r);
+		goto free_sae;
+	}
+
+	if (new_sta) {
+		if (!ap->sta_states)
+			ap->sta_states = l_queue_new();
+
+		l_queue_push_tail(ap->sta_states, sta);
+	}
+
+	/*
+	 * Bound the time the exchange may take and, once Accepted, the time
+	 * the STA then has to associate
+	 */
+	if (new_sae || (!accepted && sta->sae_hs->have_pmk)) {
+		if (!accepted && sta->sae_hs->have_pmk)
+			l_debug("SAE with %s accepted",
+				util_address_to_string(sta->addr));
+
+		l_timeout_remove(sta->sae_timeout);
+		sta->sae_timeout = l_timeout_create(AP_SAE_TIMEOUT,
+							ap_sae_timeout,
+							sta, NULL);
+	}
+
+	return;
+
+free_sae:
+	ap_sae_free(sta);
+
+	if (new_sta)
+		ap_sta_free(sta);
+	else if (!sta->associated)
+		ap_remove_sta(sta);
+}
+
 /*
  * 802.11-2016 9.3.3.12 (frame format), 802.11-2016 11.3.4.3 and
  * 802.11-2016 12.3.3.2 (MLME/SME)
@@ -2626,9 +3046,19 @@ static void ap_auth_cb(const struct mmpdu_header *hdr, const void *body,
 		}
 	}
 
-	/* Only Open System authentication implemented here */
-	if (L_LE16_TO_CPU(auth->algorithm) !=
-			MMPDU_AUTH_ALGO_OPEN_SYSTEM) {
+	/* Open System here, SAE is handed to its protocol instances */
+	switch (L_LE16_TO_CPU(auth->algorithm)) {
+	case MMPDU_AUTH_ALGO_OPEN_SYSTEM:
+		break;
+	case MMPDU_AUTH_ALGO_SAE:
+		if (ap->akm_suites & IE_RSN_AKM_SUITE_SAE_SHA256) {
+			ap_sae_auth(ap, hdr, (const uint8_t *) body + body_len -
+						(const uint8_t *) hdr);
+			return;
+		}
+
+		/* fall through */
+	default:
 		ap_auth_reply(ap, from, MMPDU_REASON_CODE_UNSPECIFIED);
 		return;
 	}
@@ -2788,7 +3218,8 @@ static struct l_genl_msg *ap_build_cmd_start_ap(struct ap_state *ap)
 	uint32_t nl_ciphers[nl_ciphers_cnt];
 	uint32_t group_nl_cipher =
 		ie_rsn_cipher_suite_to_cipher(ap->group_cipher);
-	uint32_t nl_akm = CRYPTO_AKM_PSK;
+	uint32_t nl_akms[2];
+	unsigned int nl_akms_cnt = 0;
 	uint32_t wpa_version = NL80211_WPA_VERSION_2;
 	uint32_t auth_type = NL80211_AUTHTYPE_OPEN_SYSTEM;
 	unsigned int i;
@@ -2804,6 +3235,12 @@ static struct l_genl_msg *ap_build_cmd_start_ap(struct ap_state *ap)
 			nl_ciphers[nl_ciphers_cnt++] =
 				ie_rsn_cipher_suite_to_cipher(1 << i);
 
+	if (ap->akm_suites & IE_RSN_AKM_SUITE_PSK)
+		nl_akms[nl_akms_cnt++] = CRYPTO_AKM_PSK;
+
+	if (ap->akm_suites & IE_RSN_AKM_SUITE_SAE_SHA256)
+		nl_akms[nl_akms_cnt++] = CRYPTO_AKM_SAE_SHA256;
+
 	head_len = ap_build_beacon_pr_head(ap, MPDU_MANAGEMENT_SUBTYPE_BEACON,
 						bcast_addr, head, sizeof(head));
 	tail_len = ap_build_beacon_pr_tail(ap, MPDU_MANAGEMENT_SUBTYPE_BEACON,
@@ -2836,7 +3273,8 @@ static struct l_genl_msg *ap_build_cmd_start_ap(struct ap_state *ap)
 	l_genl_msg_append_attr(cmd, NL80211_ATTR_CIPHER_SUITE_GROUP, 4,
 				&group_nl_cipher);
 	l_genl_msg_append_attr(cmd, NL80211_ATTR_WPA_VERSIONS, 4, &wpa_version);
-	l_genl_msg_append_attr(cmd, NL80211_ATTR_AKM_SUITES, 4, &nl_akm);
+	l_genl_msg_append_attr(cmd, NL80211_ATTR_AKM_SUITES, nl_akms_cnt * 4,
+				nl_akms);
 	l_genl_msg_append_attr(cmd, NL80211_ATTR_AUTH_TYPE, 4, &auth_type);
 	l_genl_msg_append_attr(cmd, NL80211_ATTR_WIPHY_FREQ, 4,
 				&ap->chandef.frequency);
@@ -2966,6 +3404,7 @@ static void ap_handle_new_station(struct ap_state *ap, struct l_genl_msg *msg)
 	const void *data;
 	const uint8_t *mac = NULL;
 	uint8_t *assoc_rsne = NULL;
+	struct ie_rsn_info rsn_info;
 
 	if (!l_genl_attr_init(&attr, msg))
 		return;
@@ -3006,6 +3445,10 @@ static void ap_handle_new_station(struct ap_state *ap, struct l_genl_msg *msg)
 	sta->assoc_rsne = assoc_rsne;
 	sta->aid = ++ap->last_aid;
 
+	if (!ie_parse_rsne_from_data(assoc_rsne, assoc_rsne[1] + 2,
+					&rsn_info))
+		sta->mfp = ap->mfpc && rsn_info.mfpc;
+
 	sta->associated = true;
 
 	if (!ap->sta_states)
@@ -3522,6 +3965,72 @@ static bool ap_load_psk(struct ap_state *ap, const struct l_settings *config)
 	return true;
 }
 
+static bool ap_load_sae(struct ap_state *ap, const struct l_settings *config)
+{
+	struct wiphy *wiphy = netdev_get_wiphy(ap->netdev);
+	bool sae = false;
+	bool disable_psk = false;
+
+	if (l_settings_has_key(config, "Security", "SAE") &&
+			!l_settings_get_bool(config, "Security", "SAE", &sae)) {
+		l_error("AP [Security].SAE must be a boolean");
+		return false;
+	}
+
+	if (l_settings_has_key(config, "Security", "DisablePSK") &&
+			!l_settings_get_bool(config, "Security", "DisablePSK",
+						&disable_psk)) {
+		l_error("AP [Security].DisablePSK must be a boolean");
+		return false;
+	}
+
+	if (disable_psk && !sae) {
+		l_error("AP [Security].DisablePSK requires [Security].SAE");
+		return false;
+	}
+
+	ap->akm_suites = disable_psk ? 0 : IE_RSN_AKM_SUITE_PSK;
+
+	if (!sae)
+		return true;
+
+	if (!ap->passphrase[0]) {
+		l_error("AP [Security].SAE requires [Security].Passphrase");
+		return false;
+	}
+
+	/*
+	 * WPA3 Specification v3.0 2.2, 2.3: SAE requires MFP, capable in
+	 * transition mode and required when only SAE is offered.
+	 */
+	if (!wiphy_get_supported_ciphers(wiphy,
+					IE_RSN_CIPHER_SUITE_BIP_CMAC)) {
+		l_error("AP [Security].SAE requires BIP-CMAC-128 support");
+		return false;
+	}
+
+	ap->akm_suites |= IE_RSN_AKM_SUITE_SAE_SHA256;
+	ap->group_management_cipher = IE_RSN_CIPHER_SUITE_BIP_CMAC;
+	ap->mfpc = true;
+	ap->mfpr = disable_psk;
+
+	/*
+	 * The PTs only depend on the SSID and the password so derive them
+	 * once here rather than for every STA.  Without them STAs can still
+	 * use hunting-and-pecking.
+	 */
+	ap->sae_pt_19 = crypto_derive_sae_pt_ecc(19, ap->ssid, ap->passphrase,
+							NULL);
+	ap->sae_pt_20 = crypto_derive_sae_pt_ecc(20, ap->ssid, ap->passphrase,
+							NULL);
+	if (!ap->sae_pt_19 && !ap->sae_pt_20)
+		l_warn("AP couldn't derive SAE PTs, H2E disabled");
+
+	l_getrandom(ap->sae_token_key, sizeof(ap->sae_token_key));
+
+	return true;
+}
+
 /*
  * Note: only PTK/GTK ciphers are supported here since this is all these are
  *       used for.
@@ -3643,6 +4152,9 @@ static int ap_load_config(struct ap_state *ap, const struct l_settings *config,
 	if (!ap_load_psk(ap, config))
 		return -EINVAL;
 
+	if (!ap_load_sae(ap, config))
+		return -EINVAL;
+
 	/*
 	 * This looks at the network configuration settings in @config and
 	 * relevant global settings and if it determines that netconfig is to
@@ -4036,7 +4548,7 @@ void ap_shutdown(struct ap_state *ap, ap_stopped_func_t stopped_func,
 	if (ap->gtk_set) {
 		ap->gtk_set = false;
 
-		cmd = ap_build_cmd_del_key(ap);
+		cmd = ap_build_cmd_del_key(ap, ap->gtk_index);
 		if (!cmd) {
 			l_error("ap_build_cmd_del_key failed");
 			goto free_ap;
@@ -4048,6 +4560,16 @@ void ap_shutdown(struct ap_state *ap, ap_stopped_func_t stopped_func,
 			l_error("Issuing DEL_KEY failed");
 			goto free_ap;
 		}
+
+		if (ap->mfpc) {
+			cmd = ap_build_cmd_del_key(ap, ap->igtk_index);
+			if (!l_genl_family_send(ap->nl80211, cmd, ap_gtk_op_cb,
+						NULL, NULL)) {
+				l_genl_msg_unref(cmd);
+				l_error("Issuing DEL_KEY failed");
+				goto free_ap;
+			}
+		}
 	}
 
 	cmd = ap_build_cmd_stop_ap(ap);
@@ -4151,6 +4673,9 @@ bool ap_push_button(struct ap_state *ap)
 						ap_wsc_pbc_timeout_destroy);
 	ap->wsc_dpid = WSC_DEVICE_PASSWORD_ID_PUSH_BUTTON;
 	ap_update_beacon(ap);
+
+	/* Have the registrar's DH keypair ready before an enrollee shows up */
+	eap_wsc_prepare_keys();
 	return true;
 }
 
@@ -1575,6 +1575,18 @@ static enum band_freq oper_class_to_band(const uint8_t *country,
 		return 0;
 }
 
+/*
+ * 802.11ax-2021, Section 26.17.2.3.3: Preferred Scanning Channels are every
+ * fourth 20 MHz 6 GHz channel, starting with channel 5
+ */
+bool band_6ghz_channel_is_psc(uint8_t channel)
+{
+	if (channel < 5 || channel > 229)
+		return false;
+
+	return (channel - 5) % 16 == 0;
+}
+
 enum band_freq band_oper_class_to_band(const uint8_t *country,
 					uint8_t oper_class)
 {
@@ -27,6 +27,7 @@
 #include <ell/ell.h>
 
 #include "src/blacklist.h"
+#include "src/bss-history.h"
 #include "src/util.h"
 #include "src/iwd.h"
 #include "src/module.h"
@@ -43,9 +44,13 @@
 /* The maximum amount of time a BSS can be blacklisted for */
 #define BLACKLIST_DEFAULT_MAX_TIMEOUT	86400
 
+/* Time for the rank penalty of a past connection failure to halve */
+#define BLACKLIST_DEFAULT_HISTORY_HALF_LIFE	900
+
 static uint64_t blacklist_multiplier;
 static uint64_t blacklist_initial_timeout;
 static uint64_t blacklist_max_timeout;
+static uint64_t blacklist_history_half_life;
 
 struct blacklist_entry {
 	uint8_t addr[6];
@@ -54,6 +59,7 @@ struct blacklist_entry {
 };
 
 static struct l_queue *blacklist;
+static struct bss_history *history;
 
 static bool check_if_expired(void *data, void *user_data)
 {
@@ -153,6 +159,31 @@ void blacklist_remove_bss(const uint8_t *addr)
 	l_free(entry);
 }
 
+/*
+ * Unlike the blacklist, which keeps a BSS from being tried at all for a
+ * while, the connection history of a BSS only lowers its rank and does so
+ * for longer, fading as the failures age.
+ */
+void blacklist_bss_event(const uint8_t *addr, enum bss_history_event event)
+{
+	l_debug(MAC" %s", MAC_STR(addr), bss_history_event_to_string(event));
+
+	bss_history_record(history, addr, event, l_time_now());
+}
+
+double blacklist_get_rank_factor(const uint8_t *addr)
+{
+	if (!history || !blacklist_history_half_life)
+		return 1.0;
+
+	return bss_history_get_rank_factor(history, addr, l_time_now());
+}
+
+const struct bss_history *blacklist_get_history(void)
+{
+	return history;
+}
+
 static int blacklist_init(void)
 {
 	const struct l_settings *config = iwd_get_config();
@@ -176,7 +207,16 @@ static int blacklist_init(void)
 
 	blacklist_max_timeout *= 1000000;
 
+	if (!l_settings_get_uint64(config, "Blacklist", "HistoryHalfLife",
+					&blacklist_history_half_life))
+		blacklist_history_half_life =
+				BLACKLIST_DEFAULT_HISTORY_HALF_LIFE;
+
+	blacklist_history_half_life *= 1000000;
+
 	blacklist = l_queue_new();
+	history = bss_history_new(BSS_HISTORY_MAX_BSS,
+					blacklist_history_half_life);
 
 	return 0;
 }
@@ -184,6 +224,8 @@ static int blacklist_init(void)
 static void blacklist_exit(void)
 {
 	l_queue_destroy(blacklist, l_free);
+	bss_history_free(history);
+	history = NULL;
 }
 
 IWD_MODULE(blacklist, blacklist_init, blacklist_exit)
@@ -20,6 +20,13 @@
  *
  */
 
+enum bss_history_event;
+struct bss_history;
+
 void blacklist_add_bss(const uint8_t *addr);
 bool blacklist_contains_bss(const uint8_t *addr);
 void blacklist_remove_bss(const uint8_t *addr);
+
+void blacklist_bss_event(const uint8_t *addr, enum bss_history_event event);
+double blacklist_get_rank_factor(const uint8_t *addr);
+const struct bss_history *blacklist_get_history(void);
@@ -0,0 +1,295 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "src/bss-history.h"
+
+/*
+ * Bounded record of how connections to individual BSSes turned out.  Each
+ * failure adds to a penalty which halves every half_life microseconds, so a
+ * BSS that keeps failing ranks below its neighbors for a while after any
+ * blacklist entry for it has expired, and recovers on its own once it
+ * stops failing.
+ */
+
+struct bss_history_record {
+	enum bss_history_event event;
+	uint64_t time;
+	/* How long the connection lasted before failing, 0 if it never did */
+	uint64_t time_to_failure;
+};
+
+struct bss_history_entry {
+	uint8_t addr[6];
+	uint64_t connected_time;
+	unsigned int n_records;
+	unsigned int next;
+	struct bss_history_record records[BSS_HISTORY_MAX_RECORDS];
+};
+
+struct bss_history {
+	unsigned int max_bss;
+	uint64_t half_life;
+	/* Most recently updated first */
+	struct l_queue *entries;
+};
+
+static bool match_addr(const void *a, const void *b)
+{
+	const struct bss_history_entry *entry = a;
+	const uint8_t *addr = b;
+
+	return !memcmp(entry->addr, addr, 6);
+}
+
+struct bss_history *bss_history_new(unsigned int max_bss, uint64_t half_life)
+{
+	struct bss_history *history = l_new(struct bss_history, 1);
+
+	history->max_bss = max_bss ?: 1;
+	history->half_life = half_life;
+	history->entries = l_queue_new();
+
+	return history;
+}
+
+void bss_history_free(struct bss_history *history)
+{
+	if (!history)
+		return;
+
+	l_queue_destroy(history->entries, l_free);
+	l_free(history);
+}
+
+static struct bss_history_entry *bss_history_get_entry(
+						struct bss_history *history,
+						const uint8_t *addr)
+{
+	struct bss_history_entry *entry;
+
+	entry = l_queue_remove_if(history->entries, match_addr, addr);
+	if (entry)
+		goto done;
+
+	if (l_queue_length(history->entries) >= history->max_bss) {
+		entry = l_queue_peek_tail(history->entries);
+		l_queue_remove(history->entries, entry);
+		l_free(entry);
+	}
+
+	entry = l_new(struct bss_history_entry, 1);
+	memcpy(entry->addr, addr, 6);
+
+done:
+	l_queue_push_head(history->entries, entry);
+	return entry;
+}
+
+void bss_history_record(struct bss_history *history, const uint8_t *addr,
+			enum bss_history_event event, uint64_t now)
+{
+	struct bss_history_entry *entry = bss_history_get_entry(history, addr);
+	struct bss_history_record *record = &entry->records[entry->next];
+
+	record->event = event;
+	record->time = now;
+	record->time_to_failure = 0;
+
+	switch (event) {
+	case BSS_HISTORY_CONNECTED:
+		entry->connected_time = now;
+		break;
+	case BSS_HISTORY_CONNECT_FAILED:
+	case BSS_HISTORY_HANDSHAKE_FAILED:
+		entry->connected_time = 0;
+		break;
+	case BSS_HISTORY_BEACON_LOSS:
+	case BSS_HISTORY_DISCONNECTED:
+		if (entry->connected_time)
+			record->time_to_failure = l_time_diff(
+							entry->connected_time,
+							now) ?: 1;
+
+		/* Beacon loss only triggers a roam, we may well stay */
+		if (event == BSS_HISTORY_DISCONNECTED)
+			entry->connected_time = 0;
+
+		break;
+	}
+
+	entry->next = (entry->next + 1) % BSS_HISTORY_MAX_RECORDS;
+
+	if (entry->n_records < BSS_HISTORY_MAX_RECORDS)
+		entry->n_records++;
+}
+
+static double bss_history_record_weight(
+				const struct bss_history_record *record)
+{
+	uint64_t connected = l_time_to_secs(record->time_to_failure);
+
+	switch (record->event) {
+	case BSS_HISTORY_CONNECTED:
+		return 0;
+	case BSS_HISTORY_CONNECT_FAILED:
+	case BSS_HISTORY_HANDSHAKE_FAILED:
+		return 1.0;
+	case BSS_HISTORY_BEACON_LOSS:
+	case BSS_HISTORY_DISCONNECTED:
+		/*
+		 * A connection that only lasts seconds is as bad as no
+		 * connection at all, losing one after a long while is normal.
+		 */
+		if (!record->time_to_failure)
+			return 0.5;
+
+		if (connected < 60)
+			return 1.0;
+
+		if (connected < 600)
+			return 0.5;
+
+		return 0.25;
+	}
+
+	return 0;
+}
+
+/*
+ * 2^(-age / half_life), interpolating linearly between whole half lives to
+ * avoid depending on libm.  Negligible past 16 half lives.
+ */
+static double bss_history_decay(uint64_t age, uint64_t half_life)
+{
+	uint64_t n;
+	double frac;
+
+	if (!half_life)
+		return 0;
+
+	n = age / half_life;
+	if (n >= 16)
+		return 0;
+
+	frac = (double) (age % half_life) / half_life;
+
+	return (1.0 - frac / 2) / (1 << n);
+}
+
+static const struct bss_history_entry *bss_history_find(
+					const struct bss_history *history,
+					const uint8_t *addr)
+{
+	return l_queue_find(history->entries, match_addr, addr);
+}
+
+/* Sum of the decayed weights of the failures recorded for a BSS */
+double bss_history_get_penalty(const struct bss_history *history,
+				const uint8_t *addr, uint64_t now)
+{
+	const struct bss_history_entry *entry;
+	double penalty = 0;
+	unsigned int i;
+
+	if (!history)
+		return 0;
+
+	entry = bss_history_find(history, addr);
+	if (!entry)
+		return 0;
+
+	for (i = 0; i < entry->n_records; i++) {
+		const struct bss_history_record *record = &entry->records[i];
+		uint64_t age = 0;
+
+		if (l_time_after(now, record->time))
+			age = l_time_diff(record->time, now);
+
+		penalty += bss_history_record_weight(record) *
+				bss_history_decay(age, history->half_life);
+	}
+
+	return penalty;
+}
+
+/* Multiplier in (0, 1] to be applied to the rank of a BSS */
+double bss_history_get_rank_factor(const struct bss_history *history,
+					const uint8_t *addr, uint64_t now)
+{
+	return 1.0 / (1.0 + bss_history_get_penalty(history, addr, now));
+}
+
+/* Walks the records kept for a BSS, oldest first */
+unsigned int bss_history_foreach(const struct bss_history *history,
+					const uint8_t *addr,
+					bss_history_foreach_func_t func,
+					void *user_data)
+{
+	const struct bss_history_entry *entry;
+	unsigned int first;
+	unsigned int i;
+
+	if (!history)
+		return 0;
+
+	entry = bss_history_find(history, addr);
+	if (!entry)
+		return 0;
+
+	first = entry->n_records < BSS_HISTORY_MAX_RECORDS ? 0 : entry->next;
+
+	for (i = 0; i < entry->n_records; i++) {
+		const struct bss_history_record *record =
+			&entry->records[(first + i) % BSS_HISTORY_MAX_RECORDS];
+
+		func(record->event, record->time, record->time_to_failure,
+			user_data);
+	}
+
+	return entry->n_records;
+}
+
+const char *bss_history_event_to_string(enum bss_history_event event)
+{
+	switch (event) {
+	case BSS_HISTORY_CONNECTED:
+		return "connected";
+	case BSS_HISTORY_CONNECT_FAILED:
+		return "connect-failed";
+	case BSS_HISTORY_HANDSHAKE_FAILED:
+		return "handshake-failed";
+	case BSS_HISTORY_BEACON_LOSS:
+		return "beacon-loss";
+	case BSS_HISTORY_DISCONNECTED:
+		return "disconnected";
+	}
+
+	return "unknown";
+}
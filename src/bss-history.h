@@ -0,0 +1,61 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct bss_history;
+
+/* BSSes tracked, the least recently updated one is evicted first */
+#define BSS_HISTORY_MAX_BSS 64
+
+/* Outcomes kept per BSS, older ones are overwritten */
+#define BSS_HISTORY_MAX_RECORDS 8
+
+enum bss_history_event {
+	BSS_HISTORY_CONNECTED,
+	/* Authentication or association rejected or timed out */
+	BSS_HISTORY_CONNECT_FAILED,
+	/* 4-Way or EAP handshake failed, or deauthenticated while in it */
+	BSS_HISTORY_HANDSHAKE_FAILED,
+	BSS_HISTORY_BEACON_LOSS,
+	/* Disconnected by the AP while connected */
+	BSS_HISTORY_DISCONNECTED,
+};
+
+typedef void (*bss_history_foreach_func_t)(enum bss_history_event event,
+						uint64_t time,
+						uint64_t time_to_failure,
+						void *user_data);
+
+struct bss_history *bss_history_new(unsigned int max_bss, uint64_t half_life);
+void bss_history_free(struct bss_history *history);
+
+void bss_history_record(struct bss_history *history, const uint8_t *addr,
+			enum bss_history_event event, uint64_t now);
+double bss_history_get_penalty(const struct bss_history *history,
+				const uint8_t *addr, uint64_t now);
+double bss_history_get_rank_factor(const struct bss_history *history,
+					const uint8_t *addr, uint64_t now);
+unsigned int bss_history_foreach(const struct bss_history *history,
+					const uint8_t *addr,
+					bss_history_foreach_func_t func,
+					void *user_data);
+
+const char *bss_history_event_to_string(enum bss_history_event event);
@@ -0,0 +1,212 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ell/ell.h>
+
+#include "src/util.h"
+#include "src/channel-stats.h"
+
+/*
+ * Per-channel record of what scans have found.  A channel on which the
+ * last quiet_scans scans found no BSS at all is considered quiet, callers
+ * can leave it out of routine scans until a full sweep or any other scan
+ * finds something there again.
+ */
+
+struct channel_stats_entry {
+	uint32_t freq;
+	struct channel_stats_info info;
+};
+
+struct channel_stats {
+	unsigned int quiet_scans;
+	/* Sorted by frequency */
+	struct l_queue *entries;
+};
+
+struct channel_stats_update {
+	struct channel_stats *stats;
+	const uint32_t *bss_freqs;
+	unsigned int n_bss;
+	uint64_t now;
+};
+
+static bool match_freq(const void *a, const void *b)
+{
+	const struct channel_stats_entry *entry = a;
+	uint32_t freq = L_PTR_TO_UINT(b);
+
+	return entry->freq == freq;
+}
+
+static int entry_compare(const void *a, const void *b, void *user_data)
+{
+	const struct channel_stats_entry *new_entry = a;
+	const struct channel_stats_entry *entry = b;
+
+	return new_entry->freq < entry->freq ? -1 : 1;
+}
+
+struct channel_stats *channel_stats_new(unsigned int quiet_scans)
+{
+	struct channel_stats *stats = l_new(struct channel_stats, 1);
+
+	stats->quiet_scans = quiet_scans;
+	stats->entries = l_queue_new();
+
+	return stats;
+}
+
+void channel_stats_free(struct channel_stats *stats)
+{
+	if (!stats)
+		return;
+
+	l_queue_destroy(stats->entries, l_free);
+	l_free(stats);
+}
+
+static struct channel_stats_entry *channel_stats_find(
+					const struct channel_stats *stats,
+					uint32_t freq)
+{
+	return l_queue_find(stats->entries, match_freq, L_UINT_TO_PTR(freq));
+}
+
+static void channel_stats_update_freq(uint32_t freq, void *user_data)
+{
+	struct channel_stats_update *update = user_data;
+	struct channel_stats_entry *entry;
+	struct channel_stats_info *info;
+	unsigned int count = 0;
+	unsigned int i;
+
+	entry = channel_stats_find(update->stats, freq);
+	if (!entry) {
+		entry = l_new(struct channel_stats_entry, 1);
+		entry->freq = freq;
+		l_queue_insert(update->stats->entries, entry,
+				entry_compare, NULL);
+	}
+
+	info = &entry->info;
+
+	for (i = 0; i < update->n_bss; i++)
+		if (update->bss_freqs[i] == freq)
+			count++;
+
+	info->scans++;
+	info->last_bss_count = count;
+	info->last_scanned = update->now;
+	info->occupancy += ((count ? 1.0 : 0.0) - info->occupancy) / 8;
+
+	if (!count) {
+		info->empty_streak++;
+		return;
+	}
+
+	info->occupied_scans++;
+	info->empty_streak = 0;
+	info->last_seen = update->now;
+}
+
+/*
+ * 'scanned' is the set of channels the scan covered and 'bss_freqs' the
+ * frequency of every BSS it found.  BSSes on channels outside of 'scanned'
+ * are ignored.
+ */
+void channel_stats_add_scan(struct channel_stats *stats,
+				const struct scan_freq_set *scanned,
+				const uint32_t *bss_freqs, unsigned int n_bss,
+				uint64_t now)
+{
+	struct channel_stats_update update = {
+		.stats = stats,
+		.bss_freqs = bss_freqs,
+		.n_bss = n_bss,
+		.now = now,
+	};
+
+	scan_freq_set_foreach(scanned, channel_stats_update_freq, &update);
+}
+
+static bool channel_stats_entry_is_quiet(const struct channel_stats *stats,
+					const struct channel_stats_entry *entry)
+{
+	return stats->quiet_scans &&
+		entry->info.empty_streak >= stats->quiet_scans;
+}
+
+bool channel_stats_is_quiet(const struct channel_stats *stats, uint32_t freq)
+{
+	const struct channel_stats_entry *entry =
+					channel_stats_find(stats, freq);
+
+	return entry && channel_stats_entry_is_quiet(stats, entry);
+}
+
+/*
+ * Returns the quiet channels out of 'freqs', or out of all channels seen
+ * so far if 'freqs' is NULL.  The returned set may be empty.
+ */
+struct scan_freq_set *channel_stats_get_quiet(
+					const struct channel_stats *stats,
+					const struct scan_freq_set *freqs)
+{
+	struct scan_freq_set *quiet = scan_freq_set_new();
+	const struct l_queue_entry *e;
+
+	for (e = l_queue_get_entries(stats->entries); e; e = e->next) {
+		const struct channel_stats_entry *entry = e->data;
+
+		if (!channel_stats_entry_is_quiet(stats, entry))
+			continue;
+
+		if (freqs && !scan_freq_set_contains(freqs, entry->freq))
+			continue;
+
+		scan_freq_set_add(quiet, entry->freq);
+	}
+
+	return quiet;
+}
+
+unsigned int channel_stats_foreach(const struct channel_stats *stats,
+					channel_stats_foreach_func_t func,
+					void *user_data)
+{
+	const struct l_queue_entry *e;
+	unsigned int n = 0;
+
+	for (e = l_queue_get_entries(stats->entries); e; e = e->next, n++) {
+		const struct channel_stats_entry *entry = e->data;
+
+		func(entry->freq, &entry->info, user_data);
+	}
+
+	return n;
+}
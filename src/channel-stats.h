@@ -0,0 +1,61 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+struct scan_freq_set;
+struct channel_stats;
+
+/* What past scans found on one channel */
+struct channel_stats_info {
+	/* Scans that covered the channel */
+	uint32_t scans;
+	/* Of those, scans that found at least one BSS */
+	uint32_t occupied_scans;
+	/* Scans in a row that found nothing, reset by the first BSS seen */
+	uint32_t empty_streak;
+	/* BSSes found by the most recent scan */
+	uint32_t last_bss_count;
+	/* Share of recent scans that found a BSS, 1/8 weight per scan */
+	double occupancy;
+	/* Last time a BSS was seen on the channel, 0 if never */
+	uint64_t last_seen;
+	uint64_t last_scanned;
+};
+
+typedef void (*channel_stats_foreach_func_t)(uint32_t freq,
+					const struct channel_stats_info *info,
+					void *user_data);
+
+struct channel_stats *channel_stats_new(unsigned int quiet_scans);
+void channel_stats_free(struct channel_stats *stats);
+
+void channel_stats_add_scan(struct channel_stats *stats,
+				const struct scan_freq_set *scanned,
+				const uint32_t *bss_freqs, unsigned int n_bss,
+				uint64_t now);
+bool channel_stats_is_quiet(const struct channel_stats *stats, uint32_t freq);
+struct scan_freq_set *channel_stats_get_quiet(
+					const struct channel_stats *stats,
+					const struct scan_freq_set *freqs);
+unsigned int channel_stats_foreach(const struct channel_stats *stats,
+					channel_stats_foreach_func_t func,
+					void *user_data);
@@ -90,6 +90,81 @@ static bool hmac_common(enum l_checksum_type type,
 	return true;
 }
 
+/*
+ * Keying an HMAC context is by far the most expensive part of the short
+ * PRF/KDF invocations used for key derivation.  A cache keeps one context per
+ * hash type for as long as the key stays the same, e.g. for a PMK across
+ * rekeys and PMKID computations.
+ */
+struct crypto_hmac_cache {
+	uint8_t key[64];
+	size_t key_len;
+	struct l_checksum *hmac[L_CHECKSUM_SHA512 + 1];
+};
+
+void crypto_hmac_cache_free(struct crypto_hmac_cache *cache)
+{
+	unsigned int i;
+
+	if (!cache)
+		return;
+
+	for (i = 0; i < L_ARRAY_SIZE(cache->hmac); i++)
+		l_checksum_free(cache->hmac[i]);
+
+	explicit_bzero(cache, sizeof(*cache));
+	l_free(cache);
+}
+
+/*
+ * Get an HMAC context keyed with @key, from @cache if one is given.  A cache
+ * holding a different key is replaced.  If @cached is set to false the
+ * caller owns the context and must free it.
+ */
+static struct l_checksum *crypto_hmac_get(struct crypto_hmac_cache **cache,
+						enum l_checksum_type type,
+						const void *key, size_t key_len,
+						bool *cached)
+{
+	struct crypto_hmac_cache *c;
+
+	*cached = false;
+
+	if (!cache || key_len > sizeof(c->key) ||
+			(unsigned int) type >= L_ARRAY_SIZE(c->hmac))
+		return l_checksum_new_hmac(type, key, key_len);
+
+	c = *cache;
+
+	if (c && (c->key_len != key_len ||
+			l_secure_memcmp(c->key, key, key_len))) {
+		crypto_hmac_cache_free(c);
+		c = NULL;
+	}
+
+	if (!c) {
+		c = l_new(struct crypto_hmac_cache, 1);
+		memcpy(c->key, key, key_len);
+		c->key_len = key_len;
+		*cache = c;
+	}
+
+	if (!c->hmac[type]) {
+		c->hmac[type] = l_checksum_new_hmac(type, key, key_len);
+		if (!c->hmac[type])
+			return NULL;
+	}
+
+	*cached = true;
+	return c->hmac[type];
+}
+
+static void crypto_hmac_put(struct l_checksum *hmac, bool cached)
+{
+	if (!cached)
+		l_checksum_free(hmac);
+}
+
 bool hmac_md5(const void *key, size_t key_len,
 		const void *data, size_t data_len, void *output, size_t size)
 {
@@ -584,11 +659,11 @@ int crypto_psk_from_passphrase(const char *passphrase,
 	return 0;
 }
 
-bool prf_sha1(const void *key, size_t key_len,
-		const void *prefix, size_t prefix_len,
-		const void *data, size_t data_len, void *output, size_t size)
+static void prf_sha1_hmac(struct l_checksum *hmac,
+				const void *prefix, size_t prefix_len,
+				const void *data, size_t data_len,
+				void *output, size_t size)
 {
-	struct l_checksum *hmac;
 	unsigned int i, offset = 0;
 	unsigned char empty = '\0';
 	unsigned char counter;
@@ -599,10 +674,6 @@ bool prf_sha1(const void *key, size_t key_len,
 		[3] = { .iov_base = &counter, .iov_len = 1 },
 	};
 
-	hmac = l_checksum_new_hmac(L_CHECKSUM_SHA1, key, key_len);
-	if (!hmac)
-		return false;
-
 	/* PRF processes in 160-bit chunks (20 bytes) */
 	for (i = 0, counter = 0; i < (size + 19) / 20; i++, counter++) {
 		size_t len;
@@ -617,12 +688,35 @@ bool prf_sha1(const void *key, size_t key_len,
 
 		offset += len;
 	}
+}
 
-	l_checksum_free(hmac);
+static bool prf_sha1_cached(struct crypto_hmac_cache **cache,
+				const void *key, size_t key_len,
+				const void *prefix, size_t prefix_len,
+				const void *data, size_t data_len,
+				void *output, size_t size)
+{
+	struct l_checksum *hmac;
+	bool cached;
+
+	hmac = crypto_hmac_get(cache, L_CHECKSUM_SHA1, key, key_len, &cached);
+	if (!hmac)
+		return false;
+
+	prf_sha1_hmac(hmac, prefix, prefix_len, data, data_len, output, size);
+	crypto_hmac_put(hmac, cached);
 
 	return true;
 }
 
+bool prf_sha1(const void *key, size_t key_len,
+		const void *prefix, size_t prefix_len,
+		const void *data, size_t data_len, void *output, size_t size)
+{
+	return prf_sha1_cached(NULL, key, key_len, prefix, prefix_len,
+					data, data_len, output, size);
+}
+
 /* PRF+ from RFC 5295 Section 3.1.2 (also RFC 4306 Section 2.13) */
 bool prf_plus(enum l_checksum_type type, const void *key, size_t key_len,
 		void *out, size_t out_len,
@@ -754,11 +848,11 @@ bool prf_plus_sha1(const void *key, size_t key_len,
 }
 
 /* Defined in 802.11-2012, Section 11.6.1.7.2 Key derivation function (KDF) */
-bool crypto_kdf(enum l_checksum_type type, const void *key, size_t key_len,
-		const void *prefix, size_t prefix_len,
-		const void *data, size_t data_len, void *output, size_t size)
+static void kdf_hmac(struct l_checksum *hmac, enum l_checksum_type type,
+			const void *prefix, size_t prefix_len,
+			const void *data, size_t data_len,
+			void *output, size_t size)
 {
-	struct l_checksum *hmac;
 	unsigned int i, offset = 0;
 	unsigned int counter;
 	unsigned int chunk_size;
@@ -772,10 +866,6 @@ bool crypto_kdf(enum l_checksum_type type, const void *key, size_t key_len,
 		[3] = { .iov_base = length_le, .iov_len = 2 },
 	};
 
-	hmac = l_checksum_new_hmac(type, key, key_len);
-	if (!hmac)
-		return false;
-
 	chunk_size = l_checksum_digest_length(type);
 	n_iterations = (size + chunk_size - 1) / chunk_size;
 
@@ -797,12 +887,36 @@ bool crypto_kdf(enum l_checksum_type type, const void *key, size_t key_len,
 
 		offset += len;
 	}
+}
 
-	l_checksum_free(hmac);
+static bool crypto_kdf_cached(struct crypto_hmac_cache **cache,
+				enum l_checksum_type type,
+				const void *key, size_t key_len,
+				const void *prefix, size_t prefix_len,
+				const void *data, size_t data_len,
+				void *output, size_t size)
+{
+	struct l_checksum *hmac;
+	bool cached;
+
+	hmac = crypto_hmac_get(cache, type, key, key_len, &cached);
+	if (!hmac)
+		return false;
+
+	kdf_hmac(hmac, type, prefix, prefix_len, data, data_len, output, size);
+	crypto_hmac_put(hmac, cached);
 
 	return true;
 }
 
+bool crypto_kdf(enum l_checksum_type type, const void *key, size_t key_len,
+		const void *prefix, size_t prefix_len,
+		const void *data, size_t data_len, void *output, size_t size)
+{
+	return crypto_kdf_cached(NULL, type, key, key_len, prefix, prefix_len,
+					data, data_len, output, size);
+}
+
 bool kdf_sha256(const void *key, size_t key_len,
 		const void *prefix, size_t prefix_len,
 		const void *data, size_t data_len, void *output, size_t size)
@@ -888,7 +1002,8 @@ bool hkdf_expand(enum l_checksum_type type, const void *key, size_t key_len,
  * Max operations for nonces are with the nonces treated as positive integers
  * converted as specified in 8.2.2.
  */
-static bool crypto_derive_ptk(const uint8_t *pmk, size_t pmk_len,
+static bool crypto_derive_ptk(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk, size_t pmk_len,
 				const char *label,
 				const uint8_t *addr1, const uint8_t *addr2,
 				const uint8_t *nonce1, const uint8_t *nonce2,
@@ -922,27 +1037,43 @@ static bool crypto_derive_ptk(const uint8_t *pmk, size_t pmk_len,
 	pos += 64;
 
 	if (type == L_CHECKSUM_SHA1)
-		return prf_sha1(pmk, pmk_len, label, strlen(label),
+		return prf_sha1_cached(cache, pmk, pmk_len,
+					label, strlen(label),
 					data, sizeof(data), out_ptk, ptk_len);
 	else
-		return crypto_kdf(type, pmk, pmk_len, label, strlen(label),
+		return crypto_kdf_cached(cache, type, pmk, pmk_len,
+					label, strlen(label),
 					data, sizeof(data), out_ptk, ptk_len);
 }
 
-bool crypto_derive_pairwise_ptk(const uint8_t *pmk, size_t pmk_len,
+bool crypto_derive_pairwise_ptk_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk, size_t pmk_len,
 				const uint8_t *addr1, const uint8_t *addr2,
 				const uint8_t *nonce1, const uint8_t *nonce2,
 				uint8_t *out_ptk, size_t ptk_len,
 				enum l_checksum_type type)
 {
-	return crypto_derive_ptk(pmk, pmk_len, "Pairwise key expansion",
+	return crypto_derive_ptk(cache, pmk, pmk_len, "Pairwise key expansion",
 					addr1, addr2, nonce1, nonce2,
 					out_ptk, ptk_len,
 					type);
 }
 
+bool crypto_derive_pairwise_ptk(const uint8_t *pmk, size_t pmk_len,
+				const uint8_t *addr1, const uint8_t *addr2,
+				const uint8_t *nonce1, const uint8_t *nonce2,
+				uint8_t *out_ptk, size_t ptk_len,
+				enum l_checksum_type type)
+{
+	return crypto_derive_pairwise_ptk_cached(NULL, pmk, pmk_len,
+							addr1, addr2,
+							nonce1, nonce2,
+							out_ptk, ptk_len, type);
+}
+
 /* Defined in 802.11-2012, Section 11.6.1.7.3 PMK-R0 */
-bool crypto_derive_pmk_r0(const uint8_t *xxkey, size_t xxkey_len,
+bool crypto_derive_pmk_r0_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *xxkey, size_t xxkey_len,
 				const uint8_t *ssid, size_t ssid_len,
 				uint16_t mdid,
 				const uint8_t *r0khid, size_t r0kh_len,
@@ -976,15 +1107,11 @@ bool crypto_derive_pmk_r0(const uint8_t *xxkey, size_t xxkey_len,
 	memcpy(context + pos, s0khid, ETH_ALEN);
 	pos += ETH_ALEN;
 
-	if (sha384) {
-		if (!kdf_sha384(xxkey, xxkey_len, "FT-R0", 5, context, pos,
-					output, 64))
-			goto exit;
-	} else {
-		if (!kdf_sha256(xxkey, xxkey_len, "FT-R0", 5, context, pos,
-					output, 48))
-			goto exit;
-	}
+	if (!crypto_kdf_cached(cache, sha384 ?
+					L_CHECKSUM_SHA384 : L_CHECKSUM_SHA256,
+				xxkey, xxkey_len, "FT-R0", 5, context, pos,
+				output, sha384 ? 64 : 48))
+		goto exit;
 
 	sha = l_checksum_new((sha384) ? L_CHECKSUM_SHA384 : L_CHECKSUM_SHA256);
 	if (!sha)
@@ -1006,8 +1133,23 @@ exit:
 	return r;
 }
 
+bool crypto_derive_pmk_r0(const uint8_t *xxkey, size_t xxkey_len,
+				const uint8_t *ssid, size_t ssid_len,
+				uint16_t mdid,
+				const uint8_t *r0khid, size_t r0kh_len,
+				const uint8_t *s0khid, bool sha384,
+				uint8_t *out_pmk_r0, uint8_t *out_pmk_r0_name)
+{
+	return crypto_derive_pmk_r0_cached(NULL, xxkey, xxkey_len,
+						ssid, ssid_len, mdid,
+						r0khid, r0kh_len, s0khid,
+						sha384, out_pmk_r0,
+						out_pmk_r0_name);
+}
+
 /* Defined in 802.11-2012, Section 11.6.1.7.4 PMK-R1 */
-bool crypto_derive_pmk_r1(const uint8_t *pmk_r0,
+bool crypto_derive_pmk_r1_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk_r0,
 				const uint8_t *r1khid, const uint8_t *s1khid,
 				const uint8_t *pmk_r0_name, bool sha384,
 				uint8_t *out_pmk_r1,
@@ -1027,12 +1169,14 @@ bool crypto_derive_pmk_r1(const uint8_t *pmk_r0,
 	memcpy(context + ETH_ALEN, s1khid, ETH_ALEN);
 
 	if (sha384) {
-		if (!kdf_sha384(pmk_r0, 48, "FT-R1", 5, context,
-					sizeof(context), out_pmk_r1, 48))
+		if (!crypto_kdf_cached(cache, L_CHECKSUM_SHA384, pmk_r0, 48,
+					"FT-R1", 5, context, sizeof(context),
+					out_pmk_r1, 48))
 			goto exit;
 	} else {
-		if (!kdf_sha256(pmk_r0, 32, "FT-R1", 5, context,
-					sizeof(context), out_pmk_r1, 32))
+		if (!crypto_kdf_cached(cache, L_CHECKSUM_SHA256, pmk_r0, 32,
+					"FT-R1", 5, context, sizeof(context),
+					out_pmk_r1, 32))
 			goto exit;
 	}
 
@@ -1055,8 +1199,21 @@ exit:
 	return r;
 }
 
+bool crypto_derive_pmk_r1(const uint8_t *pmk_r0,
+				const uint8_t *r1khid, const uint8_t *s1khid,
+				const uint8_t *pmk_r0_name, bool sha384,
+				uint8_t *out_pmk_r1,
+				uint8_t *out_pmk_r1_name)
+{
+	return crypto_derive_pmk_r1_cached(NULL, pmk_r0, r1khid, s1khid,
+						pmk_r0_name, sha384,
+						out_pmk_r1, out_pmk_r1_name);
+}
+
 /* Defined in 802.11-2012, Section 11.6.1.7.5 PTK */
-bool crypto_derive_ft_ptk(const uint8_t *pmk_r1, const uint8_t *pmk_r1_name,
+bool crypto_derive_ft_ptk_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk_r1,
+				const uint8_t *pmk_r1_name,
 				const uint8_t *addr1, const uint8_t *addr2,
 				const uint8_t *nonce1, const uint8_t *nonce2,
 				bool sha384, uint8_t *out_ptk, size_t ptk_len,
@@ -1080,12 +1237,14 @@ bool crypto_derive_ft_ptk(const uint8_t *pmk_r1, const uint8_t *pmk_r1_name,
 	memcpy(context + 64 + ETH_ALEN, addr2, ETH_ALEN);
 
 	if (sha384) {
-		if (!kdf_sha384(pmk_r1, 48, "FT-PTK", 6, context,
-					sizeof(context), out_ptk, ptk_len))
+		if (!crypto_kdf_cached(cache, L_CHECKSUM_SHA384, pmk_r1, 48,
+					"FT-PTK", 6, context, sizeof(context),
+					out_ptk, ptk_len))
 			goto exit;
 	} else {
-		if (!kdf_sha256(pmk_r1, 32, "FT-PTK", 6, context,
-					sizeof(context), out_ptk, ptk_len))
+		if (!crypto_kdf_cached(cache, L_CHECKSUM_SHA256, pmk_r1, 32,
+					"FT-PTK", 6, context, sizeof(context),
+					out_ptk, ptk_len))
 			goto exit;
 	}
 
@@ -1108,19 +1267,51 @@ exit:
 	return r;
 }
 
+bool crypto_derive_ft_ptk(const uint8_t *pmk_r1, const uint8_t *pmk_r1_name,
+				const uint8_t *addr1, const uint8_t *addr2,
+				const uint8_t *nonce1, const uint8_t *nonce2,
+				bool sha384, uint8_t *out_ptk, size_t ptk_len,
+				uint8_t *out_ptk_name)
+{
+	return crypto_derive_ft_ptk_cached(NULL, pmk_r1, pmk_r1_name,
+						addr1, addr2, nonce1, nonce2,
+						sha384, out_ptk, ptk_len,
+						out_ptk_name);
+}
+
 /* Defined in 802.11-2012, Section 11.6.1.3 Pairwise Key Hierarchy */
-bool crypto_derive_pmkid(const uint8_t *pmk, size_t key_len,
+bool crypto_derive_pmkid_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk, size_t key_len,
 				const uint8_t *addr1, const uint8_t *addr2,
 				uint8_t *out_pmkid,
 				enum l_checksum_type checksum)
 {
+	struct l_checksum *hmac;
+	bool cached;
 	uint8_t data[20];
 
 	memcpy(data + 0, "PMK Name", 8);
 	memcpy(data + 8, addr2, 6);
 	memcpy(data + 14, addr1, 6);
 
-	return hmac_common(checksum, pmk, key_len, data, 20, out_pmkid, 16);
+	hmac = crypto_hmac_get(cache, checksum, pmk, key_len, &cached);
+	if (!hmac)
+		return false;
+
+	l_checksum_update(hmac, data, 20);
+	l_checksum_get_digest(hmac, out_pmkid, 16);
+	crypto_hmac_put(hmac, cached);
+
+	return true;
+}
+
+bool crypto_derive_pmkid(const uint8_t *pmk, size_t key_len,
+				const uint8_t *addr1, const uint8_t *addr2,
+				uint8_t *out_pmkid,
+				enum l_checksum_type checksum)
+{
+	return crypto_derive_pmkid_cached(NULL, pmk, key_len, addr1, addr2,
+						out_pmkid, checksum);
 }
 
 enum l_checksum_type crypto_sae_hash_from_ecc_prime_len(enum crypto_sae type,
@@ -24,6 +24,7 @@
 #include <stdbool.h>
 
 struct l_ecc_point;
+struct crypto_hmac_cache;
 
 enum crypto_cipher {
 	CRYPTO_CIPHER_WEP40 = 0x000fac01,
@@ -131,11 +132,19 @@ bool hkdf_extract(enum l_checksum_type type, const void *key, size_t key_len,
 bool hkdf_expand(enum l_checksum_type type, const void *key, size_t key_len,
 				const char *info, void *out, size_t out_len);
 
+void crypto_hmac_cache_free(struct crypto_hmac_cache *cache);
+
 bool crypto_derive_pairwise_ptk(const uint8_t *pmk, size_t pmk_len,
 				const uint8_t *addr1, const uint8_t *addr2,
 				const uint8_t *nonce1, const uint8_t *nonce2,
 				uint8_t *out_ptk, size_t ptk_len,
 				enum l_checksum_type type);
+bool crypto_derive_pairwise_ptk_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk, size_t pmk_len,
+				const uint8_t *addr1, const uint8_t *addr2,
+				const uint8_t *nonce1, const uint8_t *nonce2,
+				uint8_t *out_ptk, size_t ptk_len,
+				enum l_checksum_type type);
 
 bool crypto_derive_pmk_r0(const uint8_t *xxkey, size_t xxkey_len,
 				const uint8_t *ssid, size_t ssid_len,
@@ -143,21 +152,46 @@ bool crypto_derive_pmk_r0(const uint8_t *xxkey, size_t xxkey_len,
 				const uint8_t *r0khid, size_t r0kh_len,
 				const uint8_t *s0khid, bool sha384,
 				uint8_t *out_pmk_r0, uint8_t *out_pmk_r0_name);
+bool crypto_derive_pmk_r0_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *xxkey, size_t xxkey_len,
+				const uint8_t *ssid, size_t ssid_len,
+				uint16_t mdid,
+				const uint8_t *r0khid, size_t r0kh_len,
+				const uint8_t *s0khid, bool sha384,
+				uint8_t *out_pmk_r0, uint8_t *out_pmk_r0_name);
 bool crypto_derive_pmk_r1(const uint8_t *pmk_r0,
 				const uint8_t *r1khid, const uint8_t *s1khid,
 				const uint8_t *pmk_r0_name, bool sha384,
 				uint8_t *out_pmk_r1,
 				uint8_t *out_pmk_r1_name);
+bool crypto_derive_pmk_r1_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk_r0,
+				const uint8_t *r1khid, const uint8_t *s1khid,
+				const uint8_t *pmk_r0_name, bool sha384,
+				uint8_t *out_pmk_r1,
+				uint8_t *out_pmk_r1_name);
 bool crypto_derive_ft_ptk(const uint8_t *pmk_r1, const uint8_t *pmk_r1_name,
 				const uint8_t *addr1, const uint8_t *addr2,
 				const uint8_t *nonce1, const uint8_t *nonce2,
 				bool sha384, uint8_t *out_ptk, size_t ptk_len,
 				uint8_t *out_ptk_name);
+bool crypto_derive_ft_ptk_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk_r1,
+				const uint8_t *pmk_r1_name,
+				const uint8_t *addr1, const uint8_t *addr2,
+				const uint8_t *nonce1, const uint8_t *nonce2,
+				bool sha384, uint8_t *out_ptk, size_t ptk_len,
+				uint8_t *out_ptk_name);
 
 bool crypto_derive_pmkid(const uint8_t *pmk, size_t key_len,
 				const uint8_t *addr1, const uint8_t *addr2,
 				uint8_t *out_pmkid,
 				enum l_checksum_type checksum);
+bool crypto_derive_pmkid_cached(struct crypto_hmac_cache **cache,
+				const uint8_t *pmk, size_t key_len,
+				const uint8_t *addr1, const uint8_t *addr2,
+				uint8_t *out_pmkid,
+				enum l_checksum_type checksum);
 
 enum crypto_sae {
 	CRYPTO_SAE_LOOPING,
@@ -881,6 +881,11 @@ static void dpp_start_connect(struct l_idle *idle, void *user_data)
 	l_debug("connecting to %s from DPP", network_get_ssid(network));
 
 	bss = network_bss_select(network, true);
+	if (!bss) {
+		l_debug("No suitable BSS found");
+		return;
+	}
+
 	ret = network_autoconnect(network, bss);
 	if (ret < 0)
 		l_warn("failed to connect after DPP (%d) %s", ret,
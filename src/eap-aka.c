@@ -27,6 +27,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <errno.h>
+#include <alloca.h>
 #include <ell/ell.h>
 
 #include "src/missing.h"
@@ -71,6 +72,16 @@ struct eap_aka_handle {
 	/* Identity from SIM */
 	char *identity;
 
+	/* Identity last presented to the server, used for the MK */
+	char *id_used;
+
+	/*
+	 * Fast re-authentication state, see struct eap_sim_reauth.  Only
+	 * the pseudonym is kept for AKA' which derives its re-authentication
+	 * keys differently (RFC 5448 Section 3.3).
+	 */
+	struct eap_sim_reauth reauth;
+
 	/* Derived master key */
 	uint8_t mk[EAP_SIM_MK_LEN];
 
@@ -86,12 +97,12 @@ struct eap_aka_handle {
 	/* Derived EMSK from PRNG */
 	uint8_t emsk[EAP_SIM_EMSK_LEN];
 
-	/* Flag set if AT_ANY_ID_REQ was present */
-	bool any_id_req : 1;
-
 	/* Flag to indicate protected status indications */
 	bool protected : 1;
 
+	/* Flag set if the re-authentication ID was used as our identity */
+	bool reauth_offered : 1;
+
 	/* Authentication value from AuC */
 	uint8_t autn[EAP_AKA_AUTN_LEN];
 
@@ -128,8 +139,20 @@ static void eap_aka_free(struct eap_state *eap)
 
 	eap_aka_clear_secrets(aka);
 
+	/* Don't offer a re-authentication ID again after a failed attempt */
+	if (aka->reauth_offered && !eap_method_is_success(eap) &&
+			aka->reauth.reauth_id) {
+		l_free(l_steal_ptr(aka->reauth.reauth_id));
+		eap_sim_reauth_save(eap_get_peer_id(eap), aka->type,
+					&aka->reauth);
+	}
+
+	eap_sim_reauth_clear(&aka->reauth);
+
 	l_free(aka->identity);
+	l_free(aka->id_used);
 	l_free(aka->kdf_in);
+	l_free(aka->chal_pkt);
 	l_free(aka);
 
 	eap_set_data(eap, NULL);
@@ -177,6 +200,8 @@ static void eap_aka_finish(struct eap_state *eap)
 	memcpy(session_id + 1, aka->rand, EAP_SIM_RAND_LEN);
 	memcpy(session_id + 1 + EAP_SIM_RAND_LEN, aka->autn, EAP_AKA_AUTN_LEN);
 
+	eap_sim_reauth_save(eap_get_peer_id(eap), aka->type, &aka->reauth);
+
 	eap_method_success(eap);
 	eap_set_key_material(eap, aka->msk, 32, aka->emsk, 32, NULL, 0,
 					session_id, sizeof(session_id));
@@ -226,7 +251,7 @@ static void check_milenage_cb(const uint8_t *res, const uint8_t *ck,
 			goto chal_fatal;
 		}
 
-		r = eap_aka_prf_prime(ik_p, ck_p, aka->identity, aka->k_encr,
+		r = eap_aka_prf_prime(ik_p, ck_p, aka->id_used, aka->k_encr,
 				aka->k_aut, aka->k_re, aka->msk, aka->emsk);
 		explicit_bzero(ik_p, sizeof(ik_p));
 		explicit_bzero(ck_p, sizeof(ck_p));
@@ -239,7 +264,7 @@ static void check_milenage_cb(const uint8_t *res, const uint8_t *ck,
 		uint8_t prng_buf[160];
 		bool r;
 
-		if (!derive_aka_mk(aka->identity, ik, ck, aka->mk)) {
+		if (!derive_aka_mk(aka->id_used, ik, ck, aka->mk)) {
 			l_error("error deriving MK");
 			goto chal_fatal;
 		}
@@ -262,6 +287,21 @@ static void check_milenage_cb(const uint8_t *res, const uint8_t *ck,
 		goto chal_error;
 	}
 
+	if (!eap_sim_reauth_update_ids(&aka->reauth, aka->k_encr,
+					aka->chal_pkt, aka->pkt_len)) {
+		l_error("could not decrypt AT_ENCR_DATA");
+		goto chal_error;
+	}
+
+	if (aka->type == EAP_TYPE_AKA) {
+		/* Keys for any following re-authentications */
+		memcpy(aka->reauth.mk, aka->mk, EAP_SIM_MK_LEN);
+		memcpy(aka->reauth.k_encr, aka->k_encr, EAP_SIM_K_ENCR_LEN);
+		memcpy(aka->reauth.k_aut, aka->k_aut, EAP_SIM_K_AUT_LEN);
+		aka->reauth.counter = 0;
+	} else
+		l_free(l_steal_ptr(aka->reauth.reauth_id));
+
 	aka->state = EAP_AKA_STATE_CHALLENGE;
 
 	pos += eap_sim_build_header(eap, aka->type, EAP_AKA_ST_CHALLENGE,
@@ -564,28 +604,106 @@ static void handle_identity(struct eap_state *eap, const uint8_t *pkt,
 		size_t len)
 {
 	struct eap_aka_handle *aka = eap_get_data(eap);
-	uint8_t response[EAP_SIM_ROUND(8 + strlen(aka->identity) + 4)];
-	uint8_t *pos = response;
+	struct eap_sim_tlv_iter iter;
+	uint8_t id_req = 0;
+	uint8_t *response;
+	uint8_t *pos;
 
-	if (aka->state != EAP_AKA_STATE_UNCONNECTED) {
+	if (aka->state != EAP_AKA_STATE_UNCONNECTED || len < 3) {
 		l_error("invalid packet for EAP-AKA state");
 		eap_sim_client_error(eap, aka->type, EAP_SIM_ERROR_PROCESS);
 		return;
 	}
 
+	eap_sim_tlv_iter_init(&iter, pkt + 3, len - 3);
+
+	while (eap_sim_tlv_iter_next(&iter)) {
+		switch (eap_sim_tlv_iter_get_type(&iter)) {
+		case EAP_SIM_AT_ANY_ID_REQ:
+			/*
+			 * A full authentication follows, answer with the
+			 * pseudonym rather than the re-authentication ID.
+			 */
+		case EAP_SIM_AT_FULLAUTH_ID_REQ:
+			id_req = EAP_SIM_AT_FULLAUTH_ID_REQ;
+			break;
+		case EAP_SIM_AT_PERMANENT_ID_REQ:
+			id_req = EAP_SIM_AT_PERMANENT_ID_REQ;
+			break;
+		}
+	}
+
+	if (id_req) {
+		l_free(aka->id_used);
+		aka->id_used = l_strdup(eap_sim_reauth_select_identity(
+					&aka->reauth, id_req, aka->identity));
+	}
+
 	aka->state = EAP_AKA_STATE_IDENTITY;
 	/*
 	 * Build response packet
 	 */
+	response = alloca(EAP_SIM_ROUND(8 + strlen(aka->id_used) + 4));
+	pos = response;
+
 	pos += eap_sim_build_header(eap, aka->type, EAP_AKA_ST_IDENTITY, pos,
 			20);
 	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_IDENTITY,
-			EAP_SIM_PAD_LENGTH, (uint8_t *)aka->identity,
-			strlen(aka->identity));
+			EAP_SIM_PAD_LENGTH, (uint8_t *)aka->id_used,
+			strlen(aka->id_used));
 
 	eap_method_respond(eap, response, pos - response);
 }
 
+/*
+ * Handles EAP-AKA Re-authentication subtype, RFC 4187 Section 5
+ */
+static void handle_reauthentication(struct eap_state *eap,
+					const uint8_t *pkt, size_t len)
+{
+	struct eap_aka_handle *aka = eap_get_data(eap);
+	uint8_t response[EAP_SIM_REAUTH_RESPONSE_LEN];
+	uint8_t session_id[EAP_SIM_REAUTH_SESSION_ID_LEN];
+	size_t resp_len;
+	int r;
+
+	if (aka->state != EAP_AKA_STATE_UNCONNECTED) {
+		l_error("invalid packet for EAP-AKA state");
+		goto reauth_error;
+	}
+
+	r = eap_sim_reauth_respond(eap, aka->type, pkt, len, &aka->reauth,
+					aka->msk, aka->emsk, session_id,
+					response, &resp_len);
+	if (r < 0) {
+		/* Full authentication from here on, stop offering the ID */
+		l_free(l_steal_ptr(aka->reauth.reauth_id));
+		eap_sim_reauth_save(eap_get_peer_id(eap), aka->type,
+					&aka->reauth);
+
+		if (r != -ERANGE)
+			goto reauth_error;
+
+		/* Server follows up with a full authentication */
+		eap_method_respond(eap, response, resp_len);
+		return;
+	}
+
+	eap_method_respond(eap, response, resp_len);
+
+	eap_sim_reauth_save(eap_get_peer_id(eap), aka->type, &aka->reauth);
+
+	aka->state = EAP_AKA_STATE_SUCCESS;
+
+	eap_method_success(eap);
+	eap_set_key_material(eap, aka->msk, 32, aka->emsk, 32, NULL, 0,
+					session_id, sizeof(session_id));
+	return;
+
+reauth_error:
+	eap_sim_client_error(eap, aka->type, EAP_SIM_ERROR_PROCESS);
+}
+
 static void eap_aka_handle_request(struct eap_state *eap,
 					const uint8_t *pkt, size_t len)
 {
@@ -609,6 +727,10 @@ static void eap_aka_handle_request(struct eap_state *eap,
 		handle_notification(eap, pkt, len);
 		break;
 
+	case EAP_SIM_ST_REAUTHENTICATION:
+		handle_reauthentication(eap, pkt, len);
+		break;
+
 	default:
 		l_error("unknown EAP-SIM subtype: %u", pkt[0]);
 		goto req_error;
@@ -624,7 +746,7 @@ static const char *eap_aka_get_identity(struct eap_state *eap)
 {
 	struct eap_aka_handle *aka = eap_get_data(eap);
 
-	return aka->identity;
+	return aka->id_used;
 }
 
 static void auth_destroyed(void *data)
@@ -696,6 +818,13 @@ static bool eap_aka_common_load_settings(struct eap_state *eap,
 	aka->identity = l_strdup_printf("%c%s", id_prefix,
 			iwd_sim_auth_get_nai(aka->auth));
 
+	/* The peer ID must be set before loading settings */
+	eap_sim_reauth_load(eap_get_peer_id(eap), aka->type, &aka->reauth);
+	aka->id_used = l_strdup(eap_sim_reauth_select_identity(&aka->reauth,
+								0,
+								aka->identity));
+	aka->reauth_offered = aka->reauth.reauth_id != NULL;
+
 	return true;
 }
 
@@ -737,6 +866,10 @@ static bool eap_aka_reset_state(struct eap_state *eap)
 	eap_aka_clear_secrets(aka);
 	memset(aka->autn, 0, sizeof(aka->autn));
 
+	/* The restarted exchange begins with the same EAP identity */
+	l_free(aka->id_used);
+	aka->id_used = l_strdup(eap_get_identity(eap));
+
 	return true;
 }
 
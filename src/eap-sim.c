@@ -41,15 +41,13 @@
 /*
  * EAP-SIM authentication protocol.
  *
- * Open Items:
- *    - Fast Re-authentication. In order to implement this, the higher level
- *      EAP code would need to know/retrieve a fast re-authentication identity
- *      that it would send in the EAP-Start packet. This ID is provided by
- *      the server during the challenge in full authentication. EAP-SIM does
- *      save this ID, but there is no mechanism to provide it to the upper
- *      level EAP system. Once this is done the server will recognize the
- *      ID and send a SIM/Re-authentication request.
+ * Fast re-authentication: the pseudonym and re-authentication ID handed out
+ * in the Challenge are saved together with the keys, per network, through
+ * the eap_sim_reauth_* cache.  The next connection then presents the
+ * re-authentication ID in the EAP-Response/Identity so the server can skip
+ * the round trip to the SIM provider.
  *
+ * Open Items:
  *    - Version validation. Perhaps a real SIM card will provide a version
  *      of EAP-SIM that it supports? Currently we accept any version the
  *      server provides.
@@ -86,6 +84,12 @@ struct eap_sim_handle {
 	/* Identity from SIM */
 	char *identity;
 
+	/* Identity last presented to the server, used for the MK */
+	char *id_used;
+
+	/* Fast re-authentication state, see struct eap_sim_reauth */
+	struct eap_sim_reauth reauth;
+
 	/* EAP-SIM supported version list */
 	uint16_t *vlist;
 	uint16_t vlist_len;
@@ -114,12 +118,12 @@ struct eap_sim_handle {
 	/* Save RANDS from AT_RAND attribute for session ID derivation */
 	uint8_t rands[EAP_SIM_RAND_LEN * 3];
 
-	/* Flag set if AT_ANY_ID_REQ was present */
-	bool any_id_req : 1;
-
 	/* Flag to indicate protected status indications */
 	bool protected : 1;
 
+	/* Flag set if the re-authentication ID was used as our identity */
+	bool reauth_offered : 1;
+
 	uint8_t *chal_pkt;
 	uint32_t pkt_len;
 
@@ -145,8 +149,23 @@ static void eap_sim_free(struct eap_state *eap)
 
 	eap_sim_clear_secrets(sim);
 
+	/*
+	 * Like with TLS session resumption, don't offer a re-authentication
+	 * ID again if the last attempt to use it didn't succeed.
+	 */
+	if (sim->reauth_offered && !eap_method_is_success(eap) &&
+			sim->reauth.reauth_id) {
+		l_free(l_steal_ptr(sim->reauth.reauth_id));
+		eap_sim_reauth_save(eap_get_peer_id(eap), EAP_TYPE_SIM,
+					&sim->reauth);
+	}
+
+	eap_sim_reauth_clear(&sim->reauth);
+
 	l_free(sim->identity);
+	l_free(sim->id_used);
 	l_free(sim->vlist);
+	l_free(sim->chal_pkt);
 	l_free(sim);
 
 	eap_set_data(eap, NULL);
@@ -202,6 +221,7 @@ static void handle_start(struct eap_state *eap, const uint8_t *pkt,
 {
 	struct eap_sim_handle *sim = eap_get_data(eap);
 	struct eap_sim_tlv_iter iter;
+	uint8_t id_req = 0;
 	uint16_t resp_len;
 	uint8_t *response;
 	uint8_t *pos;
@@ -245,15 +265,19 @@ static void handle_start(struct eap_state *eap, const uint8_t *pkt,
 			break;
 
 		case EAP_SIM_AT_ANY_ID_REQ:
-			sim->any_id_req = true;
+			/*
+			 * We're going through a full authentication, so never
+			 * answer with the re-authentication ID, RFC 4186
+			 * Section 4.2.5 allows for the pseudonym instead.
+			 */
+		case EAP_SIM_AT_FULLAUTH_ID_REQ:
+			id_req = EAP_SIM_AT_FULLAUTH_ID_REQ;
 
 			break;
 
 		case EAP_SIM_AT_PERMANENT_ID_REQ:
-		case EAP_SIM_AT_FULLAUTH_ID_REQ:
-			/*
-			 * TODO: Server requesting permanent ID/pseudonym
-			 */
+			id_req = EAP_SIM_AT_PERMANENT_ID_REQ;
+
 			break;
 
 		default:
@@ -265,11 +289,17 @@ static void handle_start(struct eap_state *eap, const uint8_t *pkt,
 
 	sim->state = EAP_SIM_STATE_START;
 
+	if (id_req) {
+		l_free(sim->id_used);
+		sim->id_used = l_strdup(eap_sim_reauth_select_identity(
+					&sim->reauth, id_req, sim->identity));
+	}
+
 	/* header + AT_NONCE + AT_SELECTED_VERSION */
 	resp_len = (8) + (20) + (4);
-	if (sim->any_id_req) {
+	if (id_req) {
 		/* + AT_IDENTITY */
-		resp_len += EAP_SIM_ROUND(strlen(sim->identity) + 4);
+		resp_len += EAP_SIM_ROUND(strlen(sim->id_used) + 4);
 	}
 
 	l_getrandom(sim->nonce, EAP_SIM_NONCE_LEN);
@@ -285,10 +315,10 @@ static void handle_start(struct eap_state *eap, const uint8_t *pkt,
 			EAP_SIM_PAD_NONE, (uint8_t *)&sim->selected_version,
 			2);
 
-	if (sim->any_id_req)
+	if (id_req)
 		pos += eap_sim_add_attribute(pos, EAP_SIM_AT_IDENTITY,
-				EAP_SIM_PAD_LENGTH, (uint8_t *)sim->identity,
-				strlen(sim->identity));
+				EAP_SIM_PAD_LENGTH, (uint8_t *)sim->id_used,
+				strlen(sim->id_used));
 
 	eap_method_respond(eap, response, resp_len);
 
@@ -309,6 +339,8 @@ static void eap_sim_finish(struct eap_state *eap)
 	memcpy(session_id + 1 + sizeof(sim->rands), sim->nonce,
 				EAP_SIM_NONCE_LEN);
 
+	eap_sim_reauth_save(eap_get_peer_id(eap), EAP_TYPE_SIM, &sim->reauth);
+
 	eap_method_success(eap);
 	eap_set_key_material(eap, sim->msk, 32, sim->emsk, 32, NULL, 0,
 					session_id, sizeof(session_id));
@@ -332,7 +364,7 @@ static void gsm_callback(const uint8_t *sres, const uint8_t *kc,
 	if (sim->protected)
 		resp_len += 4;
 
-	if (!derive_master_key(sim->identity, kc, sim->nonce, sim->vlist,
+	if (!derive_master_key(sim->id_used, kc, sim->nonce, sim->vlist,
 			sim->vlist_len, sim->selected_version, sim->mk)) {
 		l_error("error deriving master key");
 		goto chal_fatal;
@@ -356,14 +388,19 @@ static void gsm_callback(const uint8_t *sres, const uint8_t *kc,
 		goto chal_error;
 	}
 
-	sim->state = EAP_SIM_STATE_CHALLENGE;
+	if (!eap_sim_reauth_update_ids(&sim->reauth, sim->k_encr,
+					sim->chal_pkt, sim->pkt_len)) {
+		l_error("could not decrypt AT_ENCR_DATA");
+		goto chal_error;
+	}
 
-	/*
-	 * TODO: When/If fast re-authentication is supported, the AT_ENCR_DATA
-	 *       attribute would be decrypted here. Currently there is no need
-	 *       or reason to do this without support for fast
-	 *       re-authentication.
-	 */
+	/* Keys for any following re-authentications */
+	memcpy(sim->reauth.mk, sim->mk, EAP_SIM_MK_LEN);
+	memcpy(sim->reauth.k_encr, sim->k_encr, EAP_SIM_K_ENCR_LEN);
+	memcpy(sim->reauth.k_aut, sim->k_aut, EAP_SIM_K_AUT_LEN);
+	sim->reauth.counter = 0;
+
+	sim->state = EAP_SIM_STATE_CHALLENGE;
 
 	/* build response packet */
 	pos += eap_sim_build_header(eap, EAP_TYPE_SIM, EAP_SIM_ST_CHALLENGE,
@@ -452,11 +489,6 @@ static void handle_challenge(struct eap_state *eap, const uint8_t *pkt,
 				code = EAP_SIM_ERROR_CHALLENGE;
 				goto chal_error;
 			}
-			/*
-			 * TODO: check that RAND's are fresh. Existing RAND's
-			 * should only exist if we are re-authenticating to the
-			 * server, which is currently not implemented.
-			 */
 			memcpy(sim->rands, contents + 2, EAP_SIM_RAND_LEN * 3);
 			break;
 
@@ -467,7 +499,7 @@ static void handle_challenge(struct eap_state *eap, const uint8_t *pkt,
 		case EAP_SIM_AT_IV:
 		case EAP_SIM_AT_ENCR_DATA:
 		case EAP_SIM_AT_MAC:
-			/* need a case for these so the default won't get hit */
+			/* Decrypted in gsm_callback once K_encr is known */
 			break;
 
 		default:
@@ -588,6 +620,55 @@ notif_error:
 	eap_sim_client_error(eap, EAP_TYPE_SIM, EAP_SIM_ERROR_PROCESS);
 }
 
+/*
+ * Handles EAP-SIM Re-authentication subtype, RFC 4186 Section 5
+ */
+static void handle_reauthentication(struct eap_state *eap,
+					const uint8_t *pkt, size_t len)
+{
+	struct eap_sim_handle *sim = eap_get_data(eap);
+	uint8_t response[EAP_SIM_REAUTH_RESPONSE_LEN];
+	uint8_t session_id[EAP_SIM_REAUTH_SESSION_ID_LEN];
+	size_t resp_len;
+	int r;
+
+	if (sim->state != EAP_SIM_STATE_UNCONNECTED) {
+		l_error("invalid packet for EAP-SIM state");
+		goto reauth_error;
+	}
+
+	r = eap_sim_reauth_respond(eap, EAP_TYPE_SIM, pkt, len, &sim->reauth,
+					sim->msk, sim->emsk, session_id,
+					response, &resp_len);
+	if (r < 0) {
+		/* Full authentication from here on, stop offering the ID */
+		l_free(l_steal_ptr(sim->reauth.reauth_id));
+		eap_sim_reauth_save(eap_get_peer_id(eap), EAP_TYPE_SIM,
+					&sim->reauth);
+
+		if (r != -ERANGE)
+			goto reauth_error;
+
+		/* Server follows up with a Start for a full authentication */
+		eap_method_respond(eap, response, resp_len);
+		return;
+	}
+
+	eap_method_respond(eap, response, resp_len);
+
+	eap_sim_reauth_save(eap_get_peer_id(eap), EAP_TYPE_SIM, &sim->reauth);
+
+	sim->state = EAP_SIM_STATE_SUCCESS;
+
+	eap_method_success(eap);
+	eap_set_key_material(eap, sim->msk, 32, sim->emsk, 32, NULL, 0,
+					session_id, sizeof(session_id));
+	return;
+
+reauth_error:
+	eap_sim_client_error(eap, EAP_TYPE_SIM, EAP_SIM_ERROR_PROCESS);
+}
+
 static void eap_sim_handle_request(struct eap_state *eap,
 					const uint8_t *pkt, size_t len)
 {
@@ -606,6 +687,9 @@ static void eap_sim_handle_request(struct eap_state *eap,
 	case EAP_SIM_ST_NOTIFICATION:
 		handle_notification(eap, pkt, len);
 		break;
+	case EAP_SIM_ST_REAUTHENTICATION:
+		handle_reauthentication(eap, pkt, len);
+		break;
 	default:
 		l_error("unknown EAP-SIM subtype: %u", pkt[0]);
 		goto req_error;
@@ -621,7 +705,7 @@ static const char *eap_sim_get_identity(struct eap_state *eap)
 {
 	struct eap_sim_handle *sim = eap_get_data(eap);
 
-	return sim->identity;
+	return sim->id_used;
 }
 
 static void auth_destroyed(void *data)
@@ -679,6 +763,10 @@ static bool eap_sim_reset_state(struct eap_state *eap)
 	memset(sim->nonce, 0, sizeof(sim->nonce));
 	eap_sim_clear_secrets(sim);
 
+	/* The restarted exchange begins with the same EAP identity */
+	l_free(sim->id_used);
+	sim->id_used = l_strdup(eap_get_identity(eap));
+
 	return true;
 }
 
@@ -708,6 +796,16 @@ static bool eap_sim_load_settings(struct eap_state *eap,
 	sim->identity = l_strdup_printf("%c%s", '1',
 			iwd_sim_auth_get_nai(sim->auth));
 
+	/*
+	 * Use a re-authentication ID or pseudonym from an earlier connection
+	 * to this network if we have one.  The peer ID must be set first.
+	 */
+	eap_sim_reauth_load(eap_get_peer_id(eap), EAP_TYPE_SIM, &sim->reauth);
+	sim->id_used = l_strdup(eap_sim_reauth_select_identity(&sim->reauth,
+								0,
+								sim->identity));
+	sim->reauth_offered = sim->reauth.reauth_id != NULL;
+
 	return true;
 }
 
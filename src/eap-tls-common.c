@@ -26,6 +26,9 @@
 
 #include <stdio.h>
 #include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <ell/ell.h>
 
 #include "ell/useful.h"
@@ -84,6 +87,34 @@ static void databuf_free(struct databuf *databuf)
 	l_free(databuf);
 }
 
+/*
+ * During the handshake l_tls_handle_rx may verify the server certificate
+ * chain and sign with the client key, each taking milliseconds.  Those
+ * steps are run on a worker thread so that the main loop is not stalled.
+ * While a job is pending the tunnel is only touched by the worker and the
+ * l_tls callbacks record their results in the job, which are processed on
+ * the main loop once the worker signals completion through an eventfd.
+ *
+ * The tunnel never sees the session cache shared by all tunnels, it works
+ * on a private copy of its peer's group which the main loop fills before
+ * starting the handshake and merges back when l_tls updates it.
+ */
+struct eap_tls_job {
+	struct l_tls *tunnel;
+	pthread_t thread;
+	int fd;
+	uint8_t *data;
+	size_t len;
+	uint64_t duration;
+	char *peer_identity;
+	struct l_queue *debug_msgs;
+	enum l_tls_alert_desc alert;
+	bool alert_remote:1;
+	bool ready:1;
+	bool cache_dirty:1;
+	bool disconnected:1;
+};
+
 #define EAP_TLS_PDU_MAX_LEN 65536
 
 #define EAP_TLS_HEADER_LEN  6
@@ -123,6 +154,10 @@ struct eap_tls_state {
 	struct l_key *client_key;
 	char **domain_mask;
 
+	struct eap_tls_job *job;
+	struct l_io *job_io;
+	struct l_settings *session_cache;
+
 	const struct eap_tls_variant_ops *variant_ops;
 	void *variant_data;
 };
@@ -130,12 +165,114 @@ struct eap_tls_state {
 static struct l_settings *eap_tls_session_cache;
 static eap_tls_session_cache_load_func_t eap_tls_session_cache_load;
 static eap_tls_session_cache_sync_func_t eap_tls_session_cache_sync;
+static bool eap_tls_offload;
+static struct eap_tls_offload_stats offload_stats;
+
+/*
+ * Longest the main loop should be blocked by a single TLS step, anything
+ * longer is reported.  Handshake steps only stay under it when run on the
+ * worker.
+ */
+#define EAP_TLS_MAIN_LOOP_BOUND_US	(10 * L_USEC_PER_MSEC)
+
+static void eap_tls_main_loop_step_done(const char *method_name,
+					uint64_t start)
+{
+	uint64_t duration = l_time_diff(start, l_time_now());
+
+	if (duration > offload_stats.main_loop_max_us)
+		offload_stats.main_loop_max_us = duration;
+
+	if (duration > EAP_TLS_MAIN_LOOP_BOUND_US)
+		l_warn("%s: TLS step blocked the main loop for %" PRIu64 " us",
+			method_name, duration);
+}
+
+/* Replaces @group in @to with its contents in @from, if any */
+static void eap_tls_cache_copy_group(struct l_settings *to,
+					const struct l_settings *from,
+					const char *group)
+{
+	char **keys;
+	unsigned int i;
+
+	if (!group)
+		return;
+
+	l_settings_remove_group(to, group);
+
+	keys = l_settings_get_keys(from, group);
+	if (!keys)
+		return;
+
+	for (i = 0; keys[i]; i++)
+		l_settings_set_value(to, group, keys[i],
+				l_settings_get_value(from, group, keys[i]));
+
+	l_strv_free(keys);
+}
+
+/* Merges the tunnel's copy of its session back into the shared cache */
+static void eap_tls_session_cache_commit(struct eap_state *eap)
+{
+	struct eap_tls_state *eap_tls = eap_get_data(eap);
+
+	if (L_WARN_ON(!eap_tls_session_cache_sync) ||
+			L_WARN_ON(!eap_tls_session_cache))
+		return;
+
+	eap_tls_cache_copy_group(eap_tls_session_cache, eap_tls->session_cache,
+					eap_get_peer_id(eap));
+	eap_tls_session_cache_sync(eap_tls_session_cache);
+}
+
+static void eap_tls_job_free(struct eap_tls_job *job)
+{
+	if (job->data) {
+		explicit_bzero(job->data, job->len);
+		l_free(job->data);
+	}
+
+	l_free(job->peer_identity);
+	l_queue_destroy(job->debug_msgs, l_free);
+	l_free(job);
+}
+
+static struct eap_tls_job *eap_tls_job_wait(struct eap_tls_state *eap_tls)
+{
+	struct eap_tls_job *job = eap_tls->job;
+	uint64_t count;
+
+	/* The callbacks check eap_tls->job until the worker is done */
+	pthread_join(job->thread, NULL);
+	eap_tls->job = NULL;
+
+	/* Consume the completion so the read handler doesn't fire again */
+	if (read(job->fd, &count, sizeof(count)) < 0)
+		l_debug("eventfd read: %s", strerror(errno));
+
+	return job;
+}
+
+static bool eap_tls_job_done(struct l_io *io, void *user_data);
+
+/* Used on reset and free, waits for a pending job and drops its results */
+static void eap_tls_job_cancel(struct eap_tls_state *eap_tls)
+{
+	if (!eap_tls->job)
+		return;
+
+	eap_tls_job_free(eap_tls_job_wait(eap_tls));
+}
 
 static void __eap_tls_common_state_reset(struct eap_state *eap)
 {
 	struct eap_tls_state *eap_tls = eap_get_data(eap);
 	const char *peer_id;
 
+	/* Stop the worker before touching any state it may still write */
+	eap_tls_job_cancel(eap_tls);
+
 	eap_tls->version_negotiated = EAP_TLS_VERSION_NOT_NEGOTIATED;
 	eap_tls->method_completed = false;
 	eap_tls->phase2_failed = false;
@@ -219,9 +356,13 @@ static void __eap_tls_common_state_free(struct eap_tls_state *eap_tls)
 
 	l_strv_free(eap_tls->domain_mask);
 
+	eap_tls_job_cancel(eap_tls);
+	l_io_destroy(eap_tls->job_io);
+
 	if (eap_tls->tunnel)
 		l_tls_free(eap_tls->tunnel);
 
+	l_settings_free(eap_tls->session_cache);
 	l_free(eap_tls);
 }
 
@@ -254,6 +395,16 @@ void eap_tls_common_state_free(struct eap_state *eap)
 static void eap_tls_tunnel_debug(const char *str, void *user_data)
 {
 	struct eap_state *eap = user_data;
+	struct eap_tls_state *eap_tls = eap_get_data(eap);
+
+	/* On the worker thread, logged once back on the main loop */
+	if (eap_tls->job) {
+		if (!eap_tls->job->debug_msgs)
+			eap_tls->job->debug_msgs = l_queue_new();
+
+		l_queue_push_tail(eap_tls->job->debug_msgs, l_strdup(str));
+		return;
+	}
 
 	l_info("%s: %s", eap_get_method_name(eap), str);
 }
@@ -287,6 +438,13 @@ static void eap_tls_tunnel_ready(const char *peer_identity, void *user_data)
 	struct eap_state *eap = user_data;
 	struct eap_tls_state *eap_tls = eap_get_data(eap);
 
+	/* On the worker thread, handled once back on the main loop */
+	if (eap_tls->job) {
+		eap_tls->job->ready = true;
+		eap_tls->job->peer_identity = l_strdup(peer_identity);
+		return;
+	}
+
 	eap_tls->tls_session_resumed =
 		l_tls_get_session_resumed(eap_tls->tunnel);
 
@@ -311,7 +469,7 @@ static void eap_tls_tunnel_ready(const char *peer_identity, void *user_data)
 
 	if (!eap_tls->variant_ops->tunnel_ready(eap, peer_identity,
 						eap_tls->tls_session_resumed))
-		l_tls_close(eap_tls->tunnel);
+		eap_tls_common_tunnel_close(eap);
 }
 
 static void eap_tls_debug_hint(void)
@@ -327,6 +485,14 @@ static void eap_tls_tunnel_disconnected(enum l_tls_alert_desc reason,
 	struct eap_state *eap = user_data;
 	struct eap_tls_state *eap_tls = eap_get_data(eap);
 
+	/* On the worker thread, handled once back on the main loop */
+	if (eap_tls->job) {
+		eap_tls->job->disconnected = true;
+		eap_tls->job->alert = reason;
+		eap_tls->job->alert_remote = remote;
+		return;
+	}
+
 	l_info("%s: Tunnel has disconnected with alert: %s",
 			eap_get_method_name(eap), l_tls_alert_to_str(reason));
 
@@ -624,11 +790,15 @@ static int eap_tls_handle_fragmented_request(struct eap_state *eap,
 
 static void eap_tls_session_cache_update(void *user_data)
 {
-	if (L_WARN_ON(!eap_tls_session_cache_sync) ||
-			L_WARN_ON(!eap_tls_session_cache))
+	struct eap_state *eap = user_data;
+	struct eap_tls_state *eap_tls = eap_get_data(eap);
+
+	if (eap_tls->job) {
+		eap_tls->job->cache_dirty = true;
 		return;
+	}
 
-	eap_tls_session_cache_sync(eap_tls_session_cache);
+	eap_tls_session_cache_commit(eap);
 }
 
 static bool eap_tls_tunnel_init(struct eap_state *eap)
@@ -693,18 +863,38 @@ static bool eap_tls_tunnel_init(struct eap_state *eap)
 	if (eap_tls->domain_mask)
 		l_tls_set_domain_mask(eap_tls->tunnel, eap_tls->domain_mask);
 
+	if (eap_tls_offload) {
+		int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		if (fd >= 0) {
+			eap_tls->job_io = l_io_new(fd);
+			l_io_set_close_on_destroy(eap_tls->job_io, true);
+			l_io_set_read_handler(eap_tls->job_io,
+						eap_tls_job_done, eap, NULL);
+		} else
+			l_warn("%s: eventfd: %s, TLS handshake will block",
+				eap_get_method_name(eap), strerror(errno));
+	}
+
 	if (!eap_tls_session_cache_load || eap_tls->tls_cache_disabled)
 		goto start;
 
 	if (!eap_tls_session_cache)
 		eap_tls_session_cache = eap_tls_session_cache_load();
 
-	l_tls_set_session_cache(eap_tls->tunnel, eap_tls_session_cache,
+	eap_tls->session_cache = l_settings_new();
+	l_tls_set_session_cache(eap_tls->tunnel, eap_tls->session_cache,
 				eap_get_peer_id(eap),
 				24 * 3600 * L_USEC_PER_SEC, 0,
-				eap_tls_session_cache_update, NULL);
+				eap_tls_session_cache_update, eap);
 
 start:
+	/* Pick up the session last stored for this peer, or its removal */
+	if (eap_tls->session_cache)
+		eap_tls_cache_copy_group(eap_tls->session_cache,
+						eap_tls_session_cache,
+						eap_get_peer_id(eap));
+
 	if (!l_tls_start(eap_tls->tunnel)) {
 		l_error("%s: Failed to start the TLS client",
 						eap_get_method_name(eap));
@@ -730,7 +920,135 @@ static void eap_tls_handle_phase2_payload(struct eap_state *eap,
 		 * fails a method-specific integrity check result in tunnel
 		 * shutdown.
 		 */
-		l_tls_close(eap_tls->tunnel);
+		eap_tls_common_tunnel_close(eap);
+}
+
+static void eap_tls_handle_rx_done(struct eap_state *eap)
+{
+	struct eap_tls_state *eap_tls = eap_get_data(eap);
+
+	if (eap_tls->plain_buf) {
+		/*
+		 * An existence of the plain_buf indicates that the TLS tunnel
+		 * has been established and Phase 2 payload was transmitted
+		 * through it.
+		 */
+		eap_tls_handle_phase2_payload(eap, eap_tls->plain_buf->data,
+						eap_tls->plain_buf->len);
+
+		databuf_free(eap_tls->plain_buf);
+		eap_tls->plain_buf = NULL;
+	}
+
+	if (eap_tls->rx_pdu_buf) {
+		databuf_free(eap_tls->rx_pdu_buf);
+		eap_tls->rx_pdu_buf = NULL;
+	}
+
+	if (!eap_tls->tx_pdu_buf) {
+		if (eap_tls->phase2_failed)
+			goto error;
+
+		return;
+	}
+
+	eap_tls_send_response(eap, eap_tls->tx_pdu_buf->data,
+						eap_tls->tx_pdu_buf->len);
+
+	if (eap_tls->phase2_failed)
+		goto error;
+
+	return;
+
+error:
+	eap_method_error(eap);
+}
+
+static void *eap_tls_job_run(void *user_data)
+{
+	struct eap_tls_job *job = user_data;
+	uint64_t start = l_time_now();
+	uint64_t count = 1;
+
+	l_tls_handle_rx(job->tunnel, job->data, job->len);
+
+	job->duration = l_time_diff(start, l_time_now());
+
+	/*
+	 * Nothing is logged from here, the main loop reports everything.
+	 * A non-overflowing eventfd write can only be interrupted.
+	 */
+	while (write(job->fd, &count, sizeof(count)) < 0 && errno == EINTR)
+		;
+
+	return NULL;
+}
+
+static bool eap_tls_job_done(struct l_io *io, void *user_data)
+{
+	struct eap_state *eap = user_data;
+	struct eap_tls_state *eap_tls = eap_get_data(eap);
+	const char *method_name = eap_get_method_name(eap);
+	uint64_t start = l_time_now();
+	struct eap_tls_job *job;
+
+	if (!eap_tls->job)
+		return true;
+
+	job = eap_tls_job_wait(eap_tls);
+
+	l_debug("%s: handshake step took %" PRIu64 " us on a worker thread",
+			method_name, job->duration);
+
+	offload_stats.worker_steps++;
+	offload_stats.worker_us += job->duration;
+
+	while (!l_queue_isempty(job->debug_msgs)) {
+		_auto_(l_free) char *str = l_queue_pop_head(job->debug_msgs);
+
+		eap_tls_tunnel_debug(str, eap);
+	}
+
+	if (job->cache_dirty)
+		eap_tls_session_cache_commit(eap);
+
+	if (job->ready)
+		eap_tls_tunnel_ready(job->peer_identity, eap);
+
+	if (job->disconnected)
+		eap_tls_tunnel_disconnected(job->alert, job->alert_remote,
+						eap);
+
+	eap_tls_job_free(job);
+	eap_tls_handle_rx_done(eap);
+
+	/* The results are processed on the main loop */
+	eap_tls_main_loop_step_done(method_name, start);
+
+	return true;
+}
+
+static bool eap_tls_job_start(struct eap_state *eap, const uint8_t *pkt,
+				size_t len)
+{
+	struct eap_tls_state *eap_tls = eap_get_data(eap);
+	struct eap_tls_job *job = l_new(struct eap_tls_job, 1);
+
+	job->tunnel = eap_tls->tunnel;
+	job->fd = l_io_get_fd(eap_tls->job_io);
+	job->data = l_memdup(pkt, len);
+	job->len = len;
+
+	/* Set before the thread starts so the callbacks see it */
+	eap_tls->job = job;
+
+	if (pthread_create(&job->thread, NULL, eap_tls_job_run, job)) {
+		eap_tls->job = NULL;
+		eap_tls_job_free(job);
+		return false;
+	}
+
+	return true;
 }
 
 void eap_tls_common_handle_request(struct eap_state *eap,
@@ -739,6 +1057,10 @@ void eap_tls_common_handle_request(struct eap_state *eap,
 	struct eap_tls_state *eap_tls = eap_get_data(eap);
 	uint8_t flags_version;
 
+	/* The server retransmitted while we are still working on it */
+	if (eap_tls->job)
+		return;
+
 	if (eap_tls->method_completed)
 		return;
 
@@ -816,40 +1138,21 @@ proceed:
 			goto error;
 	}
 
-	if (len)
-		l_tls_handle_rx(eap_tls->tunnel, pkt, len);
-
-	if (eap_tls->plain_buf) {
-		/*
-		 * An existence of the plain_buf indicates that the TLS tunnel
-		 * has been established and Phase 2 payload was transmitted
-		 * through it.
-		 */
-		eap_tls_handle_phase2_payload(eap, eap_tls->plain_buf->data,
-						eap_tls->plain_buf->len);
-
-		databuf_free(eap_tls->plain_buf);
-		eap_tls->plain_buf = NULL;
-	}
+	if (len && eap_tls->job_io && !eap_tls->tunnel_ready &&
+			eap_tls_job_start(eap, pkt, len))
+		return;
 
-	if (eap_tls->rx_pdu_buf) {
-		databuf_free(eap_tls->rx_pdu_buf);
-		eap_tls->rx_pdu_buf = NULL;
-	}
+	if (len) {
+		uint64_t start = l_time_now();
 
-	if (!eap_tls->tx_pdu_buf) {
-		if (eap_tls->phase2_failed)
-			goto error;
+		if (!eap_tls->tunnel_ready)
+			offload_stats.main_loop_handshake_steps++;
 
-		return;
+		l_tls_handle_rx(eap_tls->tunnel, pkt, len);
+		eap_tls_main_loop_step_done(eap_get_method_name(eap), start);
 	}
 
-	eap_tls_send_response(eap, eap_tls->tx_pdu_buf->data,
-						eap_tls->tx_pdu_buf->len);
-
-	if (eap_tls->phase2_failed)
-		goto error;
-
+	eap_tls_handle_rx_done(eap);
 	return;
 
 error:
@@ -862,6 +1165,10 @@ void eap_tls_common_handle_retransmit(struct eap_state *eap,
 	struct eap_tls_state *eap_tls = eap_get_data(eap);
 	uint8_t flags_version;
 
+	/* The response is sent once the worker is done */
+	if (eap_tls->job)
+		return;
+
 	if (len < 1) {
 		l_error("%s: Request packet is too short.",
 						eap_get_method_name(eap));
@@ -1195,13 +1502,32 @@ void eap_tls_forget_peer(const char *peer_id)
 		eap_tls_session_cache_sync(eap_tls_session_cache);
 }
 
+void __eap_tls_set_offload(bool enabled)
+{
+	eap_tls_offload = enabled;
+}
+
+void __eap_tls_get_offload_stats(struct eap_tls_offload_stats *out_stats)
+{
+	*out_stats = offload_stats;
+}
+
+void __eap_tls_reset_offload_stats(void)
+{
+	memset(&offload_stats, 0, sizeof(offload_stats));
+}
+
 static int eap_tls_common_init(void)
 {
+	eap_tls_offload = true;
+
 	return 0;
 }
 
 static void eap_tls_common_exit(void)
 {
+	eap_tls_offload = false;
+
 	l_settings_free(eap_tls_session_cache);
 	eap_tls_session_cache = NULL;
 }
@@ -89,3 +89,15 @@ void eap_tls_common_tunnel_close(struct eap_state *eap);
 void eap_tls_set_session_cache_ops(eap_tls_session_cache_load_func_t load,
 					eap_tls_session_cache_sync_func_t sync);
 void eap_tls_forget_peer(const char *peer_id);
+
+/* Where the TLS handshake steps were run */
+struct eap_tls_offload_stats {
+	unsigned int worker_steps;
+	unsigned int main_loop_handshake_steps;
+	uint64_t worker_us;
+	uint64_t main_loop_max_us;
+};
+
+void __eap_tls_set_offload(bool enabled);
+void __eap_tls_get_offload_stats(struct eap_tls_offload_stats *out_stats);
+void __eap_tls_reset_offload_stats(void);
@@ -76,6 +76,22 @@ enum state {
 static struct l_key *dh5_generator;
 static struct l_key *dh5_prime;
 
+/*
+ * Generating the DH5 private key and public value is a 1536-bit modexp.
+ * Keep a few keypairs ready, generated while the main loop is idle, so
+ * that this isn't done while the peer is waiting for our M1 or M2.
+ */
+#define DH5_POOL_SIZE 2
+
+struct dh5_keypair {
+	struct l_key *private;
+	uint8_t public_key[192];
+};
+
+static struct l_queue *dh5_pool;
+static struct l_idle *dh5_pool_refill;
+static struct eap_wsc_dh5_stats dh5_stats;
+
 struct eap_wsc_state {
 	bool registrar;
 	struct wsc_m1 *m1;
@@ -106,6 +122,129 @@ struct eap_wsc_state {
 	size_t tx_last_frag_len;
 };
 
+static void dh5_keypair_free(void *data)
+{
+	struct dh5_keypair *keypair = data;
+
+	l_key_free(keypair->private);
+	l_free(keypair);
+}
+
+static struct dh5_keypair *dh5_keypair_generate(void)
+{
+	struct dh5_keypair *keypair = l_new(struct dh5_keypair, 1);
+	size_t len = sizeof(keypair->public_key);
+
+	keypair->private = l_key_generate_dh_private(crypto_dh5_prime,
+							crypto_dh5_prime_size);
+	if (!keypair->private)
+		goto err;
+
+	if (!l_key_compute_dh_public(dh5_generator, keypair->private,
+					dh5_prime, keypair->public_key, &len))
+		goto err;
+
+	if (len != sizeof(keypair->public_key))
+		goto err;
+
+	return keypair;
+
+err:
+	dh5_keypair_free(keypair);
+	return NULL;
+}
+
+static void dh5_pool_refill_cb(struct l_idle *idle, void *user_data)
+{
+	struct dh5_keypair *keypair;
+
+	/* One keypair per main loop iteration to stay responsive */
+	if (l_queue_length(dh5_pool) < DH5_POOL_SIZE) {
+		keypair = dh5_keypair_generate();
+		if (keypair) {
+			l_queue_push_tail(dh5_pool, keypair);
+
+			if (l_queue_length(dh5_pool) < DH5_POOL_SIZE)
+				return;
+		}
+	}
+
+	l_idle_remove(dh5_pool_refill);
+	dh5_pool_refill = NULL;
+}
+
+static void dh5_pool_schedule_refill(void)
+{
+	if (dh5_pool_refill || l_queue_length(dh5_pool) >= DH5_POOL_SIZE)
+		return;
+
+	dh5_pool_refill = l_idle_create(dh5_pool_refill_cb, NULL, NULL);
+}
+
+/*
+ * Starts filling the keypair pool ahead of a WSC session, e.g. while the
+ * enrollee scans for a registrar.  Nothing is precomputed before WSC is
+ * first used so daemons that never run WSC don't pay for it.
+ */
+void eap_wsc_prepare_keys(void)
+{
+	if (!dh5_pool)
+		return;
+
+	dh5_pool_schedule_refill();
+}
+
+/*
+ * Hands out a pooled keypair, or generates one on the spot if the pool
+ * has run dry, and schedules a refill either way.
+ */
+static bool dh5_keypair_take(struct l_key **private, uint8_t *public_key)
+{
+	uint64_t start = l_time_now();
+	struct dh5_keypair *keypair = l_queue_pop_head(dh5_pool);
+
+	if (keypair)
+		dh5_stats.pool_hits++;
+	else {
+		dh5_stats.pool_misses++;
+		keypair = dh5_keypair_generate();
+	}
+
+	dh5_stats.keypair_us += l_time_diff(start, l_time_now());
+	dh5_pool_schedule_refill();
+
+	if (!keypair)
+		return false;
+
+	*private = l_steal_ptr(keypair->private);
+	memcpy(public_key, keypair->public_key, sizeof(keypair->public_key));
+	dh5_keypair_free(keypair);
+
+	return true;
+}
+
+static bool dh5_compute_secret(const uint8_t *remote_public_key,
+				struct l_key *private,
+				uint8_t *shared_secret,
+				size_t *shared_secret_len)
+{
+	uint64_t start = l_time_now();
+	struct l_key *remote_public;
+	bool r;
+
+	remote_public = l_key_new(L_KEY_RAW, remote_public_key, 192);
+	if (!remote_public)
+		return false;
+
+	r = l_key_compute_dh_secret(remote_public, private, dh5_prime,
+					shared_secret, shared_secret_len);
+	l_key_free(remote_public);
+
+	dh5_stats.secret_us += l_time_diff(start, l_time_now());
+
+	return r;
+}
+
 static inline void eap_wsc_state_set_sent_pdu(struct eap_wsc_state *wsc,
 						uint8_t *pdu, size_t len)
 {
@@ -863,7 +1002,6 @@ static void eap_wsc_handle_m2(struct eap_state *eap,
 					const uint8_t *pdu, size_t len)
 {
 	struct eap_wsc_state *wsc = eap_get_data(eap);
-	struct l_key *remote_public;
 	uint8_t shared_secret[192] = { 0 };
 	size_t shared_secret_len = sizeof(shared_secret);
 	struct l_checksum *sha256;
@@ -894,16 +1032,8 @@ static void eap_wsc_handle_m2(struct eap_state *eap,
 					crypto_dh5_prime_size))
 		return;
 
-	remote_public = l_key_new(L_KEY_RAW, wsc->m2->public_key,
-						sizeof(wsc->m2->public_key));
-	if (!remote_public)
-		return;
-
-	r = l_key_compute_dh_secret(remote_public, wsc->private, dh5_prime,
-					shared_secret, &shared_secret_len);
-	l_key_free(remote_public);
-
-	if (!r)
+	if (!dh5_compute_secret(wsc->m2->public_key, wsc->private,
+					shared_secret, &shared_secret_len))
 		return;
 
 	sha256 = l_checksum_new(L_CHECKSUM_SHA256);
@@ -1329,7 +1459,6 @@ static void eap_wsc_r_handle_m1(struct eap_state *eap,
 					const uint8_t *pdu, size_t len)
 {
 	struct eap_wsc_state *wsc = eap_get_data(eap);
-	struct l_key *remote_public;
 	uint8_t shared_secret[192] = { 0 };
 	size_t shared_secret_len = sizeof(shared_secret);
 	struct l_checksum *sha256;
@@ -1393,16 +1522,8 @@ static void eap_wsc_r_handle_m1(struct eap_state *eap,
 	 * the rest of the registration protocol.
 	 */
 
-	remote_public = l_key_new(L_KEY_RAW, wsc->m1->public_key,
-						sizeof(wsc->m1->public_key));
-	if (!remote_public)
-		return;
-
-	r = l_key_compute_dh_secret(remote_public, wsc->private, dh5_prime,
-					shared_secret, &shared_secret_len);
-	l_key_free(remote_public);
-
-	if (!r)
+	if (!dh5_compute_secret(wsc->m1->public_key, wsc->private,
+					shared_secret, &shared_secret_len))
 		return;
 
 	sha256 = l_checksum_new(L_CHECKSUM_SHA256);
@@ -1858,6 +1979,7 @@ static struct eap_wsc_state *eap_wsc_new_common(struct l_settings *settings,
 	struct eap_wsc_state *wsc;
 	const char *v;
 	uint8_t private_key[192];
+	uint8_t *public_key;
 	size_t len;
 	unsigned int u32;
 
@@ -1865,9 +1987,12 @@ static struct eap_wsc_state *eap_wsc_new_common(struct l_settings *settings,
 	wsc->registrar = registrar;
 
 	wsc->m1 = l_new(struct wsc_m1, 1);
+	public_key = wsc->m1->public_key;
 
-	if (registrar)
+	if (registrar) {
 		wsc->m2 = l_new(struct wsc_m2, 1);
+		public_key = wsc->m2->public_key;
+	}
 
 	v = l_settings_get_value(settings, "WSC", "EnrolleeMAC");
 	if (!v)
@@ -1932,20 +2057,18 @@ static struct eap_wsc_state *eap_wsc_new_common(struct l_settings *settings,
 
 		wsc->private = l_key_new(L_KEY_RAW, private_key, 192);
 		explicit_bzero(private_key, 192);
-	} else
-		wsc->private = l_key_generate_dh_private(crypto_dh5_prime,
-							crypto_dh5_prime_size);
 
-	if (!wsc->private)
-		goto err;
+		if (!wsc->private)
+			goto err;
 
-	len = sizeof(wsc->m1->public_key);
-	if (!l_key_compute_dh_public(dh5_generator, wsc->private, dh5_prime,
-					registrar ? wsc->m2->public_key :
-					wsc->m1->public_key, &len))
-		goto err;
+		len = sizeof(wsc->m1->public_key);
+		if (!l_key_compute_dh_public(dh5_generator, wsc->private,
+						dh5_prime, public_key, &len))
+			goto err;
 
-	if (len != sizeof(wsc->m1->public_key))
+		if (len != sizeof(wsc->m1->public_key))
+			goto err;
+	} else if (!dh5_keypair_take(&wsc->private, public_key))
 		goto err;
 
 	if (!load_hexencoded(settings, registrar ? "R-SNonce1" : "E-SNonce1",
@@ -2202,8 +2325,10 @@ static int eap_wsc_init(void)
 		goto fail_register;
 
 	r = eap_register_method(&eap_wsc_r);
-	if (!r)
+	if (!r) {
+		dh5_pool = l_queue_new();
 		return 0;
+	}
 
 	eap_unregister_method(&eap_wsc);
 
@@ -2224,8 +2349,38 @@ static void eap_wsc_exit(void)
 	eap_unregister_method(&eap_wsc);
 	eap_unregister_method(&eap_wsc_r);
 
+	l_idle_remove(dh5_pool_refill);
+	dh5_pool_refill = NULL;
+	l_queue_destroy(dh5_pool, dh5_keypair_free);
+	dh5_pool = NULL;
+
 	l_key_free(dh5_prime);
 	l_key_free(dh5_generator);
 }
 
+unsigned int __eap_wsc_dh5_pool_fill(void)
+{
+	struct dh5_keypair *keypair;
+
+	while (l_queue_length(dh5_pool) < DH5_POOL_SIZE) {
+		keypair = dh5_keypair_generate();
+		if (!keypair)
+			break;
+
+		l_queue_push_tail(dh5_pool, keypair);
+	}
+
+	return l_queue_length(dh5_pool);
+}
+
+void __eap_wsc_get_dh5_stats(struct eap_wsc_dh5_stats *out_stats)
+{
+	*out_stats = dh5_stats;
+}
+
+void __eap_wsc_reset_dh5_stats(void)
+{
+	memset(&dh5_stats, 0, sizeof(dh5_stats));
+}
+
 EAP_METHOD_BUILTIN(eap_wsc, eap_wsc_init, eap_wsc_exit)
@@ -24,3 +24,17 @@ enum EAP_WSC_EVENT {
 	EAP_WSC_EVENT_CREDENTIAL_OBTAINED	= 0x0050f200,
 	EAP_WSC_EVENT_CREDENTIAL_SENT		= 0x0050f201,
 };
+
+/* Time spent on the DH5 operations in the M1/M2 path */
+struct eap_wsc_dh5_stats {
+	unsigned int pool_hits;
+	unsigned int pool_misses;
+	uint64_t keypair_us;
+	uint64_t secret_us;
+};
+
+void eap_wsc_prepare_keys(void);
+
+unsigned int __eap_wsc_dh5_pool_fill(void);
+void __eap_wsc_get_dh5_stats(struct eap_wsc_dh5_stats *out_stats);
+void __eap_wsc_reset_dh5_stats(void);
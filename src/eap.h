@@ -97,6 +97,17 @@ void eap_rx_packet(struct eap_state *eap, const uint8_t *pkt, size_t len);
 void eap_set_peer_id(struct eap_state *eap, const char *id);
 const char *eap_get_peer_id(struct eap_state *eap);
 
+/*
+ * EAP-SIM/AKA fast re-authentication state is cached per network, keyed by
+ * the EAP peer ID.  The cache contains keys and should be stored securely.
+ */
+typedef struct l_settings *(*eap_sim_reauth_cache_load_func_t)(void);
+typedef void (*eap_sim_reauth_cache_sync_func_t)(const struct l_settings *);
+
+void eap_sim_set_reauth_cache_ops(eap_sim_reauth_cache_load_func_t load,
+				eap_sim_reauth_cache_sync_func_t sync);
+void eap_sim_forget_peer(const char *peer_id);
+
 void __eap_set_config(struct l_settings *config);
 
 int eap_init(void);
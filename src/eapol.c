@@ -1104,7 +1104,6 @@ static void eapol_set_key_timeout(struct eapol_sm *sm,
 /* 802.11-2016 Section 12.7.6.2 */
 static void eapol_send_ptk_1_of_4(struct eapol_sm *sm)
 {
-	const uint8_t *aa = sm->handshake->aa;
 	uint8_t frame_buf[512];
 	struct eapol_key *ek = (struct eapol_key *) frame_buf;
 	enum crypto_cipher cipher = ie_rsn_cipher_suite_to_cipher(
@@ -1131,9 +1130,11 @@ static void eapol_send_ptk_1_of_4(struct eapol_sm *sm)
 	ek->key_replay_counter = L_CPU_TO_BE64(sm->replay_counter);
 	memcpy(ek->key_nonce, sm->handshake->anonce, sizeof(ek->key_nonce));
 
-	/* Write the PMKID KDE into Key Data field unencrypted */
-	crypto_derive_pmkid(sm->handshake->pmk, 32, sm->handshake->spa, aa,
-			pmkid, L_CHECKSUM_SHA1);
+	/*
+	 * Write the PMKID KDE into Key Data field unencrypted.  SAE exports
+	 * its own PMKID, for PSK it is derived from the PMK
+	 */
+	handshake_state_get_pmkid(sm->handshake, pmkid, L_CHECKSUM_SHA1);
 
 	eapol_key_data_append(ek, sm->mic_len, HANDSHAKE_KDE_PMKID, pmkid, 16);
 
@@ -1403,8 +1404,10 @@ static void eapol_send_ptk_3_of_4(struct eapol_sm *sm)
 {
 	uint8_t frame_buf[512];
 	unsigned int rsne_len = sm->handshake->authenticator_ie[1] + 2;
-	uint8_t key_data_buf[128 + rsne_len];
-	int key_data_len = rsne_len;
+	const uint8_t *rsnxe = sm->handshake->authenticator_rsnxe;
+	unsigned int rsnxe_len = rsnxe ? rsnxe[1] + 2 : 0;
+	uint8_t key_data_buf[128 + rsne_len + rsnxe_len];
+	int key_data_len = rsne_len + rsnxe_len;
 	struct eapol_key *ek = (struct eapol_key *) frame_buf;
 	enum crypto_cipher cipher = ie_rsn_cipher_suite_to_cipher(
 				sm->handshake->pairwise_cipher);
@@ -1444,6 +1447,10 @@ static void eapol_send_ptk_3_of_4(struct eapol_sm *sm)
 	 */
 	memcpy(key_data_buf, sm->handshake->authenticator_ie, rsne_len);
 
+	/* The RSNXE, if advertised, must follow so the STA can verify it */
+	if (rsnxe)
+		memcpy(key_data_buf + rsne_len, rsnxe, rsnxe_len);
+
 	if (group_cipher) {
 		uint8_t *gtk_kde = key_data_buf + key_data_len;
 
@@ -1610,7 +1617,8 @@ static void eapol_handle_ptk_2_of_4(struct eapol_sm *sm,
 	if (sm->handshake->akm_suite == IE_RSN_AKM_SUITE_SAE_SHA256)
 		type = L_CHECKSUM_SHA256;
 
-	if (!crypto_derive_pairwise_ptk(sm->handshake->pmk,
+	if (!crypto_derive_pairwise_ptk_cached(&sm->handshake->pmk_hmacs,
+					sm->handshake->pmk,
 					sm->handshake->pmk_len,
 					sm->handshake->spa, aa,
 					sm->handshake->anonce, ek->key_nonce,
@@ -2840,6 +2848,15 @@ bool eapol_start(struct eapol_sm *sm)
 		if (!sm->eap)
 			goto eap_error;
 
+		/*
+		 * Set before loading the settings so that methods can pick
+		 * up state cached for this network, e.g. an EAP-SIM
+		 * re-authentication identity.
+		 */
+		network_id = l_util_hexstring(sm->handshake->ssid,
+						sm->handshake->ssid_len);
+		eap_set_peer_id(sm->eap, network_id);
+
 		if (!eap_load_settings(sm->eap, sm->handshake->settings_8021x,
 					"EAP-")) {
 			eap_free(sm->eap);
@@ -2850,10 +2867,6 @@ bool eapol_start(struct eapol_sm *sm)
 
 		eap_set_key_material_func(sm->eap, eapol_eap_results_cb);
 		eap_set_event_func(sm->eap, eapol_eap_event_cb);
-
-		network_id = l_util_hexstring(sm->handshake->ssid,
-						sm->handshake->ssid_len);
-		eap_set_peer_id(sm->eap, network_id);
 	}
 
 	handshake_event(sm->handshake, HANDSHAKE_EVENT_STARTED);
@@ -43,12 +43,23 @@
 static const unsigned int FT_ONCHANNEL_TIME = 300u; /* ms */
 
 static ft_tx_frame_func_t tx_frame = NULL;
-static struct l_queue *info_list = NULL;
+static struct l_hashmap *info_map = NULL;
 
-struct ft_info {
+/* Time from the target being chosen until the first frame goes out */
+static struct {
+	uint32_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+} ft_tx_latency;
+
+struct ft_info_key {
 	uint32_t ifindex;
-	uint8_t spa[6];
 	uint8_t aa[6];
+};
+
+struct ft_info {
+	struct ft_info_key key;
+	uint8_t spa[6];
 	uint8_t snonce[32];
 	uint8_t mde[3];
 	uint8_t *fte;
@@ -59,6 +70,11 @@ struct ft_info {
 	uint32_t offchannel_id;
 	/* Status of Authenticate/Action frame response, or error (< 0) */
 	int status;
+	uint64_t start_time;
+
+	/* RSNE + MDE + FTE for the Authenticate/FT Request frame */
+	uint8_t auth_ies[512];
+	size_t auth_ies_len;
 
 	struct l_timeout *timeout;
 	struct wiphy_radio_work_item work;
@@ -678,23 +694,32 @@ ft_error:
 	return false;
 }
 
-static struct ft_info *ft_info_find(uint32_t ifindex, const uint8_t *aa)
+static unsigned int ft_info_key_hash(const void *p)
+{
+	const struct ft_info_key *key = p;
+
+	return key->ifindex ^ l_get_le32(key->aa + 2);
+}
+
+static int ft_info_key_compare(const void *a, const void *b)
 {
-	const struct l_queue_entry *e;
+	const struct ft_info_key *key_a = a;
+	const struct ft_info_key *key_b = b;
 
-	for (e = l_queue_get_entries(info_list); e; e = e->next) {
-		struct ft_info *info = e->data;
+	if (key_a->ifindex != key_b->ifindex)
+		return key_a->ifindex < key_b->ifindex ? -1 : 1;
 
-		if (info->ifindex != ifindex)
-			continue;
+	return memcmp(key_a->aa, key_b->aa, 6);
+}
 
-		if (aa && memcmp(info->aa, aa, 6))
-			continue;
+static struct ft_info *ft_info_find(uint32_t ifindex, const uint8_t *aa)
+{
+	struct ft_info_key key;
 
-		return info;
-	}
+	key.ifindex = ifindex;
+	memcpy(key.aa, aa, 6);
 
-	return NULL;
+	return l_hashmap_lookup(info_map, &key);
 }
 
 void __ft_rx_action(uint32_t ifindex, const uint8_t *frame, size_t frame_len)
@@ -724,7 +749,7 @@ void __ft_rx_action(uint32_t ifindex, const uint8_t *frame, size_t frame_len)
 
 	if (ret != 0) {
 		l_debug("BSS "MAC" rejected FT action with status=%u",
-				MAC_STR(info->aa), ret);
+				MAC_STR(info->key.aa), ret);
 		info->status = ret;
 		goto done;
 	}
@@ -745,7 +770,24 @@ done:
 	return;
 
 ft_error:
-	l_debug("FT-over-DS authenticate to "MAC" failed", MAC_STR(info->aa));
+	l_debug("FT-over-DS authenticate to "MAC" failed",
+			MAC_STR(info->key.aa));
+}
+
+static void ft_info_destroy(void *data)
+{
+	struct ft_info *info = data;
+
+	if (info->fte)
+		l_free(info->fte);
+
+	if (info->authenticator_ie)
+		l_free(info->authenticator_ie);
+
+	if (info->timeout)
+		l_timeout_remove(info->timeout);
+
+	l_free(info);
 }
 
 static struct ft_info *ft_info_new(struct handshake_state *hs,
@@ -753,9 +795,10 @@ static struct ft_info *ft_info_new(struct handshake_state *hs,
 {
 	struct ft_info *info = l_new(struct ft_info, 1);
 
-	info->ifindex = hs->ifindex;
+	info->start_time = l_time_now();
+	info->key.ifindex = hs->ifindex;
 	memcpy(info->spa, hs->spa, 6);
-	memcpy(info->aa, target_bss->addr, 6);
+	memcpy(info->key.aa, target_bss->addr, 6);
 	memcpy(info->mde, target_bss->mde, sizeof(info->mde));
 	memcpy(info->prev_bssid, hs->aa, 6);
 
@@ -768,23 +811,64 @@ static struct ft_info *ft_info_new(struct handshake_state *hs,
 	l_getrandom(info->snonce, 32);
 	info->status = -ENOENT;
 
+	/*
+	 * Everything needed for the Authenticate/FT Request IEs is known
+	 * once the target is chosen, so build them now rather than when
+	 * the radio becomes available.
+	 */
+	if (!ft_build_authenticate_ies(hs, hs->supplicant_ocvc, info->snonce,
+					info->auth_ies, &info->auth_ies_len)) {
+		ft_info_destroy(info);
+		return NULL;
+	}
+
 	return info;
 }
 
-static void ft_info_destroy(void *data)
+static void ft_info_add(struct ft_info *info)
 {
-	struct ft_info *info = data;
+	struct ft_info *old = l_hashmap_remove(info_map, &info->key);
 
-	if (info->fte)
-		l_free(info->fte);
+	/* A newer attempt to the same target supersedes any earlier one */
+	if (old) {
+		struct netdev *netdev = netdev_find(old->key.ifindex);
 
-	if (info->authenticator_ie)
-		l_free(info->authenticator_ie);
+		if (old->offchannel_id)
+			offchannel_cancel(netdev_get_wdev_id(netdev),
+						old->offchannel_id);
 
-	if (info->timeout)
-		l_timeout_remove(info->timeout);
+		/* Queued or running, the work item must not outlive old */
+		if (old->work.id)
+			wiphy_radio_work_done(netdev_get_wiphy(netdev),
+						old->work.id);
 
-	l_free(info);
+		ft_info_destroy(old);
+	}
+
+	l_hashmap_insert(info_map, &info->key, info);
+}
+
+static void ft_info_tx_done(struct ft_info *info)
+{
+	uint64_t elapsed;
+
+	if (!info->start_time)
+		return;
+
+	elapsed = l_time_diff(info->start_time, l_time_now());
+	info->start_time = 0;
+
+	ft_tx_latency.count++;
+	ft_tx_latency.total_us += elapsed;
+
+	if (elapsed > ft_tx_latency.max_us)
+		ft_tx_latency.max_us = elapsed;
+
+	l_debug("FT frame to "MAC" sent %"PRIu64" us after target selection "
+		"(avg %"PRIu64" us, max %"PRIu64" us over %u roams)",
+		MAC_STR(info->key.aa), elapsed,
+		ft_tx_latency.total_us / ft_tx_latency.count,
+		ft_tx_latency.max_us, ft_tx_latency.count);
 }
 
 static bool ft_prepare_handshake(struct ft_info *info,
@@ -796,7 +880,7 @@ static bool ft_prepare_handshake(struct ft_info *info,
 	uint8_t *fte;
 	uint8_t *rsne;
 
-	handshake_state_set_authenticator_address(hs, info->aa);
+	handshake_state_set_authenticator_address(hs, info->key.aa);
 
 	memcpy(hs->mde + 2, info->mde, 3);
 
@@ -899,36 +983,31 @@ static bool ft_prepare_handshake(struct ft_info *info,
 static bool ft_send_action(struct wiphy_radio_work_item *work)
 {
 	struct ft_info *info = l_container_of(work, struct ft_info, work);
-	struct netdev *netdev = netdev_find(info->ifindex);
+	struct netdev *netdev = netdev_find(info->key.ifindex);
 	struct handshake_state *hs = netdev_get_handshake(netdev);
 	uint8_t ft_req[14];
 	struct iovec iov[5];
-	uint8_t ies[512];
-	size_t len;
-	int ret = -EINVAL;
+	int ret;
 
 	ft_req[0] = 6; /* FT category */
 	ft_req[1] = 1; /* FT Request action */
 	memcpy(ft_req + 2, info->spa, 6);
-	memcpy(ft_req + 8, info->aa, 6);
+	memcpy(ft_req + 8, info->key.aa, 6);
 
 	l_debug("");
 
-	if (!ft_build_authenticate_ies(hs, hs->supplicant_ocvc, info->snonce,
-					ies, &len))
-		goto failed;
-
 	iov[0].iov_base = ft_req;
 	iov[0].iov_len = sizeof(ft_req);
 
-	iov[1].iov_base = ies;
-	iov[1].iov_len = len;
+	iov[1].iov_base = info->auth_ies;
+	iov[1].iov_len = info->auth_ies_len;
 
 	ret = tx_frame(hs->ifindex, 0x00d0, info->ds_frequency, hs->aa, iov, 2);
 	if (ret < 0)
 		goto failed;
 
-	l_queue_push_tail(info_list, info);
+	ft_info_tx_done(info);
+	ft_info_add(info);
 
 	return false;
 
@@ -946,7 +1025,7 @@ struct wiphy_radio_work_item_ops ft_ops = {
 static void ft_ds_timeout(struct l_timeout *timeout, void *user_data)
 {
 	struct ft_info *info = user_data;
-	struct netdev *netdev = netdev_find(info->ifindex);
+	struct netdev *netdev = netdev_find(info->key.ifindex);
 
 	wiphy_radio_work_done(netdev_get_wiphy(netdev), info->work.id);
 }
@@ -958,6 +1037,9 @@ int ft_action(uint32_t ifindex, uint32_t freq, const struct scan_bss *target)
 	struct ft_info *info;
 
 	info = ft_info_new(hs, target);
+	if (!info)
+		return -EINVAL;
+
 	info->ds_frequency = freq;
 	info->timeout = l_timeout_create_ms(200, ft_ds_timeout, info, NULL);
 
@@ -977,12 +1059,17 @@ void __ft_rx_authenticate(uint32_t ifindex, const uint8_t *frame,
 	const uint8_t *ies;
 	size_t ies_len;
 
-	info = ft_info_find(ifindex, NULL);
+	if (frame_len < 30)
+		return;
+
+	/* Address 2 (TA) of the Authentication frame is the target AA */
+	info = ft_info_find(ifindex, frame + 10);
 	if (!info)
 		return;
 
 	if (!ft_parse_authentication_resp_frame(frame, frame_len,
-					info->spa, info->aa, info->aa, 2,
+					info->spa, info->key.aa,
+					info->key.aa, 2,
 					&status, &ies, &ies_len)) {
 		l_debug("Could not parse auth response");
 		return;
@@ -990,7 +1077,7 @@ void __ft_rx_authenticate(uint32_t ifindex, const uint8_t *frame,
 
 	if (status != 0) {
 		l_debug("BSS "MAC" rejected FT auth with status=%u",
-				MAC_STR(info->aa), status);
+				MAC_STR(info->key.aa), status);
 		info->status = status;
 		goto cancel;
 	}
@@ -1019,10 +1106,6 @@ cancel:
 static void ft_send_authenticate(void *user_data)
 {
 	struct ft_info *info = user_data;
-	struct netdev *netdev = netdev_find(info->ifindex);
-	struct handshake_state *hs = netdev_get_handshake(netdev);
-	uint8_t ies[256];
-	size_t len;
 	struct iovec iov[2];
 	struct mmpdu_authentication auth;
 
@@ -1036,14 +1119,14 @@ static void ft_send_authenticate(void *user_data)
 	iov[0].iov_base = &auth;
 	iov[0].iov_len = sizeof(struct mmpdu_authentication);
 
-	if (!ft_build_authenticate_ies(hs, hs->supplicant_ocvc, info->snonce,
-					ies, &len))
-		return;
+	iov[1].iov_base = info->auth_ies;
+	iov[1].iov_len = info->auth_ies_len;
 
-	iov[1].iov_base = ies;
-	iov[1].iov_len = len;
+	if (tx_frame(info->key.ifindex, 0x00b0, info->frequency, info->key.aa,
+			iov, 2) < 0)
+		return;
 
-	tx_frame(info->ifindex, 0x00b0, info->frequency, info->aa, iov, 2);
+	ft_info_tx_done(info);
 }
 
 static void ft_authenticate_destroy(int error, void *user_data)
@@ -1068,13 +1151,16 @@ int ft_authenticate(uint32_t ifindex, const struct scan_bss *target)
 	struct handshake_state *hs = netdev_get_handshake(netdev);
 	struct ft_info *info = ft_info_new(hs, target);
 
+	if (!info)
+		return -EINVAL;
+
 	info->offchannel_id = offchannel_start(netdev_get_wdev_id(netdev),
 						WIPHY_WORK_PRIORITY_FT,
 						target->frequency,
 						200, ft_send_authenticate, info,
 						ft_authenticate_destroy);
 
-	l_queue_push_tail(info_list, info);
+	ft_info_add(info);
 
 	return 0;
 }
@@ -1082,7 +1168,7 @@ int ft_authenticate(uint32_t ifindex, const struct scan_bss *target)
 static void ft_onchannel_timeout(struct l_timeout *timeout, void *user_data)
 {
 	struct ft_info *info = user_data;
-	struct netdev *netdev = netdev_find(info->ifindex);
+	struct netdev *netdev = netdev_find(info->key.ifindex);
 
 	wiphy_radio_work_done(netdev_get_wiphy(netdev), info->work.id);
 }
@@ -1109,11 +1195,14 @@ int ft_authenticate_onchannel(uint32_t ifindex, const struct scan_bss *target)
 	struct handshake_state *hs = netdev_get_handshake(netdev);
 	struct ft_info *info = ft_info_new(hs, target);
 
+	if (!info)
+		return -EINVAL;
+
 	info->onchannel = true;
 
 	wiphy_radio_work_insert(netdev_get_wiphy(netdev), &info->work,
 				WIPHY_WORK_PRIORITY_FT, &ft_onchannel_ops);
-	l_queue_push_tail(info_list, info);
+	ft_info_add(info);
 
 	return 0;
 }
@@ -1136,7 +1225,7 @@ int ft_handshake_setup(uint32_t ifindex, const uint8_t *target)
 	if (info->status != 0) {
 		int status = info->status;
 
-		l_queue_remove(info_list, info);
+		l_hashmap_remove(info_map, &info->key);
 		ft_info_destroy(info);
 
 		return status;
@@ -1158,12 +1247,12 @@ int ft_handshake_setup(uint32_t ifindex, const uint8_t *target)
 	return ret;
 }
 
-static bool remove_ifindex(void *data, void *user_data)
+static bool remove_ifindex(const void *key, void *data, void *user_data)
 {
 	struct ft_info *info = data;
 	uint32_t ifindex = L_PTR_TO_UINT(user_data);
 
-	if (info->ifindex != ifindex)
+	if (info->key.ifindex != ifindex)
 		return false;
 
 	if (info->offchannel_id)
@@ -1176,23 +1265,25 @@ static bool remove_ifindex(void *data, void *user_data)
 
 void ft_clear_authentications(uint32_t ifindex)
 {
-	l_queue_foreach_remove(info_list, remove_ifindex,
-				L_UINT_TO_PTR(ifindex));
+	l_hashmap_foreach_remove(info_map, remove_ifindex,
+					L_UINT_TO_PTR(ifindex));
 }
 
 static int ft_init(void)
 {
-	info_list = l_queue_new();
+	info_map = l_hashmap_new();
+	l_hashmap_set_hash_function(info_map, ft_info_key_hash);
+	l_hashmap_set_compare_function(info_map, ft_info_key_compare);
 
 	return 0;
 }
 
 static void ft_exit(void)
 {
-	if (!l_queue_isempty(info_list))
+	if (!l_hashmap_isempty(info_map))
 		l_warn("stale FT info objects found!");
 
-	l_queue_destroy(info_list, ft_info_destroy);
+	l_hashmap_destroy(info_map, ft_info_destroy);
 }
 
 IWD_MODULE(ft, ft_init, ft_exit);
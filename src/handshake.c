@@ -128,6 +128,10 @@ void handshake_state_free(struct handshake_state *s)
 	l_free(s->fils_ip_resp_ie);
 	l_free(s->vendor_ies);
 
+	crypto_hmac_cache_free(s->pmk_hmacs);
+	crypto_hmac_cache_free(s->pmk_r0_hmacs);
+	crypto_hmac_cache_free(s->pmk_r1_hmacs);
+
 	if (s->erp_cache)
 		erp_cache_put(s->erp_cache);
 
@@ -596,25 +600,30 @@ bool handshake_state_derive_ptk(struct handshake_state *s)
 		ie_parse_mobility_domain_from_data(s->mde, s->mde[1] + 2,
 							&mdid, NULL, NULL);
 
-		if (!crypto_derive_pmk_r0(xxkey, xxkey_len, s->ssid,
+		if (!crypto_derive_pmk_r0_cached(&s->pmk_hmacs,
+						xxkey, xxkey_len, s->ssid,
 						s->ssid_len, mdid,
 						s->r0khid, s->r0khid_len,
 						s->spa, sha384,
 						s->pmk_r0, s->pmk_r0_name))
 			return false;
 
-		if (!crypto_derive_pmk_r1(s->pmk_r0, s->r1khid, s->spa,
+		if (!crypto_derive_pmk_r1_cached(&s->pmk_r0_hmacs,
+						s->pmk_r0, s->r1khid, s->spa,
 						s->pmk_r0_name, sha384,
 						s->pmk_r1, s->pmk_r1_name))
 			return false;
 
-		if (!crypto_derive_ft_ptk(s->pmk_r1, s->pmk_r1_name, s->aa,
-						s->spa, s->snonce, s->anonce,
+		if (!crypto_derive_ft_ptk_cached(&s->pmk_r1_hmacs,
+						s->pmk_r1, s->pmk_r1_name,
+						s->aa, s->spa,
+						s->snonce, s->anonce,
 						sha384, s->ptk, ptk_size,
 						ptk_name))
 			return false;
 	} else
-		if (!crypto_derive_pairwise_ptk(s->pmk, s->pmk_len, s->spa,
+		if (!crypto_derive_pairwise_ptk_cached(&s->pmk_hmacs,
+						s->pmk, s->pmk_len, s->spa,
 						s->aa, s->anonce, s->snonce,
 						s->ptk, ptk_size, type))
 			return false;
@@ -771,8 +780,8 @@ bool handshake_state_get_pmkid(struct handshake_state *s, uint8_t *out_pmkid,
 	if (!s->have_pmk)
 		return false;
 
-	return crypto_derive_pmkid(s->pmk, 32, s->spa, s->aa, out_pmkid,
-					sha);
+	return crypto_derive_pmkid_cached(&s->pmk_hmacs, s->pmk, 32,
+						s->spa, s->aa, out_pmkid, sha);
 }
 
 bool handshake_state_pmkid_matches(struct handshake_state *s,
@@ -29,6 +29,7 @@
 struct handshake_state;
 enum crypto_cipher;
 struct eapol_frame;
+struct crypto_hmac_cache;
 
 enum handshake_kde {
 	/* 802.11-2020 Table 12-9 in section 12.7.2 */
@@ -125,6 +126,10 @@ struct handshake_state {
 	uint8_t fils_ft_len;
 	struct l_settings *settings_8021x;
 	struct l_ecc_point **ecc_sae_pts;
+	/* HMAC contexts keyed with the PMK (or XXKey), PMK-R0 and PMK-R1 */
+	struct crypto_hmac_cache *pmk_hmacs;
+	struct crypto_hmac_cache *pmk_r0_hmacs;
+	struct crypto_hmac_cache *pmk_r1_hmacs;
 	bool have_snonce : 1;
 	bool ptk_complete : 1;
 	bool wpa_ie : 1;
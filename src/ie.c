@@ -2691,6 +2691,394 @@ int ie_parse_oci(const void *data, size_t len, const uint8_t **oci)
 	return 0;
 }
 
+/* One element of a nontransmitted BSSID profile */
+struct ie_mbssid_element {
+	unsigned int tag;
+	const uint8_t *raw;
+	size_t raw_len;
+	bool used;
+};
+
+static const uint8_t *ie_tlv_iter_get_raw(struct ie_tlv_iter *iter,
+						size_t *raw_len)
+{
+	size_t hdr_len = iter->tag >= 256 ? 3 : 2;
+
+	*raw_len = iter->len + hdr_len;
+
+	return iter->data - hdr_len;
+}
+
+/*
+ * 802.11-2020 9.4.2.46: the BSSID of the nontransmitted BSS with a given
+ * index replaces the 'n' least significant bits of the transmitted BSSID
+ * with (LSBs + index) mod 2^n.
+ */
+static void ie_nontransmitted_bssid(const uint8_t *ref, uint8_t max_indicator,
+					uint8_t index, uint8_t *out)
+{
+	uint64_t mask = (1ULL << max_indicator) - 1;
+	uint64_t addr = 0;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		addr = (addr << 8) | ref[i];
+
+	addr = (addr & ~mask) | ((addr + index) & mask);
+
+	for (i = 5; i >= 0; i--) {
+		out[i] = addr & 0xff;
+		addr >>= 8;
+	}
+}
+
+static bool ie_mbssid_is_inherited(unsigned int tag,
+					const uint8_t *non_inherit,
+					size_t non_inherit_len)
+{
+	uint8_t list_len;
+	uint8_t ext_list_len;
+
+	/* Never inherited, 802.11-2020 Table 9-4 and 35.3.3.3 */
+	if (tag == IE_TYPE_MULTIPLE_BSSID ||
+			tag == IE_TYPE_MULTIPLE_BSSID_CONFIGURATION ||
+			tag == IE_TYPE_NON_INHERITANCE)
+		return false;
+
+	if (!non_inherit || non_inherit_len < 2)
+		return true;
+
+	list_len = non_inherit[0];
+	if (list_len + 2u > non_inherit_len)
+		return true;
+
+	ext_list_len = non_inherit[list_len + 1];
+	if (list_len + ext_list_len + 2u > non_inherit_len)
+		ext_list_len = 0;
+
+	if (tag < 256)
+		return !memchr(non_inherit + 1, tag, list_len);
+
+	return !memchr(non_inherit + list_len + 2, tag - 256, ext_list_len);
+}
+
+static bool ie_mbssid_element_match(const struct ie_mbssid_element *elem,
+					unsigned int tag, const uint8_t *raw,
+					size_t raw_len)
+{
+	if (elem->used || elem->tag != tag)
+		return false;
+
+	/* Vendor elements only replace ones with the same OUI and type */
+	if (tag == IE_TYPE_VENDOR_SPECIFIC)
+		return elem->raw_len >= 7 && raw_len >= 7 &&
+					!memcmp(elem->raw + 2, raw + 2, 5);
+
+	return true;
+}
+
+static bool ie_parse_mbssid_profile(const uint8_t *ies, size_t ies_len,
+					const uint8_t *bssid,
+					uint8_t max_indicator,
+					const uint8_t *profile,
+					size_t profile_len,
+					ie_multiple_bssid_func_t func,
+					void *user_data)
+{
+	struct ie_mbssid_element elems[128];
+	unsigned int n_elems = 0;
+	const uint8_t *ssid = NULL;
+	size_t ssid_len = 0;
+	const uint8_t *non_inherit = NULL;
+	size_t non_inherit_len = 0;
+	const uint8_t *cap = NULL;
+	uint8_t index = 0;
+	_auto_(l_free) uint8_t *out = NULL;
+	size_t pos = 0;
+	uint8_t new_bssid[6];
+	struct ie_tlv_iter iter;
+	unsigned int i;
+
+	ie_tlv_iter_init(&iter, profile, profile_len);
+
+	while (ie_tlv_iter_next(&iter) && n_elems < L_ARRAY_SIZE(elems)) {
+		struct ie_mbssid_element *elem = &elems[n_elems++];
+
+		elem->tag = ie_tlv_iter_get_tag(&iter);
+		elem->raw = ie_tlv_iter_get_raw(&iter, &elem->raw_len);
+		elem->used = false;
+
+		switch (elem->tag) {
+		case IE_TYPE_NONTRANSMITTED_BSSID_CAPABILITY:
+			if (iter.len == 2)
+				cap = iter.data;
+
+			elem->used = true;
+			break;
+		case IE_TYPE_SSID:
+			ssid = elem->raw;
+			ssid_len = elem->raw_len;
+			elem->used = true;
+			break;
+		case IE_TYPE_MULTIPLE_BSSID_INDEX:
+			if (iter.len >= 1)
+				index = iter.data[0];
+
+			break;
+		case IE_TYPE_NON_INHERITANCE:
+			non_inherit = iter.data;
+			non_inherit_len = iter.len;
+			elem->used = true;
+			break;
+		}
+	}
+
+	/*
+	 * A profile split over several Multiple BSSID elements carries
+	 * these in its first part only, the remainder is ignored.
+	 */
+	if (!cap || !ssid || !index || index >= (1u << max_indicator))
+		return false;
+
+	out = l_malloc(ies_len + profile_len);
+
+	memcpy(out, ssid, ssid_len);
+	pos += ssid_len;
+
+	ie_tlv_iter_init(&iter, ies, ies_len);
+
+	while (ie_tlv_iter_next(&iter)) {
+		unsigned int tag = ie_tlv_iter_get_tag(&iter);
+		const uint8_t *raw;
+		size_t raw_len;
+
+		if (tag == IE_TYPE_SSID)
+			continue;
+
+		raw = ie_tlv_iter_get_raw(&iter, &raw_len);
+
+		for (i = 0; i < n_elems; i++)
+			if (ie_mbssid_element_match(&elems[i], tag, raw,
+							raw_len))
+				break;
+
+		if (i < n_elems) {
+			/* Overridden by the profile, keep the parent order */
+			memcpy(out + pos, elems[i].raw, elems[i].raw_len);
+			pos += elems[i].raw_len;
+			elems[i].used = true;
+		} else if (ie_mbssid_is_inherited(tag, non_inherit,
+							non_inherit_len)) {
+			memcpy(out + pos, raw, raw_len);
+			pos += raw_len;
+		}
+	}
+
+	/* Elements only present in the profile go last */
+	for (i = 0; i < n_elems; i++) {
+		if (elems[i].used)
+			continue;
+
+		memcpy(out + pos, elems[i].raw, elems[i].raw_len);
+		pos += elems[i].raw_len;
+	}
+
+	ie_nontransmitted_bssid(bssid, max_indicator, index, new_bssid);
+	func(new_bssid, l_get_le16(cap), out, pos, user_data);
+
+	return true;
+}
+
+/*
+ * Expands the nontransmitted BSSID profiles found in the Multiple BSSID
+ * elements of a transmitted BSS (802.11-2020 35.3.3.3).  For each profile
+ * 'func' is given the BSSID, the Nontransmitted BSSID Capability and the
+ * full set of elements of that BSS: the profile's own elements plus those
+ * of the transmitted BSS it inherits, minus any listed in its
+ * Non-Inheritance element.
+ *
+ * Returns the number of profiles reported.
+ */
+int ie_parse_multiple_bssid(const uint8_t *ies, size_t ies_len,
+				const uint8_t *bssid,
+				ie_multiple_bssid_func_t func,
+				void *user_data)
+{
+	struct ie_tlv_iter iter;
+	struct ie_tlv_iter sub;
+	int n = 0;
+
+	ie_tlv_iter_init(&iter, ies, ies_len);
+
+	while (ie_tlv_iter_next(&iter)) {
+		uint8_t max_indicator;
+
+		if (ie_tlv_iter_get_tag(&iter) != IE_TYPE_MULTIPLE_BSSID)
+			continue;
+
+		if (iter.len < 1)
+			continue;
+
+		max_indicator = iter.data[0];
+		if (max_indicator < 1 || max_indicator > 8)
+			continue;
+
+		ie_tlv_iter_init(&sub, iter.data + 1, iter.len - 1);
+
+		/* Subelement 0 is the Nontransmitted BSSID Profile */
+		while (ie_tlv_iter_next(&sub)) {
+			if (ie_tlv_iter_get_tag(&sub) != 0)
+				continue;
+
+			if (ie_parse_mbssid_profile(ies, ies_len, bssid,
+							max_indicator,
+							sub.data, sub.len,
+							func, user_data))
+				n++;
+		}
+	}
+
+	return n;
+}
+
+static bool ie_parse_rnr_tbtt_info(const uint8_t *data, uint8_t len,
+					struct ie_rnr_info *info)
+{
+	/*
+	 * 802.11ax-2021 Table 9-344: the contents of a TBTT Information
+	 * field are only given away by its length.  Every layout starts
+	 * with the one octet Neighbor AP TBTT Offset, lengths beyond 13
+	 * append fields (e.g. MLD Parameters) that are of no interest here.
+	 */
+	switch (len) {
+	case 1:
+		break;
+	case 2:
+		info->bss_params = data[1];
+		info->bss_params_present = true;
+		break;
+	case 5:
+	case 6:
+		info->short_ssid = l_get_le32(data + 1);
+		info->short_ssid_present = true;
+
+		if (len == 6) {
+			info->bss_params = data[5];
+			info->bss_params_present = true;
+		}
+
+		break;
+	case 7:
+	case 8:
+	case 9:
+		memcpy(info->addr, data + 1, 6);
+		info->addr_present = true;
+
+		if (len >= 8) {
+			info->bss_params = data[7];
+			info->bss_params_present = true;
+		}
+
+		break;
+	case 0:
+	case 3:
+	case 4:
+	case 10:
+		return false;
+	default:
+		memcpy(info->addr, data + 1, 6);
+		info->addr_present = true;
+		info->short_ssid = l_get_le32(data + 7);
+		info->short_ssid_present = true;
+
+		if (len >= 12) {
+			info->bss_params = data[11];
+			info->bss_params_present = true;
+		}
+
+		break;
+	}
+
+	return true;
+}
+
+/*
+ * Parses a Reduced Neighbor Report element (802.11ax-2021 9.4.2.170) into
+ * up to 'max' entries.  Neighbor AP Information fields of an unknown TBTT
+ * Information Field Type or with a reserved TBTT Information Length are
+ * skipped, entries beyond 'max' are ignored.
+ */
+int ie_parse_reduced_neighbor_report(struct ie_tlv_iter *iter,
+					struct ie_rnr_info *out, size_t max,
+					size_t *n_out)
+{
+	unsigned int len = ie_tlv_iter_get_length(iter);
+	const uint8_t *data = ie_tlv_iter_get_data(iter);
+	size_t n = 0;
+
+	while (len) {
+		uint8_t info_type;
+		uint8_t info_count;
+		uint8_t info_len;
+		uint8_t oper_class;
+		uint8_t channel;
+		unsigned int i;
+
+		if (len < 4)
+			return -EINVAL;
+
+		info_type = bit_field(data[0], 0, 2);
+		info_count = bit_field(data[0], 4, 4) + 1;
+		info_len = data[1];
+		oper_class = data[2];
+		channel = data[3];
+		data += 4;
+		len -= 4;
+
+		if ((unsigned int) info_count * info_len > len)
+			return -EINVAL;
+
+		for (i = 0; i < info_count && info_type == 0 && n < max; i++) {
+			struct ie_rnr_info *info = &out[n];
+
+			memset(info, 0, sizeof(*info));
+			info->oper_class = oper_class;
+			info->channel = channel;
+
+			if (ie_parse_rnr_tbtt_info(data + i * info_len,
+							info_len, info))
+				n++;
+		}
+
+		data += info_count * info_len;
+		len -= info_count * info_len;
+	}
+
+	*n_out = n;
+
+	return 0;
+}
+
+/*
+ * The Short SSID (802.11ax-2021 9.4.2.170.3) is the CRC-32 of the SSID,
+ * computed as for the FCS.
+ */
+uint32_t ie_short_ssid(const uint8_t *ssid, size_t ssid_len)
+{
+	uint32_t crc = 0xffffffff;
+	size_t i;
+	int j;
+
+	for (i = 0; i < ssid_len; i++) {
+		crc ^= ssid[i];
+
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
 /*
  * Checks the supported width set (Table 9-322b) meets the following
  * requirements:
@@ -292,7 +292,7 @@ enum ie_type {
 	IE_TYPE_ESTIMATED_SERVICE_PARAMETERS_OUT     = 256 + 53,
 	IE_TYPE_OCI                                  = 256 + 54,
 	IE_TYPE_MULTIPLE_BSSID_CONFIGURATION         = 256 + 55,
-	/* Reserved 56 */
+	IE_TYPE_NON_INHERITANCE                      = 256 + 56,
 	IE_TYPE_KNOWN_BSSID                          = 256 + 57,
 	IE_TYPE_SHORT_SSID_LIST                      = 256 + 58,
 	IE_TYPE_HE_6GHZ_BAND_CAPABILITIES            = 256 + 59,
@@ -572,6 +572,29 @@ struct ie_owe_transition_info {
 	uint8_t channel;
 };
 
+/* 802.11ax-2021 Table 9-364a, BSS Parameters subfield of an RNR entry */
+enum ie_rnr_bss_param {
+	IE_RNR_BSS_PARAM_OCT_RECOMMENDED	= 0x01,
+	IE_RNR_BSS_PARAM_SAME_SSID		= 0x02,
+	IE_RNR_BSS_PARAM_MULTIPLE_BSSID		= 0x04,
+	IE_RNR_BSS_PARAM_TRANSMITTED_BSSID	= 0x08,
+	IE_RNR_BSS_PARAM_MEMBER_ESS		= 0x10,
+	IE_RNR_BSS_PARAM_20MHZ_PROBE_RESP	= 0x20,
+	IE_RNR_BSS_PARAM_COLOCATED_AP		= 0x40,
+};
+
+/* One TBTT Information field of a Reduced Neighbor Report element */
+struct ie_rnr_info {
+	uint8_t oper_class;
+	uint8_t channel;
+	uint8_t addr[6];
+	uint32_t short_ssid;
+	uint8_t bss_params;
+	bool addr_present : 1;
+	bool short_ssid_present : 1;
+	bool bss_params_present : 1;
+};
+
 extern const unsigned char ieee_oui[3];
 extern const unsigned char microsoft_oui[3];
 extern const unsigned char wifi_alliance_oui[3];
@@ -724,4 +747,20 @@ int ie_parse_owe_transition(const void *data, size_t len,
 
 int ie_parse_oci(const void *data, size_t len, const uint8_t **oci);
 
+typedef void (*ie_multiple_bssid_func_t)(const uint8_t *bssid,
+						uint16_t capability,
+						const uint8_t *ies,
+						size_t ies_len,
+						void *user_data);
+
+int ie_parse_multiple_bssid(const uint8_t *ies, size_t ies_len,
+				const uint8_t *bssid,
+				ie_multiple_bssid_func_t func,
+				void *user_data);
+
+int ie_parse_reduced_neighbor_report(struct ie_tlv_iter *iter,
+					struct ie_rnr_info *out, size_t max,
+					size_t *n_out);
+uint32_t ie_short_ssid(const uint8_t *ssid, size_t ssid_len);
+
 bool ie_validate_he_capabilities(const void *data, size_t len);
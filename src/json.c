@@ -51,38 +51,38 @@
 #define ITER_END(iter) \
 	(((iter)->contents->tokens + (iter)->start) + (iter)->count)
 
+/* Max number of keys json_iter_parse can look up in a single call */
+#define JSON_MAX_ARGS 16
+
 struct json_contents {
 	const char *json;
 	size_t json_len;
-	jsmntok_t *tokens;
 	int tokens_len;
-	jsmn_parser *p;
+	jsmntok_t tokens[JSON_DEFAULT_TOKENS];
+	/* Number of tokens nested below each token, filled in once parsed */
+	int spans[JSON_DEFAULT_TOKENS];
 };
 
-static jsmntok_t *next_key_in_parent(struct json_iter *iter, jsmntok_t *current)
+static int token_span(struct json_contents *c, jsmntok_t *token)
 {
-	int parent = current->parent;
-
-	/* iterate the list and stop on the first token with the same parent */
-	while (++current < ITER_END(iter)) {
-		if (current->parent == parent)
-			return current;
-	}
-
-	return NULL;
+	return c->spans[token - c->tokens];
 }
 
-static int count_tokens_in_container(struct json_iter *iter,
-							jsmntok_t *container)
+/*
+ * Tokens are stored in document order so all of a token's descendants follow
+ * it.  Walking backwards, each token's span is final by the time it is added
+ * to its parent.
+ */
+static void compute_spans(struct json_contents *c)
 {
-	int idx = container - iter->contents->tokens;
-	jsmntok_t *contents;
+	int i;
 
-	for (contents = ++container; contents < ITER_END(iter); contents++)
-		if (contents->parent < idx)
-			break;
+	for (i = c->tokens_len - 1; i >= 0; i--) {
+		int parent = c->tokens[i].parent;
 
-	return contents - container;
+		if (parent >= 0)
+			c->spans[parent] += c->spans[i] + 1;
+	}
 }
 
 static void iter_recurse(struct json_iter *iter, jsmntok_t *token,
@@ -93,7 +93,7 @@ static void iter_recurse(struct json_iter *iter, jsmntok_t *token,
 	child->contents = c;
 	child->start = token - c->tokens;
 	child->current = child->start;
-	child->count = count_tokens_in_container(iter, token);
+	child->count = token_span(c, token);
 
 	/*
 	 * Add one to include the object/array token itself. This is required
@@ -108,20 +108,21 @@ static void iter_recurse(struct json_iter *iter, jsmntok_t *token,
 struct json_contents *json_contents_new(const char *json, size_t json_len)
 {
 	struct json_contents *c = l_new(struct json_contents, 1);
+	jsmn_parser p;
 
 	c->json = json;
 	c->json_len = json_len;
-	c->p = l_new(jsmn_parser, 1);
-	c->tokens = l_new(jsmntok_t, JSON_DEFAULT_TOKENS);
 
-	jsmn_init(c->p);
-	c->tokens_len = jsmn_parse(c->p, c->json, c->json_len,
+	jsmn_init(&p);
+	c->tokens_len = jsmn_parse(&p, c->json, c->json_len,
 					c->tokens, JSON_DEFAULT_TOKENS);
 	if (c->tokens_len < 0) {
 		json_contents_free(c);
 		return NULL;
 	}
 
+	compute_spans(c);
+
 	return c;
 }
 
@@ -134,33 +135,20 @@ void json_iter_init(struct json_iter *iter, struct json_contents *c)
 
 void json_contents_free(struct json_contents *c)
 {
-	l_free(c->p);
-	l_free(c->tokens);
 	l_free(c);
 }
 
 struct json_arg {
 	enum json_type type;
+	const char *key;
+	size_t key_len;
 	void *value;
+	enum json_flag flag;
 	jsmntok_t *v;
 };
 
-static void push_arg(struct l_queue *q, enum json_type type,
-			void *value, jsmntok_t *v)
+static void assign_arg(struct json_iter *iter, struct json_arg *arg)
 {
-	struct json_arg *arg = l_new(struct json_arg, 1);
-
-	arg->type = type;
-	arg->value = value;
-	arg->v = v;
-
-	l_queue_push_head(q, arg);
-}
-
-static void assign_arg(void *data, void *user_data)
-{
-	struct json_iter *iter = user_data;
-	struct json_arg *arg = data;
 	struct json_contents *c = iter->contents;
 	char **sval;
 	struct json_iter *iter_val;
@@ -185,20 +173,63 @@ static void assign_arg(void *data, void *user_data)
 		break;
 	default:
 		/* Types are verified earlier, this should never happen */
-		return;
+		break;
 	}
+}
 
-	l_free(arg);
+/*
+ * Walks the object's keys once, matching each against the requested
+ * arguments.  The first occurrence of a key wins.
+ */
+static bool lookup_args(struct json_iter *iter, struct json_arg *args,
+			unsigned int n_args)
+{
+	struct json_contents *c = iter->contents;
+	jsmntok_t *object = c->tokens + iter->start;
+	jsmntok_t *key = object + 1;
+	unsigned int found = 0;
+	unsigned int i;
+	int n;
+
+	for (n = 0; n < object->size && found < n_args; n++) {
+		const char *ptr = TOK_PTR(c->json, key);
+		size_t len = TOK_LEN(key);
+
+		if (key + 1 >= ITER_END(iter))
+			return false;
+
+		for (i = 0; i < n_args; i++) {
+			if (args[i].v || args[i].key_len != len ||
+					memcmp(ptr, args[i].key, len))
+				continue;
+
+			/* Key found but the wrong value type */
+			if ((key + 1)->type != (jsmntype_t) args[i].type)
+				return false;
+
+			args[i].v = key + 1;
+			found++;
+			break;
+		}
+
+		/* Skip over the key and everything nested below its value */
+		key += token_span(c, key) + 1;
+	}
+
+	for (i = 0; i < n_args; i++)
+		if (args[i].flag == JSON_FLAG_MANDATORY && !args[i].v)
+			return false;
+
+	return true;
 }
 
 bool json_iter_parse(struct json_iter *iter, enum json_type type, ...)
 {
 	struct json_contents *c = iter->contents;
+	struct json_arg args[JSON_MAX_ARGS];
+	unsigned int n_args = 0;
+	unsigned int i;
 	va_list va;
-	int i;
-	int num = c->tokens->size;
-	jsmntok_t *next;
-	struct l_queue *args;
 
 	if (iter->start == -1)
 		return false;
@@ -206,86 +237,53 @@ bool json_iter_parse(struct json_iter *iter, enum json_type type, ...)
 	if (c->tokens[iter->start].type != JSMN_OBJECT)
 		return false;
 
-	args = l_queue_new();
-
 	va_start(va, type);
 
-	while (true) {
-		enum json_flag flag;
-		char *key;
-		void *value;
-		jsmntok_t *v = NULL;
-		void *ptr;
-		size_t len;
+	while (type != JSON_UNDEFINED) {
+		struct json_arg *arg = &args[n_args];
 
 		/* Check the type is supported before wasting any cycles */
 		switch (type) {
-		case JSON_UNDEFINED:
-			goto done;
 		case JSON_STRING:
 		case JSON_OBJECT:
 		case JSON_PRIMITIVE:
 		case JSON_ARRAY:
 			break;
 		default:
-			goto error;
+			va_end(va);
+			return false;
 		}
 
-		key = va_arg(va, char *);
-		value = va_arg(va, void *);
-		flag = va_arg(va, enum json_flag);
-
-		/* First key */
-		next = c->tokens + iter->start + 1;
-
-		/* Iterate over this objects keys */
-		for (i = 0; i < num; i++) {
-			ptr = TOK_PTR(c->json, next);
-			len = TOK_LEN(next);
-
-			if (next + 1 > ITER_END(iter))
-				goto error;
-
-			if (strlen(key) == len && !memcmp(ptr, key, len)) {
-				/* Key found but the wrong value type */
-				if ((next + 1)->type != (jsmntype_t)type)
-					goto error;
-
-				v = next + 1;
-				break;
-			}
-
-			next = next_key_in_parent(iter, next);
-			if (!next)
-				break;
+		if (n_args == L_ARRAY_SIZE(args)) {
+			va_end(va);
+			return false;
 		}
 
-		if (flag == JSON_FLAG_MANDATORY && !v)
-			goto error;
-
-		/*
-		 * Still push even if an optional value doesn't exist (!v) so
-		 * the caller can check if it was found or not.
-		 */
-		if (value)
-			push_arg(args, type, value, v);
+		arg->type = type;
+		arg->key = va_arg(va, const char *);
+		arg->key_len = strlen(arg->key);
+		arg->value = va_arg(va, void *);
+		arg->flag = va_arg(va, enum json_flag);
+		arg->v = NULL;
+		n_args++;
 
 		type = va_arg(va, enum json_type);
 	}
 
-done:
 	va_end(va);
 
-	l_queue_foreach(args, assign_arg, iter);
-	l_queue_destroy(args, NULL);
-
-	return true;
+	if (!lookup_args(iter, args, n_args))
+		return false;
 
-error:
-	va_end(va);
+	/*
+	 * Assign even if an optional value doesn't exist (!v) so the caller
+	 * can check if it was found or not.
+	 */
+	for (i = 0; i < n_args; i++)
+		if (args[i].value)
+			assign_arg(iter, &args[i]);
 
-	l_queue_destroy(args, l_free);
-	return false;
+	return true;
 }
 
 static bool iter_get_primitive_data(struct json_iter *iter, void **ptr,
@@ -462,7 +460,7 @@ bool json_iter_next(struct json_iter *iter)
 	 */
 	if (iter->current != iter->start && ((t->type == JSMN_OBJECT ||
 					t->type == JSMN_ARRAY) && t->size))
-		inc = count_tokens_in_container(iter, t) + 1;
+		inc = token_span(c, t) + 1;
 
 	if (c->tokens + iter->current + inc >= ITER_END(iter))
 		return false;
@@ -84,6 +84,8 @@ void json_iter_init(struct json_iter *iter, struct json_contents *c);
  * No other types are supported at this time, and json_iter_parse will fail if
  * other types are encountered.
  *
+ * At most 16 keys can be looked up in a single call.
+ *
  * JSON_OPTIONAL string values will point to NULL if not found
  * JSON_OPTIONAL objects/primitives can be checked with json_iter_is_valid.
  */
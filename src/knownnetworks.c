@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <ell/ell.h>
 
@@ -46,12 +47,14 @@
 #include "src/util.h"
 #include "src/watchlist.h"
 #include "src/band.h"
+#include "src/topology.h"
 
 static struct l_queue *known_networks;
 static size_t num_known_hidden_networks;
 static struct l_dir_watch *storage_dir_watch;
 static struct watchlist known_network_watches;
 static struct l_settings *known_freqs;
+static struct l_settings *known_topology;
 
 void __network_config_parse(const struct l_settings *settings,
 					const char *full_path,
@@ -156,6 +159,7 @@ static void network_info_free(void *data)
 	struct network_info *network = data;
 
 	l_queue_destroy(network->known_frequencies, l_free);
+	topology_free(network->topology);
 
 	network->ops->free(network);
 }
@@ -773,6 +777,14 @@ void known_networks_remove(struct network_info *network)
 		storage_known_frequencies_sync(known_freqs);
 	}
 
+	if (known_topology && network->has_uuid) {
+		char uuid[37];
+
+		l_uuid_to_string(network->uuid, uuid, sizeof(uuid));
+		l_settings_remove_group(known_topology, uuid);
+		storage_topology_sync(known_topology);
+	}
+
 	network_info_free(network);
 }
 
@@ -1064,6 +1076,37 @@ void known_network_frequency_sync(struct network_info *info)
 	storage_known_frequencies_sync(known_freqs);
 }
 
+struct topology *known_network_get_topology(struct network_info *info)
+{
+	if (!info->topology)
+		info->topology = topology_new();
+
+	return info->topology;
+}
+
+/*
+ * Syncs a single network_info ESS topology to the global topology file
+ */
+void known_network_topology_sync(struct network_info *info)
+{
+	_auto_(l_free) char *file_path = NULL;
+	char group[37];
+
+	if (!info->topology || topology_isempty(info->topology))
+		return;
+
+	if (!known_topology)
+		known_topology = l_settings_new();
+
+	file_path = info->ops->get_file_path(info);
+	l_uuid_to_string(network_info_get_uuid(info), group, sizeof(group));
+
+	topology_save(info->topology, known_topology, group);
+	l_settings_set_value(known_topology, group, "name", file_path);
+
+	storage_topology_sync(known_topology);
+}
+
 uint32_t known_networks_watch_add(known_networks_watch_func_t func,
 					void *user_data,
 					known_networks_destroy_func_t destroy)
@@ -1182,3 +1225,72 @@ static void known_frequencies_exit(void)
  */
 IWD_MODULE(known_frequencies, known_network_frequencies_load, known_frequencies_exit)
 IWD_MODULE_DEPENDS(known_frequencies, hotspot)
+
+static int known_network_topology_load(void)
+{
+	_auto_(l_strv_free) char **groups = NULL;
+	uint64_t now = time(NULL);
+	uint8_t uuid[16];
+	char uuid_str[37];
+	uint32_t i;
+
+	known_topology = storage_topology_load();
+	if (!known_topology) {
+		l_debug("No known topology file found.");
+		return 0;
+	}
+
+	groups = l_settings_get_groups(known_topology);
+
+	for (i = 0; groups[i]; i++) {
+		struct network_info *info;
+		const char *path = l_settings_get_value(known_topology,
+							groups[i], "name");
+		if (!path)
+			goto invalid_entry;
+
+		info = find_network_info_from_path(path);
+		if (!info)
+			goto invalid_entry;
+
+		if (!l_uuid_from_string(groups[i], uuid))
+			goto invalid_entry;
+
+		/*
+		 * The UUID is normally assigned from the known frequency
+		 * file already, an entry for a different UUID belongs to a
+		 * network that has since been forgotten and re-added.
+		 */
+		if (info->has_uuid) {
+			l_uuid_to_string(info->uuid, uuid_str,
+						sizeof(uuid_str));
+
+			if (strcmp(uuid_str, groups[i]))
+				goto invalid_entry;
+		} else
+			network_info_set_uuid(info, uuid);
+
+		info->topology = topology_new();
+		topology_load(info->topology, known_topology, groups[i], now);
+
+		if (!topology_isempty(info->topology))
+			continue;
+
+		topology_free(info->topology);
+		info->topology = NULL;
+
+invalid_entry:
+		l_settings_remove_group(known_topology, groups[i]);
+	}
+
+	return 0;
+}
+
+static void known_topology_exit(void)
+{
+	l_settings_free(known_topology);
+	known_topology = NULL;
+}
+
+IWD_MODULE(known_topology, known_network_topology_load, known_topology_exit)
+IWD_MODULE_DEPENDS(known_topology, known_frequencies)
@@ -33,6 +33,7 @@
 
 enum security;
 struct scan_freq_set;
+struct topology;
 struct network_info;
 
 enum known_networks_event {
@@ -89,6 +90,7 @@ struct network_info {
 	char ssid[SSID_MAX_SIZE + 1];
 	enum security type;
 	struct l_queue *known_frequencies;
+	struct topology *topology;
 	int seen_count;			/* Ref count for network.info */
 	uint8_t uuid[16];
 	bool is_hotspot:1;
@@ -128,6 +130,8 @@ struct scan_freq_set *known_networks_get_recent_frequencies(
 int known_network_add_frequency(struct network_info *info,
 				uint32_t frequency);
 void known_network_frequency_sync(struct network_info *info);
+struct topology *known_network_get_topology(struct network_info *info);
+void known_network_topology_sync(struct network_info *info);
 
 uint32_t known_networks_watch_add(known_networks_watch_func_t func,
 					void *user_data,
@@ -50,6 +50,7 @@ static char **blacklist_filter;
 static bool randomize;
 static bool use_default;
 static unsigned int config_watch;
+static uint64_t manager_start_time;
 
 struct wiphy_setup_state {
 	uint32_t id;
@@ -58,6 +59,14 @@ struct wiphy_setup_state {
 	bool aborted;
 	bool retry;
 
+	/* Default interfaces waiting for their turn to be deleted */
+	struct l_queue *del_wdevs;
+
+	/* Setup timeline, for debugging slow startups */
+	uint64_t start_time;
+	uint64_t del_start_time;
+	uint64_t create_start_time;
+
 	/*
 	 * Data we may need if the driver does not seem to support interface
 	 * manipulation and we fall back to using the driver-created default
@@ -69,10 +78,67 @@ struct wiphy_setup_state {
 
 static struct l_queue *pending_wiphys;
 
+/*
+ * Deleting the default interfaces and creating our own are pipelined across
+ * wiphys: only one wiphy has DEL_INTERFACE commands in flight at a time and
+ * as soon as they complete its NEW_INTERFACE commands are queued ahead of
+ * the next wiphy's DEL_INTERFACE commands.  The nl80211 requests are
+ * serialized on the socket anyway, so this lets the first wiphys become
+ * usable after a couple of round trips instead of only once every default
+ * interface in the system has been removed.
+ */
+static struct wiphy_setup_state *deleting_wiphy;
+static struct l_queue *delete_pipeline;
+
+static struct wiphy_setup_state *wiphy_setup_state_new(uint32_t id,
+							struct wiphy *wiphy)
+{
+	struct wiphy_setup_state *state = l_new(struct wiphy_setup_state, 1);
+
+	state->id = id;
+	state->wiphy = wiphy;
+	state->start_time = l_time_now();
+
+	return state;
+}
+
+static uint64_t manager_ms_between(uint64_t start, uint64_t end)
+{
+	if (!start || !end)
+		return 0;
+
+	return l_time_to_msecs(l_time_diff(start, end));
+}
+
+static void wiphy_setup_state_log_ready(struct wiphy_setup_state *state)
+{
+	uint64_t now = l_time_now();
+	uint64_t del_end = state->create_start_time ?: now;
+
+	if (state->aborted)
+		return;
+
+	l_debug("Wiphy %s ready %"PRIu64" ms after startup, setup took "
+		"%"PRIu64" ms (queued: %"PRIu64" ms, deleting: %"PRIu64" ms, "
+		"creating: %"PRIu64" ms)", wiphy_get_name(state->wiphy),
+		manager_ms_between(manager_start_time, now),
+		manager_ms_between(state->start_time, now),
+		manager_ms_between(state->start_time,
+					state->del_start_time ?: del_end),
+		manager_ms_between(state->del_start_time, del_end),
+		manager_ms_between(state->create_start_time, now));
+}
+
 static void wiphy_setup_state_free(void *data)
 {
 	struct wiphy_setup_state *state = data;
 
+	l_queue_remove(delete_pipeline, state);
+
+	if (deleting_wiphy == state)
+		deleting_wiphy = NULL;
+
+	l_queue_destroy(state->del_wdevs, l_free);
 	l_queue_destroy(state->default_interfaces,
 				(l_queue_destroy_func_t) l_genl_msg_unref);
 
@@ -82,6 +148,8 @@ static void wiphy_setup_state_free(void *data)
 
 static void wiphy_setup_state_destroy(struct wiphy_setup_state *state)
 {
+	wiphy_setup_state_log_ready(state);
+
 	l_queue_remove(pending_wiphys, state);
 	wiphy_setup_state_free(state);
 }
@@ -202,6 +270,8 @@ static void manager_create_interfaces(struct wiphy_setup_state *state)
 	if (state->aborted)
 		return;
 
+	state->create_start_time = l_time_now();
+
 	if (state->use_default) {
 		manager_use_default(state);
 
@@ -302,19 +372,43 @@ static bool manager_wiphy_check_setup_done(struct wiphy_setup_state *state)
 	if (state->pending_cmd_count || state->retry)
 		return false;
 
+	/*
+	 * Wait for our turn to delete the default interface(s), the caller
+	 * is responsible for kicking the pipeline with manager_delete_next
+	 */
+	if (!l_queue_isempty(state->del_wdevs) && !state->aborted) {
+		l_queue_remove(delete_pipeline, state);
+		l_queue_push_tail(delete_pipeline, state);
+		return false;
+	}
+
 	manager_create_interfaces(state);
 
 	return !state->pending_cmd_count && !state->retry;
 }
 
+static void manager_delete_next(void);
+
 static void manager_setup_cmd_done(void *user_data)
 {
 	struct wiphy_setup_state *state = user_data;
 
 	state->pending_cmd_count--;
 
+	if (state->pending_cmd_count)
+		return;
+
+	if (deleting_wiphy == state)
+		deleting_wiphy = NULL;
+
+	/*
+	 * Queue this wiphy's NEW_INTERFACE commands before the next wiphy's
+	 * DEL_INTERFACE commands so that it becomes usable first.
+	 */
 	if (manager_wiphy_check_setup_done(state))
 		wiphy_setup_state_destroy(state);
+
+	manager_delete_next();
 }
 
 static void manager_del_interface_cb(struct l_genl_msg *msg, void *user_data)
@@ -346,8 +440,6 @@ static void manager_get_interface_cb(struct l_genl_msg *msg, void *user_data)
 	uint32_t iftype;
 	uint64_t wdev;
 	const char *ifname;
-	struct l_genl_msg *del_msg;
-	unsigned int cmd_id;
 	char *pattern;
 	unsigned int i;
 	bool whitelisted = false, blacklisted = false;
@@ -415,22 +507,72 @@ delete_interface:
 	if (state->use_default)
 		return;
 
-	del_msg = l_genl_msg_new(NL80211_CMD_DEL_INTERFACE);
-	l_genl_msg_append_attr(del_msg, NL80211_ATTR_WDEV, 8, &wdev);
-	l_genl_msg_append_attr(del_msg, NL80211_ATTR_WIPHY, 4, &state->id);
-	cmd_id = l_genl_family_send(nl80211, del_msg,
-					manager_del_interface_cb, state,
-					manager_setup_cmd_done);
+	/* Deleted once this wiphy's turn in the pipeline comes */
+	if (!state->del_wdevs)
+		state->del_wdevs = l_queue_new();
 
-	if (!cmd_id) {
-		l_error("Sending DEL_INTERFACE for wdev: %" PRIu64" failed",
-				wdev);
-		state->use_default = true;
-		return;
+	l_queue_push_tail(state->del_wdevs, l_memdup(&wdev, sizeof(wdev)));
+}
+
+static void manager_send_del_interfaces(struct wiphy_setup_state *state)
+{
+	uint64_t *wdev;
+
+	state->del_start_time = l_time_now();
+
+	while ((wdev = l_queue_pop_head(state->del_wdevs))) {
+		struct l_genl_msg *del_msg;
+		unsigned int cmd_id;
+
+		if (state->use_default) {
+			l_free(wdev);
+			continue;
+		}
+
+		del_msg = l_genl_msg_new(NL80211_CMD_DEL_INTERFACE);
+		l_genl_msg_append_attr(del_msg, NL80211_ATTR_WDEV, 8, wdev);
+		l_genl_msg_append_attr(del_msg, NL80211_ATTR_WIPHY, 4,
+					&state->id);
+		cmd_id = l_genl_family_send(nl80211, del_msg,
+						manager_del_interface_cb, state,
+						manager_setup_cmd_done);
+
+		if (!cmd_id) {
+			l_error("Sending DEL_INTERFACE for wdev: %" PRIu64
+				" failed", *wdev);
+			l_genl_msg_unref(del_msg);
+			state->use_default = true;
+		} else
+			state->pending_cmd_count++;
+
+		l_free(wdev);
 	}
+}
 
-	l_debug("");
-	state->pending_cmd_count++;
+/*
+ * Start deleting the default interfaces of the next wiphy in the pipeline,
+ * unless another wiphy's DEL_INTERFACE commands are still in flight.
+ */
+static void manager_delete_next(void)
+{
+	struct wiphy_setup_state *state;
+
+	while (!deleting_wiphy &&
+			(state = l_queue_pop_head(delete_pipeline))) {
+		l_debug("Deleting default interfaces of wiphy %s",
+					wiphy_get_name(state->wiphy));
+
+		manager_send_del_interfaces(state);
+
+		if (state->pending_cmd_count) {
+			deleting_wiphy = state;
+			break;
+		}
+
+		/* Nothing could be sent, carry on with the setup right away */
+		if (manager_wiphy_check_setup_done(state))
+			wiphy_setup_state_destroy(state);
+	}
 }
 
 static bool manager_wiphy_state_match(const void *a, const void *b)
@@ -468,9 +610,9 @@ static void manager_del_wiphy_event(struct l_genl_msg *msg)
 
 	state = manager_find_pending(id);
 	if (state) {
-		if (state->pending_cmd_count)
-			state->aborted = true;
-		else
+		state->aborted = true;
+
+		if (!state->pending_cmd_count)
 			wiphy_setup_state_destroy(state);
 	}
 
@@ -499,8 +641,10 @@ static void manager_filtered_interface_dump_done(void *user_data)
 
 	l_debug("");
 
-	if (!manager_wiphy_check_setup_done(state))
+	if (!manager_wiphy_check_setup_done(state)) {
+		manager_delete_next();
 		return;
+	}
 
 	/* We decided to keep the the default interface(s) */
 	l_debug("Wiphy setup complete: %s", wiphy_get_name(state->wiphy));
@@ -514,6 +658,7 @@ static bool manager_check_create_interfaces(void *data, void *user_data)
 	if (!manager_wiphy_check_setup_done(state))
 		return false;
 
+	wiphy_setup_state_log_ready(state);
 	wiphy_setup_state_free(state);
 	return true;
 }
@@ -524,6 +669,8 @@ static void manager_interface_dump_done(void *user_data)
 
 	l_queue_foreach_remove(pending_wiphys,
 				manager_check_create_interfaces, NULL);
+
+	manager_delete_next();
 }
 
 /* We are dumping multiple wiphys for the very first time */
@@ -552,9 +699,7 @@ static void manager_wiphy_dump_callback(struct l_genl_msg *msg, void *user_data)
 	if (!wiphy || wiphy_is_blacklisted(wiphy))
 		return;
 
-	state = l_new(struct wiphy_setup_state, 1);
-	state->id = id;
-	state->wiphy = wiphy;
+	state = wiphy_setup_state_new(id, wiphy);
 
 	l_debug("New wiphy %s added (%d)", name, id);
 
@@ -716,9 +861,7 @@ static void manager_config_notify(struct l_genl_msg *msg, void *user_data)
 		if (!wiphy || wiphy_is_blacklisted(wiphy))
 			return;
 
-		state = l_new(struct wiphy_setup_state, 1);
-		state->id = wiphy_id;
-		state->wiphy = wiphy;
+		state = wiphy_setup_state_new(wiphy_id, wiphy);
 
 		if (manager_wiphy_filtered_dump(wiphy_id,
 					manager_wiphy_filtered_dump_callback,
@@ -755,6 +898,7 @@ static void manager_config_notify(struct l_genl_msg *msg, void *user_data)
 			if (manager_wiphy_check_setup_done(state))
 				wiphy_setup_state_destroy(state);
 
+			manager_delete_next();
 			return;
 		}
 
@@ -834,6 +978,8 @@ static int manager_init(void)
 		blacklist_filter = l_strsplit(if_blacklist, ',');
 
 	pending_wiphys = l_queue_new();
+	delete_pipeline = l_queue_new();
+	manager_start_time = l_time_now();
 
 	config_watch = l_genl_family_register(nl80211, "config",
 						manager_config_notify,
@@ -905,6 +1051,8 @@ static int manager_init(void)
 error:
 	l_queue_destroy(pending_wiphys, NULL);
 	pending_wiphys = NULL;
+	l_queue_destroy(delete_pipeline, NULL);
+	delete_pipeline = NULL;
 
 	l_genl_family_free(nl80211);
 	nl80211 = NULL;
@@ -921,6 +1069,9 @@ static void manager_exit(void)
 
 	l_queue_destroy(pending_wiphys, wiphy_setup_state_free);
 	pending_wiphys = NULL;
+	l_queue_destroy(delete_pipeline, NULL);
+	delete_pipeline = NULL;
+	deleting_wiphy = NULL;
 
 	l_genl_family_free(nl80211);
 	nl80211 = NULL;
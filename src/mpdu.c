@@ -354,23 +354,91 @@ static bool skip_resource_req_resp(struct ie_tlv_iter *iter)
 	return true;
 }
 
+/* Element IDs, including Element ID Extensions, fit into 512 bits */
+#define IE_TAG_BITMAP_WORDS	(512 / 64)
+
+static inline bool ie_tag_bitmap_test(const uint64_t *bitmap,
+					unsigned int tag)
+{
+	return bitmap[tag / 64] & (1ULL << (tag % 64));
+}
+
+static inline void ie_tag_bitmap_set(uint64_t *bitmap, unsigned int tag)
+{
+	bitmap[tag / 64] |= 1ULL << (tag % 64);
+}
+
+/*
+ * The set of elements valid in a given frame type.  The membership bitmap
+ * is filled from the element order list the first time the frame type is
+ * validated so that each element is looked up in constant time.
+ */
+struct mgmt_ie_set {
+	const enum ie_type *order;
+	unsigned int n_order;
+	bool initialized : 1;
+	uint64_t known[IE_TAG_BITMAP_WORDS];
+};
+
+#define MGMT_IE_SET(ie_order) \
+	{ .order = ie_order, .n_order = L_ARRAY_SIZE(ie_order) }
+
+static struct mgmt_ie_set association_request_ies =
+	MGMT_IE_SET(association_request_ie_order);
+static struct mgmt_ie_set association_response_ies =
+	MGMT_IE_SET(association_response_ie_order);
+static struct mgmt_ie_set reassociation_request_ies =
+	MGMT_IE_SET(reassociation_request_ie_order);
+static struct mgmt_ie_set reassociation_response_ies =
+	MGMT_IE_SET(reassociation_response_ie_order);
+static struct mgmt_ie_set probe_request_ies =
+	MGMT_IE_SET(probe_request_ie_order);
+
+static const uint64_t *mgmt_ie_set_get_known(struct mgmt_ie_set *set)
+{
+	unsigned int i;
+
+	if (set->initialized)
+		return set->known;
+
+	for (i = 0; i < set->n_order; i++)
+		ie_tag_bitmap_set(set->known, set->order[i]);
+
+	set->initialized = true;
+	return set->known;
+}
+
+static bool ie_allows_duplicates(enum ie_type tag)
+{
+	switch (tag) {
+	case IE_TYPE_VENDOR_SPECIFIC:
+	case IE_TYPE_RIC_DATA:
+	case IE_TYPE_TRANSMIT_POWER_ENVELOPE:
+	case IE_TYPE_MCCAOP_ADVERTISEMENT:
+	case IE_TYPE_EMERGENCY_ALERT_IDENTIFIER:
+	case IE_TYPE_MULTIPLE_BSSID:
+	case IE_TYPE_NEIGHBOR_REPORT:
+	case IE_TYPE_QUIET_CHANNEL:
+	case IE_TYPE_FILS_HLP_CONTAINER:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static bool validate_mgmt_ies(const uint8_t *ies, size_t ies_len,
-				const enum ie_type tag_order[], int tag_count)
+				struct mgmt_ie_set *set)
 {
+	const uint64_t *known = mgmt_ie_set_get_known(set);
+	uint64_t seen[IE_TAG_BITMAP_WORDS] = {};
 	struct ie_tlv_iter iter;
 	enum ie_type tag;
 
 	ie_tlv_iter_init(&iter, ies, ies_len);
 
 	while (ie_tlv_iter_next(&iter)) {
-		int i = 0;
-
 		tag = ie_tlv_iter_get_tag(&iter);
 
-		/* Check that the tag is part of the valid set */
-		while (i < tag_count && tag_order[i] != tag)
-			i += 1;
-
 		/*
 		 * 802.11-2016 section 9.3.3.2:
 		 * "All fields and elements are mandatory unless stated
@@ -381,31 +449,22 @@ static bool validate_mgmt_ies(const uint8_t *ies, size_t ies_len,
 		 * management frame body (if any) for additional elements
 		 * with recognizable element IDs."
 		 */
-		if (i == tag_count)
+		if (!ie_tag_bitmap_test(known, tag))
 			continue;
 
-		/* Tag found, make sure no duplicates present unless allowed */
-		if (tag != IE_TYPE_VENDOR_SPECIFIC &&
-				tag != IE_TYPE_RIC_DATA &&
-				tag != IE_TYPE_TRANSMIT_POWER_ENVELOPE &&
-				tag != IE_TYPE_MCCAOP_ADVERTISEMENT &&
-				tag != IE_TYPE_EMERGENCY_ALERT_IDENTIFIER &&
-				tag != IE_TYPE_MULTIPLE_BSSID &&
-				tag != IE_TYPE_NEIGHBOR_REPORT &&
-				tag != IE_TYPE_QUIET_CHANNEL &&
-				tag != IE_TYPE_FILS_HLP_CONTAINER) {
-			struct ie_tlv_iter clone;
-
-			memcpy(&clone, &iter, sizeof(clone));
-
-			while (ie_tlv_iter_next(&clone)) {
-				if (ie_tlv_iter_get_tag(&clone) != tag)
-					continue;
-
+		/* Make sure no duplicates are present unless allowed */
+		if (!ie_allows_duplicates(tag)) {
+			if (ie_tag_bitmap_test(seen, tag))
 				return false;
-			}
+
+			ie_tag_bitmap_set(seen, tag);
 		}
 
+		/*
+		 * None of the Resource Descriptor elements skipped here are
+		 * part of any element set, other than the Vendor Specific
+		 * element which may be repeated anyway.
+		 */
 		if (tag == IE_TYPE_RIC_DATA && !skip_resource_req_resp(&iter))
 			return false;
 	}
@@ -425,8 +484,7 @@ static bool validate_association_request_mmpdu(const struct mmpdu_header *mpdu,
 	*offset += sizeof(struct mmpdu_association_request);
 
 	return validate_mgmt_ies(body->ies, len - *offset,
-				association_request_ie_order,
-				L_ARRAY_SIZE(association_request_ie_order));
+					&association_request_ies);
 }
 
 static bool validate_association_response_mmpdu(const struct mmpdu_header *mpdu,
@@ -441,8 +499,7 @@ static bool validate_association_response_mmpdu(const struct mmpdu_header *mpdu,
 	*offset += sizeof(struct mmpdu_association_response);
 
 	return validate_mgmt_ies(body->ies, len - *offset,
-				association_response_ie_order,
-				L_ARRAY_SIZE(association_response_ie_order));
+					&association_response_ies);
 }
 
 static bool validate_reassociation_request_mmpdu(
@@ -458,8 +515,7 @@ static bool validate_reassociation_request_mmpdu(
 	*offset += sizeof(struct mmpdu_reassociation_request);
 
 	return validate_mgmt_ies(body->ies, len - *offset,
-				reassociation_request_ie_order,
-				L_ARRAY_SIZE(reassociation_request_ie_order));
+					&reassociation_request_ies);
 }
 
 static bool validate_reassociation_response_mmpdu(
@@ -475,8 +531,7 @@ static bool validate_reassociation_response_mmpdu(
 	*offset += sizeof(struct mmpdu_reassociation_response);
 
 	return validate_mgmt_ies(body->ies, len - *offset,
-				reassociation_response_ie_order,
-				L_ARRAY_SIZE(reassociation_response_ie_order));
+					&reassociation_response_ies);
 }
 
 static bool validate_probe_request_mmpdu(const struct mmpdu_header *mpdu,
@@ -490,8 +545,7 @@ static bool validate_probe_request_mmpdu(const struct mmpdu_header *mpdu,
 	*offset += sizeof(struct mmpdu_probe_request);
 
 	return validate_mgmt_ies(body->ies, len - *offset,
-				probe_request_ie_order,
-				L_ARRAY_SIZE(probe_request_ie_order));
+					&probe_request_ies);
 }
 
 /* 802.11-2016 section 9.3.3.11 */
@@ -528,14 +582,14 @@ static bool validate_timing_advertisement_mmpdu(const struct mmpdu_header *mpdu,
 		IE_TYPE_EXTENDED_CAPABILITIES,
 		IE_TYPE_VENDOR_SPECIFIC,
 	};
+	static struct mgmt_ie_set ies = MGMT_IE_SET(ie_order);
 
 	if (len < *offset + (int) sizeof(struct mmpdu_timing_advertisement))
 		return false;
 
 	*offset += sizeof(struct mmpdu_timing_advertisement);
 
-	return validate_mgmt_ies(body->ies, len - *offset, ie_order,
-					L_ARRAY_SIZE(ie_order));
+	return validate_mgmt_ies(body->ies, len - *offset, &ies);
 }
 
 /* 802.11-2020 section 9.3.3.2 */
@@ -619,14 +673,14 @@ static bool validate_beacon_mmpdu(const struct mmpdu_header *mpdu,
 		IE_TYPE_RSNX,
 		IE_TYPE_VENDOR_SPECIFIC,
 	};
+	static struct mgmt_ie_set ies = MGMT_IE_SET(ie_order);
 
 	if (len < *offset + (int) sizeof(struct mmpdu_beacon))
 		return false;
 
 	*offset += sizeof(struct mmpdu_beacon);
 
-	return validate_mgmt_ies(body->ies, len - *offset, ie_order,
-					L_ARRAY_SIZE(ie_order));
+	return validate_mgmt_ies(body->ies, len - *offset, &ies);
 }
 
 static bool validate_atim_mmpdu(const struct mmpdu_header *mpdu,
@@ -670,6 +724,11 @@ static bool validate_authentication_mmpdu(const struct mmpdu_header *mpdu,
 		IE_TYPE_FILS_SESSION,
 		IE_TYPE_FILS_WRAPPED_DATA,
 	};
+	static struct mgmt_ie_set shared_key_ies =
+					MGMT_IE_SET(ie_order_shared_key);
+	static struct mgmt_ie_set ft_ies = MGMT_IE_SET(ie_order_ft);
+	static struct mgmt_ie_set error_ies = MGMT_IE_SET(ie_order_error);
+	static struct mgmt_ie_set fils_ies = MGMT_IE_SET(ie_order_fils);
 
 	if (len < *offset + 6)
 		return false;
@@ -678,8 +737,7 @@ static bool validate_authentication_mmpdu(const struct mmpdu_header *mpdu,
 
 	if (L_LE16_TO_CPU(L_LE16_TO_CPU(body->status)) != 0)
 		return validate_mgmt_ies(body->ies, len - *offset,
-						ie_order_error,
-						L_ARRAY_SIZE(ie_order_error));
+						&error_ies);
 
 	switch (L_LE16_TO_CPU(body->algorithm)) {
 	case MMPDU_AUTH_ALGO_OPEN_SYSTEM:
@@ -692,18 +750,15 @@ static bool validate_authentication_mmpdu(const struct mmpdu_header *mpdu,
 			return *offset <= len;
 
 		return validate_mgmt_ies(body->ies, len - *offset,
-					ie_order_shared_key,
-					L_ARRAY_SIZE(ie_order_shared_key));
+						&shared_key_ies);
 	case MMPDU_AUTH_ALGO_FT:
-		return validate_mgmt_ies(body->ies, len - *offset, ie_order_ft,
-						L_ARRAY_SIZE(ie_order_ft));
+		return validate_mgmt_ies(body->ies, len - *offset, &ft_ies);
 	case MMPDU_AUTH_ALGO_SAE:
 		return *offset <= len;
 	case MMPDU_AUTH_ALGO_FILS_SK:
 	case MMPDU_AUTH_ALGO_FILS_SK_PFS:
 		return validate_mgmt_ies(body->ies, len - *offset,
-						ie_order_fils,
-						L_ARRAY_SIZE(ie_order_fils));
+						&fils_ies);
 	default:
 		return false;
 	}
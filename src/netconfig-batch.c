@@ -0,0 +1,237 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2022  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <ell/ell.h>
+
+#include "src/netconfig-batch.h"
+
+/*
+ * What was last sent to the kernel for a given l_rtnl_address or
+ * l_rtnl_route.  The structure is always zeroed before being filled in so
+ * that entries can be compared with memcmp.
+ */
+struct netconfig_batch_entry {
+	/* Fields identifying the address or route to the kernel */
+	struct {
+		uint8_t family;
+		uint8_t prefix_len;
+		uint32_t priority;
+		char addr[INET6_ADDRSTRLEN];
+	} key;
+	char gateway[INET6_ADDRSTRLEN];
+	char prefsrc[INET6_ADDRSTRLEN];
+	char broadcast[INET6_ADDRSTRLEN];
+	uint32_t mtu;
+	uint8_t preference;
+	uint64_t preferred_expiry;
+	uint64_t valid_expiry;
+};
+
+struct netconfig_batch {
+	/* l_rtnl_address / l_rtnl_route -> struct netconfig_batch_entry */
+	struct l_hashmap *addresses;
+	struct l_hashmap *routes;
+};
+
+typedef void (*netconfig_batch_fill_func_t)(const void *obj,
+					struct netconfig_batch_entry *entry);
+
+static void netconfig_batch_fill_address(const void *obj,
+					struct netconfig_batch_entry *entry)
+{
+	const struct l_rtnl_address *addr = obj;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->key.family = l_rtnl_address_get_family(addr);
+	entry->key.prefix_len = l_rtnl_address_get_prefix_length(addr);
+	l_rtnl_address_get_address(addr, entry->key.addr);
+	l_rtnl_address_get_broadcast(addr, entry->broadcast);
+	l_rtnl_address_get_expiry(addr, &entry->preferred_expiry,
+					&entry->valid_expiry);
+}
+
+static void netconfig_batch_fill_route(const void *obj,
+					struct netconfig_batch_entry *entry)
+{
+	const struct l_rtnl_route *rt = obj;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->key.family = l_rtnl_route_get_family(rt);
+	entry->key.priority = l_rtnl_route_get_priority(rt);
+	l_rtnl_route_get_dst(rt, entry->key.addr, &entry->key.prefix_len);
+	l_rtnl_route_get_gateway(rt, entry->gateway);
+	l_rtnl_route_get_prefsrc(rt, entry->prefsrc);
+	entry->mtu = l_rtnl_route_get_mtu(rt);
+	entry->preference = l_rtnl_route_get_preference(rt);
+	entry->valid_expiry = l_rtnl_route_get_expiry(rt);
+}
+
+struct netconfig_batch *netconfig_batch_new(void)
+{
+	struct netconfig_batch *batch = l_new(struct netconfig_batch, 1);
+
+	batch->addresses = l_hashmap_new();
+	batch->routes = l_hashmap_new();
+
+	return batch;
+}
+
+void netconfig_batch_free(struct netconfig_batch *batch)
+{
+	if (!batch)
+		return;
+
+	l_hashmap_destroy(batch->addresses, l_free);
+	l_hashmap_destroy(batch->routes, l_free);
+	l_free(batch);
+}
+
+static void netconfig_batch_store(struct l_hashmap *committed, const void *obj,
+				const struct netconfig_batch_entry *new)
+{
+	struct netconfig_batch_entry *entry = l_hashmap_lookup(committed, obj);
+
+	if (!entry) {
+		entry = l_new(struct netconfig_batch_entry, 1);
+		l_hashmap_insert(committed, obj, entry);
+	}
+
+	memcpy(entry, new, sizeof(*entry));
+}
+
+/*
+ * Works out the minimal set of deletes and adds/replaces for one l_netconfig
+ * change list.  Updates that leave everything the kernel sees unchanged are
+ * dropped and a removal followed by an add of the same address or route is
+ * folded into the add, which the RTNL helpers send with NLM_F_REPLACE.
+ */
+static void netconfig_batch_diff(struct l_hashmap *committed,
+				const struct netconfig_batch_changes *changes,
+				netconfig_batch_fill_func_t fill,
+				struct l_queue *dels, struct l_queue *adds,
+				struct netconfig_batch_stats *stats)
+{
+	const struct l_queue_entry *e;
+	const struct l_queue_entry *a;
+	struct netconfig_batch_entry new;
+	struct netconfig_batch_entry *entry;
+
+	/* The kernel drops expired addresses and routes by itself */
+	for (e = changes->expired; e; e = e->next)
+		l_free(l_hashmap_remove(committed, e->data));
+
+	for (e = changes->added; e; e = e->next) {
+		fill(e->data, &new);
+		netconfig_batch_store(committed, e->data, &new);
+		l_queue_push_tail(adds, e->data);
+	}
+
+	for (e = changes->removed; e; e = e->next) {
+		l_free(l_hashmap_remove(committed, e->data));
+		fill(e->data, &new);
+
+		for (a = changes->added; a; a = a->next) {
+			entry = l_hashmap_lookup(committed, a->data);
+
+			if (!memcmp(&entry->key, &new.key, sizeof(new.key)))
+				break;
+		}
+
+		if (a) {
+			stats->replaced++;
+			continue;
+		}
+
+		l_queue_push_tail(dels, e->data);
+	}
+
+	for (e = changes->updated; e; e = e->next) {
+		entry = l_hashmap_lookup(committed, e->data);
+		fill(e->data, &new);
+
+		if (entry && !memcmp(entry, &new, sizeof(new))) {
+			stats->skipped++;
+			continue;
+		}
+
+		netconfig_batch_store(committed, e->data, &new);
+		l_queue_push_tail(adds, e->data);
+	}
+}
+
+void netconfig_batch_commit(struct netconfig_batch *batch,
+				const struct netconfig_batch_changes *addrs,
+				const struct netconfig_batch_changes *routes,
+				const struct netconfig_batch_ops *ops,
+				void *user_data,
+				struct netconfig_batch_stats *out_stats)
+{
+	struct netconfig_batch_stats stats = {};
+	struct l_queue *addr_dels = l_queue_new();
+	struct l_queue *addr_adds = l_queue_new();
+	struct l_queue *route_dels = l_queue_new();
+	struct l_queue *route_adds = l_queue_new();
+	const struct l_queue_entry *e;
+
+	netconfig_batch_diff(batch->addresses, addrs,
+				netconfig_batch_fill_address,
+				addr_dels, addr_adds, &stats);
+	netconfig_batch_diff(batch->routes, routes,
+				netconfig_batch_fill_route,
+				route_dels, route_adds, &stats);
+
+	/*
+	 * Issue everything back to back.  Routes go away before the addresses
+	 * they may use as source and come back after them.
+	 */
+	for (e = l_queue_get_entries(route_dels); e; e = e->next)
+		ops->route(false, e->data, user_data);
+
+	for (e = l_queue_get_entries(addr_dels); e; e = e->next)
+		ops->address(false, e->data, user_data);
+
+	for (e = l_queue_get_entries(addr_adds); e; e = e->next)
+		ops->address(true, e->data, user_data);
+
+	for (e = l_queue_get_entries(route_adds); e; e = e->next)
+		ops->route(true, e->data, user_data);
+
+	stats.route_del = l_queue_length(route_dels);
+	stats.addr_del = l_queue_length(addr_dels);
+	stats.addr_add = l_queue_length(addr_adds);
+	stats.route_add = l_queue_length(route_adds);
+
+	l_queue_destroy(addr_dels, NULL);
+	l_queue_destroy(addr_adds, NULL);
+	l_queue_destroy(route_dels, NULL);
+	l_queue_destroy(route_adds, NULL);
+
+	if (out_stats)
+		*out_stats = stats;
+}
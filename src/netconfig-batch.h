@@ -0,0 +1,69 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2022  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct l_queue_entry;
+struct l_rtnl_address;
+struct l_rtnl_route;
+struct netconfig_batch;
+
+/* The change lists l_netconfig reports for one event */
+struct netconfig_batch_changes {
+	const struct l_queue_entry *added;
+	const struct l_queue_entry *updated;
+	const struct l_queue_entry *removed;
+	const struct l_queue_entry *expired;
+};
+
+/* Number of RTNL requests a single commit resulted in */
+struct netconfig_batch_stats {
+	unsigned int addr_del;
+	unsigned int addr_add;
+	unsigned int route_del;
+	unsigned int route_add;
+	/* Updates dropped because nothing the kernel sees has changed */
+	unsigned int skipped;
+	/* Removals folded into a following add of the same address/route */
+	unsigned int replaced;
+};
+
+struct netconfig_batch_ops {
+	void (*address)(bool add, const struct l_rtnl_address *addr,
+			void *user_data);
+	void (*route)(bool add, const struct l_rtnl_route *rt,
+			void *user_data);
+};
+
+static inline unsigned int netconfig_batch_stats_msgs(
+				const struct netconfig_batch_stats *stats)
+{
+	return stats->addr_del + stats->addr_add +
+		stats->route_del + stats->route_add;
+}
+
+struct netconfig_batch *netconfig_batch_new(void);
+void netconfig_batch_free(struct netconfig_batch *batch);
+void netconfig_batch_commit(struct netconfig_batch *batch,
+				const struct netconfig_batch_changes *addrs,
+				const struct netconfig_batch_changes *routes,
+				const struct netconfig_batch_ops *ops,
+				void *user_data,
+				struct netconfig_batch_stats *out_stats);
@@ -39,6 +39,7 @@
 #include "src/resolve.h"
 #include "src/dbus.h"
 #include "src/netconfig.h"
+#include "src/netconfig-batch.h"
 
 struct netconfig_commit_ops {
 	bool (*init_data)(struct netconfig *netconfig);
@@ -284,43 +285,116 @@ void netconfig_commit_fils_macs(struct netconfig *netconfig, uint8_t family)
 			family == AF_INET ? "AF_INET" : "AF_INET6");
 }
 
-static void netconfig_dns_list_update(struct netconfig *netconfig)
+static bool netconfig_dns_list_update(struct netconfig *netconfig)
 {
 	_auto_(l_strv_free) char **dns_list =
 		l_netconfig_get_dns_list(netconfig->nc);
+	bool updated = false;
 
 	if (l_strv_eq(netconfig->dns_list, dns_list))
-		return;
+		return false;
 
-	if (netconfig->resolve && dns_list)
+	if (netconfig->resolve && dns_list) {
 		resolve_set_dns(netconfig->resolve, dns_list);
+		updated = true;
+	}
 
 	l_strv_free(netconfig->dns_list);
 	netconfig->dns_list = l_steal_ptr(dns_list);
+	return updated;
 }
 
-static void netconfig_domains_update(struct netconfig *netconfig)
+static bool netconfig_domains_update(struct netconfig *netconfig)
 {
 	_auto_(l_strv_free) char **domains =
 		l_netconfig_get_domain_names(netconfig->nc);
+	bool updated = false;
 
 	if (l_strv_eq(netconfig->domains, domains))
-		return;
+		return false;
 
-	if (netconfig->resolve && domains)
+	if (netconfig->resolve && domains) {
 		resolve_set_domains(netconfig->resolve, domains);
+		updated = true;
+	}
 
 	l_strv_free(netconfig->domains);
 	netconfig->domains = l_steal_ptr(domains);
+	return updated;
+}
+
+static void netconfig_rtnl_batch_address(bool add,
+					const struct l_rtnl_address *addr,
+					void *user_data)
+{
+	struct netconfig *netconfig = user_data;
+	uint32_t ifindex = netdev_get_ifindex(netconfig->netdev);
+
+	/* l_rtnl_ifaddr_add uses NLM_F_REPLACE so it also covers updates */
+	if (add)
+		l_rtnl_ifaddr_add(rtnl, ifindex, addr, NULL, NULL, NULL);
+	else
+		l_rtnl_ifaddr_delete(rtnl, ifindex, addr, NULL, NULL, NULL);
+}
+
+static void netconfig_rtnl_batch_route(bool add, const struct l_rtnl_route *rt,
+					void *user_data)
+{
+	struct netconfig *netconfig = user_data;
+	uint32_t ifindex = netdev_get_ifindex(netconfig->netdev);
+
+	if (add)
+		l_rtnl_route_add(rtnl, ifindex, rt, NULL, NULL, NULL);
+	else
+		l_rtnl_route_delete(rtnl, ifindex, rt, NULL, NULL, NULL);
+}
+
+static const struct netconfig_batch_ops netconfig_rtnl_batch_ops = {
+	.address = netconfig_rtnl_batch_address,
+	.route   = netconfig_rtnl_batch_route,
+};
+
+/*
+ * Instead of l_netconfig_apply_rtnl(), which sends every entry on the change
+ * lists, diff against what was last sent and only issue what changed.
+ */
+static void netconfig_rtnl_apply(struct netconfig *netconfig)
+{
+	struct netconfig_batch_changes addrs;
+	struct netconfig_batch_changes routes;
+	struct netconfig_batch_stats stats;
+
+	if (!netconfig->commit_data)
+		netconfig->commit_data = netconfig_batch_new();
+
+	l_netconfig_get_addresses(netconfig->nc, &addrs.added, &addrs.updated,
+					&addrs.removed, &addrs.expired);
+	l_netconfig_get_routes(netconfig->nc, &routes.added, &routes.updated,
+					&routes.removed, &routes.expired);
+
+	netconfig_batch_commit(netconfig->commit_data, &addrs, &routes,
+				&netconfig_rtnl_batch_ops, netconfig, &stats);
+
+	l_debug("rtnl messages: %u (addresses -%u +%u, routes -%u +%u), "
+		"%u unchanged skipped, %u replaced",
+		netconfig_batch_stats_msgs(&stats),
+		stats.addr_del, stats.addr_add,
+		stats.route_del, stats.route_add,
+		stats.skipped, stats.replaced);
 }
 
 static void netconfig_rtnl_commit(struct netconfig *netconfig, uint8_t family,
 					enum l_netconfig_event event)
 {
-	l_netconfig_apply_rtnl(netconfig->nc);
+	unsigned int resolver_updates = 0;
+
+	netconfig_rtnl_apply(netconfig);
+
+	resolver_updates += netconfig_dns_list_update(netconfig);
+	resolver_updates += netconfig_domains_update(netconfig);
 
-	netconfig_dns_list_update(netconfig);
-	netconfig_domains_update(netconfig);
+	if (!resolver_updates)
+		l_debug("DNS and domains unchanged, resolver not updated");
 
 	if (event == L_NETCONFIG_EVENT_CONFIGURE && family == AF_INET)
 		/*
@@ -344,6 +418,7 @@ static void netconfig_rtnl_free_data(struct netconfig *netconfig,
 {
 	l_strv_free(l_steal_ptr(netconfig->dns_list));
 	l_strv_free(l_steal_ptr(netconfig->domains));
+	netconfig_batch_free(l_steal_ptr(netconfig->commit_data));
 }
 
 
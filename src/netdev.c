@@ -65,6 +65,7 @@
 #include "src/frame-xchg.h"
 #include "src/diagnostic.h"
 #include "src/band.h"
+#include "src/wowlan.h"
 
 #ifndef ENOTSUPP
 #define ENOTSUPP 524
@@ -192,6 +193,7 @@ struct netdev {
 	bool in_reassoc : 1;
 	bool privacy : 1;
 	bool cqm_poll_fallback : 1;
+	bool wowlan_armed : 1;
 };
 
 struct netdev_preauth_state {
@@ -857,6 +859,11 @@ static void netdev_connect_free(struct netdev *netdev)
 		netdev->group_handshake_timeout = NULL;
 	}
 
+	if (netdev->wowlan_armed) {
+		wiphy_set_wowlan(netdev->wiphy, netdev, 0, NULL);
+		netdev->wowlan_armed = false;
+	}
+
 	netdev->associated = false;
 	netdev->operational = false;
 	netdev->connected = false;
@@ -1396,6 +1403,26 @@ static void netdev_operstate_cb(int error, uint16_t type,
 							strerror(-error));
 }
 
+/*
+ * Keep the connection alive across suspend.  The host is only woken if the
+ * link is lost, or if the offloaded group rekey fails and the connection
+ * would be unusable on resume.
+ */
+static void netdev_wowlan_arm(struct netdev *netdev)
+{
+	uint32_t triggers = WOWLAN_TRIGGER_DISCONNECT;
+
+	if (netdev->type != NL80211_IFTYPE_STATION)
+		return;
+
+	if (netdev->sm && netdev->rekey_offload_support &&
+			wiphy_supports_rekey_offload(netdev->wiphy))
+		triggers |= WOWLAN_TRIGGER_GTK_REKEY_FAILURE;
+
+	wiphy_set_wowlan(netdev->wiphy, netdev, triggers, NULL);
+	netdev->wowlan_armed = true;
+}
+
 static void netdev_connect_ok(struct netdev *netdev)
 {
 	l_debug("");
@@ -1425,6 +1452,7 @@ static void netdev_connect_ok(struct netdev *netdev)
 		l_warn("Connection event without a connect callback!");
 
 	netdev_rssi_polling_update(netdev);
+	netdev_wowlan_arm(netdev);
 
 	if (netdev->work.id)
 		wiphy_radio_work_done(netdev->wiphy, netdev->work.id);
@@ -2234,8 +2262,8 @@ static void hardware_rekey_cb(struct l_genl_msg *msg, void *data)
 		}
 
 		/*
-		 * TODO: Ignore all other errors for now, until WoWLAN is
-		 * supported properly
+		 * Other errors are not fatal, the GTK rekey will then wake
+		 * the host up as usual.
 		 */
 	}
 }
@@ -5165,6 +5193,69 @@ static void netdev_michael_mic_failure(struct l_genl_msg *msg,
 	l_debug("ifindex=%u key_idx=%u type=%u", netdev->index, idx, type);
 }
 
+static void netdev_wowlan_link_cb(const struct diagnostic_station_info *info,
+					void *user_data)
+{
+	struct netdev *netdev = user_data;
+
+	if (info) {
+		l_debug("Connection survived suspend");
+		return;
+	}
+
+	if (!netdev->connected || netdev->disconnect_cmd_id)
+		return;
+
+	l_info("Connection lost during suspend, disconnecting");
+	netdev_disconnect_by_sme(netdev, NETDEV_RESULT_DISCONNECTED,
+					MMPDU_REASON_CODE_UNSPECIFIED);
+}
+
+/*
+ * The kernel reports the reason for a wakeup once the system has resumed.
+ * Avoid rescanning and reconnecting when the connection is still intact,
+ * only verify that the AP still knows about us.
+ */
+static void netdev_wowlan_wakeup_event(struct l_genl_msg *msg,
+					struct netdev *netdev)
+{
+	_auto_(scan_freq_set_free) struct scan_freq_set *nd_freqs =
+							scan_freq_set_new();
+	uint32_t reasons = wowlan_parse_wakeup(msg, nd_freqs);
+
+	l_debug("Wakeup reasons: 0x%x", reasons);
+
+	if (netdev->type != NL80211_IFTYPE_STATION)
+		return;
+
+	if (!netdev->connected) {
+		if (reasons & WOWLAN_TRIGGER_NET_DETECT)
+			scan_periodic_resume(netdev->wdev_id, nd_freqs);
+
+		return;
+	}
+
+	if (!netdev->operational || netdev->disconnect_cmd_id)
+		return;
+
+	/* A DISCONNECT event is reported separately */
+	if (reasons & WOWLAN_TRIGGER_DISCONNECT)
+		return;
+
+	/* Our group key is stale, the AP would not talk to us anymore */
+	if (reasons & (WOWLAN_TRIGGER_GTK_REKEY_FAILURE |
+			WOWLAN_TRIGGER_4WAY_HANDSHAKE)) {
+		l_info("Group rekey failed during suspend, disconnecting");
+		netdev_disconnect_by_sme(netdev, NETDEV_RESULT_DISCONNECTED,
+					MMPDU_REASON_CODE_UNSPECIFIED);
+		return;
+	}
+
+	if (netdev_get_current_station(netdev, netdev_wowlan_link_cb,
+					netdev, NULL) < 0)
+		l_debug("Unable to verify the connection after resume");
+}
+
 static void netdev_mlme_notify(struct l_genl_msg *msg, void *user_data)
 {
 	struct netdev *netdev = NULL;
@@ -5205,6 +5296,9 @@ static void netdev_mlme_notify(struct l_genl_msg *msg, void *user_data)
 	case NL80211_CMD_SET_REKEY_OFFLOAD:
 		netdev_rekey_offload_event(msg, netdev);
 		break;
+	case NL80211_CMD_SET_WOWLAN:
+		netdev_wowlan_wakeup_event(msg, netdev);
+		break;
 	case NL80211_CMD_UNPROT_DEAUTHENTICATE:
 	case NL80211_CMD_UNPROT_DISASSOCIATE:
 		netdev_unprot_disconnect_event(msg, netdev);
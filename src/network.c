@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <limits.h>
 #include <alloca.h>
+#include <time.h>
 #include <linux/if_ether.h>
 
 #include <ell/ell.h>
@@ -56,6 +57,7 @@
 #include "src/erp.h"
 #include "src/handshake.h"
 #include "src/band.h"
+#include "src/topology.h"
 
 #define SAE_PT_SETTING "SAE-PT-Group%u"
 
@@ -874,6 +876,14 @@ int network_can_connect_bss(struct network *network, const struct scan_bss *bss)
 		return -ENOSYS;
 	}
 
+	/*
+	 * Expanded from another BSS's Multiple BSSID element without the
+	 * kernel reporting it, so cfg80211 has no entry for it and
+	 * CMD_AUTHENTICATE or CMD_CONNECT would fail with -ENOENT
+	 */
+	if (bss->mbssid_expanded)
+		return -ENOENT;
+
 	if (!band_freq_to_channel(bss->frequency, &band))
 		return -ENOTSUP;
 
@@ -1079,6 +1089,8 @@ static bool hotspot_info_matches(struct network *network,
 		return false;
 
 	bss = network_bss_select(network, true);
+	if (!bss)
+		return false;
 
 	if (network_info_match_hessid(info, bss->hessid))
 		return true;
@@ -1104,6 +1116,24 @@ static bool match_hotspot_network(const struct network_info *info,
 	return true;
 }
 
+/*
+ * Returns the ESS topology of a known network, NULL if the network is not
+ * known.
+ */
+struct topology *network_get_topology(struct network *network)
+{
+	if (!network->info)
+		return NULL;
+
+	return known_network_get_topology(network->info);
+}
+
+void network_topology_sync(struct network *network)
+{
+	if (network->info)
+		known_network_topology_sync(network->info);
+}
+
 bool network_update_known_frequencies(struct network *network)
 {
 	const struct l_queue_entry *e;
@@ -1154,6 +1184,16 @@ void network_bss_list_clear(struct network *network)
 	network->bss_list = l_queue_new();
 }
 
+static void network_topology_bss_seen(struct network *network,
+					const struct scan_bss *bss)
+{
+	int mdid = bss->mde_present ? l_get_le16(bss->mde) : TOPOLOGY_NO_MD;
+
+	topology_bss_seen(known_network_get_topology(network->info),
+				bss->addr, bss->frequency, mdid,
+				bss->signal_strength, time(NULL));
+}
+
 bool network_bss_add(struct network *network, struct scan_bss *bss)
 {
 	if (!l_queue_insert(network->bss_list, bss, scan_bss_rank_compare,
@@ -1165,6 +1205,9 @@ bool network_bss_add(struct network *network, struct scan_bss *bss)
 				IWD_NETWORK_INTERFACE, "ExtendedServiceSet");
 #endif
 
+	if (network->info)
+		network_topology_bss_seen(network, bss);
+
 	/* Done if BSS is not HS20 or we already have network_info set */
 	if (!bss->hs20_capable)
 		return true;
@@ -1202,11 +1245,36 @@ bool network_bss_update(struct network *network, struct scan_bss *bss)
 	if (network->info) {
 		known_network_add_frequency(network->info, bss->frequency);
 		known_network_frequency_sync(network->info);
+		network_topology_bss_seen(network, bss);
 	}
 
 	return true;
 }
 
+/*
+ * Lowers the rank of each BSS by the age of its reading and re-sorts the
+ * list.  'skip', if any, keeps its rank.
+ */
+void network_bss_list_age_ranks(struct network *network,
+					const struct scan_bss *skip,
+					uint64_t now)
+{
+	struct l_queue *old = network->bss_list;
+	struct scan_bss *bss;
+
+	network->bss_list = l_queue_new();
+
+	while ((bss = l_queue_pop_head(old))) {
+		if (bss != skip)
+			scan_bss_age_rank(bss, now);
+
+		l_queue_insert(network->bss_list, bss, scan_bss_rank_compare,
+				NULL);
+	}
+
+	l_queue_destroy(old, NULL);
+}
+
 bool network_bss_list_isempty(struct network *network)
 {
 	return l_queue_isempty(network->bss_list);
@@ -2232,10 +2300,28 @@ static bool network_bss_property_get_address(struct l_dbus *dbus,
 	return true;
 }
 
+static bool network_bss_property_get_age(struct l_dbus *dbus,
+					struct l_dbus_message *message,
+					struct l_dbus_message_builder *builder,
+					void *user_data)
+{
+	struct scan_bss *bss = user_data;
+	uint64_t now = l_time_now();
+	uint32_t age = 0;
+
+	if (l_time_after(now, bss->time_stamp))
+		age = l_time_diff(bss->time_stamp, now) / L_USEC_PER_SEC;
+
+	l_dbus_message_builder_append_basic(builder, 'u', &age);
+	return true;
+}
+
 static void setup_bss_interface(struct l_dbus_interface *interface)
 {
 	l_dbus_interface_property(interface, "Address", 0, "s",
 					network_bss_property_get_address, NULL);
+	l_dbus_interface_property(interface, "Age", 0, "u",
+					network_bss_property_get_age, NULL);
 }
 
 static int network_init(void)
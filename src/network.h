@@ -31,6 +31,7 @@ struct scan_bss;
 struct handshake_state;
 struct erp_cache_entry;
 struct scan_freq_set;
+struct topology;
 
 void network_connected(struct network *network);
 void network_disconnected(struct network *network);
@@ -63,6 +64,8 @@ void network_set_force_default_ecc_group(struct network *network);
 bool network_get_force_default_ecc_group(struct network *network);
 
 bool network_update_known_frequencies(struct network *network);
+struct topology *network_get_topology(struct network *network);
+void network_topology_sync(struct network *network);
 
 int network_can_connect_bss(struct network *network,
 						const struct scan_bss *bss);
@@ -71,6 +74,9 @@ void network_connect_failed(struct network *network, bool in_handshake);
 void network_bss_list_clear(struct network *network);
 bool network_bss_add(struct network *network, struct scan_bss *bss);
 bool network_bss_update(struct network *network, struct scan_bss *bss);
+void network_bss_list_age_ranks(struct network *network,
+					const struct scan_bss *skip,
+					uint64_t now);
 const char *network_bss_get_path(const struct network *network,
 						const struct scan_bss *bss);
 bool network_bss_list_isempty(struct network *network);
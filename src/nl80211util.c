@@ -540,15 +540,20 @@ struct l_genl_msg *nl80211_build_set_station_authorized(uint32_t ifindex,
 }
 
 struct l_genl_msg *nl80211_build_set_station_associated(uint32_t ifindex,
-							const uint8_t *addr)
+							const uint8_t *addr,
+							bool mfp)
 {
 	struct nl80211_sta_flag_update flags = {
 		.mask = (1 << NL80211_STA_FLAG_AUTHENTICATED) |
-			(1 << NL80211_STA_FLAG_ASSOCIATED),
+			(1 << NL80211_STA_FLAG_ASSOCIATED) |
+			(1 << NL80211_STA_FLAG_MFP),
 		.set = (1 << NL80211_STA_FLAG_AUTHENTICATED) |
 			(1 << NL80211_STA_FLAG_ASSOCIATED),
 	};
 
+	if (mfp)
+		flags.set |= 1 << NL80211_STA_FLAG_MFP;
+
 	return nl80211_build_set_station(ifindex, addr, &flags);
 }
 
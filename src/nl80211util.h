@@ -68,7 +68,8 @@ struct l_genl_msg *nl80211_build_set_station_authorized(uint32_t ifindex,
 							const uint8_t *addr);
 
 struct l_genl_msg *nl80211_build_set_station_associated(uint32_t ifindex,
-							const uint8_t *addr);
+							const uint8_t *addr,
+							bool mfp);
 
 struct l_genl_msg *nl80211_build_set_station_unauthorized(uint32_t ifindex,
 							const uint8_t *addr);
@@ -81,6 +81,11 @@ struct sae_sm {
 	uint8_t pmkid[16];
 	uint8_t *token;
 	size_t token_len;
+	/* anti-clogging token the peer must present (authenticator only) */
+	uint8_t *required_token;
+	size_t required_token_len;
+	/* length of the looping mode token in the peer's Commit */
+	size_t peer_token_len;
 	/* number of state resyncs that have occurred */
 	uint16_t sync;
 	/* number of SAE confirm messages that have been sent */
@@ -620,7 +625,12 @@ old_commit:
 
 	ie_tlv_builder_init(&builder, ptr, len - (ptr - commit));
 
-	if (sm->sae_type != CRYPTO_SAE_LOOPING && sm->rejected_groups) {
+	/*
+	 * As the responder the rejected groups are the peer's, which are only
+	 * tracked for the KDF salt and never echoed back
+	 */
+	if (sm->sae_type != CRYPTO_SAE_LOOPING && sm->rejected_groups &&
+			!sm->handshake->authenticator) {
 		ie_tlv_builder_next(&builder, IE_TYPE_REJECTED_GROUPS);
 		ie_tlv_builder_set_data(&builder, sm->rejected_groups + 1,
 				sm->rejected_groups[0] * sizeof(uint16_t));
@@ -795,6 +805,13 @@ static int sae_process_commit(struct sae_sm *sm, const uint8_t *from,
 
 	ptr += 2;
 
+	/*
+	 * As the responder any looping mode Anti-Clogging Token sits between
+	 * the group and the scalar, its presence was checked in Nothing state
+	 */
+	if (sm->handshake->authenticator && sm->sae_type == CRYPTO_SAE_LOOPING)
+		ptr += sm->peer_token_len;
+
 	sm->p_scalar = l_ecc_scalar_new(sm->curve, ptr, nbytes);
 	if (!sm->p_scalar) {
 		l_error("Server sent invalid P_Scalar during commit");
@@ -882,13 +899,11 @@ static int sae_process_confirm(struct sae_sm *sm, const uint8_t *from,
 
 	sm->state = SAE_STATE_ACCEPTED;
 
+	/* As the responder our Confirm was sent along with our Commit */
 	if (!sm->handshake->authenticator) {
 		sae_debug("Sending Associate to "
 				MAC, MAC_STR(sm->handshake->aa));
 		sm->tx_assoc(sm->user_data);
-	} else {
-		if (!sae_send_confirm(sm))
-			return -EPROTO;
 	}
 
 	return 0;
@@ -1000,31 +1015,212 @@ static int sae_process_anti_clogging(struct sae_sm *sm, const uint8_t *ptr,
 }
 
 /*
- * 802.11-2016 - 12.4.8.6.3 Protocol instance behavior - Nothing state
+ * Index of a group we are willing to use as the responder, with the SAE type
+ * chosen by the peer's Commit, or -ENOENT
+ */
+static int sae_responder_group(struct sae_sm *sm, unsigned int group)
+{
+	const unsigned int *ecc_groups = l_ecc_supported_ike_groups();
+	unsigned int i;
+
+	if (sm->force_default_group && group != 19)
+		return -ENOENT;
+
+	for (i = 0; ecc_groups[i]; i++) {
+		if (ecc_groups[i] != group)
+			continue;
+
+		if (sm->sae_type != CRYPTO_SAE_LOOPING &&
+				!sm->handshake->ecc_sae_pts[i])
+			return -ENOENT;
+
+		return i;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * 802.11-2020 - 12.4.6 Anti-clogging tokens
+ *
+ * Reply to a Commit with ANTI_CLOGGING_TOKEN_REQUIRED, carrying the token the
+ * peer must echo.  No state is kept and no ECC operations are performed.
+ */
+static int sae_request_token(struct sae_sm *sm, uint16_t group)
+{
+	uint8_t body[6 + 3 + 256];
+	uint8_t *ptr = body;
+
+	l_put_le16(SAE_STATE_COMMITTED, ptr);
+	ptr += 2;
+	l_put_le16(MMPDU_STATUS_CODE_ANTI_CLOGGING_TOKEN_REQ, ptr);
+	ptr += 2;
+	l_put_le16(group, ptr);
+	ptr += 2;
+
+	if (sm->sae_type != CRYPTO_SAE_LOOPING) {
+		*ptr++ = IE_TYPE_EXTENSION;
+		*ptr++ = sm->required_token_len + 1;
+		*ptr++ = IE_TYPE_ANTI_CLOGGING_TOKEN_CONTAINER - 256;
+	}
+
+	memcpy(ptr, sm->required_token, sm->required_token_len);
+	ptr += sm->required_token_len;
+
+	sae_debug("Requesting anti-clogging token from "MAC,
+			MAC_STR(sm->peer));
+
+	sm->tx_auth(body, ptr - body, sm->user_data);
+
+	return -EAGAIN;
+}
+
+/*
+ * 802.11-2020 - 12.4.8.6.3 Protocol instance behavior - Nothing state
+ *
+ * Only the responder (authenticator) ever receives frames in Nothing state.
+ * The peer's Commit is validated up front, so that nothing expensive is done
+ * for a Commit which is then rejected or answered with a token request.  On
+ * success our own Commit is sent and the peer's is processed as usual.
  */
 static int sae_verify_nothing(struct sae_sm *sm, uint16_t transaction,
 					uint16_t status, const uint8_t *frame,
 					size_t len)
 {
-	/*
-	 * TODO: This does not handle the transition from NOTHING -> CONFIRMED
-	 * as this is only relevant to the AP or in Mesh mode which is not
-	 * yet supported.
-	 */
+	const struct l_ecc_curve *curve;
+	const uint8_t *token = NULL;
+	size_t token_len = 0;
+	struct ie_tlv_iter iter;
+	unsigned int nbytes;
+	unsigned int group;
+	size_t offset;
+	int i;
+
+	if (!sm->handshake->authenticator)
+		return -EBADMSG;
+
+	/* A Confirm (or anything else) in Nothing state is discarded */
 	if (transaction != SAE_STATE_COMMITTED)
 		return -EBADMSG;
 
-	/* frame shall be silently discarded and Del event sent */
-	if (status != 0)
+	switch (status) {
+	case MMPDU_STATUS_CODE_SUCCESS:
+		sm->sae_type = CRYPTO_SAE_LOOPING;
+		break;
+	case MMPDU_STATUS_CODE_SAE_HASH_TO_ELEMENT:
+		if (!sm->handshake->ecc_sae_pts)
+			return -EBADMSG;
+
+		sm->sae_type = CRYPTO_SAE_HASH_TO_ELEMENT;
+		break;
+	default:
 		return -EBADMSG;
+	}
 
 	if (len < 2)
 		return -EBADMSG;
 
+	memcpy(sm->peer, sm->handshake->spa, 6);
+	group = l_get_le16(frame);
+
+	i = sae_responder_group(sm, group);
+
 	/* reject with unsupported group */
-	if (l_get_le16(frame) != sm->group)
+	if (i < 0) {
+		sm->group = group;
 		return sae_reject(sm, SAE_STATE_COMMITTED,
 				MMPDU_STATUS_CODE_UNSUPP_FINITE_CYCLIC_GROUP);
+	}
+
+	curve = l_ecc_curve_from_ike_group(group);
+	nbytes = l_ecc_curve_get_scalar_bytes(curve);
+
+	if (len < 2 + nbytes * 3)
+		return -EBADMSG;
+
+	offset = 2 + nbytes * 3;
+
+	/*
+	 * A looping mode token has no length field, it just sits between the
+	 * group and the scalar.  Only the token we asked for is valid, so use
+	 * its length.  Anything following the element is parsed as elements.
+	 */
+	if (sm->sae_type == CRYPTO_SAE_LOOPING) {
+		if (sm->required_token &&
+				len >= offset + sm->required_token_len) {
+			token = frame + 2;
+			token_len = sm->required_token_len;
+		}
+
+		sm->peer_token_len = token_len;
+		offset += token_len;
+	}
+
+	ie_tlv_iter_init(&iter, frame + offset, len - offset);
+
+	while (ie_tlv_iter_next(&iter)) {
+		const uint8_t *data = ie_tlv_iter_get_data(&iter);
+		size_t data_len = ie_tlv_iter_get_length(&iter);
+		size_t j;
+
+		switch (ie_tlv_iter_get_tag(&iter)) {
+		/*
+		 * "... the list of rejected groups shall be checked to ensure
+		 * that all of the groups in the list are groups that would be
+		 * rejected. If any groups in the list would not be rejected
+		 * then processing of the SAE Commit message terminates and the
+		 * STA shall reject the peer's authentication."
+		 */
+		case IE_TYPE_REJECTED_GROUPS:
+			if (sm->sae_type == CRYPTO_SAE_LOOPING)
+				break;
+
+			if (!data_len || data_len % 2)
+				return -EBADMSG;
+
+			for (j = 0; j < data_len; j += 2) {
+				if (sae_responder_group(sm,
+						l_get_le16(data + j)) >= 0) {
+					l_error("SAE: Peer rejected a group we "
+						"support -- Reject");
+					return sae_reject(sm,
+						SAE_STATE_COMMITTED,
+						MMPDU_STATUS_CODE_UNSPECIFIED);
+				}
+
+				sae_rejected_groups_append(sm,
+							l_get_le16(data + j));
+			}
+
+			break;
+		case IE_TYPE_ANTI_CLOGGING_TOKEN_CONTAINER:
+			if (sm->sae_type == CRYPTO_SAE_LOOPING)
+				break;
+
+			token = data;
+			token_len = data_len;
+			break;
+		case IE_TYPE_PASSWORD_IDENTIFIER:
+			return sae_reject(sm, SAE_STATE_COMMITTED,
+				MMPDU_STATUS_CODE_UNKNOWN_PASSWORD_IDENTIFIER);
+		}
+	}
+
+	if (sm->required_token && (token_len != sm->required_token_len ||
+			l_secure_memcmp(token, sm->required_token, token_len)))
+		return sae_request_token(sm, group);
+
+	sm->group = group;
+	sm->group_retry = i;
+	sm->curve = curve;
+
+	sae_debug("Responding to Commit from "MAC" using group %u",
+			MAC_STR(sm->peer), sm->group);
+
+	sm->state = SAE_STATE_COMMITTED;
+
+	if (!sae_send_commit(sm, false))
+		return -EPROTO;
 
 	return 0;
 }
@@ -1493,6 +1689,19 @@ bool sae_sm_is_h2e(struct auth_proto *ap)
 	return sm->sae_type != CRYPTO_SAE_LOOPING;
 }
 
+void sae_sm_require_token(struct auth_proto *ap, const uint8_t *token,
+				size_t len)
+{
+	struct sae_sm *sm = l_container_of(ap, struct sae_sm, ap);
+
+	if (!sm->handshake->authenticator || !len || len > 256)
+		return;
+
+	l_free(sm->required_token);
+	sm->required_token = l_memdup(token, len);
+	sm->required_token_len = len;
+}
+
 static void sae_free(struct auth_proto *ap)
 {
 	struct sae_sm *sm = l_container_of(ap, struct sae_sm, ap);
@@ -1502,6 +1711,9 @@ static void sae_free(struct auth_proto *ap)
 	l_free(sm->token);
 	sm->token = NULL;
 
+	l_free(sm->required_token);
+	sm->required_token = NULL;
+
 	if (sm->rejected_groups)
 		free(sm->rejected_groups);
 
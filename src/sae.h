@@ -29,6 +29,8 @@ typedef void (*sae_tx_authenticate_func_t)(const uint8_t *data, size_t len,
 typedef void (*sae_tx_associate_func_t)(void *user_data);
 
 bool sae_sm_is_h2e(struct auth_proto *ap);
+void sae_sm_require_token(struct auth_proto *ap, const uint8_t *token,
+				size_t len);
 
 struct auth_proto *sae_sm_new(struct handshake_state *hs,
 				sae_tx_authenticate_func_t tx_auth,
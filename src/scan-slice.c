@@ -0,0 +1,157 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "ell/useful.h"
+#include "src/util.h"
+#include "src/band.h"
+#include "src/scan.h"
+#include "src/scan-slice.h"
+
+/*
+ * While connected every channel scanned is time spent away from the
+ * operating channel.  Rather than leaving for the whole frequency set at
+ * once, a connected scan is cut into slices of a few channels which are
+ * scanned one at a time, returning to the operating channel in between.
+ * Slices never span bands so that each keeps a uniform dwell time.
+ */
+
+struct scan_slice {
+	struct scan_freq_set **chunks;
+	unsigned int n_chunks;
+};
+
+struct scan_slice *scan_slice_new(const struct scan_freq_set *freqs,
+					unsigned int max_freqs)
+{
+	struct scan_slice *slice;
+	_auto_(l_free) uint32_t *list = NULL;
+	struct scan_freq_set *chunk = NULL;
+	enum band_freq last_band = 0;
+	unsigned int in_chunk = 0;
+	size_t len = 0;
+	size_t i;
+
+	if (!max_freqs)
+		return NULL;
+
+	list = scan_freq_set_to_fixed_array(freqs, &len);
+	if (!list)
+		return NULL;
+
+	slice = l_new(struct scan_slice, 1);
+	/* Every chunk holds at least one frequency */
+	slice->chunks = l_new(struct scan_freq_set *, len);
+
+	for (i = 0; i < len; i++) {
+		enum band_freq band;
+
+		if (!band_freq_to_channel(list[i], &band))
+			continue;
+
+		if (!chunk || in_chunk == max_freqs || band != last_band) {
+			chunk = scan_freq_set_new();
+			slice->chunks[slice->n_chunks++] = chunk;
+			in_chunk = 0;
+			last_band = band;
+		}
+
+		scan_freq_set_add(chunk, list[i]);
+		in_chunk++;
+	}
+
+	if (!slice->n_chunks) {
+		scan_slice_free(slice);
+		return NULL;
+	}
+
+	return slice;
+}
+
+void scan_slice_free(struct scan_slice *slice)
+{
+	unsigned int i;
+
+	if (!slice)
+		return;
+
+	for (i = 0; i < slice->n_chunks; i++)
+		scan_freq_set_free(slice->chunks[i]);
+
+	l_free(slice->chunks);
+	l_free(slice);
+}
+
+unsigned int scan_slice_get_count(const struct scan_slice *slice)
+{
+	return slice ? slice->n_chunks : 0;
+}
+
+const struct scan_freq_set *scan_slice_get(const struct scan_slice *slice,
+						unsigned int idx)
+{
+	if (!slice || idx >= slice->n_chunks)
+		return NULL;
+
+	return slice->chunks[idx];
+}
+
+static bool scan_slice_bss_match(const void *a, const void *b)
+{
+	return scan_bss_addr_eq(a, b);
+}
+
+/*
+ * Moves the entries of 'from' into 'to', keeping 'to' ordered by 'compare'.
+ * A BSS heard on more than one slice, e.g. through adjacent channel leakage
+ * on 2.4 GHz, is only kept once using the most recent observation.
+ */
+void scan_slice_merge_bss(struct l_queue *to, struct l_queue *from,
+				l_queue_compare_func_t compare,
+				l_queue_destroy_func_t destroy)
+{
+	struct scan_bss *bss;
+
+	while ((bss = l_queue_pop_head(from))) {
+		struct scan_bss *old = l_queue_find(to, scan_slice_bss_match,
+							bss);
+
+		if (old) {
+			if (old->time_stamp > bss->time_stamp) {
+				destroy(bss);
+				continue;
+			}
+
+			l_queue_remove(to, old);
+			destroy(old);
+		}
+
+		l_queue_insert(to, bss, compare, NULL);
+	}
+}
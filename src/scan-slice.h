@@ -0,0 +1,36 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct l_queue;
+struct scan_freq_set;
+struct scan_slice;
+
+struct scan_slice *scan_slice_new(const struct scan_freq_set *freqs,
+					unsigned int max_freqs);
+void scan_slice_free(struct scan_slice *slice);
+unsigned int scan_slice_get_count(const struct scan_slice *slice);
+const struct scan_freq_set *scan_slice_get(const struct scan_slice *slice,
+						unsigned int idx);
+
+void scan_slice_merge_bss(struct l_queue *to, struct l_queue *from,
+				l_queue_compare_func_t compare,
+				l_queue_destroy_func_t destroy);
@@ -50,6 +50,11 @@
 #include "src/p2putil.h"
 #include "src/mpdu.h"
 #include "src/band.h"
+#include "src/sched-scan.h"
+#include "src/scan-slice.h"
+#include "src/channel-stats.h"
+#include "src/wowlan.h"
+#include "src/blacklist.h"
 #include "src/scan.h"
 
 /* User configurable options */
@@ -58,8 +63,19 @@ static double RANK_5G_FACTOR;
 static double RANK_6G_FACTOR;
 static uint32_t SCAN_MAX_INTERVAL;
 static uint32_t SCAN_INIT_INTERVAL;
+static bool SCAN_SCHED_DISABLED;
+static int SCAN_SCHED_RSSI_THRESHOLD;
+static uint32_t SCAN_SLICE_MAX_FREQS;
+static uint32_t SCAN_SLICE_GAP;
+static uint64_t SCAN_FULL_SWEEP_INTERVAL;
+
+/* Empty scans in a row after which periodic scans leave a channel out */
+#define SCAN_QUIET_CHANNEL_SCANS 8
+
+#define SCAN_BSS_RANK_AGE_SPAN (60 * L_USEC_PER_SEC)
 
 static struct l_queue *scan_contexts;
+static uint32_t known_networks_watch;
 
 static struct l_genl_family *nl80211;
 
@@ -72,7 +88,13 @@ struct scan_periodic {
 	scan_notify_func_t callback;
 	void *userdata;
 	uint32_t id;
+	/* Non-zero if START_SCHED_SCAN is still running */
+	uint32_t sched_scan_cmd_id;
+	/* When the last periodic scan covering every channel was queued */
+	uint64_t last_full_sweep;
 	bool needs_active_scan:1;
+	/* A scheduled scan is programmed in place of the periodic timer */
+	bool sched_scan:1;
 };
 
 struct scan_request {
@@ -97,6 +119,8 @@ struct scan_request {
 	bool in_callback : 1; /* Scan request complete, re-entrancy guard */
 	/* The request was split anticipating 6GHz will become available */
 	bool split : 1;
+	/* The request was built from the wiphy's scan plan */
+	bool planned : 1;
 	struct l_queue *cmds;
 	/* The time the current scan was started. Reported in TRIGGER_SCAN */
 	uint64_t start_time_tsf;
@@ -134,6 +158,12 @@ struct scan_context {
 	struct wiphy *wiphy;
 
 	unsigned int get_survey_cmd_id;
+	/* Regulatory aware scan plan, rebuilt on every regdom change */
+	struct scan_freq_plan *plan;
+	/* Connected scans being run one slice at a time */
+	struct l_queue *sliced;
+	/* What past scans found on each channel */
+	struct channel_stats *channel_stats;
 };
 
 struct scan_survey {
@@ -153,12 +183,17 @@ struct scan_results {
 	struct scan_request *sr;
 	struct scan_freq_set *freqs;
 	struct scan_survey_results survey;
+	/* Entries of bss_list expanded from a Multiple BSSID element */
+	unsigned int num_expanded;
 
 	bool survey_parsed : 1;
 };
 
 static bool start_next_scan_request(struct wiphy_radio_work_item *item);
+static void scan_sliced_free(void *data);
+static bool scan_cancel_request(struct scan_context *sc, uint32_t id);
 static void scan_periodic_rearm(struct scan_context *sc);
+static bool scan_sched_start(struct scan_context *sc);
 
 static bool scan_context_match(const void *a, const void *b)
 {
@@ -218,6 +253,8 @@ static void scan_context_free(struct scan_context *sc)
 {
 	l_debug("sc: %p", sc);
 
+	/* Sliced scans cancel their current slice request, free them first */
+	l_queue_destroy(sc->sliced, scan_sliced_free);
 	l_queue_destroy(sc->requests, scan_request_cancel);
 
 	if (sc->sp.timeout)
@@ -235,8 +272,17 @@ static void scan_context_free(struct scan_context *sc)
 	if (sc->get_survey_cmd_id && nl80211)
 		l_genl_family_cancel(nl80211, sc->get_survey_cmd_id);
 
+	if (sc->sp.sched_scan_cmd_id && nl80211)
+		l_genl_family_cancel(nl80211, sc->sp.sched_scan_cmd_id);
+
 	wiphy_state_watch_remove(sc->wiphy, sc->wiphy_watch_id);
 
+	/* Other interfaces on the wiphy keep their WoWLAN triggers */
+	if (sc->sp.sched_scan)
+		wiphy_set_wowlan(sc->wiphy, sc, 0, NULL);
+
+	scan_freq_plan_free(sc->plan);
+	channel_stats_free(sc->channel_stats);
 	l_free(sc);
 }
 
@@ -507,6 +553,7 @@ struct scan_cmds_add_data {
 	const struct scan_parameters *params;
 	struct l_queue *cmds;
 	struct l_genl_msg **cmd;
+	const struct scan_freq_set *freqs;
 	uint8_t max_ssids_per_scan;
 	uint8_t num_ssids_can_append;
 };
@@ -536,7 +583,7 @@ static bool scan_cmds_add_hidden(const struct network_info *network,
 		 */
 		*data->cmd = scan_build_cmd(data->sc, true, false,
 							data->params,
-							data->params->freqs);
+							data->freqs);
 		l_genl_msg_enter_nested(*data->cmd, NL80211_ATTR_SCAN_SSIDS);
 	}
 
@@ -544,7 +591,7 @@ static bool scan_cmds_add_hidden(const struct network_info *network,
 }
 
 static void scan_build_next_cmd(struct l_queue *cmds, struct scan_context *sc,
-				bool passive,
+				bool passive, bool ignore_flush,
 				const struct scan_parameters *params,
 				const struct scan_freq_set *freqs)
 {
@@ -554,10 +601,11 @@ static void scan_build_next_cmd(struct l_queue *cmds, struct scan_context *sc,
 		params,
 		cmds,
 		&cmd,
+		freqs,
 		wiphy_get_max_num_ssids_per_scan(sc->wiphy),
 	};
 
-	cmd = scan_build_cmd(sc, false, passive, params, freqs);
+	cmd = scan_build_cmd(sc, ignore_flush, passive, params, freqs);
 
 	if (passive) {
 		/* passive scan */
@@ -585,6 +633,68 @@ static void scan_build_next_cmd(struct l_queue *cmds, struct scan_context *sc,
 	l_queue_push_tail(cmds, cmd);
 }
 
+/*
+ * Issue one trigger per scan plan set so each gets its own dwell time.  The
+ * flush flag, if requested, is only honored by the first trigger so that
+ * results of the earlier triggers survive until GET_SCAN.
+ */
+static void scan_cmds_add_planned(struct scan_request *sr,
+					struct scan_context *sc, bool passive,
+					const struct scan_parameters *params)
+{
+	const struct scan_freq_plan *plan = sc->plan;
+	uint32_t bands = BAND_FREQ_2_4_GHZ | BAND_FREQ_5_GHZ | BAND_FREQ_6_GHZ;
+	struct scan_parameters subset_params = *params;
+	struct {
+		struct scan_freq_set *freqs;
+		uint16_t dwell;
+		bool passive;
+	} subsets[3];
+	bool ignore_flush = false;
+	unsigned int i;
+
+	subsets[0].freqs = scan_freq_set_clone(plan->active, bands);
+	subsets[0].dwell = plan->active_dwell;
+	subsets[0].passive = passive;
+	subsets[1].freqs = scan_freq_set_clone(plan->passive, bands);
+	subsets[1].dwell = plan->passive_dwell;
+	subsets[1].passive = true;
+	subsets[2].freqs = scan_freq_set_clone(plan->psc, bands);
+	subsets[2].dwell = plan->psc_dwell;
+	subsets[2].passive = passive;
+
+	/*
+	 * A passive scan has to wait for a beacon on every channel, so the
+	 * short active dwell would miss most APs
+	 */
+	if (passive) {
+		scan_freq_set_merge(subsets[1].freqs, subsets[0].freqs);
+		scan_freq_set_free(subsets[0].freqs);
+		subsets[0].freqs = scan_freq_set_new();
+	}
+
+	for (i = 0; i < L_ARRAY_SIZE(subsets); i++) {
+		scan_freq_set_constrain(subsets[i].freqs, sr->scan_freqs);
+
+		if (!scan_freq_set_isempty(subsets[i].freqs)) {
+			subset_params.duration = subsets[i].dwell;
+			scan_build_next_cmd(sr->cmds, sc, subsets[i].passive,
+						ignore_flush, &subset_params,
+						subsets[i].freqs);
+			ignore_flush = true;
+		}
+
+		scan_freq_set_free(subsets[i].freqs);
+	}
+
+	/*
+	 * 6GHz channels are not in the plan until the regdom allows them,
+	 * let scan_wiphy_watch append the PSC scan if that happens.
+	 */
+	if (wiphy_band_is_disabled(sc->wiphy, BAND_FREQ_6_GHZ) == 1)
+		sr->split = true;
+}
+
 static void scan_cmds_add(struct scan_request *sr, struct scan_context *sc,
 				bool passive,
 				const struct scan_parameters *params)
@@ -594,6 +704,8 @@ static void scan_cmds_add(struct scan_request *sr, struct scan_context *sc,
 	struct scan_freq_set *subsets[2] = { 0 };
 	const struct scan_freq_set *supported =
 					wiphy_get_supported_freqs(sc->wiphy);
+	_auto_(scan_freq_set_free) struct scan_freq_set *planned = NULL;
+	const struct scan_freq_set *freqs;
 
 	/*
 	 * No frequencies, just include the entire supported list and let the
@@ -604,10 +716,33 @@ static void scan_cmds_add(struct scan_request *sr, struct scan_context *sc,
 	else
 		sr->scan_freqs = scan_freq_set_clone(params->freqs, bands);
 
+	freqs = sr->scan_freqs;
+
+	if (params->planned && sc->plan) {
+		planned = scan_freq_plan_get_all(sc->plan);
+		scan_freq_set_constrain(planned, sr->scan_freqs);
+	}
+
+	if (planned && !scan_freq_set_isempty(planned)) {
+		sr->planned = true;
+
+		if (wiphy_has_ext_feature(sc->wiphy,
+					NL80211_EXT_FEATURE_SET_SCAN_DWELL)) {
+			scan_cmds_add_planned(sr, sc, passive, params);
+			return;
+		}
+
+		/*
+		 * Without dwell control splitting the plan buys nothing, only
+		 * leave out the channels the plan excluded
+		 */
+		freqs = planned;
+	}
+
 	/* If 6GHz is not possible or already allowed don't split the request */
 	if (wiphy_band_is_disabled(sc->wiphy, BAND_FREQ_6_GHZ) != 1) {
-		scan_build_next_cmd(sr->cmds, sc, passive,
-						params, sr->scan_freqs);
+		scan_build_next_cmd(sr->cmds, sc, passive, false,
+						params, freqs);
 		return;
 	}
 
@@ -623,13 +758,13 @@ static void scan_cmds_add(struct scan_request *sr, struct scan_context *sc,
 	 * extra 6GHz-only passive scan can be appended to this request
 	 * at that time.
 	 */
-	subsets[0] = scan_freq_set_clone(sr->scan_freqs, BAND_FREQ_2_4_GHZ);
-	subsets[1] = scan_freq_set_clone(sr->scan_freqs, BAND_FREQ_5_GHZ);
+	subsets[0] = scan_freq_set_clone(freqs, BAND_FREQ_2_4_GHZ);
+	subsets[1] = scan_freq_set_clone(freqs, BAND_FREQ_5_GHZ);
 
 	for(i = 0; i < L_ARRAY_SIZE(subsets); i++) {
 		if (!scan_freq_set_isempty(subsets[i]))
-			scan_build_next_cmd(sr->cmds, sc, passive, params,
-								subsets[i]);
+			scan_build_next_cmd(sr->cmds, sc, passive, false,
+							params, subsets[i]);
 
 		scan_freq_set_free(subsets[i]);
 	}
@@ -770,6 +905,261 @@ uint32_t scan_active_full(uint64_t wdev_id,
 					trigger, notify, userdata, destroy);
 }
 
+/*
+ * A sliced scan issues one scan request per slice of the frequency set.
+ * Every slice is its own radio work item so that other work, and the data
+ * traffic on the operating channel, get a chance to run in between.  The
+ * id of the first slice's request identifies the sliced scan as a whole.
+ */
+struct scan_sliced {
+	struct scan_context *sc;
+	uint32_t id;
+	/* Request of the slice currently queued or running, if any */
+	uint32_t slice_id;
+	struct scan_slice *slice;
+	unsigned int next;
+	unsigned int completed;
+	struct scan_parameters params;
+	uint8_t ssid[SSID_MAX_SIZE];
+	uint8_t source_mac[6];
+	uint8_t *extra_ie;
+	struct l_timeout *gap_timeout;
+	struct l_queue *bss_list;
+	struct scan_freq_set *freqs_scanned;
+	scan_trigger_func_t trigger;
+	scan_notify_func_t callback;
+	void *userdata;
+	scan_destroy_func_t destroy;
+	bool in_callback : 1;
+	bool canceled : 1;
+};
+
+static void scan_sliced_free(void *data)
+{
+	struct scan_sliced *ss = data;
+
+	if (ss->slice_id)
+		scan_cancel_request(ss->sc, ss->slice_id);
+
+	l_timeout_remove(ss->gap_timeout);
+
+	if (ss->destroy)
+		ss->destroy(ss->userdata);
+
+	l_queue_destroy(ss->bss_list, (l_queue_destroy_func_t) scan_bss_free);
+	scan_freq_set_free(ss->freqs_scanned);
+	scan_slice_free(ss->slice);
+	l_free(ss->extra_ie);
+	l_free(ss);
+}
+
+static void scan_sliced_finish(struct scan_sliced *ss, int err)
+{
+	struct l_queue *bss_list = l_steal_ptr(ss->bss_list);
+
+	ss->in_callback = true;
+
+	if (ss->callback && ss->callback(err, err ? NULL : bss_list,
+						ss->freqs_scanned,
+						ss->userdata))
+		bss_list = NULL;
+
+	ss->in_callback = false;
+
+	l_queue_destroy(bss_list, (l_queue_destroy_func_t) scan_bss_free);
+	l_queue_remove(ss->sc->sliced, ss);
+	scan_sliced_free(ss);
+}
+
+static void scan_sliced_triggered(int err, void *user_data);
+static bool scan_sliced_notify(int err, struct l_queue *bss_list,
+				const struct scan_freq_set *freqs,
+				void *userdata);
+
+static bool scan_sliced_next(struct scan_sliced *ss)
+{
+	ss->params.freqs = scan_slice_get(ss->slice, ss->next++);
+
+	/* The flush only makes sense before the first slice */
+	if (ss->next > 1)
+		ss->params.flush = false;
+
+	/*
+	 * The slice requests carry no destroy callback, the sliced scan is
+	 * freed once its last slice has been notified or when canceled.
+	 */
+	ss->slice_id = scan_common(ss->sc->wdev_id, false, &ss->params,
+					WIPHY_WORK_PRIORITY_SCAN,
+					scan_sliced_triggered,
+					scan_sliced_notify, ss, NULL);
+
+	return ss->slice_id != 0;
+}
+
+static void scan_sliced_gap_expired(struct l_timeout *timeout,
+					void *user_data)
+{
+	struct scan_sliced *ss = user_data;
+
+	l_timeout_remove(l_steal_ptr(ss->gap_timeout));
+
+	if (!scan_sliced_next(ss))
+		scan_sliced_finish(ss, 0);
+}
+
+static void scan_sliced_triggered(int err, void *user_data)
+{
+	struct scan_sliced *ss = user_data;
+
+	/* Only the first slice is reported to the caller */
+	if (ss->next == 1 && ss->trigger) {
+		ss->in_callback = true;
+		ss->trigger(err, ss->userdata);
+		ss->in_callback = false;
+	}
+
+	if (err >= 0)
+		return;
+
+	/* The failed slice request is removed once we return */
+	ss->slice_id = 0;
+
+	/*
+	 * A failure on the first slice has been reported through the trigger
+	 * callback, for later ones deliver what has been gathered so far.
+	 */
+	if (!ss->completed) {
+		ss->callback = NULL;
+		scan_sliced_finish(ss, err);
+	} else
+		scan_sliced_finish(ss, 0);
+}
+
+static bool scan_sliced_notify(int err, struct l_queue *bss_list,
+				const struct scan_freq_set *freqs,
+				void *userdata)
+{
+	struct scan_sliced *ss = userdata;
+
+	ss->slice_id = 0;
+
+	/* Canceled from the trigger callback, don't queue further slices */
+	if (ss->canceled) {
+		scan_sliced_finish(ss, 0);
+		return false;
+	}
+
+	if (err) {
+		scan_sliced_finish(ss, ss->completed ? 0 : err);
+		return false;
+	}
+
+	ss->completed++;
+	scan_slice_merge_bss(ss->bss_list, bss_list, scan_bss_rank_compare,
+				(l_queue_destroy_func_t) scan_bss_free);
+	l_queue_destroy(bss_list, NULL);
+
+	if (freqs)
+		scan_freq_set_merge(ss->freqs_scanned, freqs);
+
+	if (ss->next >= scan_slice_get_count(ss->slice)) {
+		scan_sliced_finish(ss, 0);
+		return true;
+	}
+
+	if (!SCAN_SLICE_GAP) {
+		if (!scan_sliced_next(ss))
+			scan_sliced_finish(ss, 0);
+
+		return true;
+	}
+
+	ss->gap_timeout = l_timeout_create_ms(SCAN_SLICE_GAP,
+						scan_sliced_gap_expired,
+						ss, NULL);
+	return true;
+}
+
+/*
+ * Active scan meant for use while connected.  Unless disabled through
+ * [Scan].ConnectedScanChannels the frequencies are scanned a few at a time
+ * with [Scan].ConnectedScanGap milliseconds spent back on the operating
+ * channel in between.  The results of all slices are merged and reported
+ * through a single notify call, the returned id can be used with
+ * scan_cancel like that of any other scan.
+ */
+uint32_t scan_active_sliced(uint64_t wdev_id,
+			const struct scan_parameters *params,
+			scan_trigger_func_t trigger, scan_notify_func_t notify,
+			void *userdata, scan_destroy_func_t destroy)
+{
+	uint32_t bands = BAND_FREQ_2_4_GHZ | BAND_FREQ_5_GHZ | BAND_FREQ_6_GHZ;
+	_auto_(scan_freq_set_free) struct scan_freq_set *all = NULL;
+	struct scan_context *sc;
+	struct scan_sliced *ss;
+	struct scan_slice *slice;
+
+	sc = l_queue_find(scan_contexts, scan_context_match, &wdev_id);
+	if (!sc)
+		return 0;
+
+	if (!params->freqs)
+		all = scan_freq_set_clone(wiphy_get_supported_freqs(sc->wiphy),
+						bands);
+
+	slice = scan_slice_new(params->freqs ?: all, SCAN_SLICE_MAX_FREQS);
+
+	if (scan_slice_get_count(slice) <= 1) {
+		scan_slice_free(slice);
+
+		return scan_common(wdev_id, false, params,
+					WIPHY_WORK_PRIORITY_SCAN,
+					trigger, notify, userdata, destroy);
+	}
+
+	ss = l_new(struct scan_sliced, 1);
+	ss->sc = sc;
+	ss->slice = slice;
+	ss->params = *params;
+	ss->bss_list = l_queue_new();
+	ss->freqs_scanned = scan_freq_set_new();
+	ss->trigger = trigger;
+	ss->callback = notify;
+	ss->userdata = userdata;
+	ss->destroy = destroy;
+
+	/* The caller's parameters need not outlive this call */
+	if (params->ssid) {
+		memcpy(ss->ssid, params->ssid, params->ssid_len);
+		ss->params.ssid = ss->ssid;
+	}
+
+	if (params->source_mac) {
+		memcpy(ss->source_mac, params->source_mac, 6);
+		ss->params.source_mac = ss->source_mac;
+	}
+
+	if (params->extra_ie) {
+		ss->extra_ie = l_memdup(params->extra_ie,
+					params->extra_ie_size);
+		ss->params.extra_ie = ss->extra_ie;
+	}
+
+	if (!scan_sliced_next(ss)) {
+		ss->destroy = NULL;
+		scan_sliced_free(ss);
+		return 0;
+	}
+
+	ss->id = ss->slice_id;
+	l_queue_push_tail(sc->sliced, ss);
+
+	l_debug("Sliced scan %u: %u slices of up to %u frequencies", ss->id,
+			scan_slice_get_count(slice), SCAN_SLICE_MAX_FREQS);
+
+	return ss->id;
+}
+
 static void scan_add_owe_freq(struct scan_freq_set *freqs,
 				const struct scan_bss *bss)
 {
@@ -899,10 +1289,17 @@ done:
 					WIPHY_WORK_PRIORITY_SCAN, &work_ops);
 }
 
+static bool scan_sliced_match(const void *a, const void *b)
+{
+	const struct scan_sliced *ss = a;
+
+	return ss->id == L_PTR_TO_UINT(b);
+}
+
 bool scan_cancel(uint64_t wdev_id, uint32_t id)
 {
 	struct scan_context *sc;
-	struct scan_request *sr;
+	struct scan_sliced *ss;
 
 	l_debug("Trying to cancel scan id %u for wdev %" PRIx64, id, wdev_id);
 
@@ -910,6 +1307,36 @@ bool scan_cancel(uint64_t wdev_id, uint32_t id)
 	if (!sc)
 		return false;
 
+	ss = l_queue_find(sc->sliced, scan_sliced_match, L_UINT_TO_PTR(id));
+	if (!ss)
+		return scan_cancel_request(sc, id);
+
+	/*
+	 * We're in the trigger callback, or in the final callback and about
+	 * to be freed.  Invoke destroy now and let the slice that is running
+	 * finish the sliced scan instead of queuing the next one.
+	 */
+	if (ss->in_callback) {
+		if (ss->destroy) {
+			ss->destroy(ss->userdata);
+			ss->destroy = NULL;
+		}
+
+		ss->callback = NULL;
+		ss->canceled = true;
+		return true;
+	}
+
+	l_queue_remove(sc->sliced, ss);
+	scan_sliced_free(ss);
+
+	return true;
+}
+
+static bool scan_cancel_request(struct scan_context *sc, uint32_t id)
+{
+	struct scan_request *sr;
+
 	sr = l_queue_find(sc->requests, scan_request_match, L_UINT_TO_PTR(id));
 	if (!sr)
 		return false;
@@ -990,7 +1417,12 @@ static bool scan_periodic_notify(int err, struct l_queue *bss_list,
 {
 	struct scan_context *sc = user_data;
 
-	scan_periodic_rearm(sc);
+	/*
+	 * Once the initial results are in, let the wiphy look for known
+	 * networks on its own if it can instead of waking up periodically.
+	 */
+	if (!scan_sched_start(sc))
+		scan_periodic_rearm(sc);
 
 	if (sc->sp.callback)
 		return sc->sp.callback(err, bss_list, freqs, sc->sp.userdata);
@@ -1028,6 +1460,46 @@ static struct scan_freq_set *scan_periodic_get_freqs(struct scan_context *sc)
 	return freqs;
 }
 
+/*
+ * Leave out the channels recent scans have found empty, unless a sweep of
+ * every channel is due.  Channels recently used by known networks are always
+ * scanned.
+ */
+static void scan_periodic_skip_quiet(struct scan_context *sc,
+					struct scan_freq_set *freqs)
+{
+	uint64_t now = l_time_now();
+	_auto_(scan_freq_set_free) struct scan_freq_set *quiet = NULL;
+	_auto_(scan_freq_set_free) struct scan_freq_set *recent = NULL;
+
+	if (!SCAN_FULL_SWEEP_INTERVAL || !sc->sp.last_full_sweep ||
+			l_time_diff(now, sc->sp.last_full_sweep) >=
+						SCAN_FULL_SWEEP_INTERVAL) {
+		sc->sp.last_full_sweep = now;
+		return;
+	}
+
+	quiet = channel_stats_get_quiet(sc->channel_stats, freqs);
+
+	recent = known_networks_get_recent_frequencies(5, 5);
+	if (recent)
+		scan_freq_set_subtract(quiet, recent);
+
+	if (scan_freq_set_isempty(quiet))
+		return;
+
+	scan_freq_set_subtract(freqs, quiet);
+
+	/* Everything is quiet, scan it all rather than nothing */
+	if (scan_freq_set_isempty(freqs)) {
+		scan_freq_set_merge(freqs, quiet);
+		return;
+	}
+
+	l_debug("Periodic scan skipping quiet channels on wdev %" PRIx64,
+			sc->wdev_id);
+}
+
 static bool scan_periodic_queue(struct scan_context *sc)
 {
 	struct scan_parameters params = {};
@@ -1041,7 +1513,10 @@ static bool scan_periodic_queue(struct scan_context *sc)
 	if (L_WARN_ON(!freqs))
 		return false;
 
+	scan_periodic_skip_quiet(sc, freqs);
+
 	params.freqs = freqs;
+	params.planned = true;
 
 	if (sc->sp.needs_active_scan && known_networks_has_hidden()) {
 		params.randomize_mac_addr_hint = true;
@@ -1064,6 +1539,183 @@ static bool scan_periodic_queue(struct scan_context *sc)
 	return sc->sp.id != 0;
 }
 
+static bool scan_sched_add_known(const struct network_info *info,
+					void *user_data)
+{
+	struct sched_scan_request *req = user_data;
+
+	if (!info->config.is_autoconnectable)
+		return true;
+
+	/* Hotspot networks can't be matched on the SSID, scan from the host */
+	if (info->is_hotspot)
+		return false;
+
+	return sched_scan_request_add_ssid(req, info->ssid,
+						info->config.is_hidden) == 0;
+}
+
+static struct sched_scan_request *scan_sched_request_new(
+					struct scan_context *sc,
+					const struct sched_scan_caps *caps)
+{
+	struct sched_scan_request *req;
+
+	req = sched_scan_request_new(caps, SCAN_SCHED_RSSI_THRESHOLD);
+	if (!req)
+		return NULL;
+
+	if (!known_networks_foreach(scan_sched_add_known, req) ||
+			!sched_scan_request_get_match_sets(req)) {
+		sched_scan_request_free(req);
+		return NULL;
+	}
+
+	sched_scan_request_set_intervals(req, sc->sp.interval,
+						SCAN_MAX_INTERVAL);
+	return req;
+}
+
+/*
+ * While the periodic scan is offloaded, have the firmware keep looking for
+ * the known networks during suspend as well.  Net-detect may support fewer
+ * match sets than the scheduled scan.
+ */
+static void scan_sched_set_wowlan(struct scan_context *sc)
+{
+	const struct wowlan_caps *wowlan = wiphy_get_wowlan_caps(sc->wiphy);
+	struct sched_scan_caps caps = *wiphy_get_sched_scan_caps(sc->wiphy);
+	struct sched_scan_request *nd;
+
+	caps.max_match_sets = minsize(caps.max_match_sets,
+					wowlan->max_nd_match_sets);
+
+	nd = scan_sched_request_new(sc, &caps);
+	wiphy_set_wowlan(sc->wiphy, sc, WOWLAN_TRIGGER_NET_DETECT, nd);
+}
+
+static void scan_sched_start_cb(struct l_genl_msg *msg, void *user_data)
+{
+	struct scan_context *sc = user_data;
+	int err = l_genl_msg_get_error(msg);
+
+	sc->sp.sched_scan_cmd_id = 0;
+
+	if (err >= 0) {
+		l_debug("Scheduled scan started for wdev %" PRIx64,
+				sc->wdev_id);
+		scan_sched_set_wowlan(sc);
+		return;
+	}
+
+	l_debug("Starting scheduled scan failed: %s(%d)", strerror(-err), err);
+
+	sc->sp.sched_scan = false;
+	scan_periodic_rearm(sc);
+}
+
+/*
+ * Program the known networks as scheduled scan match sets.  Returns false if
+ * the wiphy can't offload the periodic scan for the current set of known
+ * networks, in which case the host keeps scanning periodically.
+ */
+static bool scan_sched_start(struct scan_context *sc)
+{
+	const struct sched_scan_caps *caps =
+					wiphy_get_sched_scan_caps(sc->wiphy);
+	struct sched_scan_request *req;
+	struct scan_freq_set *freqs;
+	struct l_genl_msg *msg;
+
+	if (SCAN_SCHED_DISABLED)
+		return false;
+
+	if (sc->sp.sched_scan)
+		return true;
+
+	req = scan_sched_request_new(sc, caps);
+	if (!req)
+		return false;
+
+	msg = sched_scan_build_start(sc->wdev_id, req);
+	if (!msg)
+		goto done;
+
+	freqs = scan_periodic_get_freqs(sc);
+	if (freqs) {
+		scan_build_attr_scan_frequencies(msg, freqs);
+		scan_freq_set_free(freqs);
+	}
+
+	sc->sp.sched_scan_cmd_id = l_genl_family_send(nl80211, msg,
+							scan_sched_start_cb,
+							sc, NULL);
+	if (!sc->sp.sched_scan_cmd_id) {
+		l_genl_msg_unref(msg);
+		goto done;
+	}
+
+	l_debug("Offloading periodic scan for wdev %" PRIx64 ", %u networks",
+			sc->wdev_id, sched_scan_request_get_match_sets(req));
+
+	sc->sp.sched_scan = true;
+
+	if (sc->sp.timeout) {
+		l_timeout_remove(sc->sp.timeout);
+		sc->sp.timeout = NULL;
+	}
+
+done:
+	sched_scan_request_free(req);
+	return sc->sp.sched_scan;
+}
+
+static void scan_sched_stop(struct scan_context *sc)
+{
+	struct l_genl_msg *msg;
+
+	if (!sc->sp.sched_scan)
+		return;
+
+	l_debug("Stopping scheduled scan for wdev %" PRIx64, sc->wdev_id);
+
+	sc->sp.sched_scan = false;
+	wiphy_set_wowlan(sc->wiphy, sc, 0, NULL);
+
+	if (sc->sp.sched_scan_cmd_id) {
+		l_genl_family_cancel(nl80211, sc->sp.sched_scan_cmd_id);
+		sc->sp.sched_scan_cmd_id = 0;
+	}
+
+	msg = sched_scan_build_stop(sc->wdev_id);
+	if (!l_genl_family_send(nl80211, msg, NULL, NULL, NULL))
+		l_genl_msg_unref(msg);
+}
+
+static void scan_known_networks_changed(enum known_networks_event event,
+					const struct network_info *info,
+					void *user_data)
+{
+	const struct l_queue_entry *entry;
+
+	for (entry = l_queue_get_entries(scan_contexts); entry;
+						entry = entry->next) {
+		struct scan_context *sc = entry->data;
+
+		if (!sc->sp.sched_scan)
+			continue;
+
+		/*
+		 * The match sets are stale.  Scan from the host right away,
+		 * the scheduled scan is reprogrammed once that is done.
+		 */
+		scan_sched_stop(sc);
+
+		if (!scan_periodic_queue(sc))
+			scan_periodic_rearm(sc);
+	}
+}
+
 static bool scan_periodic_is_disabled(void)
 {
 	const struct l_settings *config = iwd_get_config();
@@ -1127,6 +1779,8 @@ bool scan_periodic_stop(uint64_t wdev_id)
 		sc->sp.id = 0;
 	}
 
+	scan_sched_stop(sc);
+
 	sc->sp.interval = 0;
 	sc->sp.trigger = NULL;
 	sc->sp.callback = NULL;
@@ -1136,6 +1790,38 @@ bool scan_periodic_stop(uint64_t wdev_id)
 	return true;
 }
 
+/*
+ * Called when the system was woken up by net-detect.  Rather than waiting
+ * for the next periodic scan or scanning all channels, scan right away on
+ * the channels a known network was detected on.
+ */
+bool scan_periodic_resume(uint64_t wdev_id, const struct scan_freq_set *freqs)
+{
+	struct scan_context *sc;
+	struct scan_parameters params = {};
+
+	sc = l_queue_find(scan_contexts, scan_context_match, &wdev_id);
+	if (!sc || !sc->sp.interval)
+		return false;
+
+	if (sc->sp.id)
+		return true;
+
+	if (!freqs || scan_freq_set_isempty(freqs))
+		return scan_periodic_queue(sc);
+
+	l_debug("Net-detect wakeup for wdev %" PRIx64, wdev_id);
+
+	params.freqs = freqs;
+	sc->sp.id = scan_common(sc->wdev_id, false, &params,
+					WIPHY_WORK_PRIORITY_PERIODIC_SCAN,
+					scan_periodic_triggered,
+					scan_periodic_notify, sc,
+					scan_periodic_destroy);
+
+	return sc->sp.id != 0;
+}
+
 uint64_t scan_get_triggered_time(uint64_t wdev_id, uint32_t id)
 {
 	struct scan_context *sc;
@@ -1152,6 +1838,17 @@ uint64_t scan_get_triggered_time(uint64_t wdev_id, uint32_t id)
 	return sr->start_time_tsf;
 }
 
+const struct channel_stats *scan_get_channel_stats(uint64_t wdev_id)
+{
+	struct scan_context *sc;
+
+	sc = l_queue_find(scan_contexts, scan_context_match, &wdev_id);
+	if (!sc)
+		return NULL;
+
+	return sc->channel_stats;
+}
+
 static void scan_periodic_timeout(struct l_timeout *timeout, void *user_data)
 {
 	struct scan_context *sc = user_data;
@@ -1312,6 +2009,48 @@ static bool scan_parse_advertisement_protocol(struct scan_bss *bss,
 	return true;
 }
 
+#define SCAN_MAX_COLOCATED_6GHZ 16
+
+/*
+ * Keep the 6 GHz entries of a Reduced Neighbor Report so that the APs they
+ * describe can be probed for directly instead of sweeping the whole band.
+ * Entries without a Short SSID are only useful if they share the SSID of
+ * the reporting AP.
+ */
+static void scan_parse_reduced_neighbor_report(struct scan_bss *bss,
+						struct ie_tlv_iter *iter)
+{
+	struct ie_rnr_info rnr[SCAN_MAX_COLOCATED_6GHZ];
+	size_t n;
+	size_t i;
+
+	if (ie_parse_reduced_neighbor_report(iter, rnr, L_ARRAY_SIZE(rnr),
+						&n) < 0) {
+		l_debug("Invalid RNR from "MAC, MAC_STR(bss->addr));
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (bss->num_colocated_6ghz == SCAN_MAX_COLOCATED_6GHZ)
+			break;
+
+		if (band_oper_class_to_band(NULL, rnr[i].oper_class) !=
+							BAND_FREQ_6_GHZ)
+			continue;
+
+		if (!rnr[i].short_ssid_present &&
+				!(rnr[i].bss_params &
+					IE_RNR_BSS_PARAM_SAME_SSID))
+			continue;
+
+		if (!bss->colocated_6ghz)
+			bss->colocated_6ghz = l_new(struct ie_rnr_info,
+						SCAN_MAX_COLOCATED_6GHZ);
+
+		bss->colocated_6ghz[bss->num_colocated_6ghz++] = rnr[i];
+	}
+}
+
 static bool scan_parse_bss_information_elements(struct scan_bss *bss,
 					const void *data, uint16_t len)
 {
@@ -1354,6 +2093,9 @@ static bool scan_parse_bss_information_elements(struct scan_bss *bss,
 		case IE_TYPE_VENDOR_SPECIFIC:
 			scan_parse_vendor_specific(bss, iter.data, iter.len);
 			break;
+		case IE_TYPE_REDUCED_NEIGHBOR_REPORT:
+			scan_parse_reduced_neighbor_report(bss, &iter);
+			break;
 		case IE_TYPE_MOBILITY_DOMAIN:
 			if (!bss->mde_present && iter.len == 3) {
 				memcpy(bss->mde, iter.data, iter.len);
@@ -1525,9 +2267,71 @@ static int32_t signal_unspec_to_mbm(uint8_t strength)
 	return ((int32_t)strength * 100) - 10000;
 }
 
+struct scan_mbssid_data {
+	const struct scan_bss *parent;
+	struct wiphy *wiphy;
+	struct l_queue *expanded;
+};
+
+static void scan_add_nontransmitted_bss(const uint8_t *bssid,
+					uint16_t capability,
+					const uint8_t *ies, size_t ies_len,
+					void *user_data)
+{
+	struct scan_mbssid_data *data = user_data;
+	const struct scan_bss *parent = data->parent;
+	struct scan_bss *bss;
+	int ret;
+
+	bss = l_new(struct scan_bss, 1);
+	memcpy(bss->addr, bssid, 6);
+	bss->capability = capability;
+	bss->frequency = parent->frequency;
+	bss->signal_strength = parent->signal_strength;
+	bss->source_frame = parent->source_frame;
+	bss->parent_tsf = parent->parent_tsf;
+	bss->time_stamp = parent->time_stamp;
+	bss->data_rate = 2000000;
+	bss->mbssid_expanded = true;
+
+	if (!scan_parse_bss_information_elements(bss, ies, ies_len)) {
+		scan_bss_free(bss);
+		return;
+	}
+
+	ret = wiphy_estimate_data_rate(data->wiphy, ies, ies_len, bss,
+					&bss->data_rate);
+	if (ret < 0 && ret != -ENETUNREACH)
+		l_warn("wiphy_estimate_data_rate() failed");
+
+	if (!data->expanded)
+		data->expanded = l_queue_new();
+
+	l_queue_push_tail(data->expanded, bss);
+}
+
+/*
+ * Not every driver has cfg80211 report the BSSes hosted behind a Multiple
+ * BSSID element, so expand them here.  Duplicates of BSSes the kernel did
+ * report are dropped when the results are collected.
+ */
+static struct l_queue *scan_expand_multiple_bssid(const struct scan_bss *bss,
+						struct wiphy *wiphy,
+						const uint8_t *ies,
+						size_t ies_len)
+{
+	struct scan_mbssid_data data = { .parent = bss, .wiphy = wiphy };
+
+	ie_parse_multiple_bssid(ies, ies_len, bss->addr,
+				scan_add_nontransmitted_bss, &data);
+
+	return data.expanded;
+}
+
 static struct scan_bss *scan_parse_attr_bss(struct l_genl_attr *attr,
 						struct wiphy *wiphy,
-						uint32_t *out_seen_ms_ago)
+						uint32_t *out_seen_ms_ago,
+						struct l_queue **out_expanded)
 {
 	uint16_t type, len;
 	const void *data;
@@ -1629,6 +2433,10 @@ static struct scan_bss *scan_parse_attr_bss(struct l_genl_attr *attr,
 						&bss->data_rate);
 		if (ret < 0 && ret != -ENETUNREACH)
 			l_warn("wiphy_estimate_data_rate() failed");
+
+		if (out_expanded)
+			*out_expanded = scan_expand_multiple_bssid(bss, wiphy,
+								ies, ies_len);
 	}
 
 	return bss;
@@ -1657,7 +2465,8 @@ static void scan_parse_attr_scan_frequencies(struct l_genl_attr *attr,
 
 static struct scan_bss *scan_parse_result(struct l_genl_msg *msg,
 						struct wiphy *wiphy,
-						uint32_t *out_seen_ms_ago)
+						uint32_t *out_seen_ms_ago,
+						struct l_queue **out_expanded)
 {
 	struct l_genl_attr attr, nested;
 	uint16_t type;
@@ -1673,7 +2482,8 @@ static struct scan_bss *scan_parse_result(struct l_genl_msg *msg,
 				return NULL;
 
 			bss = scan_parse_attr_bss(&nested, wiphy,
-							out_seen_ms_ago);
+							out_seen_ms_ago,
+							out_expanded);
 			break;
 		}
 	}
@@ -1722,12 +2532,36 @@ static void scan_bss_compute_rank(struct scan_bss *bss)
 			rank *= RANK_HIGH_SNR_FACTOR;
 	}
 
+	/* Rank BSSes that recently failed us lower */
+	rank *= blacklist_get_rank_factor(bss->addr);
+
 	irank = rank;
 
 	if (irank > USHRT_MAX)
 		bss->rank = USHRT_MAX;
 	else
 		bss->rank = irank;
+
+	bss->fresh_rank = bss->rank;
+}
+
+/*
+ * A reading loses rank as it ages, down to half once it is
+ * SCAN_BSS_RANK_AGE_SPAN old, so that a fresh reading of a weaker BSS can
+ * win over an old one of a stronger BSS that no recent scan covered.
+ */
+void scan_bss_age_rank(struct scan_bss *bss, uint64_t now)
+{
+	uint64_t age = 0;
+
+	if (l_time_after(now, bss->time_stamp))
+		age = l_time_diff(bss->time_stamp, now);
+
+	if (age > SCAN_BSS_RANK_AGE_SPAN)
+		age = SCAN_BSS_RANK_AGE_SPAN;
+
+	bss->rank = bss->fresh_rank -
+			bss->fresh_rank * age / (2 * SCAN_BSS_RANK_AGE_SPAN);
 }
 
 struct scan_bss *scan_bss_new_from_probe_req(const struct mmpdu_header *mpdu,
@@ -1764,6 +2598,7 @@ void scan_bss_free(struct scan_bss *bss)
 	l_free(bss->rc_ie);
 	l_free(bss->wfd);
 	l_free(bss->owe_trans);
+	l_free(bss->colocated_6ghz);
 
 	switch (bss->source_frame) {
 	case SCAN_BSS_PROBE_RESP:
@@ -1891,11 +2726,43 @@ static bool scan_survey_get_snr(struct scan_results *results,
 	return false;
 }
 
+static void scan_results_add_bss(struct scan_results *results,
+					struct scan_bss *bss,
+					uint32_t seen_ms_ago)
+{
+	if (!bss->time_stamp)
+		bss->time_stamp = results->time_stamp -
+					seen_ms_ago * L_USEC_PER_MSEC;
+
+	bss->have_snr = scan_survey_get_snr(results, bss->frequency,
+						bss->signal_strength / 100,
+						&bss->snr);
+
+	scan_bss_compute_rank(bss);
+	scan_bss_age_rank(bss, results->time_stamp);
+	l_queue_insert(results->bss_list, bss, scan_bss_rank_compare, NULL);
+}
+
+static bool scan_bss_match_addr(const void *a, const void *b)
+{
+	const struct scan_bss *bss = a;
+
+	return !memcmp(bss->addr, b, 6);
+}
+
+static bool scan_bss_match_expanded(const void *a, const void *b)
+{
+	const struct scan_bss *bss = a;
+
+	return bss->mbssid_expanded && scan_bss_match_addr(a, b);
+}
+
 static void get_scan_callback(struct l_genl_msg *msg, void *user_data)
 {
 	struct scan_results *results = user_data;
 	struct scan_context *sc = results->sc;
 	struct scan_bss *bss;
+	struct l_queue *expanded = NULL;
 	uint64_t wdev_id;
 	uint32_t seen_ms_ago = 0;
 
@@ -1908,20 +2775,36 @@ static void get_scan_callback(struct l_genl_msg *msg, void *user_data)
 		return;
 	}
 
-	bss = scan_parse_result(msg, sc->wiphy, &seen_ms_ago);
+	bss = scan_parse_result(msg, sc->wiphy, &seen_ms_ago, &expanded);
 	if (!bss)
 		return;
 
-	if (!bss->time_stamp)
-		bss->time_stamp = results->time_stamp -
-					seen_ms_ago * L_USEC_PER_MSEC;
+	/* A BSS reported by the kernel supersedes one we expanded */
+	if (results->num_expanded) {
+		struct scan_bss *old = l_queue_remove_if(results->bss_list,
+							scan_bss_match_expanded,
+							bss->addr);
 
-	bss->have_snr = scan_survey_get_snr(results, bss->frequency,
-						bss->signal_strength / 100,
-						&bss->snr);
+		if (old) {
+			scan_bss_free(old);
+			results->num_expanded--;
+		}
+	}
 
-	scan_bss_compute_rank(bss);
-	l_queue_insert(results->bss_list, bss, scan_bss_rank_compare, NULL);
+	scan_results_add_bss(results, bss, seen_ms_ago);
+
+	while ((bss = l_queue_pop_head(expanded))) {
+		if (l_queue_find(results->bss_list, scan_bss_match_addr,
+					bss->addr)) {
+			scan_bss_free(bss);
+			continue;
+		}
+
+		scan_results_add_bss(results, bss, seen_ms_ago);
+		results->num_expanded++;
+	}
+
+	l_queue_destroy(expanded, NULL);
 }
 
 static void discover_hidden_network_bsses(struct scan_context *sc,
@@ -1940,6 +2823,27 @@ static void discover_hidden_network_bsses(struct scan_context *sc,
 	}
 }
 
+static void scan_update_channel_stats(struct scan_context *sc,
+					struct l_queue *bss_list,
+					const struct scan_freq_set *freqs)
+{
+	_auto_(l_free) uint32_t *bss_freqs = NULL;
+	const struct l_queue_entry *entry;
+	unsigned int n_bss = 0;
+
+	bss_freqs = l_new(uint32_t, l_queue_length(bss_list) + 1);
+
+	for (entry = l_queue_get_entries(bss_list); entry;
+						entry = entry->next) {
+		const struct scan_bss *bss = entry->data;
+
+		bss_freqs[n_bss++] = bss->frequency;
+	}
+
+	channel_stats_add_scan(sc->channel_stats, freqs, bss_freqs, n_bss,
+				l_time_now());
+}
+
 static void scan_finished(struct scan_context *sc,
 				int err, struct l_queue *bss_list,
 				const struct scan_freq_set *freqs,
@@ -1952,6 +2856,9 @@ static void scan_finished(struct scan_context *sc,
 	if (bss_list)
 		discover_hidden_network_bsses(sc, bss_list);
 
+	if (bss_list && freqs)
+		scan_update_channel_stats(sc, bss_list, freqs);
+
 	if (sr)
 		sr->in_callback = true;
 
@@ -2098,6 +3005,32 @@ static void scan_get_results(struct scan_context *sc, struct scan_request *sr,
 	get_results(results);
 }
 
+static void scan_context_update_plan(struct scan_context *sc)
+{
+	static const enum band_freq bands[] = {
+		BAND_FREQ_2_4_GHZ, BAND_FREQ_5_GHZ, BAND_FREQ_6_GHZ
+	};
+	struct scan_freq_plan *plan = scan_freq_plan_new();
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(bands); i++) {
+		const struct band_freq_attrs *attrs;
+		size_t num_channels;
+
+		attrs = wiphy_get_frequency_info_list(sc->wiphy, bands[i],
+							&num_channels);
+		if (!attrs)
+			continue;
+
+		scan_freq_plan_add_band(plan, bands[i], attrs, num_channels);
+	}
+
+	scan_freq_plan_free(sc->plan);
+	sc->plan = plan;
+
+	l_debug("Scan plan updated for wiphy %u", wiphy_get_id(sc->wiphy));
+}
+
 static void scan_wiphy_watch(struct wiphy *wiphy,
 				enum wiphy_state_watch_event event,
 				void *user_data)
@@ -2113,6 +3046,8 @@ static void scan_wiphy_watch(struct wiphy *wiphy,
 	if (event != WIPHY_STATE_WATCH_EVENT_REGDOM_DONE)
 		return;
 
+	scan_context_update_plan(sc);
+
 	if (!sc->sp.id)
 		return;
 
@@ -2150,6 +3085,20 @@ static void scan_wiphy_watch(struct wiphy *wiphy,
 
 	freqs_6ghz = scan_freq_set_clone(sr->scan_freqs, BAND_FREQ_6_GHZ);
 
+	/* Stick to the channels the updated plan allows, with its dwell */
+	if (sr->planned) {
+		_auto_(scan_freq_set_free) struct scan_freq_set *allowed =
+					scan_freq_plan_get_all(sc->plan);
+
+		scan_freq_set_constrain(freqs_6ghz, allowed);
+		params.duration = sc->plan->psc_dwell;
+
+		if (scan_freq_set_isempty(freqs_6ghz)) {
+			scan_get_results(sc, sr, sr->freqs_scanned);
+			return;
+		}
+	}
+
 	/*
 	 * At this point we know there is an ongoing periodic scan.
 	 * Create a new 6GHz passive scan request and append to the
@@ -2180,8 +3129,11 @@ static struct scan_context *scan_context_new(uint64_t wdev_id)
 	sc->wiphy = wiphy;
 	sc->state = SCAN_STATE_NOT_RUNNING;
 	sc->requests = l_queue_new();
+	sc->sliced = l_queue_new();
+	sc->channel_stats = channel_stats_new(SCAN_QUIET_CHANNEL_SCANS);
 	sc->wiphy_watch_id = wiphy_state_watch_add(wiphy, scan_wiphy_watch,
 							sc, NULL);
+	scan_context_update_plan(sc);
 
 	return sc;
 }
@@ -2251,6 +3203,55 @@ static void scan_retry_pending(uint32_t wiphy_id)
 	}
 }
 
+static bool scan_context_match_sched(const void *a, const void *b)
+{
+	const struct scan_context *sc = a;
+
+	return sc->sp.sched_scan &&
+			wiphy_get_id(sc->wiphy) == L_PTR_TO_UINT(b);
+}
+
+/*
+ * Scheduled scan events carry the ifindex and wiphy but no wdev, there is
+ * only ever one scheduled scan per wiphy from our side.
+ */
+static void scan_sched_notify(struct l_genl_msg *msg, uint8_t cmd)
+{
+	struct scan_context *sc;
+	uint32_t wiphy_id;
+
+	if (nl80211_parse_attrs(msg, NL80211_ATTR_WIPHY, &wiphy_id,
+					NL80211_ATTR_UNSPEC) < 0)
+		return;
+
+	sc = l_queue_find(scan_contexts, scan_context_match_sched,
+				L_UINT_TO_PTR(wiphy_id));
+	if (!sc)
+		return;
+
+	l_debug("Scan notification %s(%u)", nl80211cmd_to_string(cmd), cmd);
+
+	switch (cmd) {
+	case NL80211_CMD_SCHED_SCAN_RESULTS:
+		if (sc->get_scan_cmd_id)
+			break;
+
+		/*
+		 * Reported to the periodic scan callback like an external
+		 * scan.  Nothing is expired since the scheduled scan only
+		 * tells us about matches.
+		 */
+		scan_get_results(sc, NULL, scan_freq_set_new());
+		break;
+	case NL80211_CMD_SCHED_SCAN_STOPPED:
+		/* Stopped by the driver, go back to scanning from the host */
+		sc->sp.sched_scan = false;
+		wiphy_set_wowlan(sc->wiphy, sc, 0, NULL);
+		scan_periodic_rearm(sc);
+		break;
+	}
+}
+
 static void scan_notify(struct l_genl_msg *msg, void *user_data)
 {
 	struct l_genl_attr attr;
@@ -2266,6 +3267,12 @@ static void scan_notify(struct l_genl_msg *msg, void *user_data)
 
 	cmd = l_genl_msg_get_command(msg);
 
+	if (cmd == NL80211_CMD_SCHED_SCAN_RESULTS ||
+			cmd == NL80211_CMD_SCHED_SCAN_STOPPED) {
+		scan_sched_notify(msg, cmd);
+		return;
+	}
+
 	if (nl80211_parse_attrs(msg, NL80211_ATTR_WDEV, &wdev_id,
 					NL80211_ATTR_WIPHY, &wiphy_id,
 					NL80211_ATTR_UNSPEC) < 0)
@@ -2578,6 +3585,7 @@ bool scan_wdev_remove(uint64_t wdev_id)
 static int scan_init(void)
 {
 	const struct l_settings *config = iwd_get_config();
+	uint32_t full_sweep_interval;
 
 	scan_contexts = l_queue_new();
 
@@ -2599,11 +3607,43 @@ static int scan_init(void)
 	if (SCAN_MAX_INTERVAL > UINT16_MAX)
 		SCAN_MAX_INTERVAL = UINT16_MAX;
 
+	if (!l_settings_get_bool(config, "Scan", "DisableScheduledScan",
+					&SCAN_SCHED_DISABLED))
+		SCAN_SCHED_DISABLED = false;
+
+	if (!l_settings_get_int(config, "Scan", "ScheduledScanRSSIThreshold",
+					&SCAN_SCHED_RSSI_THRESHOLD))
+		SCAN_SCHED_RSSI_THRESHOLD = -80;
+
+	if (SCAN_SCHED_RSSI_THRESHOLD > 0 || SCAN_SCHED_RSSI_THRESHOLD < -100)
+		SCAN_SCHED_RSSI_THRESHOLD = -80;
+
+	if (!l_settings_get_uint(config, "Scan", "ConnectedScanChannels",
+					&SCAN_SLICE_MAX_FREQS))
+		SCAN_SLICE_MAX_FREQS = 4;
+
+	if (!l_settings_get_uint(config, "Scan", "ConnectedScanGap",
+					&SCAN_SLICE_GAP))
+		SCAN_SLICE_GAP = 100;
+
+	if (!l_settings_get_uint(config, "Scan", "FullScanInterval",
+					&full_sweep_interval))
+		full_sweep_interval = 1800;
+
+	SCAN_FULL_SWEEP_INTERVAL = full_sweep_interval * L_USEC_PER_SEC;
+
+	known_networks_watch = known_networks_watch_add(
+						scan_known_networks_changed,
+						NULL, NULL);
+
 	return 0;
 }
 
 static void scan_exit(void)
 {
+	known_networks_watch_remove(known_networks_watch);
+	known_networks_watch = 0;
+
 	l_queue_destroy(scan_contexts,
 				(l_queue_destroy_func_t) scan_context_free);
 	scan_contexts = NULL;
@@ -2613,3 +3653,4 @@ static void scan_exit(void)
 
 IWD_MODULE(scan, scan_init, scan_exit)
 IWD_MODULE_DEPENDS(scan, wiphy)
+IWD_MODULE_DEPENDS(scan, known_networks)
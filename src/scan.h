@@ -25,11 +25,13 @@
 struct scan_freq_set;
 struct ie_rsn_info;
 struct ie_owe_transition_info;
+struct ie_rnr_info;
 struct p2p_probe_resp;
 struct p2p_probe_req;
 struct p2p_beacon;
 struct mmpdu_header;
 struct wiphy;
+struct channel_stats;
 enum security;
 enum band_freq;
 
@@ -63,12 +65,18 @@ struct scan_bss {
 		struct p2p_beacon *p2p_beacon_info;
 	};
 	struct ie_owe_transition_info *owe_trans;
+	/* 6 GHz APs advertised through Reduced Neighbor Report elements */
+	struct ie_rnr_info *colocated_6ghz;
+	uint8_t num_colocated_6ghz;
 	uint8_t mde[3];
 	uint8_t ssid[SSID_MAX_SIZE];
 	uint8_t ssid_len;
 	uint8_t utilization;
 	uint8_t cc[3];
+	/* Rank lowered by the age of the reading, see scan_bss_age_rank */
 	uint16_t rank;
+	/* Rank when the BSS was last seen */
+	uint16_t fresh_rank;
 	uint64_t time_stamp;
 	uint64_t data_rate;
 	uint8_t hessid[6];
@@ -94,6 +102,11 @@ struct scan_bss {
 	bool sae_pw_id_exclusive : 1;
 	bool have_snr : 1;
 	bool have_utilization : 1;
+	/*
+	 * Expanded from the Multiple BSSID element of another BSS and not
+	 * reported by the kernel, i.e. unknown to cfg80211
+	 */
+	bool mbssid_expanded : 1;
 };
 
 struct scan_parameters {
@@ -106,6 +119,8 @@ struct scan_parameters {
 	bool no_cck_rates : 1;
 	bool duration_mandatory : 1;
 	bool ap_scan : 1;
+	/* Split into the wiphy's active, passive and PSC scan plan sets */
+	bool planned : 1;
 	const uint8_t *ssid;	/* Used for direct probe request */
 	size_t ssid_len;
 	const uint8_t *source_mac;
@@ -152,6 +167,10 @@ uint32_t scan_active_full(uint64_t wdev_id,
 			const struct scan_parameters *params,
 			scan_trigger_func_t trigger, scan_notify_func_t notify,
 			void *userdata, scan_destroy_func_t destroy);
+uint32_t scan_active_sliced(uint64_t wdev_id,
+			const struct scan_parameters *params,
+			scan_trigger_func_t trigger, scan_notify_func_t notify,
+			void *userdata, scan_destroy_func_t destroy);
 uint32_t scan_owe_hidden(uint64_t wdev_id, struct l_queue *list,
 			scan_trigger_func_t trigger, scan_notify_func_t notify,
 			void *userdata, scan_destroy_func_t destroy);
@@ -160,14 +179,18 @@ bool scan_cancel(uint64_t wdev_id, uint32_t id);
 void scan_periodic_start(uint64_t wdev_id, scan_trigger_func_t trigger,
 				scan_notify_func_t func, void *userdata);
 bool scan_periodic_stop(uint64_t wdev_id);
+bool scan_periodic_resume(uint64_t wdev_id,
+				const struct scan_freq_set *freqs);
 
 uint64_t scan_get_triggered_time(uint64_t wdev_id, uint32_t id);
+const struct channel_stats *scan_get_channel_stats(uint64_t wdev_id);
 
 bool scan_get_firmware_scan(uint64_t wdev_id, scan_notify_func_t notify,
 				void *userdata, scan_destroy_func_t destroy);
 
 void scan_bss_free(struct scan_bss *bss);
 int scan_bss_rank_compare(const void *a, const void *b, void *user);
+void scan_bss_age_rank(struct scan_bss *bss, uint64_t now);
 
 int scan_bss_get_rsn_info(const struct scan_bss *bss, struct ie_rsn_info *info);
 int scan_bss_get_security(const struct scan_bss *bss, enum security *security);
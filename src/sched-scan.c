@@ -0,0 +1,326 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "ell/useful.h"
+#include "linux/nl80211.h"
+#include "src/sched-scan.h"
+
+/*
+ * Scheduled scans let the firmware (or mac80211) scan on its own and only
+ * report back once a BSS matching one of the programmed match sets has been
+ * found.  Each match set is one known SSID, hidden SSIDs are additionally
+ * probed for.  The interval back-off of the host periodic scan is expressed
+ * as a list of scan plans, the last of which repeats forever.
+ */
+
+struct sched_scan_ssid {
+	uint8_t ssid[32];
+	size_t ssid_len;
+};
+
+struct sched_scan_request {
+	struct sched_scan_caps caps;
+	int8_t rssi_threshold;
+	struct sched_scan_ssid *match_sets;
+	unsigned int n_match_sets;
+	struct sched_scan_ssid *probe_ssids;
+	unsigned int n_probe_ssids;
+	uint32_t intervals[SCHED_SCAN_MAX_PLANS];
+	uint32_t iterations[SCHED_SCAN_MAX_PLANS];
+	unsigned int n_plans;
+};
+
+bool sched_scan_caps_parse_attr(struct sched_scan_caps *caps, uint16_t type,
+					const void *data, uint16_t len)
+{
+	switch (type) {
+	case NL80211_ATTR_MAX_NUM_SCHED_SCAN_SSIDS:
+		if (len != sizeof(uint8_t))
+			return false;
+
+		caps->max_ssids = l_get_u8(data);
+		return true;
+	case NL80211_ATTR_MAX_MATCH_SETS:
+		if (len != sizeof(uint8_t))
+			return false;
+
+		caps->max_match_sets = l_get_u8(data);
+		return true;
+	case NL80211_ATTR_MAX_NUM_SCHED_SCAN_PLANS:
+		if (len != sizeof(uint32_t))
+			return false;
+
+		caps->max_plans = l_get_u32(data);
+		return true;
+	case NL80211_ATTR_MAX_SCAN_PLAN_INTERVAL:
+		if (len != sizeof(uint32_t))
+			return false;
+
+		caps->max_plan_interval = l_get_u32(data);
+		return true;
+	case NL80211_ATTR_MAX_SCAN_PLAN_ITERATIONS:
+		if (len != sizeof(uint32_t))
+			return false;
+
+		caps->max_plan_iterations = l_get_u32(data);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Drivers that do not filter on SSID would wake us for every BSS, which is
+ * no better than scanning from the host.
+ */
+bool sched_scan_caps_usable(const struct sched_scan_caps *caps)
+{
+	return caps->supported && caps->max_match_sets > 0;
+}
+
+struct sched_scan_request *sched_scan_request_new(
+					const struct sched_scan_caps *caps,
+					int8_t rssi_threshold)
+{
+	struct sched_scan_request *req;
+
+	if (!sched_scan_caps_usable(caps))
+		return NULL;
+
+	req = l_new(struct sched_scan_request, 1);
+	req->caps = *caps;
+	req->rssi_threshold = rssi_threshold;
+	req->match_sets = l_new(struct sched_scan_ssid, caps->max_match_sets);
+
+	if (caps->max_ssids)
+		req->probe_ssids = l_new(struct sched_scan_ssid,
+						caps->max_ssids);
+
+	return req;
+}
+
+void sched_scan_request_free(struct sched_scan_request *req)
+{
+	if (!req)
+		return;
+
+	l_free(req->match_sets);
+	l_free(req->probe_ssids);
+	l_free(req);
+}
+
+static bool sched_scan_ssid_find(const struct sched_scan_ssid *list,
+					unsigned int n, const char *ssid,
+					size_t ssid_len)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		if (list[i].ssid_len == ssid_len &&
+				!memcmp(list[i].ssid, ssid, ssid_len))
+			return true;
+
+	return false;
+}
+
+/*
+ * Returns -ENOSPC if the SSID does not fit.  Since a network that is not
+ * programmed would never be found, callers are expected to fall back to
+ * host scanning in that case rather than to offload a subset.
+ */
+int sched_scan_request_add_ssid(struct sched_scan_request *req,
+				const char *ssid, bool hidden)
+{
+	size_t ssid_len = strlen(ssid);
+	struct sched_scan_ssid *entry;
+	bool have_match;
+	bool have_probe;
+
+	if (!ssid_len || ssid_len > 32)
+		return -EINVAL;
+
+	have_match = sched_scan_ssid_find(req->match_sets, req->n_match_sets,
+						ssid, ssid_len);
+	have_probe = !hidden || sched_scan_ssid_find(req->probe_ssids,
+							req->n_probe_ssids,
+							ssid, ssid_len);
+
+	if (!have_match && req->n_match_sets >= req->caps.max_match_sets)
+		return -ENOSPC;
+
+	if (!have_probe && req->n_probe_ssids >= req->caps.max_ssids)
+		return -ENOSPC;
+
+	if (!have_match) {
+		entry = &req->match_sets[req->n_match_sets++];
+		memcpy(entry->ssid, ssid, ssid_len);
+		entry->ssid_len = ssid_len;
+	}
+
+	if (!have_probe) {
+		entry = &req->probe_ssids[req->n_probe_ssids++];
+		memcpy(entry->ssid, ssid, ssid_len);
+		entry->ssid_len = ssid_len;
+	}
+
+	return 0;
+}
+
+/*
+ * Mirror the host periodic scan back-off: one scan at each doubling of the
+ * initial interval and then the maximum interval forever.  Plans beyond
+ * what the wiphy supports are dropped from the back-off part.
+ */
+void sched_scan_request_set_intervals(struct sched_scan_request *req,
+					uint32_t initial, uint32_t maximum)
+{
+	uint32_t max_plans = req->caps.max_plans ?: 1;
+	uint32_t limit = req->caps.max_plan_interval ?: UINT32_MAX;
+	uint32_t interval = initial ?: 1;
+
+	max_plans = minsize(max_plans, SCHED_SCAN_MAX_PLANS);
+	maximum = maxsize(maximum, interval);
+	req->n_plans = 0;
+
+	while (req->n_plans + 1 < max_plans && interval < maximum &&
+			req->caps.max_plan_iterations) {
+		req->intervals[req->n_plans] = minsize(interval, limit);
+		req->iterations[req->n_plans] = 1;
+		req->n_plans++;
+		interval *= 2;
+	}
+
+	/*
+	 * With a single plan there is no back-off, stay at the initial
+	 * interval so that known networks are still found quickly.
+	 */
+	req->intervals[req->n_plans] = minsize(req->n_plans ? maximum : initial,
+						limit) ?: 1;
+	req->iterations[req->n_plans] = 0;
+	req->n_plans++;
+}
+
+unsigned int sched_scan_request_get_match_sets(
+					const struct sched_scan_request *req)
+{
+	return req->n_match_sets;
+}
+
+unsigned int sched_scan_request_get_plans(const struct sched_scan_request *req,
+					uint32_t *intervals,
+					uint32_t *iterations)
+{
+	memcpy(intervals, req->intervals, req->n_plans * sizeof(uint32_t));
+	memcpy(iterations, req->iterations, req->n_plans * sizeof(uint32_t));
+
+	return req->n_plans;
+}
+
+/*
+ * Appends the probe SSIDs, match sets and scan plans.  Shared between
+ * START_SCHED_SCAN and the WoWLAN net-detect trigger which embeds the same
+ * attributes.
+ */
+void sched_scan_request_append_attrs(const struct sched_scan_request *req,
+					struct l_genl_msg *msg)
+{
+	int32_t rssi = req->rssi_threshold;
+	unsigned int i;
+
+	if (req->n_probe_ssids) {
+		l_genl_msg_enter_nested(msg, NL80211_ATTR_SCAN_SSIDS);
+
+		for (i = 0; i < req->n_probe_ssids; i++)
+			l_genl_msg_append_attr(msg, i,
+						req->probe_ssids[i].ssid_len,
+						req->probe_ssids[i].ssid);
+
+		l_genl_msg_leave_nested(msg);
+	}
+
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_SCHED_SCAN_MATCH);
+
+	for (i = 0; i < req->n_match_sets; i++) {
+		l_genl_msg_enter_nested(msg, i + 1);
+		l_genl_msg_append_attr(msg, NL80211_SCHED_SCAN_MATCH_ATTR_SSID,
+					req->match_sets[i].ssid_len,
+					req->match_sets[i].ssid);
+		l_genl_msg_append_attr(msg, NL80211_SCHED_SCAN_MATCH_ATTR_RSSI,
+					4, &rssi);
+		l_genl_msg_leave_nested(msg);
+	}
+
+	l_genl_msg_leave_nested(msg);
+
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_SCHED_SCAN_PLANS);
+
+	for (i = 0; i < req->n_plans; i++) {
+		l_genl_msg_enter_nested(msg, i + 1);
+		l_genl_msg_append_attr(msg, NL80211_SCHED_SCAN_PLAN_INTERVAL,
+					4, &req->intervals[i]);
+
+		/* The last plan runs forever and must not carry iterations */
+		if (req->iterations[i])
+			l_genl_msg_append_attr(msg,
+					NL80211_SCHED_SCAN_PLAN_ITERATIONS,
+					4, &req->iterations[i]);
+
+		l_genl_msg_leave_nested(msg);
+	}
+
+	l_genl_msg_leave_nested(msg);
+}
+
+struct l_genl_msg *sched_scan_build_start(uint64_t wdev_id,
+					const struct sched_scan_request *req)
+{
+	struct l_genl_msg *msg;
+
+	if (!req->n_match_sets || !req->n_plans)
+		return NULL;
+
+	msg = l_genl_msg_new(NL80211_CMD_START_SCHED_SCAN);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_WDEV, 8, &wdev_id);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_SOCKET_OWNER, 0, NULL);
+	sched_scan_request_append_attrs(req, msg);
+
+	return msg;
+}
+
+struct l_genl_msg *sched_scan_build_stop(uint64_t wdev_id)
+{
+	struct l_genl_msg *msg;
+
+	msg = l_genl_msg_new_sized(NL80211_CMD_STOP_SCHED_SCAN, 16);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_WDEV, 8, &wdev_id);
+
+	return msg;
+}
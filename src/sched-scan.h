@@ -0,0 +1,62 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct l_genl_msg;
+struct sched_scan_request;
+
+#define SCHED_SCAN_MAX_PLANS 8
+
+/* Scheduled scan limits advertised by the wiphy */
+struct sched_scan_caps {
+	bool supported : 1;
+	uint8_t max_ssids;
+	uint8_t max_match_sets;
+	uint32_t max_plans;
+	uint32_t max_plan_interval;
+	uint32_t max_plan_iterations;
+};
+
+bool sched_scan_caps_parse_attr(struct sched_scan_caps *caps, uint16_t type,
+					const void *data, uint16_t len);
+bool sched_scan_caps_usable(const struct sched_scan_caps *caps);
+
+struct sched_scan_request *sched_scan_request_new(
+					const struct sched_scan_caps *caps,
+					int8_t rssi_threshold);
+void sched_scan_request_free(struct sched_scan_request *req);
+
+int sched_scan_request_add_ssid(struct sched_scan_request *req,
+				const char *ssid, bool hidden);
+void sched_scan_request_set_intervals(struct sched_scan_request *req,
+					uint32_t initial, uint32_t maximum);
+
+unsigned int sched_scan_request_get_match_sets(
+					const struct sched_scan_request *req);
+unsigned int sched_scan_request_get_plans(const struct sched_scan_request *req,
+					uint32_t *intervals,
+					uint32_t *iterations);
+
+void sched_scan_request_append_attrs(const struct sched_scan_request *req,
+					struct l_genl_msg *msg);
+struct l_genl_msg *sched_scan_build_start(uint64_t wdev_id,
+					const struct sched_scan_request *req);
+struct l_genl_msg *sched_scan_build_stop(uint64_t wdev_id);
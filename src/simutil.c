@@ -30,6 +30,7 @@
 #include <ell/ell.h>
 
 #include "src/missing.h"
+#include "src/eap.h"
 #include "src/eap-private.h"
 #include "src/crypto.h"
 #include "src/simutil.h"
@@ -503,3 +504,589 @@ const void *eap_sim_tlv_iter_get_data(struct eap_sim_tlv_iter *iter)
 {
 	return iter->data;
 }
+
+void eap_sim_reauth_clear(struct eap_sim_reauth *reauth)
+{
+	l_free(l_steal_ptr(reauth->pseudonym));
+	l_free(l_steal_ptr(reauth->reauth_id));
+	reauth->counter = 0;
+	explicit_bzero(reauth->mk, sizeof(reauth->mk));
+	explicit_bzero(reauth->k_encr, sizeof(reauth->k_encr));
+	explicit_bzero(reauth->k_aut, sizeof(reauth->k_aut));
+}
+
+const char *eap_sim_reauth_select_identity(const struct eap_sim_reauth *reauth,
+						uint8_t id_req,
+						const char *permanent)
+{
+	switch (id_req) {
+	case EAP_SIM_AT_PERMANENT_ID_REQ:
+		return permanent;
+	case EAP_SIM_AT_FULLAUTH_ID_REQ:
+		return reauth->pseudonym ?: permanent;
+	default:
+		break;
+	}
+
+	if (reauth->reauth_id)
+		return reauth->reauth_id;
+
+	return reauth->pseudonym ?: permanent;
+}
+
+/* Attributes found inside AT_ENCR_DATA */
+struct eap_sim_encr_attrs {
+	bool has_counter : 1;
+	bool counter_too_small : 1;
+	uint16_t counter;
+	const uint8_t *nonce_s;
+	char *next_pseudonym;
+	char *next_reauth_id;
+};
+
+static char *eap_sim_parse_identity_attr(const uint8_t *data, uint16_t len)
+{
+	uint16_t actual;
+
+	if (len < 2)
+		return NULL;
+
+	actual = l_get_be16(data);
+	if (!actual || actual > len - 2)
+		return NULL;
+
+	return l_strndup((const char *) data + 2, actual);
+}
+
+static bool eap_sim_parse_encr_attrs(const uint8_t *data, size_t len,
+					struct eap_sim_encr_attrs *attrs)
+{
+	struct eap_sim_tlv_iter iter;
+
+	eap_sim_tlv_iter_init(&iter, data, len);
+
+	while (eap_sim_tlv_iter_next(&iter)) {
+		const uint8_t *contents = eap_sim_tlv_iter_get_data(&iter);
+		uint16_t length = eap_sim_tlv_iter_get_length(&iter);
+		char **id = NULL;
+
+		switch (eap_sim_tlv_iter_get_type(&iter)) {
+		case EAP_SIM_AT_COUNTER:
+			if (length < 2)
+				return false;
+
+			attrs->has_counter = true;
+			attrs->counter = l_get_be16(contents);
+			break;
+		case EAP_SIM_AT_COUNTER_TOO_SMALL:
+			attrs->counter_too_small = true;
+			break;
+		case EAP_SIM_AT_NONCE_S:
+			if (length < 2 + EAP_SIM_NONCE_S_LEN)
+				return false;
+
+			attrs->nonce_s = contents + 2;
+			break;
+		case EAP_SIM_AT_NEXT_PSEUDONYM:
+			id = &attrs->next_pseudonym;
+			break;
+		case EAP_SIM_AT_NEXT_REAUTH_ID:
+			id = &attrs->next_reauth_id;
+			break;
+		case EAP_SIM_AT_PADDING:
+			break;
+		default:
+			/* RFC 4186 Section 8.1, skippable attributes */
+			if (eap_sim_tlv_iter_get_type(&iter) >= 128)
+				break;
+
+			l_error("attribute %u not allowed in AT_ENCR_DATA",
+					eap_sim_tlv_iter_get_type(&iter));
+			return false;
+		}
+
+		if (!id)
+			continue;
+
+		l_free(*id);
+		*id = eap_sim_parse_identity_attr(contents, length);
+		if (!*id)
+			return false;
+	}
+
+	return true;
+}
+
+static void eap_sim_encr_attrs_free(struct eap_sim_encr_attrs *attrs)
+{
+	l_free(attrs->next_pseudonym);
+	l_free(attrs->next_reauth_id);
+}
+
+/*
+ * Finds AT_IV and AT_ENCR_DATA in 'pkt' and decrypts the latter.  Returns
+ * false on a malformed packet, otherwise true with *out set to NULL if the
+ * packet carried no encrypted data.
+ */
+static bool eap_sim_decrypt_encr_data(const uint8_t *k_encr,
+					const uint8_t *pkt, size_t len,
+					uint8_t **out, size_t *out_len)
+{
+	struct eap_sim_tlv_iter iter;
+	const uint8_t *iv = NULL;
+	const uint8_t *encr = NULL;
+	uint16_t encr_len = 0;
+	struct l_cipher *cipher;
+	uint8_t *plain;
+	bool r;
+
+	*out = NULL;
+
+	if (len < 3)
+		return false;
+
+	eap_sim_tlv_iter_init(&iter, pkt + 3, len - 3);
+
+	while (eap_sim_tlv_iter_next(&iter)) {
+		const uint8_t *contents = eap_sim_tlv_iter_get_data(&iter);
+		uint16_t length = eap_sim_tlv_iter_get_length(&iter);
+
+		switch (eap_sim_tlv_iter_get_type(&iter)) {
+		case EAP_SIM_AT_IV:
+			if (length < 2 + EAP_SIM_IV_LEN)
+				return false;
+
+			iv = contents + 2;
+			break;
+		case EAP_SIM_AT_ENCR_DATA:
+			if (length < 2 + 16 || (length - 2) % 16)
+				return false;
+
+			encr = contents + 2;
+			encr_len = length - 2;
+			break;
+		}
+	}
+
+	if (!encr)
+		return true;
+
+	if (!iv) {
+		l_error("AT_ENCR_DATA without AT_IV");
+		return false;
+	}
+
+	cipher = l_cipher_new(L_CIPHER_AES_CBC, k_encr, EAP_SIM_K_ENCR_LEN);
+	if (!cipher)
+		return false;
+
+	plain = l_malloc(encr_len);
+
+	r = l_cipher_set_iv(cipher, iv, EAP_SIM_IV_LEN) &&
+		l_cipher_decrypt(cipher, encr, plain, encr_len);
+	l_cipher_free(cipher);
+
+	if (!r) {
+		l_free(plain);
+		return false;
+	}
+
+	*out = plain;
+	*out_len = encr_len;
+	return true;
+}
+
+bool eap_sim_reauth_update_ids(struct eap_sim_reauth *reauth,
+				const uint8_t *k_encr,
+				const uint8_t *pkt, size_t len)
+{
+	struct eap_sim_encr_attrs attrs = {};
+	uint8_t *plain;
+	size_t plain_len;
+	bool r;
+
+	if (!eap_sim_decrypt_encr_data(k_encr, pkt, len, &plain, &plain_len))
+		return false;
+
+	l_free(l_steal_ptr(reauth->reauth_id));
+
+	if (!plain)
+		return true;
+
+	r = eap_sim_parse_encr_attrs(plain, plain_len, &attrs);
+	explicit_bzero(plain, plain_len);
+	l_free(plain);
+
+	if (!r) {
+		eap_sim_encr_attrs_free(&attrs);
+		return false;
+	}
+
+	/* Keep using the previous pseudonym if no new one was given */
+	if (attrs.next_pseudonym) {
+		l_free(reauth->pseudonym);
+		reauth->pseudonym = l_steal_ptr(attrs.next_pseudonym);
+	}
+
+	reauth->reauth_id = l_steal_ptr(attrs.next_reauth_id);
+
+	return true;
+}
+
+/*
+ * RFC 4186 Section 7
+ * XKEY' = SHA1(Identity|counter|NONCE_S|MK)
+ * MSK = FK[0..63], EMSK = FK[64..127] where FK = PRF(XKEY')
+ */
+static bool eap_sim_derive_reauth_keys(const char *identity, uint16_t counter,
+					const uint8_t *nonce_s,
+					const uint8_t *mk,
+					uint8_t *msk, uint8_t *emsk)
+{
+	struct l_checksum *checksum = l_checksum_new(L_CHECKSUM_SHA1);
+	uint8_t counter_be[2];
+	uint8_t xkey[20];
+	uint8_t fk[160];
+	struct iovec iov[4];
+	bool r;
+
+	if (!checksum)
+		return false;
+
+	l_put_be16(counter, counter_be);
+
+	iov[0].iov_base = (void *) identity;
+	iov[0].iov_len = strlen(identity);
+	iov[1].iov_base = counter_be;
+	iov[1].iov_len = 2;
+	iov[2].iov_base = (void *) nonce_s;
+	iov[2].iov_len = EAP_SIM_NONCE_S_LEN;
+	iov[3].iov_base = (void *) mk;
+	iov[3].iov_len = EAP_SIM_MK_LEN;
+
+	r = l_checksum_updatev(checksum, iov, 4) &&
+		l_checksum_get_digest(checksum, xkey, sizeof(xkey)) ==
+								sizeof(xkey);
+	l_checksum_free(checksum);
+
+	if (!r)
+		return false;
+
+	eap_sim_fips_prf(xkey, sizeof(xkey), fk, sizeof(fk));
+	memcpy(msk, fk, EAP_SIM_MSK_LEN);
+	memcpy(emsk, fk + EAP_SIM_MSK_LEN, EAP_SIM_EMSK_LEN);
+
+	explicit_bzero(xkey, sizeof(xkey));
+	explicit_bzero(fk, sizeof(fk));
+
+	return true;
+}
+
+/*
+ * Writes AT_IV and AT_ENCR_DATA holding AT_COUNTER and, if the counter was
+ * not fresh, AT_COUNTER_TOO_SMALL.  Always 40 bytes.
+ */
+static size_t eap_sim_add_encr_counter(uint8_t *buf, const uint8_t *k_encr,
+					uint16_t counter, bool too_small)
+{
+	uint8_t iv[EAP_SIM_IV_LEN];
+	uint8_t plain[16];
+	uint8_t counter_be[2];
+	uint8_t *pos = plain;
+	struct l_cipher *cipher;
+	size_t r;
+	bool ok;
+
+	l_put_be16(counter, counter_be);
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_COUNTER,
+					EAP_SIM_PAD_NONE, counter_be, 2);
+
+	if (too_small)
+		pos += eap_sim_add_attribute(pos, EAP_SIM_AT_COUNTER_TOO_SMALL,
+						EAP_SIM_PAD_NONE, NULL, 2);
+
+	/* Pad to the AES block size */
+	eap_sim_add_attribute(pos, EAP_SIM_AT_PADDING, EAP_SIM_PAD_NONE, NULL,
+				plain + sizeof(plain) - pos - 2);
+
+	l_getrandom(iv, sizeof(iv));
+
+	r = eap_sim_add_attribute(buf, EAP_SIM_AT_IV, EAP_SIM_PAD_ZERO, iv,
+					sizeof(iv));
+	r += eap_sim_add_attribute(buf + r, EAP_SIM_AT_ENCR_DATA,
+					EAP_SIM_PAD_ZERO, NULL, sizeof(plain));
+
+	cipher = l_cipher_new(L_CIPHER_AES_CBC, k_encr, EAP_SIM_K_ENCR_LEN);
+	ok = cipher && l_cipher_set_iv(cipher, iv, sizeof(iv)) &&
+		l_cipher_encrypt(cipher, plain, buf + r - sizeof(plain),
+					sizeof(plain));
+	l_cipher_free(cipher);
+
+	return ok ? r : 0;
+}
+
+int eap_sim_reauth_respond(struct eap_state *eap, enum eap_type type,
+				const uint8_t *pkt, size_t len,
+				struct eap_sim_reauth *reauth,
+				uint8_t *msk, uint8_t *emsk,
+				uint8_t *session_id,
+				uint8_t *out, size_t *out_len)
+{
+	struct eap_sim_encr_attrs attrs = {};
+	struct eap_sim_tlv_iter iter;
+	const uint8_t *mac = NULL;
+	_auto_(l_free) uint8_t *plain = NULL;
+	size_t plain_len = 0;
+	uint8_t mac_buf[EAP_SIM_REAUTH_RESPONSE_LEN + EAP_SIM_NONCE_S_LEN];
+	uint8_t *pos = mac_buf;
+	size_t encr_len;
+	bool too_small;
+	int r = -EBADMSG;
+
+	if (len < 3 || type == EAP_TYPE_AKA_PRIME)
+		return -EINVAL;
+
+	if (!reauth->reauth_id) {
+		l_error("Re-authentication without a re-authentication ID");
+		return -ENOENT;
+	}
+
+	eap_sim_tlv_iter_init(&iter, pkt + 3, len - 3);
+
+	while (eap_sim_tlv_iter_next(&iter)) {
+		uint8_t at = eap_sim_tlv_iter_get_type(&iter);
+
+		switch (at) {
+		case EAP_SIM_AT_MAC:
+			if (eap_sim_tlv_iter_get_length(&iter) <
+							2 + EAP_SIM_MAC_LEN)
+				return -EINVAL;
+
+			mac = (const uint8_t *)
+				eap_sim_tlv_iter_get_data(&iter) + 2;
+			break;
+		case EAP_SIM_AT_IV:
+		case EAP_SIM_AT_ENCR_DATA:
+		case EAP_SIM_AT_RESULT_IND:
+		case EAP_SIM_AT_CHECKCODE:
+		case EAP_SIM_AT_PADDING:
+			break;
+		default:
+			if (at >= 128)
+				break;
+
+			l_error("attribute %u not allowed in "
+					"Re-authentication", at);
+			return -EINVAL;
+		}
+	}
+
+	if (!mac || !eap_sim_verify_mac(eap, type, pkt, len, reauth->k_aut,
+					NULL, 0))
+		return -EBADMSG;
+
+	if (!eap_sim_decrypt_encr_data(reauth->k_encr, pkt, len,
+					&plain, &plain_len) || !plain)
+		return -EBADMSG;
+
+	if (!eap_sim_parse_encr_attrs(plain, plain_len, &attrs) ||
+			!attrs.has_counter || !attrs.nonce_s) {
+		l_error("AT_COUNTER or AT_NONCE_S missing");
+		goto done;
+	}
+
+	/* RFC 4186 Section 5.5 */
+	too_small = attrs.counter <= reauth->counter;
+
+	pos += eap_sim_build_header(eap, type, EAP_SIM_ST_REAUTHENTICATION,
+					pos, EAP_SIM_REAUTH_RESPONSE_LEN);
+
+	encr_len = eap_sim_add_encr_counter(pos, reauth->k_encr,
+						attrs.counter, too_small);
+	if (!encr_len) {
+		r = -EIO;
+		goto done;
+	}
+
+	pos += encr_len;
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_MAC, EAP_SIM_PAD_ZERO,
+					NULL, EAP_SIM_MAC_LEN);
+
+	/* The response MAC also covers NONCE_S */
+	memcpy(pos, attrs.nonce_s, EAP_SIM_NONCE_S_LEN);
+
+	if (!eap_sim_derive_mac(type, mac_buf,
+				EAP_SIM_REAUTH_RESPONSE_LEN +
+				EAP_SIM_NONCE_S_LEN, reauth->k_aut,
+				pos - EAP_SIM_MAC_LEN)) {
+		r = -EIO;
+		goto done;
+	}
+
+	memcpy(out, mac_buf, EAP_SIM_REAUTH_RESPONSE_LEN);
+	*out_len = EAP_SIM_REAUTH_RESPONSE_LEN;
+
+	if (too_small) {
+		l_debug("Re-authentication counter %u not fresh (%u)",
+				attrs.counter, reauth->counter);
+		r = -ERANGE;
+		goto done;
+	}
+
+	if (!eap_sim_derive_reauth_keys(reauth->reauth_id, attrs.counter,
+					attrs.nonce_s, reauth->mk,
+					msk, emsk)) {
+		r = -EIO;
+		goto done;
+	}
+
+	session_id[0] = type;
+	memcpy(session_id + 1, attrs.nonce_s, EAP_SIM_NONCE_S_LEN);
+	memcpy(session_id + 1 + EAP_SIM_NONCE_S_LEN, mac, EAP_SIM_MAC_LEN);
+
+	reauth->counter = attrs.counter;
+	l_free(reauth->reauth_id);
+	reauth->reauth_id = l_steal_ptr(attrs.next_reauth_id);
+
+	r = EAP_SIM_REAUTH_RESPONSE_LEN;
+
+done:
+	explicit_bzero(plain, plain_len);
+	eap_sim_encr_attrs_free(&attrs);
+	return r;
+}
+
+static eap_sim_reauth_cache_load_func_t reauth_cache_load;
+static eap_sim_reauth_cache_sync_func_t reauth_cache_sync;
+
+void eap_sim_set_reauth_cache_ops(eap_sim_reauth_cache_load_func_t load,
+				eap_sim_reauth_cache_sync_func_t sync)
+{
+	reauth_cache_load = load;
+	reauth_cache_sync = sync;
+}
+
+static const char *eap_sim_method_name(enum eap_type type)
+{
+	switch (type) {
+	case EAP_TYPE_SIM:
+		return "SIM";
+	case EAP_TYPE_AKA:
+		return "AKA";
+	case EAP_TYPE_AKA_PRIME:
+		return "AKA'";
+	default:
+		return NULL;
+	}
+}
+
+static bool eap_sim_reauth_load_key(struct l_settings *cache,
+					const char *peer_id, const char *key,
+					uint8_t *out, size_t len)
+{
+	_auto_(l_free) uint8_t *value = NULL;
+	size_t value_len;
+	bool r;
+
+	value = l_settings_get_bytes(cache, peer_id, key, &value_len);
+	if (!value)
+		return false;
+
+	r = value_len == len;
+	if (r)
+		memcpy(out, value, len);
+
+	explicit_bzero(value, value_len);
+	return r;
+}
+
+bool eap_sim_reauth_load(const char *peer_id, enum eap_type type,
+				struct eap_sim_reauth *out)
+{
+	_auto_(l_settings_free) struct l_settings *cache = NULL;
+	const char *method;
+	unsigned int counter = 0;
+
+	if (!peer_id || !reauth_cache_load)
+		return false;
+
+	cache = reauth_cache_load();
+
+	method = l_settings_get_value(cache, peer_id, "Method");
+	if (!method || strcmp(method, eap_sim_method_name(type)))
+		return false;
+
+	out->pseudonym = l_settings_get_string(cache, peer_id, "Pseudonym");
+	out->reauth_id = l_settings_get_string(cache, peer_id,
+							"ReauthIdentity");
+
+	if (out->reauth_id && (!l_settings_get_uint(cache, peer_id,
+						"ReauthCounter", &counter) ||
+			counter > UINT16_MAX ||
+			!eap_sim_reauth_load_key(cache, peer_id, "MasterKey",
+						out->mk, EAP_SIM_MK_LEN) ||
+			!eap_sim_reauth_load_key(cache, peer_id,
+						"EncryptionKey", out->k_encr,
+						EAP_SIM_K_ENCR_LEN) ||
+			!eap_sim_reauth_load_key(cache, peer_id,
+						"AuthenticationKey", out->k_aut,
+						EAP_SIM_K_AUT_LEN))) {
+		l_warn("Ignoring incomplete re-authentication data for %s",
+				peer_id);
+		l_free(l_steal_ptr(out->reauth_id));
+	} else if (out->reauth_id)
+		out->counter = counter;
+
+	return out->pseudonym || out->reauth_id;
+}
+
+void eap_sim_reauth_save(const char *peer_id, enum eap_type type,
+				const struct eap_sim_reauth *reauth)
+{
+	_auto_(l_settings_free) struct l_settings *cache = NULL;
+
+	if (!peer_id || !reauth_cache_load || !reauth_cache_sync)
+		return;
+
+	cache = reauth_cache_load();
+	l_settings_remove_group(cache, peer_id);
+
+	if (!reauth->pseudonym && !reauth->reauth_id)
+		goto sync;
+
+	l_settings_set_string(cache, peer_id, "Method",
+				eap_sim_method_name(type));
+
+	if (reauth->pseudonym)
+		l_settings_set_string(cache, peer_id, "Pseudonym",
+					reauth->pseudonym);
+
+	if (!reauth->reauth_id)
+		goto sync;
+
+	l_settings_set_string(cache, peer_id, "ReauthIdentity",
+				reauth->reauth_id);
+	l_settings_set_uint(cache, peer_id, "ReauthCounter", reauth->counter);
+	l_settings_set_bytes(cache, peer_id, "MasterKey", reauth->mk,
+				EAP_SIM_MK_LEN);
+	l_settings_set_bytes(cache, peer_id, "EncryptionKey", reauth->k_encr,
+				EAP_SIM_K_ENCR_LEN);
+	l_settings_set_bytes(cache, peer_id, "AuthenticationKey",
+				reauth->k_aut, EAP_SIM_K_AUT_LEN);
+
+sync:
+	reauth_cache_sync(cache);
+}
+
+void eap_sim_forget_peer(const char *peer_id)
+{
+	_auto_(l_settings_free) struct l_settings *cache = NULL;
+
+	if (!reauth_cache_load || !reauth_cache_sync)
+		return;
+
+	cache = reauth_cache_load();
+
+	if (l_settings_remove_group(cache, peer_id))
+		reauth_cache_sync(cache);
+}
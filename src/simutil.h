@@ -35,6 +35,13 @@
 #define EAP_AKA_K_RE_LEN	32
 #define EAP_AKA_IK_LEN		16
 #define EAP_AKA_CK_LEN		16
+#define EAP_SIM_NONCE_S_LEN	16
+/* Method type | NONCE_S | MAC, RFC 5247 Section 2 */
+#define EAP_SIM_REAUTH_SESSION_ID_LEN	(1 + EAP_SIM_NONCE_S_LEN + \
+							EAP_SIM_MAC_LEN)
+
+/* Re-authentication subtype, shared by EAP-SIM and EAP-AKA */
+#define EAP_SIM_ST_REAUTHENTICATION	0x0d
 
 /*
  * Possible pad types for EAP-SIM/EAP-AKA attributes
@@ -81,6 +88,7 @@ enum eap_sim_at {
 	EAP_SIM_AT_SELECTED_VERSION	= 0x10,
 	EAP_SIM_AT_FULLAUTH_ID_REQ	= 0x11,
 	EAP_SIM_AT_COUNTER		= 0x13,
+	EAP_SIM_AT_COUNTER_TOO_SMALL	= 0x14,
 	EAP_SIM_AT_NONCE_S		= 0x15,
 	EAP_SIM_AT_CLIENT_ERROR_CODE	= 0x16,
 	EAP_SIM_AT_KDF_INPUT		= 0x17,
@@ -279,3 +287,78 @@ uint8_t eap_sim_tlv_iter_get_type(struct eap_sim_tlv_iter *iter);
 uint16_t eap_sim_tlv_iter_get_length(struct eap_sim_tlv_iter *iter);
 
 const void *eap_sim_tlv_iter_get_data(struct eap_sim_tlv_iter *iter);
+
+/*
+ * Fast re-authentication state (RFC 4186 Section 5, RFC 4187 Section 5).
+ *
+ * pseudonym - last AT_NEXT_PSEUDONYM received, may be NULL
+ * reauth_id - last AT_NEXT_REAUTH_ID received, NULL if fast
+ *             re-authentication is not possible
+ * counter - last counter value used in a re-authentication, 0 after a full
+ *           authentication
+ * mk, k_encr, k_aut - keys from the full authentication, reused for every
+ *                     re-authentication until the next full authentication
+ */
+struct eap_sim_reauth {
+	char *pseudonym;
+	char *reauth_id;
+	uint16_t counter;
+	uint8_t mk[EAP_SIM_MK_LEN];
+	uint8_t k_encr[EAP_SIM_K_ENCR_LEN];
+	uint8_t k_aut[EAP_SIM_K_AUT_LEN];
+};
+
+void eap_sim_reauth_clear(struct eap_sim_reauth *reauth);
+
+/*
+ * Picks the identity to present to the server given the kind of identity
+ * request (one of EAP_SIM_AT_*_ID_REQ, or 0 if none) it made.
+ */
+const char *eap_sim_reauth_select_identity(const struct eap_sim_reauth *reauth,
+						uint8_t id_req,
+						const char *permanent);
+
+/*
+ * Decrypt AT_ENCR_DATA, if present, from a Challenge packet and update
+ * the pseudonym and re-authentication identity with any AT_NEXT_PSEUDONYM
+ * and AT_NEXT_REAUTH_ID found.  The re-authentication identity is cleared
+ * if the server didn't provide a new one.
+ *
+ * pkt - start of the EAP-SIM/AKA packet (subtype)
+ */
+bool eap_sim_reauth_update_ids(struct eap_sim_reauth *reauth,
+				const uint8_t *k_encr,
+				const uint8_t *pkt, size_t len);
+
+/*
+ * Process a Re-authentication request and build the response into 'out'.
+ * 'out' must be at least EAP_SIM_REAUTH_RESPONSE_LEN bytes.
+ *
+ * Returns the response length on success, in which case msk, emsk and
+ * session_id have been derived and 'reauth' is updated with the new counter
+ * and re-authentication identity.
+ *
+ * Returns -ERANGE if the server's counter was not fresh.  A response
+ * carrying AT_COUNTER_TOO_SMALL is still built, after which the server
+ * is expected to fall back to a full authentication.  'out_len' holds its
+ * length.
+ *
+ * Any other negative value means the request was invalid.
+ */
+#define EAP_SIM_REAUTH_RESPONSE_LEN	(8 + 20 + 20 + 4 + EAP_SIM_MAC_LEN)
+
+int eap_sim_reauth_respond(struct eap_state *eap, enum eap_type type,
+				const uint8_t *pkt, size_t len,
+				struct eap_sim_reauth *reauth,
+				uint8_t *msk, uint8_t *emsk,
+				uint8_t *session_id,
+				uint8_t *out, size_t *out_len);
+
+/*
+ * Persistent per-network storage of struct eap_sim_reauth, keyed by the
+ * EAP peer ID.  The cache ops and eap_sim_forget_peer() are in eap.h.
+ */
+bool eap_sim_reauth_load(const char *peer_id, enum eap_type type,
+				struct eap_sim_reauth *out);
+void eap_sim_reauth_save(const char *peer_id, enum eap_type type,
+				const struct eap_sim_reauth *reauth);
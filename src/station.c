@@ -50,6 +50,8 @@
 #include "src/handshake.h"
 #include "src/station.h"
 #include "src/blacklist.h"
+#include "src/bss-history.h"
+#include "src/channel-stats.h"
 #include "src/mpdu.h"
 #include "src/erp.h"
 #include "src/netconfig.h"
@@ -63,6 +65,7 @@
 #include "src/eap.h"
 #include "src/eap-tls-common.h"
 #include "src/storage.h"
+#include "src/topology.h"
 
 #define STATION_RECENT_NETWORK_LIMIT	5
 #define STATION_RECENT_FREQS_LIMIT	5
@@ -88,6 +91,8 @@ struct station {
 	struct l_queue *autoconnect_list;
 	struct l_queue *bss_list;
 	struct l_queue *hidden_bss_list_sorted;
+	/* Drops BSSes no scan has seen for STATION_BSS_MAX_AGE */
+	struct l_timeout *bss_expire_timeout;
 	struct l_hashmap *networks;
 	struct l_queue *networks_sorted;
 	struct l_dbus_message *connect_pending;
@@ -115,6 +120,8 @@ struct station {
 
 	/* Set of frequencies to scan first when attempting a roam */
 	struct scan_freq_set *roam_freqs;
+	/* Non-FT neighbors to try before falling back to a full scan */
+	struct scan_freq_set *roam_fallback_freqs;
 	struct l_queue *roam_bss_list;
 
 	/* Frequencies split into subsets by priority */
@@ -133,6 +140,7 @@ struct station {
 
 	bool preparing_roam : 1;
 	bool roam_scan_full : 1;
+	bool roam_scan_fallback : 1;
 	bool signal_low : 1;
 	bool ap_directed_roaming : 1;
 	bool scanning : 1;
@@ -613,27 +621,44 @@ static bool bss_match(const void *a, const void *b)
 struct bss_expiration_data {
 	struct scan_bss *connected_bss;
 	uint64_t now;
+	uint64_t max_age;
 	const struct scan_freq_set *freqs;
 	struct station *station;
 };
 
 #define SCAN_RESULT_BSS_RETENTION_TIME (30 * 1000000)
 
-static bool bss_free_if_expired(void *data, void *user_data)
-{
-	struct scan_bss *bss = data;
-	struct bss_expiration_data *expiration_data = user_data;
+/*
+ * BSSes are also dropped once this old, on any frequency, even if no scan has
+ * covered their channel since, e.g. between long periodic scan intervals or
+ * while connected
+ */
+#define STATION_BSS_MAX_AGE (600 * 1000000ULL)
+#define STATION_BSS_EXPIRE_RETRY_INTERVAL 60
 
+static bool bss_is_expired(const struct scan_bss *bss,
+			const struct bss_expiration_data *expiration_data)
+{
 	if (bss == expiration_data->connected_bss)
 		/* Do not expire the currently connected BSS. */
 		return false;
 
 	/* Keep any BSSes that are not on the frequency list */
-	if (!scan_freq_set_contains(expiration_data->freqs, bss->frequency))
+	if (expiration_data->freqs &&
+			!scan_freq_set_contains(expiration_data->freqs,
+						bss->frequency))
 		return false;
 
-	if (l_time_before(expiration_data->now,
-			bss->time_stamp + SCAN_RESULT_BSS_RETENTION_TIME))
+	return !l_time_before(expiration_data->now,
+				bss->time_stamp + expiration_data->max_age);
+}
+
+static bool bss_free_if_expired(void *data, void *user_data)
+{
+	struct scan_bss *bss = data;
+	struct bss_expiration_data *expiration_data = user_data;
+
+	if (!bss_is_expired(bss, expiration_data))
 		return false;
 
 	station_unregister_bss(expiration_data->station, bss);
@@ -643,19 +668,51 @@ static bool bss_free_if_expired(void *data, void *user_data)
 	return true;
 }
 
+/*
+ * Removes BSSes older than max_age.  If freqs is given only BSSes on those
+ * frequencies are considered, otherwise BSSes on any frequency.
+ */
 static void station_bss_list_remove_expired_bsses(struct station *station,
-					const struct scan_freq_set *freqs)
+					const struct scan_freq_set *freqs,
+					uint64_t max_age)
 {
 	struct bss_expiration_data data = {
 		.now = l_time_now(),
-		.connected_bss = station->connected_bss,
+		.max_age = max_age,
 		.freqs = freqs,
+		.connected_bss = station->connected_bss,
 		.station = station,
 	};
 
 	l_queue_foreach_remove(station->bss_list, bss_free_if_expired, &data);
 }
 
+/* Finds the time stamp of the oldest BSS that can expire, if any */
+static bool station_bss_list_oldest(struct station *station,
+					uint64_t *out_time_stamp)
+{
+	const struct l_queue_entry *entry;
+	bool found = false;
+
+	for (entry = l_queue_get_entries(station->bss_list); entry;
+						entry = entry->next) {
+		const struct scan_bss *bss = entry->data;
+
+		if (bss == station->connected_bss)
+			continue;
+
+		if (found && !l_time_before(bss->time_stamp, *out_time_stamp))
+			continue;
+
+		*out_time_stamp = bss->time_stamp;
+		found = true;
+	}
+
+	return found;
+}
+
+static void station_bss_expire_schedule(struct station *station);
+
 struct nai_search {
 	struct network *network;
 	const char **realms;
@@ -1016,17 +1073,21 @@ static bool bss_free_if_ssid_not_utf8(void *data, void *user_data)
 }
 
 /*
- * Used when scan results were obtained; either from scan running
- * inside station module or scans running in other state machines, e.g. wsc
+ * Merges new_bss_list into the BSSes already known, dropping those on
+ * expire_freqs (any frequency if NULL) whose last reading is older than
+ * max_age, and rebuilds the network list.
  */
-void station_set_scan_results(struct station *station,
-					struct l_queue *new_bss_list,
-					const struct scan_freq_set *freqs,
-					bool trigger_autoconnect)
+static void station_update_bss_list(struct station *station,
+				struct l_queue *new_bss_list,
+				const struct scan_freq_set *freqs,
+				bool trigger_autoconnect,
+				const struct scan_freq_set *expire_freqs,
+				uint64_t max_age)
 {
 	const struct l_queue_entry *bss_entry;
 	struct network *network;
 	struct process_network_data data;
+	uint64_t now = l_time_now();
 
 	l_queue_foreach_remove(new_bss_list, bss_free_if_ssid_not_utf8, NULL);
 
@@ -1038,7 +1099,7 @@ void station_set_scan_results(struct station *station,
 	l_queue_destroy(station->autoconnect_list, NULL);
 	station->autoconnect_list = NULL;
 
-	station_bss_list_remove_expired_bsses(station, freqs);
+	station_bss_list_remove_expired_bsses(station, expire_freqs, max_age);
 
 	for (bss_entry = l_queue_get_entries(station->bss_list); bss_entry;
 						bss_entry = bss_entry->next) {
@@ -1055,7 +1116,9 @@ void station_set_scan_results(struct station *station,
 			continue;
 		}
 
-		if (old_bss == station->connected_bss) {
+		if (old_bss == station->connected_bss &&
+				scan_freq_set_contains(freqs,
+							old_bss->frequency)) {
 			l_warn("Connected BSS not in scan results");
 			station->connected_bss->rank = 0;
 		}
@@ -1068,7 +1131,13 @@ void station_set_scan_results(struct station *station,
 	for (bss_entry = l_queue_get_entries(new_bss_list); bss_entry;
 						bss_entry = bss_entry->next) {
 		struct scan_bss *bss = bss_entry->data;
-		struct network *network = station_add_seen_bss(station, bss);
+		struct network *network;
+
+		/* Cached BSSes rank lower the longer they go unseen */
+		if (bss != station->connected_bss)
+			scan_bss_age_rank(bss, now);
+
+		network = station_add_seen_bss(station, bss);
 
 		if (!network)
 			continue;
@@ -1091,6 +1160,95 @@ void station_set_scan_results(struct station *station,
 
 	station->autoconnect_can_start = trigger_autoconnect;
 	station_autoconnect_start(station);
+
+	station_bss_expire_schedule(station);
+}
+
+/*
+ * Used when scan results were obtained; either from scan running
+ * inside station module or scans running in other state machines, e.g. wsc
+ */
+void station_set_scan_results(struct station *station,
+					struct l_queue *new_bss_list,
+					const struct scan_freq_set *freqs,
+					bool trigger_autoconnect)
+{
+	station_update_bss_list(station, new_bss_list, freqs,
+				trigger_autoconnect, freqs,
+				SCAN_RESULT_BSS_RETENTION_TIME);
+}
+
+static void station_bss_expire_timeout(struct l_timeout *timeout,
+					void *user_data)
+{
+	struct station *station = user_data;
+	_auto_(scan_freq_set_free) struct scan_freq_set *freqs = NULL;
+	uint64_t oldest;
+
+	/*
+	 * Rebuilding the network list resets the autoconnect list, leave
+	 * it alone while a connection attempt may still fall back on it.
+	 */
+	switch (station->state) {
+	case STATION_STATE_DISCONNECTED:
+	case STATION_STATE_AUTOCONNECT_QUICK:
+	case STATION_STATE_AUTOCONNECT_FULL:
+	case STATION_STATE_CONNECTED:
+		break;
+	default:
+		l_timeout_modify(timeout, STATION_BSS_EXPIRE_RETRY_INTERVAL);
+		return;
+	}
+
+	/* The BSS the timer was armed for may have been seen again since */
+	if (!station_bss_list_oldest(station, &oldest) ||
+			l_time_before(l_time_now(),
+					oldest + STATION_BSS_MAX_AGE)) {
+		station_bss_expire_schedule(station);
+		return;
+	}
+
+	l_debug("Expiring BSSes not seen for %llu seconds",
+			STATION_BSS_MAX_AGE / 1000000);
+
+	/*
+	 * No new results, only drop the expired BSSes and re-rank the rest.
+	 * This also re-arms the timer for the next BSS to expire, if any.
+	 */
+	freqs = scan_freq_set_new();
+	station_update_bss_list(station, l_queue_new(), freqs,
+				station->autoconnect_can_start, NULL,
+				STATION_BSS_MAX_AGE);
+}
+
+/*
+ * Arms the expiry timer for when the oldest BSS reaches STATION_BSS_MAX_AGE,
+ * or removes it if there is nothing left that could expire.
+ */
+static void station_bss_expire_schedule(struct station *station)
+{
+	uint64_t oldest;
+	uint64_t now = l_time_now();
+	uint64_t expires;
+	unsigned int seconds = 1;
+
+	if (!station_bss_list_oldest(station, &oldest)) {
+		l_timeout_remove(l_steal_ptr(station->bss_expire_timeout));
+		return;
+	}
+
+	expires = oldest + STATION_BSS_MAX_AGE;
+
+	/* Round up so the timer never fires before the oldest BSS expires */
+	if (l_time_before(now, expires))
+		seconds = l_time_to_secs(expires - now + 999999);
+
+	if (station->bss_expire_timeout)
+		l_timeout_modify(station->bss_expire_timeout, seconds);
+	else
+		station->bss_expire_timeout = l_timeout_create(seconds,
+						station_bss_expire_timeout,
+						station, NULL);
 }
 
 static void station_reconnect(struct station *station);
@@ -1459,6 +1617,7 @@ static struct scan_freq_set *station_get_allowed_freqs(struct station *station)
 
 static uint32_t station_scan_trigger(struct station *station,
 					struct scan_freq_set *freqs,
+					bool full_scan,
 					scan_trigger_func_t triggered,
 					scan_notify_func_t notify,
 					scan_destroy_func_t destroy)
@@ -1469,13 +1628,21 @@ static uint32_t station_scan_trigger(struct station *station,
 	memset(&params, 0, sizeof(params));
 	params.flush = true;
 	params.freqs = freqs;
+	params.planned = full_scan;
 
 	if (wiphy_can_randomize_mac_addr(station->wiphy) ||
 			station->connected_bss ||
 				station_needs_hidden_network_scan(station)) {
-		/* If we're connected, HW cannot randomize our MAC */
-		if (!station->connected_bss)
-			params.randomize_mac_addr_hint = true;
+		/*
+		 * If we're connected, HW cannot randomize our MAC.  Keep the
+		 * time spent off the operating channel short as well.
+		 */
+		if (station->connected_bss)
+			return scan_active_sliced(id, &params, triggered,
+							notify, station,
+							destroy);
+
+		params.randomize_mac_addr_hint = true;
 
 		return scan_active_full(id, &params, triggered, notify,
 					station, destroy);
@@ -1485,6 +1652,69 @@ static uint32_t station_scan_trigger(struct station *station,
 					station, destroy);
 }
 
+static bool station_short_ssid_unknown(const struct network_info *info,
+					void *user_data)
+{
+	const uint32_t *short_ssid = user_data;
+
+	return ie_short_ssid((const uint8_t *) info->ssid,
+				strlen(info->ssid)) != *short_ssid;
+}
+
+/*
+ * Adds the 6 GHz channels of APs advertised in the Reduced Neighbor Reports
+ * of already seen BSSes, limited to those belonging to 'ssid' or, if NULL,
+ * to any known network.  These are mostly non-PSC channels which a regular
+ * scan plan leaves out, so probing them directly finds the 6 GHz APs of a
+ * known network without sweeping the whole band.
+ */
+static void station_add_colocated_6ghz_freqs(struct station *station,
+						const char *ssid,
+						struct scan_freq_set *freqs)
+{
+	const struct l_queue_entry *entry;
+	uint32_t wanted = 0;
+
+	if (ssid)
+		wanted = ie_short_ssid((const uint8_t *) ssid, strlen(ssid));
+
+	for (entry = l_queue_get_entries(station->bss_list); entry;
+						entry = entry->next) {
+		const struct scan_bss *bss = entry->data;
+		uint8_t i;
+
+		for (i = 0; i < bss->num_colocated_6ghz; i++) {
+			const struct ie_rnr_info *rnr =
+						&bss->colocated_6ghz[i];
+			uint32_t short_ssid;
+			uint32_t freq;
+
+			freq = band_channel_to_freq(rnr->channel,
+							BAND_FREQ_6_GHZ);
+			if (!freq || scan_freq_set_contains(freqs, freq))
+				continue;
+
+			if (rnr->short_ssid_present)
+				short_ssid = rnr->short_ssid;
+			else
+				short_ssid = ie_short_ssid(bss->ssid,
+								bss->ssid_len);
+
+			if (ssid && short_ssid != wanted)
+				continue;
+
+			if (!ssid && known_networks_foreach(
+						station_short_ssid_unknown,
+						&short_ssid))
+				continue;
+
+			l_debug("Adding co-located 6GHz AP frequency %u "
+				"reported by "MAC, freq, MAC_STR(bss->addr));
+			scan_freq_set_add(freqs, freq);
+		}
+	}
+}
+
 static bool station_quick_scan_results(int err, struct l_queue *bss_list,
 					const struct scan_freq_set *freqs,
 					void *userdata)
@@ -1572,6 +1802,8 @@ static int station_quick_scan_trigger(struct station *station)
 			known_6ghz)
 		return -ENOTSUP;
 
+	station_add_colocated_6ghz_freqs(station, NULL, known_freq_set);
+
 	allowed = station_get_allowed_freqs(station);
 	if (L_WARN_ON(!allowed))
 		return -ENOTSUP;
@@ -1582,7 +1814,7 @@ static int station_quick_scan_trigger(struct station *station)
 		return -ENOTSUP;
 
 	station->quick_scan_id = station_scan_trigger(station,
-						known_freq_set,
+						known_freq_set, false,
 						station_quick_scan_triggered,
 						station_quick_scan_results,
 						station_quick_scan_destroy);
@@ -1860,6 +2092,7 @@ static void station_roam_state_clear(struct station *station)
 	station->roam_trigger_timeout = NULL;
 	station->preparing_roam = false;
 	station->roam_scan_full = false;
+	station->roam_scan_fallback = false;
 	station->signal_low = false;
 	station->netconfig_after_roam = false;
 	station->last_roam_scan = 0;
@@ -1873,6 +2106,11 @@ static void station_roam_state_clear(struct station *station)
 		station->roam_freqs = NULL;
 	}
 
+	if (station->roam_fallback_freqs) {
+		scan_freq_set_free(station->roam_fallback_freqs);
+		station->roam_fallback_freqs = NULL;
+	}
+
 	l_queue_clear(station->roam_bss_list, l_free);
 
 	ft_clear_authentications(netdev_get_ifindex(station->netdev));
@@ -1898,6 +2136,8 @@ static void station_reset_connection_state(struct station *station)
 	if (station->netconfig)
 		netconfig_reset(station->netconfig);
 
+	network_topology_sync(network);
+
 	/* Refresh the ordered network list */
 	network_rank_update(station->connected_network, false);
 	l_queue_remove(station->networks_sorted, station->connected_network);
@@ -1907,6 +2147,9 @@ static void station_reset_connection_state(struct station *station)
 	station->connected_bss = NULL;
 	station->connected_network = NULL;
 
+	/* The BSS we were connected to can now expire */
+	station_bss_expire_schedule(station);
+
 #ifdef HAVE_DBUS
 	l_dbus_property_changed(dbus, netdev_get_path(station->netdev),
 				IWD_STATION_INTERFACE, "ConnectedNetwork");
@@ -2009,7 +2252,11 @@ static void station_parse_zero_oper_class(struct station *station,
 	}
 }
 
-static void station_add_neighbor_report_freqs(struct station *station,
+/*
+ * Returns the neighbor's frequency, or 0 if it is not supported or could
+ * not be determined unambiguously.
+ */
+static uint32_t station_add_neighbor_report_freqs(struct station *station,
 					struct ie_neighbor_report_info *info,
 					struct scan_freq_set *freq_set)
 {
@@ -2021,13 +2268,13 @@ static void station_add_neighbor_report_freqs(struct station *station,
 
 	if (info->oper_class == 0) {
 		station_parse_zero_oper_class(station, info, freq_set);
-		return;
+		return 0;
 	} else {
 		band = band_oper_class_to_band(country, info->oper_class);
 		if (!band) {
 			l_debug("Ignored: unsupported oper class");
 
-			return;
+			return 0;
 		}
 	}
 
@@ -2035,25 +2282,83 @@ static void station_add_neighbor_report_freqs(struct station *station,
 	if (!freq) {
 		l_debug("Ignored: unsupported channel");
 
-		return;
+		return 0;
 	}
 
 	/* Skip if the band/frequency is not supported */
 	if (!is_freq_band_supported(station, freq, band))
-		return;
+		return 0;
 
 	scan_freq_set_add(freq_set, freq);
+
+	return freq;
+}
+
+static int station_get_mdid(struct station *station)
+{
+	struct handshake_state *hs = netdev_get_handshake(station->netdev);
+	uint16_t mdid;
+
+	if (!hs->mde || ie_parse_mobility_domain_from_data(hs->mde,
+							hs->mde[1] + 2,
+							&mdid, NULL, NULL) < 0)
+		return TOPOLOGY_NO_MD;
+
+	return mdid;
+}
+
+/*
+ * Picks the channels of neighbors within our Mobility Domain if there are
+ * any, those of all other neighbors otherwise.  In the former case the
+ * other neighbors are returned in @fallback to be tried, without Fast
+ * Transition, before resorting to a full scan.
+ */
+static void station_split_roam_freqs(struct station *station,
+					struct scan_freq_set *freq_set_md,
+					struct scan_freq_set *freq_set_no_md,
+					struct scan_freq_set **set,
+					struct scan_freq_set **fallback)
+{
+	uint32_t current_freq = station->connected_bss->frequency;
+
+	*fallback = NULL;
+
+	if (!scan_freq_set_isempty(freq_set_md)) {
+		scan_freq_set_add(freq_set_md, current_freq);
+		*set = freq_set_md;
+
+		scan_freq_set_subtract(freq_set_no_md, freq_set_md);
+
+		if (!scan_freq_set_isempty(freq_set_no_md)) {
+			*fallback = freq_set_no_md;
+			return;
+		}
+	} else if (!scan_freq_set_isempty(freq_set_no_md)) {
+		scan_freq_set_add(freq_set_no_md, current_freq);
+		*set = freq_set_no_md;
+		scan_freq_set_free(freq_set_md);
+		return;
+	} else {
+		scan_freq_set_free(freq_set_md);
+		*set = NULL;
+	}
+
+	scan_freq_set_free(freq_set_no_md);
 }
 
 static void parse_neighbor_report(struct station *station,
 					const uint8_t *reports,
 					size_t reports_len,
-					struct scan_freq_set **set)
+					struct scan_freq_set **set,
+					struct scan_freq_set **fallback)
 {
 	struct ie_tlv_iter iter;
 	struct scan_freq_set *freq_set_md, *freq_set_no_md;
-	uint32_t current_freq = station->connected_bss->frequency;
 	struct handshake_state *hs = netdev_get_handshake(station->netdev);
+	struct topology *topo = network_get_topology(
+						station->connected_network);
+	int mdid = station_get_mdid(station);
+	uint64_t now = time(NULL);
 
 	freq_set_md = scan_freq_set_new();
 	freq_set_no_md = scan_freq_set_new();
@@ -2062,21 +2367,23 @@ static void parse_neighbor_report(struct station *station,
 
 	/* First see if any of the reports contain the MD bit set */
 	while (ie_tlv_iter_next(&iter)) {
-		struct ie_neighbor_report_info info;
+		struct ie_neighbor_report_info report;
+		uint32_t freq;
 
 		if (ie_tlv_iter_get_tag(&iter) != IE_TYPE_NEIGHBOR_REPORT)
 			continue;
 
-		if (ie_parse_neighbor_report(&iter, &info) < 0)
+		if (ie_parse_neighbor_report(&iter, &report) < 0)
 			continue;
 
 		l_debug("Neighbor report received for %s: ch %i "
 				"(oper class %i), %s",
-				util_address_to_string(info.addr),
-				(int) info.channel_num, (int) info.oper_class,
-				info.md ? "MD set" : "MD not set");
+				util_address_to_string(report.addr),
+				(int) report.channel_num,
+				(int) report.oper_class,
+				report.md ? "MD set" : "MD not set");
 
-		if (!memcmp(info.addr,
+		if (!memcmp(report.addr,
 				station->connected_bss->addr, ETH_ALEN)) {
 			/*
 			 * If this report is for the current AP, don't add
@@ -2087,11 +2394,18 @@ static void parse_neighbor_report(struct station *station,
 			continue;
 		}
 
-		station_add_neighbor_report_freqs(station, &info,
-						info.md && hs->mde ?
+		freq = station_add_neighbor_report_freqs(station, &report,
+						report.md && hs->mde ?
 						freq_set_md : freq_set_no_md);
+
+		if (freq && topo)
+			topology_neighbor_reported(topo, report.addr, freq,
+						report.md ? mdid :
+						TOPOLOGY_NO_MD, now);
 	}
 
+	network_topology_sync(station->connected_network);
+
 	/*
 	 * If there are neighbor reports with the MD bit set then the bit
 	 * is probably valid so scan only the frequencies of the neighbors
@@ -2102,30 +2416,11 @@ static void parse_neighbor_report(struct station *station,
 	 * In any case we only select the frequencies here and will check
 	 * the IEs in the scan results as the authoritative information
 	 * on whether we can use Fast Transition, and rank BSSes based on
-	 * that.
-	 *
-	 * TODO: possibly save the neighbors from outside the MD and if
-	 * none of the ones in the MD end up working, try a non-FT
-	 * transition to those neighbors.  We should be using a
-	 * blacklisting mechanism (for both initial connection and
-	 * transitions) so that cound_md would not count the
-	 * BSSes already used and when it goes down to 0 we'd
-	 * automatically fall back to the non-FT candidates and then to
-	 * full scan.
+	 * that.  The neighbors outside the MD are kept as a fallback and
+	 * tried before a full scan if none of the ones in the MD work out.
 	 */
-	if (!scan_freq_set_isempty(freq_set_md)) {
-		scan_freq_set_add(freq_set_md, current_freq);
-		*set = freq_set_md;
-		scan_freq_set_free(freq_set_no_md);
-	} else if (!scan_freq_set_isempty(freq_set_no_md)) {
-		scan_freq_set_add(freq_set_no_md, current_freq);
-		*set = freq_set_no_md;
-		scan_freq_set_free(freq_set_md);
-	} else {
-		scan_freq_set_free(freq_set_no_md);
-		scan_freq_set_free(freq_set_md);
-		*set = NULL;
-	}
+	station_split_roam_freqs(station, freq_set_md, freq_set_no_md,
+					set, fallback);
 }
 
 static void station_early_neighbor_report_cb(struct netdev *netdev, int err,
@@ -2145,8 +2440,12 @@ static void station_early_neighbor_report_cb(struct netdev *netdev, int err,
 	if (!reports || err)
 		return;
 
+	scan_freq_set_free(station->roam_freqs);
+	scan_freq_set_free(station->roam_fallback_freqs);
+
 	parse_neighbor_report(station, reports, reports_len,
-				&station->roam_freqs);
+				&station->roam_freqs,
+				&station->roam_fallback_freqs);
 }
 
 static bool station_can_fast_transition(struct station *station,
@@ -2270,7 +2569,11 @@ static bool netconfig_after_roam(struct station *station)
 
 static void station_roamed(struct station *station)
 {
+	blacklist_bss_event(station->connected_bss->addr,
+				BSS_HISTORY_CONNECTED);
+
 	station->roam_scan_full = false;
+	station->roam_scan_fallback = false;
 
 	/*
 	 * Schedule another roaming attempt in case the signal continues to
@@ -2288,6 +2591,13 @@ static void station_roamed(struct station *station)
 		station->roam_freqs = NULL;
 	}
 
+	if (station->roam_fallback_freqs) {
+		scan_freq_set_free(station->roam_fallback_freqs);
+		station->roam_fallback_freqs = NULL;
+	}
+
+	network_topology_sync(station->connected_network);
+
 	if (station->connected_bss->cap_rm_neighbor_report) {
 		if (netdev_neighbor_report_req(station->netdev,
 					station_early_neighbor_report_cb) < 0)
@@ -2313,6 +2623,7 @@ static void station_roam_retry(struct station *station)
 	 */
 	station->preparing_roam = false;
 	station->roam_scan_full = false;
+	station->roam_scan_fallback = false;
 	station->ap_directed_roaming = false;
 
 	if (station->signal_low)
@@ -2349,7 +2660,8 @@ static void station_roam_failed(struct station *station)
 
 	/*
 	 * If we tried a limited scan, failed and the signal is still low,
-	 * repeat with a full scan right away
+	 * repeat with the non-FT neighbors and then with a full scan right
+	 * away
 	 */
 	if (station->signal_low && !station->roam_scan_full) {
 		/*
@@ -2360,6 +2672,16 @@ static void station_roam_failed(struct station *station)
 		scan_cancel(netdev_get_wdev_id(station->netdev),
 						station->roam_scan_id);
 
+		if (station->roam_fallback_freqs &&
+				!station->roam_scan_fallback) {
+			station->roam_scan_fallback = true;
+			l_debug("Trying neighbors outside the Mobility Domain");
+
+			if (!station_roam_scan(station,
+						station->roam_fallback_freqs))
+				return;
+		}
+
 		if (!station_roam_scan(station, NULL))
 			return;
 	}
@@ -2383,8 +2705,11 @@ static void station_reassociate_cb(struct netdev *netdev,
 
 	if (result == NETDEV_RESULT_OK)
 		station_roamed(station);
-	else
+	else {
+		blacklist_bss_event(station->connected_bss->addr,
+					BSS_HISTORY_CONNECT_FAILED);
 		station_roam_failed(station);
+	}
 }
 
 static void station_netdev_event(struct netdev *netdev, enum netdev_event event,
@@ -2765,12 +3090,17 @@ static void station_update_roam_bss(struct station *station,
 	struct scan_bss *old =
 		l_queue_remove_if(station->bss_list, bss_match, bss);
 
+	/* Readings the roam scan did not refresh have aged since */
+	network_bss_list_age_ranks(network, station->connected_bss,
+					l_time_now());
 	network_bss_update(network, bss);
 	station_register_bss(network, bss);
 	l_queue_push_tail(station->bss_list, bss);
 
 	if (old)
 		scan_bss_free(old);
+
+	station_bss_expire_schedule(station);
 }
 
 static bool station_roam_scan_notify(int err, struct l_queue *bss_list,
@@ -2941,7 +3271,7 @@ static int station_roam_scan(struct station *station,
 	station->last_roam_scan = l_time_now();
 
 	station->roam_scan_id =
-		scan_active_full(netdev_get_wdev_id(station->netdev), &params,
+		scan_active_sliced(netdev_get_wdev_id(station->netdev), &params,
 					station_roam_scan_triggered,
 					station_roam_scan_notify, station,
 					station_roam_scan_destroy);
@@ -2964,6 +3294,8 @@ static int station_roam_scan_known_freqs(struct station *station)
 	if (!freqs)
 		return r;
 
+	station_add_colocated_6ghz_freqs(station, info->ssid, freqs);
+
 	if (!wiphy_constrain_freq_set(station->wiphy, freqs))
 		goto free_set;
 
@@ -3008,7 +3340,9 @@ static void station_neighbor_report_cb(struct netdev *netdev, int err,
 		return;
 	}
 
-	parse_neighbor_report(station, reports, reports_len, &freq_set);
+	scan_freq_set_free(station->roam_fallback_freqs);
+	parse_neighbor_report(station, reports, reports_len, &freq_set,
+				&station->roam_fallback_freqs);
 
 	r = station_roam_scan(station, freq_set);
 
@@ -3019,6 +3353,41 @@ static void station_neighbor_report_cb(struct netdev *netdev, int err,
 		station_roam_failed(station);
 }
 
+/*
+ * Uses the channels of the BSSes of this ESS seen previously, possibly
+ * before a restart, when no neighbor report has been received yet.
+ */
+static int station_roam_scan_topology(struct station *station)
+{
+	struct topology *topo = network_get_topology(
+						station->connected_network);
+	struct scan_freq_set *freq_set_md, *freq_set_no_md;
+	struct scan_freq_set *freq_set;
+	int r;
+
+	if (!topo || topology_isempty(topo))
+		return -ENODATA;
+
+	freq_set_md = scan_freq_set_new();
+	freq_set_no_md = scan_freq_set_new();
+
+	topology_get_roam_freqs(topo, station->connected_bss->addr,
+				station_get_mdid(station),
+				freq_set_md, freq_set_no_md);
+
+	scan_freq_set_free(station->roam_fallback_freqs);
+	station_split_roam_freqs(station, freq_set_md, freq_set_no_md,
+					&freq_set,
+					&station->roam_fallback_freqs);
+	if (!freq_set)
+		return -ENODATA;
+
+	r = station_roam_scan(station, freq_set);
+	scan_freq_set_free(freq_set);
+
+	return r;
+}
+
 static void station_start_roam(struct station *station)
 {
 	int r;
@@ -3040,6 +3409,9 @@ static void station_start_roam(struct station *station)
 			l_debug("Using cached neighbor report for roam");
 			return;
 		}
+	} else if (station_roam_scan_topology(station) == 0) {
+		l_debug("Using known ESS topology for roam");
+		return;
 	} else if (station->connected_bss->cap_rm_neighbor_report) {
 		if (netdev_neighbor_report_req(station->netdev,
 					station_neighbor_report_cb) == 0) {
@@ -3297,6 +3669,7 @@ static void station_event_roamed(struct station *station, struct scan_bss *new)
 	station->connected_bss = new;
 
 	l_queue_insert(station->bss_list, new, scan_bss_rank_compare, NULL);
+	station_bss_expire_schedule(station);
 
 	station_roamed(station);
 }
@@ -3378,6 +3751,8 @@ static bool station_retry_with_reason(struct station *station,
 	}
 
 	blacklist_add_bss(station->connected_bss->addr);
+	blacklist_bss_event(station->connected_bss->addr,
+				BSS_HISTORY_HANDSHAKE_FAILED);
 
 try_next:
 	return station_try_next_bss(station);
@@ -3409,6 +3784,9 @@ static bool station_retry_with_status(struct station *station,
 	else
 		blacklist_add_bss(station->connected_bss->addr);
 
+	blacklist_bss_event(station->connected_bss->addr,
+				BSS_HISTORY_CONNECT_FAILED);
+
 	iwd_notice(IWD_NOTICE_CONNECT_FAILED, "status: %u", status_code);
 
 	return station_try_next_bss(station);
@@ -3494,6 +3872,8 @@ static void station_connect_cb(struct netdev *netdev, enum netdev_result result,
 	switch (result) {
 	case NETDEV_RESULT_OK:
 		blacklist_remove_bss(station->connected_bss->addr);
+		blacklist_bss_event(station->connected_bss->addr,
+					BSS_HISTORY_CONNECTED);
 		station_connect_ok(station);
 		return;
 	case NETDEV_RESULT_DISCONNECTED:
@@ -3504,6 +3884,8 @@ static void station_connect_cb(struct netdev *netdev, enum netdev_result result,
 		/* Disconnected while connecting */
 		network_blacklist_add(station->connected_network,
 						station->connected_bss);
+		blacklist_bss_event(station->connected_bss->addr,
+					BSS_HISTORY_HANDSHAKE_FAILED);
 		if (station_try_next_bss(station))
 			return;
 
@@ -3589,6 +3971,8 @@ static void station_disconnect_event(struct station *station, void *event_data)
 	case STATION_STATE_NETCONFIG:
 		iwd_notice(IWD_NOTICE_DISCONNECT_INFO, "reason: %u",
 					l_get_u16(event_data));
+		blacklist_bss_event(station->connected_bss->addr,
+					BSS_HISTORY_DISCONNECTED);
 		station_disassociated(station);
 		return;
 	default:
@@ -3643,6 +4027,9 @@ static void station_beacon_lost(struct station *station)
 {
 	l_debug("Beacon lost event");
 
+	blacklist_bss_event(station->connected_bss->addr,
+				BSS_HISTORY_BEACON_LOSS);
+
 	if (station_cannot_roam(station))
 		return;
 
@@ -4018,7 +4405,7 @@ static struct l_dbus_message *station_dbus_connect_hidden_network(
 		struct scan_bss *target = network_bss_select(network, true);
 
 		/* Treat OWE transition networks special */
-		if (target->owe_trans)
+		if (!target || target->owe_trans)
 			goto not_hidden;
 
 		for (; entry; entry = entry->next) {
@@ -4325,6 +4712,7 @@ static bool station_dbus_scan_subset(struct station *station)
 
 	station->dbus_scan_id = station_scan_trigger(station,
 						station->scan_freqs_order[idx],
+						true,
 						station_dbus_scan_triggered,
 						station_dbus_scan_results,
 						NULL);
@@ -5066,6 +5454,8 @@ static void station_free(struct station *station)
 
 	station_roam_state_clear(station);
 
+	l_timeout_remove(station->bss_expire_timeout);
+
 	l_queue_destroy(station->networks_sorted, NULL);
 	l_hashmap_destroy(station->networks, network_free);
 	l_queue_destroy(station->bss_list, bss_free);
@@ -5535,7 +5925,7 @@ static struct l_dbus_message *station_debug_scan(struct l_dbus *dbus,
 		l_debug("added frequency %u", freqs[i]);
 	}
 
-	station->dbus_scan_id = station_scan_trigger(station, freq_set,
+	station->dbus_scan_id = station_scan_trigger(station, freq_set, false,
 						station_debug_scan_triggered,
 						station_debug_scan_results,
 						NULL);
@@ -5609,6 +5999,48 @@ static void station_append_byte_array(struct l_dbus_message_builder *builder,
 	l_dbus_message_builder_leave_dict(builder);
 }
 
+static void station_append_history_record(enum bss_history_event event,
+						uint64_t time,
+						uint64_t time_to_failure,
+						void *user_data)
+{
+	struct l_dbus_message_builder *builder = user_data;
+	uint32_t age = l_time_to_secs(l_time_diff(time, l_time_now()));
+	uint32_t connected = l_time_to_secs(time_to_failure);
+
+	l_dbus_message_builder_enter_struct(builder, "suu");
+	l_dbus_message_builder_append_basic(builder, 's',
+					bss_history_event_to_string(event));
+	l_dbus_message_builder_append_basic(builder, 'u', &age);
+	l_dbus_message_builder_append_basic(builder, 'u', &connected);
+	l_dbus_message_builder_leave_struct(builder);
+}
+
+/*
+ * Past connection outcomes as (event, seconds ago, seconds connected before
+ * failing), oldest first, along with the resulting rank penalty.
+ */
+static void station_append_bss_history(struct l_dbus_message_builder *builder,
+					const uint8_t *addr)
+{
+	const struct bss_history *history = blacklist_get_history();
+	double penalty = bss_history_get_penalty(history, addr, l_time_now());
+
+	dbus_append_dict_basic(builder, "HistoryPenalty", 'd', &penalty);
+
+	l_dbus_message_builder_enter_dict(builder, "sv");
+	l_dbus_message_builder_append_basic(builder, 's', "History");
+	l_dbus_message_builder_enter_variant(builder, "a(suu)");
+	l_dbus_message_builder_enter_array(builder, "(suu)");
+
+	bss_history_foreach(history, addr, station_append_history_record,
+				builder);
+
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_leave_variant(builder);
+	l_dbus_message_builder_leave_dict(builder);
+}
+
 static void station_append_bss_list(struct l_dbus_message_builder *builder,
 					const struct l_queue_entry *entry)
 {
@@ -5628,6 +6060,7 @@ static void station_append_bss_list(struct l_dbus_message_builder *builder,
 					util_address_to_string(bss->addr));
 
 		station_append_byte_array(builder, "MDE", bss->mde, 3);
+		station_append_bss_history(builder, bss->addr);
 
 		l_dbus_message_builder_leave_array(builder);
 	}
@@ -5674,6 +6107,72 @@ done:
 	return reply;
 }
 
+struct station_channel_stats_data {
+	struct l_dbus_message_builder *builder;
+	const struct channel_stats *stats;
+	uint64_t now;
+};
+
+static void station_append_channel_stats(uint32_t freq,
+					const struct channel_stats_info *info,
+					void *user_data)
+{
+	struct station_channel_stats_data *data = user_data;
+	struct l_dbus_message_builder *builder = data->builder;
+	bool quiet = channel_stats_is_quiet(data->stats, freq);
+
+	l_dbus_message_builder_enter_array(builder, "{sv}");
+
+	dbus_append_dict_basic(builder, "Frequency", 'u', &freq);
+	dbus_append_dict_basic(builder, "Scans", 'u', &info->scans);
+	dbus_append_dict_basic(builder, "OccupiedScans", 'u',
+					&info->occupied_scans);
+	dbus_append_dict_basic(builder, "EmptyStreak", 'u',
+					&info->empty_streak);
+	dbus_append_dict_basic(builder, "LastBSSCount", 'u',
+					&info->last_bss_count);
+	dbus_append_dict_basic(builder, "Occupancy", 'd', &info->occupancy);
+	dbus_append_dict_basic(builder, "Quiet", 'b', &quiet);
+
+	if (info->last_seen) {
+		uint32_t age = l_time_diff(info->last_seen, data->now) /
+							L_USEC_PER_SEC;
+
+		dbus_append_dict_basic(builder, "LastSeen", 'u', &age);
+	}
+
+	l_dbus_message_builder_leave_array(builder);
+}
+
+static struct l_dbus_message *station_debug_get_channel_stats(
+						struct l_dbus *dbus,
+						struct l_dbus_message *message,
+						void *user_data)
+{
+	struct station *station = user_data;
+	struct l_dbus_message *reply =
+				l_dbus_message_new_method_return(message);
+	struct station_channel_stats_data data = {
+		.builder = l_dbus_message_builder_new(reply),
+		.stats = scan_get_channel_stats(
+				netdev_get_wdev_id(station->netdev)),
+		.now = l_time_now(),
+	};
+
+	l_dbus_message_builder_enter_array(data.builder, "a{sv}");
+
+	if (data.stats)
+		channel_stats_foreach(data.stats,
+					station_append_channel_stats, &data);
+
+	l_dbus_message_builder_leave_array(data.builder);
+
+	l_dbus_message_builder_finalize(data.builder);
+	l_dbus_message_builder_destroy(data.builder);
+
+	return reply;
+}
+
 static void station_setup_debug_interface(
 					struct l_dbus_interface *interface)
 {
@@ -5689,6 +6188,9 @@ static void station_setup_debug_interface(
 	l_dbus_interface_method(interface, "GetNetworks", 0,
 				station_debug_get_networks, "a{oaa{sv}}", "",
 				"networks");
+	l_dbus_interface_method(interface, "GetChannelStats", 0,
+				station_debug_get_channel_stats, "aa{sv}", "",
+				"channels");
 
 	l_dbus_interface_signal(interface, "Event", 0, "sav", "name", "data");
 
@@ -5772,6 +6274,7 @@ static void station_known_networks_changed(enum known_networks_event event,
 
 	network_id = l_util_hexstring(info->ssid, strlen(info->ssid));
 	eap_tls_forget_peer(network_id);
+	eap_sim_forget_peer(network_id);
 }
 
 static int station_init(void)
@@ -5843,6 +6346,8 @@ static int station_init(void)
 
 	eap_tls_set_session_cache_ops(storage_eap_tls_cache_load,
 					storage_eap_tls_cache_sync);
+	eap_sim_set_reauth_cache_ops(storage_eap_sim_cache_load,
+					storage_eap_sim_cache_sync);
 	known_networks_watch = known_networks_watch_add(
 						station_known_networks_changed,
 						NULL, NULL);
@@ -54,7 +54,9 @@
 #define STORAGE_FILE_MODE (S_IRUSR | S_IWUSR)
 
 #define KNOWN_FREQ_FILENAME ".known_network.freq"
+#define TOPOLOGY_FILENAME ".known_network.topology"
 #define EAP_TLS_CACHE_FILENAME ".eap-tls-session-cache"
+#define EAP_SIM_CACHE_FILENAME ".eap-sim-reauth-cache"
 
 static char *storage_path = NULL;
 static char *storage_hotspot_path = NULL;
@@ -703,6 +705,29 @@ void storage_known_frequencies_sync(struct l_settings *known_freqs)
 	l_free(known_freq_file_path);
 }
 
+struct l_settings *storage_topology_load(void)
+{
+	_auto_(l_free) char *path = storage_get_path("/%s", TOPOLOGY_FILENAME);
+	struct l_settings *topology = l_settings_new();
+
+	if (!l_settings_load_from_file(topology, path)) {
+		l_settings_free(topology);
+		return NULL;
+	}
+
+	return topology;
+}
+
+void storage_topology_sync(const struct l_settings *topology)
+{
+	_auto_(l_free) char *path = storage_get_path("/%s", TOPOLOGY_FILENAME);
+	_auto_(l_free) char *data = NULL;
+	size_t len;
+
+	data = l_settings_to_data(topology, &len);
+	write_file(data, len, false, "%s", path);
+}
+
 struct l_settings *storage_eap_tls_cache_load(void)
 {
 	_auto_(l_free) char *path =
@@ -744,6 +769,116 @@ void storage_eap_tls_cache_sync(const struct l_settings *cache)
 	explicit_bzero(data, len);
 }
 
+/*
+ * The EAP-SIM/AKA re-authentication cache holds the keys from the last full
+ * authentication.  When profile encryption is enabled the whole cache is
+ * sealed into [Security].EncryptedSecurity with the system key, the same
+ * way __storage_encrypt() handles a profile's [Security] group.
+ */
+struct l_settings *storage_eap_sim_cache_load(void)
+{
+	_auto_(l_free) char *path =
+		storage_get_path("%s", EAP_SIM_CACHE_FILENAME);
+	_auto_(l_settings_free) struct l_settings *file = l_settings_new();
+	_auto_(l_free) uint8_t *encrypted = NULL;
+	_auto_(l_free) uint8_t *salt = NULL;
+	_auto_(l_free) char *decrypted = NULL;
+	struct l_settings *cache;
+	size_t elen, slen;
+	struct iovec ad[2];
+
+	if (!l_settings_load_from_file(file, path)) {
+		l_debug("No re-authentication cache loaded from %s", path);
+		return l_settings_new();
+	}
+
+	encrypted = l_settings_get_bytes(file, "Security",
+						"EncryptedSecurity", &elen);
+	salt = l_settings_get_bytes(file, "Security", "EncryptedSalt", &slen);
+
+	/* Written with encryption disabled, sealed on the next sync */
+	if (!encrypted && !salt)
+		return l_steal_ptr(file);
+
+	cache = l_settings_new();
+
+	if (!system_key_set || !encrypted || !salt || elen <= 16) {
+		l_warn("Can't decrypt %s, starting with an empty cache", path);
+		return cache;
+	}
+
+	decrypted = l_malloc(elen - 16 + 1);
+
+	ad[0].iov_base = (void *) salt;
+	ad[0].iov_len = slen;
+	ad[1].iov_base = (void *) EAP_SIM_CACHE_FILENAME;
+	ad[1].iov_len = strlen(EAP_SIM_CACHE_FILENAME);
+
+	if (!aes_siv_decrypt(system_key, sizeof(system_key), encrypted, elen,
+				ad, 2, decrypted)) {
+		l_error("Could not decrypt %s, did the secret change?", path);
+		return cache;
+	}
+
+	decrypted[elen - 16] = '\0';
+
+	if (!l_settings_load_from_data(cache, decrypted, elen - 16))
+		l_error("Could not load decrypted %s", path);
+
+	explicit_bzero(decrypted, elen - 16);
+
+	return cache;
+}
+
+void storage_eap_sim_cache_sync(const struct l_settings *cache)
+{
+	_auto_(l_free) char *path =
+		storage_get_path("%s", EAP_SIM_CACHE_FILENAME);
+	_auto_(l_settings_free) struct l_settings *sealed = NULL;
+	_auto_(l_free) uint8_t *enc = NULL;
+	_auto_(l_free) char *data = NULL;
+	uint8_t salt[32];
+	struct iovec ad[2];
+	size_t len;
+
+	data = l_settings_to_data(cache, &len);
+
+	/* Note this data contains keys, write_file() sets 0600 permissions */
+	if (!system_key_set)
+		goto write;
+
+	l_getrandom(salt, sizeof(salt));
+
+	ad[0].iov_base = (void *) salt;
+	ad[0].iov_len = sizeof(salt);
+	ad[1].iov_base = (void *) EAP_SIM_CACHE_FILENAME;
+	ad[1].iov_len = strlen(EAP_SIM_CACHE_FILENAME);
+
+	enc = l_malloc(len + 16);
+
+	if (!aes_siv_encrypt(system_key, sizeof(system_key), data, len,
+				ad, 2, enc)) {
+		l_error("Could not encrypt the re-authentication cache");
+		explicit_bzero(data, len);
+		return;
+	}
+
+	explicit_bzero(data, len);
+	l_free(data);
+
+	sealed = l_settings_new();
+	l_settings_set_bytes(sealed, "Security", "EncryptedSalt",
+				salt, sizeof(salt));
+	l_settings_set_bytes(sealed, "Security", "EncryptedSecurity",
+				enc, len + 16);
+
+	data = l_settings_to_data(sealed, &len);
+
+write:
+	write_file(data, len, false, "%s", path);
+	explicit_bzero(data, len);
+}
+
 bool storage_is_file(const char *filename)
 {
 	char *path;
@@ -0,0 +1,278 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "src/util.h"
+#include "src/topology.h"
+
+/*
+ * Per-ESS record of the BSSes making up a known network: where they operate,
+ * whether they are part of the Mobility Domain and how well they were last
+ * heard.  Learned from scan results and neighbor reports and persisted so
+ * that roam scans can be limited to the right channels even before the
+ * first neighbor report of a session has been received.
+ */
+
+#define ADDR_KEY_FMT "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx"
+
+struct topology_bss {
+	uint8_t addr[6];
+	uint32_t frequency;
+	int mdid;
+	int8_t signal;
+	bool scanned : 1;
+	uint64_t last_seen;
+};
+
+struct topology {
+	/* Most recently seen first */
+	struct l_queue *bss_list;
+};
+
+struct topology *topology_new(void)
+{
+	struct topology *topo = l_new(struct topology, 1);
+
+	topo->bss_list = l_queue_new();
+
+	return topo;
+}
+
+void topology_free(struct topology *topo)
+{
+	if (!topo)
+		return;
+
+	l_queue_destroy(topo->bss_list, l_free);
+	l_free(topo);
+}
+
+bool topology_isempty(const struct topology *topo)
+{
+	return l_queue_isempty(topo->bss_list);
+}
+
+unsigned int topology_get_size(const struct topology *topo)
+{
+	return l_queue_length(topo->bss_list);
+}
+
+static bool topology_bss_match(const void *a, const void *b)
+{
+	const struct topology_bss *bss = a;
+
+	return !memcmp(bss->addr, b, 6);
+}
+
+static void topology_evict_oldest(struct topology *topo)
+{
+	struct topology_bss *oldest = l_queue_peek_tail(topo->bss_list);
+
+	l_queue_remove(topo->bss_list, oldest);
+	l_free(oldest);
+}
+
+static struct topology_bss *topology_bss_touch(struct topology *topo,
+						const uint8_t *addr,
+						uint32_t frequency,
+						uint64_t now)
+{
+	struct topology_bss *bss;
+
+	bss = l_queue_remove_if(topo->bss_list, topology_bss_match, addr);
+	if (!bss) {
+		bss = l_new(struct topology_bss, 1);
+		memcpy(bss->addr, addr, 6);
+		bss->mdid = TOPOLOGY_NO_MD;
+
+		if (l_queue_length(topo->bss_list) >= TOPOLOGY_MAX_BSS)
+			topology_evict_oldest(topo);
+	}
+
+	bss->frequency = frequency;
+	bss->last_seen = now;
+	l_queue_push_head(topo->bss_list, bss);
+
+	return bss;
+}
+
+/* @signal is in 100 * dBm, as in struct scan_bss */
+void topology_bss_seen(struct topology *topo, const uint8_t *addr,
+			uint32_t frequency, int mdid, int32_t signal,
+			uint64_t now)
+{
+	struct topology_bss *bss = topology_bss_touch(topo, addr, frequency,
+							now);
+
+	signal /= 100;
+
+	bss->mdid = mdid;
+	bss->signal = signal < -127 ? -127 : signal > -1 ? -1 : signal;
+	bss->scanned = true;
+}
+
+/*
+ * The MD bit in a neighbor report is relative to the reporting AP and not
+ * always set correctly, the MDE seen in a scan takes precedence.
+ */
+void topology_neighbor_reported(struct topology *topo, const uint8_t *addr,
+				uint32_t frequency, int mdid, uint64_t now)
+{
+	struct topology_bss *bss = topology_bss_touch(topo, addr, frequency,
+							now);
+
+	if (!bss->scanned)
+		bss->mdid = mdid;
+}
+
+/*
+ * Splits the channels of all BSSes, other than the current one, into those
+ * of BSSes in Mobility Domain @mdid and all others.  Channels present in
+ * both sets are only added to @md_freqs.  Returns false if nothing was
+ * added.
+ */
+bool topology_get_roam_freqs(const struct topology *topo,
+				const uint8_t *current, int mdid,
+				struct scan_freq_set *md_freqs,
+				struct scan_freq_set *other_freqs)
+{
+	const struct l_queue_entry *entry;
+	bool found = false;
+
+	for (entry = l_queue_get_entries(topo->bss_list); entry;
+			entry = entry->next) {
+		const struct topology_bss *bss = entry->data;
+
+		if (current && !memcmp(bss->addr, current, 6))
+			continue;
+
+		if (mdid != TOPOLOGY_NO_MD && bss->mdid == mdid)
+			scan_freq_set_add(md_freqs, bss->frequency);
+		else
+			scan_freq_set_add(other_freqs, bss->frequency);
+
+		found = true;
+	}
+
+	scan_freq_set_subtract(other_freqs, md_freqs);
+
+	return found;
+}
+
+static int topology_bss_compare_last_seen(const void *a, const void *b,
+						void *user_data)
+{
+	const struct topology_bss *new_bss = a, *bss = b;
+
+	return bss->last_seen >= new_bss->last_seen ? 1 : -1;
+}
+
+/*
+ * Each BSS is stored under its address as "<frequency> <MDID> <signal>
+ * <last seen>", a MDID of -1 meaning no Mobility Domain and a signal of 0
+ * that the BSS has only been learned from neighbor reports.
+ */
+void topology_load(struct topology *topo, const struct l_settings *settings,
+			const char *group, uint64_t now)
+{
+	_auto_(l_strv_free) char **keys = l_settings_get_keys(settings, group);
+	unsigned int i;
+
+	for (i = 0; keys && keys[i]; i++) {
+		struct topology_bss *bss;
+		const char *value;
+		uint8_t addr[6];
+		uint32_t frequency;
+		int mdid;
+		int signal;
+		uint64_t last_seen;
+
+		if (strlen(keys[i]) != 12 || sscanf(keys[i], ADDR_KEY_FMT,
+					&addr[0], &addr[1], &addr[2],
+					&addr[3], &addr[4], &addr[5]) != 6)
+			continue;
+
+		value = l_settings_get_value(settings, group, keys[i]);
+		if (!value || sscanf(value, "%u %d %d %" SCNu64, &frequency,
+					&mdid, &signal, &last_seen) != 4)
+			continue;
+
+		if (mdid < TOPOLOGY_NO_MD || mdid > 0xffff ||
+				signal < INT8_MIN || signal > 0)
+			continue;
+
+		if (last_seen > now || now - last_seen > TOPOLOGY_MAX_AGE)
+			continue;
+
+		if (l_queue_find(topo->bss_list, topology_bss_match, addr))
+			continue;
+
+		bss = l_new(struct topology_bss, 1);
+		memcpy(bss->addr, addr, 6);
+		bss->frequency = frequency;
+		bss->mdid = mdid;
+		bss->signal = signal;
+		bss->scanned = signal != 0;
+		bss->last_seen = last_seen;
+
+		l_queue_insert(topo->bss_list, bss,
+				topology_bss_compare_last_seen, NULL);
+	}
+
+	while (l_queue_length(topo->bss_list) > TOPOLOGY_MAX_BSS)
+		topology_evict_oldest(topo);
+}
+
+/* Replaces all entries of @group, callers add any other keys afterwards */
+void topology_save(const struct topology *topo, struct l_settings *settings,
+			const char *group)
+{
+	const struct l_queue_entry *entry;
+
+	l_settings_remove_group(settings, group);
+
+	for (entry = l_queue_get_entries(topo->bss_list); entry;
+			entry = entry->next) {
+		const struct topology_bss *bss = entry->data;
+		char key[13];
+		char value[64];
+
+		snprintf(key, sizeof(key), "%02x%02x%02x%02x%02x%02x",
+				bss->addr[0], bss->addr[1], bss->addr[2],
+				bss->addr[3], bss->addr[4], bss->addr[5]);
+		snprintf(value, sizeof(value), "%u %d %d %" PRIu64,
+				bss->frequency, bss->mdid, bss->scanned ?
+				bss->signal : 0, bss->last_seen);
+
+		l_settings_set_value(settings, group, key, value);
+	}
+}
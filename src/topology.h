@@ -0,0 +1,56 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+struct l_settings;
+struct scan_freq_set;
+struct topology;
+
+/* Entries kept per ESS, the least recently seen BSS is evicted first */
+#define TOPOLOGY_MAX_BSS 32
+
+/* Entries not seen for this long (seconds) are dropped when loading */
+#define TOPOLOGY_MAX_AGE (30 * 24 * 60 * 60)
+
+/* No Mobility Domain, valid MDIDs are 16 bits */
+#define TOPOLOGY_NO_MD -1
+
+struct topology *topology_new(void);
+void topology_free(struct topology *topo);
+bool topology_isempty(const struct topology *topo);
+unsigned int topology_get_size(const struct topology *topo);
+
+void topology_bss_seen(struct topology *topo, const uint8_t *addr,
+			uint32_t frequency, int mdid, int32_t signal,
+			uint64_t now);
+void topology_neighbor_reported(struct topology *topo, const uint8_t *addr,
+				uint32_t frequency, int mdid, uint64_t now);
+
+bool topology_get_roam_freqs(const struct topology *topo,
+				const uint8_t *current, int mdid,
+				struct scan_freq_set *md_freqs,
+				struct scan_freq_set *other_freqs);
+
+void topology_load(struct topology *topo, const struct l_settings *settings,
+			const char *group, uint64_t now);
+void topology_save(const struct topology *topo, struct l_settings *settings,
+			const char *group);
@@ -601,3 +601,89 @@ struct scan_freq_set *scan_freq_set_clone(const struct scan_freq_set *set,
 
 	return new;
 }
+
+/*
+ * Default dwell times.  Active dwell only needs to cover probe response
+ * latency, passive dwell has to cover a 100 TU beacon interval and PSC dwell
+ * has to catch the 20 TU FILS Discovery / unsolicited Probe Response
+ * cadence of 6 GHz APs.
+ */
+#define SCAN_PLAN_ACTIVE_DWELL		30
+#define SCAN_PLAN_PASSIVE_DWELL		110
+#define SCAN_PLAN_PSC_DWELL		40
+
+struct scan_freq_plan *scan_freq_plan_new(void)
+{
+	struct scan_freq_plan *plan = l_new(struct scan_freq_plan, 1);
+
+	plan->active = scan_freq_set_new();
+	plan->passive = scan_freq_set_new();
+	plan->psc = scan_freq_set_new();
+	plan->active_dwell = SCAN_PLAN_ACTIVE_DWELL;
+	plan->passive_dwell = SCAN_PLAN_PASSIVE_DWELL;
+	plan->psc_dwell = SCAN_PLAN_PSC_DWELL;
+
+	return plan;
+}
+
+void scan_freq_plan_free(struct scan_freq_plan *plan)
+{
+	if (!plan)
+		return;
+
+	scan_freq_set_free(plan->active);
+	scan_freq_set_free(plan->passive);
+	scan_freq_set_free(plan->psc);
+	l_free(plan);
+}
+
+/*
+ * Sorts the channels of a single band into the plan.  'attrs' is indexed by
+ * channel number and holds num_channels + 1 entries, the same layout used by
+ * struct band.
+ */
+void scan_freq_plan_add_band(struct scan_freq_plan *plan, uint32_t band,
+				const struct band_freq_attrs *attrs,
+				size_t num_channels)
+{
+	unsigned int i;
+
+	for (i = 1; i <= num_channels && i <= UINT8_MAX; i++) {
+		uint32_t freq;
+
+		if (!attrs[i].supported || attrs[i].disabled)
+			continue;
+
+		freq = band_channel_to_freq(i, band);
+		if (!freq)
+			continue;
+
+		if (band == BAND_FREQ_6_GHZ) {
+			if (!band_6ghz_channel_is_psc(i))
+				continue;
+
+			if (attrs[i].no_ir)
+				scan_freq_set_add(plan->passive, freq);
+			else
+				scan_freq_set_add(plan->psc, freq);
+
+			continue;
+		}
+
+		if (attrs[i].no_ir)
+			scan_freq_set_add(plan->passive, freq);
+		else
+			scan_freq_set_add(plan->active, freq);
+	}
+}
+
+struct scan_freq_set *scan_freq_plan_get_all(const struct scan_freq_plan *plan)
+{
+	struct scan_freq_set *all = scan_freq_set_new();
+
+	scan_freq_set_merge(all, plan->active);
+	scan_freq_set_merge(all, plan->passive);
+	scan_freq_set_merge(all, plan->psc);
+
+	return all;
+}
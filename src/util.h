@@ -130,4 +130,33 @@ struct scan_freq_set *scan_freq_set_clone(const struct scan_freq_set *set,
 
 DEFINE_CLEANUP_FUNC(scan_freq_set_free);
 
+struct band_freq_attrs;
+
+/*
+ * Frequencies a wiphy can scan under the current regulatory domain, grouped
+ * by how they need to be scanned.  Channels where probing is allowed go into
+ * 'active', NO-IR channels into 'passive' and usable 6 GHz Preferred
+ * Scanning Channels into 'psc'.  Non-PSC 6 GHz channels are left out, these
+ * are discovered through reduced neighbor reports of co-located APs.
+ */
+struct scan_freq_plan {
+	struct scan_freq_set *active;
+	struct scan_freq_set *passive;
+	struct scan_freq_set *psc;
+	/* Per-channel dwell time in TUs, 0 leaves it up to the driver */
+	uint16_t active_dwell;
+	uint16_t passive_dwell;
+	uint16_t psc_dwell;
+};
+
+struct scan_freq_plan *scan_freq_plan_new(void);
+void scan_freq_plan_free(struct scan_freq_plan *plan);
+void scan_freq_plan_add_band(struct scan_freq_plan *plan, uint32_t band,
+				const struct band_freq_attrs *attrs,
+				size_t num_channels);
+struct scan_freq_set *scan_freq_plan_get_all(
+					const struct scan_freq_plan *plan);
+
+DEFINE_CLEANUP_FUNC(scan_freq_plan_free);
+
 #endif /* __UTIL_H */
@@ -56,6 +56,8 @@
 #include "src/nl80211util.h"
 #include "src/nl80211cmd.h"
 #include "src/band.h"
+#include "src/sched-scan.h"
+#include "src/wowlan.h"
 
 #define EXT_CAP_LEN 10
 
@@ -112,6 +114,12 @@ struct wiphy {
 	uint32_t feature_flags;
 	uint8_t ext_features[(NUM_NL80211_EXT_FEATURES + 7) / 8];
 	uint8_t max_num_ssids_per_scan;
+	struct sched_scan_caps sched_scan;
+	struct wowlan_caps wowlan;
+	/* Each user's WoWLAN triggers, programmed combined */
+	struct l_queue *wowlan_users;
+	/* WoWLAN triggers currently programmed */
+	uint32_t wowlan_triggers;
 	uint32_t max_roc_duration;
 	uint16_t max_scan_ie_len;
 	uint16_t supported_iftypes;
@@ -136,7 +144,6 @@ struct wiphy {
 	unsigned int get_reg_id;
 	unsigned int dump_id;
 
-	bool support_scheduled_scan:1;
 	bool support_rekey_offload:1;
 	bool support_qos_set_map:1;
 	bool support_cmds_auth_assoc:1;
@@ -369,6 +376,27 @@ static struct wiphy *wiphy_new(uint32_t id)
 	return wiphy;
 }
 
+struct wiphy_wowlan_user {
+	const void *owner;
+	uint32_t triggers;
+	struct sched_scan_request *nd;
+};
+
+static void wiphy_wowlan_user_free(void *data)
+{
+	struct wiphy_wowlan_user *user = data;
+
+	sched_scan_request_free(user->nd);
+	l_free(user);
+}
+
+static bool wiphy_wowlan_user_match(const void *a, const void *b)
+{
+	const struct wiphy_wowlan_user *user = a;
+
+	return user->owner == b;
+}
+
 static void destroy_work(void *user_data)
 {
 	struct wiphy_radio_work_item *work = user_data;
@@ -415,6 +443,7 @@ static void wiphy_free(void *data)
 	l_free(wiphy->driver_str);
 	l_genl_family_free(wiphy->nl80211);
 	l_queue_destroy(wiphy->work, destroy_work);
+	l_queue_destroy(wiphy->wowlan_users, wiphy_wowlan_user_free);
 	l_free(wiphy);
 }
 
@@ -658,6 +687,108 @@ uint8_t wiphy_get_max_num_ssids_per_scan(struct wiphy *wiphy)
 	return wiphy->max_num_ssids_per_scan;
 }
 
+const struct sched_scan_caps *wiphy_get_sched_scan_caps(struct wiphy *wiphy)
+{
+	return &wiphy->sched_scan;
+}
+
+const struct wowlan_caps *wiphy_get_wowlan_caps(struct wiphy *wiphy)
+{
+	return &wiphy->wowlan;
+}
+
+static void wiphy_set_wowlan_cb(struct l_genl_msg *msg, void *user_data)
+{
+	int err = l_genl_msg_get_error(msg);
+
+	if (err < 0)
+		l_debug("SET_WOWLAN on wiphy %u failed: %s(%d)",
+				L_PTR_TO_UINT(user_data), strerror(-err), err);
+}
+
+static void wiphy_wowlan_update(struct wiphy *wiphy)
+{
+	const struct l_queue_entry *entry;
+	uint32_t triggers = 0;
+	const struct sched_scan_request *nd = NULL;
+	struct l_genl_msg *msg;
+
+	for (entry = l_queue_get_entries(wiphy->wowlan_users); entry;
+							entry = entry->next) {
+		const struct wiphy_wowlan_user *user = entry->data;
+
+		triggers |= user->triggers;
+
+		/* There is a single net-detect request per wiphy */
+		if (!nd)
+			nd = user->nd;
+	}
+
+	msg = wowlan_build_set(wiphy->id, &wiphy->wowlan, triggers, nd);
+	if (!msg) {
+		if (!wiphy->wowlan_triggers)
+			return;
+
+		msg = wowlan_build_clear(wiphy->id);
+		triggers = 0;
+	} else
+		triggers = wowlan_caps_filter(&wiphy->wowlan, triggers);
+
+	l_debug("wiphy %u triggers 0x%x", wiphy->id, triggers);
+
+	if (!l_genl_family_send(nl80211, msg, wiphy_set_wowlan_cb,
+					L_UINT_TO_PTR(wiphy->id), NULL)) {
+		l_genl_msg_unref(msg);
+		return;
+	}
+
+	wiphy->wowlan_triggers = triggers;
+}
+
+/*
+ * WoWLAN is configured per wiphy and only takes effect once the system
+ * suspends.  Every interface on the wiphy can need triggers of its own, so
+ * each @owner sets or, with no @triggers, removes its own and the wiphy is
+ * programmed with the union of those left.  Triggers the wiphy does not
+ * support are dropped, if none are left WoWLAN is disabled.  Takes
+ * ownership of @nd.
+ */
+void wiphy_set_wowlan(struct wiphy *wiphy, const void *owner,
+			uint32_t triggers, struct sched_scan_request *nd)
+{
+	struct wiphy_wowlan_user *user;
+
+	if (!wiphy->wowlan.supported) {
+		sched_scan_request_free(nd);
+		return;
+	}
+
+	user = l_queue_find(wiphy->wowlan_users, wiphy_wowlan_user_match,
+				owner);
+
+	if (!triggers) {
+		sched_scan_request_free(nd);
+
+		if (!user)
+			return;
+
+		l_queue_remove(wiphy->wowlan_users, user);
+		wiphy_wowlan_user_free(user);
+	} else {
+		if (!user) {
+			user = l_new(struct wiphy_wowlan_user, 1);
+			user->owner = owner;
+			l_queue_push_tail(wiphy->wowlan_users, user);
+		}
+
+		user->triggers = triggers;
+		sched_scan_request_free(user->nd);
+		user->nd = nd;
+	}
+
+	wiphy_wowlan_update(wiphy);
+}
+
 uint16_t wiphy_get_max_scan_ie_len(struct wiphy *wiphy)
 {
 	return wiphy->max_scan_ie_len;
@@ -668,6 +799,11 @@ uint32_t wiphy_get_max_roc_duration(struct wiphy *wiphy)
 	return wiphy->max_roc_duration;
 }
 
+bool wiphy_supports_rekey_offload(struct wiphy *wiphy)
+{
+	return wiphy->support_rekey_offload;
+}
+
 bool wiphy_supports_qos_set_map(struct wiphy *wiphy)
 {
 	return wiphy->support_qos_set_map;
@@ -1377,7 +1513,7 @@ static void parse_supported_commands(struct wiphy *wiphy,
 
 		switch (cmd) {
 		case NL80211_CMD_START_SCHED_SCAN:
-			wiphy->support_scheduled_scan = true;
+			wiphy->sched_scan.supported = true;
 			break;
 		case NL80211_CMD_SET_REKEY_OFFLOAD:
 			wiphy->support_rekey_offload = true;
@@ -1875,6 +2011,22 @@ static void wiphy_parse_attributes(struct wiphy *wiphy,
 			else
 				wiphy->max_scan_ie_len = *((uint16_t *) data);
 			break;
+		case NL80211_ATTR_MAX_NUM_SCHED_SCAN_SSIDS:
+		case NL80211_ATTR_MAX_MATCH_SETS:
+		case NL80211_ATTR_MAX_NUM_SCHED_SCAN_PLANS:
+		case NL80211_ATTR_MAX_SCAN_PLAN_INTERVAL:
+		case NL80211_ATTR_MAX_SCAN_PLAN_ITERATIONS:
+			if (!sched_scan_caps_parse_attr(&wiphy->sched_scan,
+							type, data, len))
+				l_warn("Invalid scheduled scan attribute %u",
+					type);
+			break;
+		case NL80211_ATTR_WOWLAN_TRIGGERS_SUPPORTED:
+			if (!l_genl_attr_recurse(&attr, &nested) ||
+					!wowlan_caps_parse(&wiphy->wowlan,
+								&nested))
+				l_warn("Invalid WOWLAN_TRIGGERS_SUPPORTED");
+			break;
 		case NL80211_ATTR_SUPPORTED_IFTYPES:
 			if (l_genl_attr_recurse(&attr, &nested))
 				parse_supported_iftypes(wiphy, &nested);
@@ -2061,6 +2213,7 @@ struct wiphy *wiphy_create(uint32_t wiphy_id, const char *name)
 		wiphy->blacklisted = true;
 
 	wiphy->work = l_queue_new();
+	wiphy->wowlan_users = l_queue_new();
 
 	return wiphy;
 }
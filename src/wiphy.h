@@ -26,6 +26,9 @@
 struct wiphy;
 struct scan_bss;
 struct scan_freq_set;
+struct sched_scan_caps;
+struct sched_scan_request;
+struct wowlan_caps;
 struct wiphy_radio_work_item;
 struct ie_rsn_info;
 struct band_freq_attrs;
@@ -121,12 +124,17 @@ bool wiphy_supports_ext_key_id(struct wiphy *wiphy);
 bool wiphy_has_feature(struct wiphy *wiphy, uint32_t feature);
 bool wiphy_has_ext_feature(struct wiphy *wiphy, uint32_t feature);
 uint8_t wiphy_get_max_num_ssids_per_scan(struct wiphy *wiphy);
+const struct sched_scan_caps *wiphy_get_sched_scan_caps(struct wiphy *wiphy);
+const struct wowlan_caps *wiphy_get_wowlan_caps(struct wiphy *wiphy);
+void wiphy_set_wowlan(struct wiphy *wiphy, const void *owner,
+			uint32_t triggers, struct sched_scan_request *nd);
 uint16_t wiphy_get_max_scan_ie_len(struct wiphy *wiphy);
 uint32_t wiphy_get_max_roc_duration(struct wiphy *wiphy);
 bool wiphy_supports_iftype(struct wiphy *wiphy, uint32_t iftype);
 const uint8_t *wiphy_get_supported_rates(struct wiphy *wiphy,
 						enum band_freq band,
 						unsigned int *out_num);
+bool wiphy_supports_rekey_offload(struct wiphy *wiphy);
 bool wiphy_supports_qos_set_map(struct wiphy *wiphy);
 bool wiphy_supports_firmware_roam(struct wiphy *wiphy);
 const char *wiphy_get_driver(struct wiphy *wiphy);
@@ -0,0 +1,242 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "linux/nl80211.h"
+#include "src/util.h"
+#include "src/sched-scan.h"
+#include "src/wowlan.h"
+
+/*
+ * The WoWLAN configuration is stored by cfg80211 and only applied once the
+ * system suspends, so the triggers are kept up to date with the connection
+ * state rather than programmed from a suspend hook.  While connected the
+ * host is woken if the link is lost or the offloaded group rekey fails,
+ * while disconnected the known networks are handed to the firmware as
+ * net-detect match sets.
+ */
+
+bool wowlan_caps_parse(struct wowlan_caps *caps, struct l_genl_attr *attr)
+{
+	uint16_t type, len;
+	const void *data;
+
+	memset(caps, 0, sizeof(*caps));
+
+	while (l_genl_attr_next(attr, &type, &len, &data)) {
+		switch (type) {
+		case NL80211_WOWLAN_TRIG_DISCONNECT:
+			caps->disconnect = true;
+			break;
+		case NL80211_WOWLAN_TRIG_GTK_REKEY_SUPPORTED:
+			caps->gtk_rekey_supported = true;
+			break;
+		case NL80211_WOWLAN_TRIG_GTK_REKEY_FAILURE:
+			caps->gtk_rekey_failure = true;
+			break;
+		case NL80211_WOWLAN_TRIG_NET_DETECT:
+			if (len != sizeof(uint32_t))
+				return false;
+
+			caps->max_nd_match_sets = l_get_u32(data);
+			break;
+		}
+	}
+
+	caps->supported = true;
+	return true;
+}
+
+/* Returns the subset of @triggers that the wiphy can wake up on */
+uint32_t wowlan_caps_filter(const struct wowlan_caps *caps, uint32_t triggers)
+{
+	uint32_t supported = 0;
+
+	if (!caps->supported)
+		return 0;
+
+	if (caps->disconnect)
+		supported |= WOWLAN_TRIGGER_DISCONNECT;
+
+	/*
+	 * Without the rekey offloaded the host would be woken for every GTK
+	 * rekey anyway, so the failure trigger is pointless.
+	 */
+	if (caps->gtk_rekey_supported && caps->gtk_rekey_failure)
+		supported |= WOWLAN_TRIGGER_GTK_REKEY_FAILURE;
+
+	if (caps->max_nd_match_sets)
+		supported |= WOWLAN_TRIGGER_NET_DETECT;
+
+	return triggers & supported;
+}
+
+struct l_genl_msg *wowlan_build_set(uint32_t wiphy_id,
+					const struct wowlan_caps *caps,
+					uint32_t triggers,
+					const struct sched_scan_request *nd)
+{
+	struct l_genl_msg *msg;
+
+	triggers = wowlan_caps_filter(caps, triggers);
+
+	if (!nd || !sched_scan_request_get_match_sets(nd) ||
+			sched_scan_request_get_match_sets(nd) >
+						caps->max_nd_match_sets)
+		triggers &= ~WOWLAN_TRIGGER_NET_DETECT;
+
+	if (!triggers)
+		return NULL;
+
+	msg = l_genl_msg_new(NL80211_CMD_SET_WOWLAN);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_WIPHY, 4, &wiphy_id);
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_WOWLAN_TRIGGERS);
+
+	if (triggers & WOWLAN_TRIGGER_DISCONNECT)
+		l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_DISCONNECT,
+					0, NULL);
+
+	if (triggers & WOWLAN_TRIGGER_GTK_REKEY_FAILURE)
+		l_genl_msg_append_attr(msg,
+					NL80211_WOWLAN_TRIG_GTK_REKEY_FAILURE,
+					0, NULL);
+
+	if (triggers & WOWLAN_TRIGGER_NET_DETECT) {
+		l_genl_msg_enter_nested(msg, NL80211_WOWLAN_TRIG_NET_DETECT);
+		sched_scan_request_append_attrs(nd, msg);
+		l_genl_msg_leave_nested(msg);
+	}
+
+	l_genl_msg_leave_nested(msg);
+
+	return msg;
+}
+
+/* SET_WOWLAN without any triggers disables WoWLAN */
+struct l_genl_msg *wowlan_build_clear(uint32_t wiphy_id)
+{
+	struct l_genl_msg *msg;
+
+	msg = l_genl_msg_new_sized(NL80211_CMD_SET_WOWLAN, 16);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_WIPHY, 4, &wiphy_id);
+
+	return msg;
+}
+
+static void wowlan_parse_nd_match(struct l_genl_attr *match,
+					struct scan_freq_set *nd_freqs)
+{
+	struct l_genl_attr freqs;
+	uint16_t type, len;
+	const void *data;
+
+	while (l_genl_attr_next(match, &type, &len, &data)) {
+		if (type != NL80211_ATTR_SCAN_FREQUENCIES)
+			continue;
+
+		if (!l_genl_attr_recurse(match, &freqs))
+			return;
+
+		while (l_genl_attr_next(&freqs, &type, &len, &data))
+			if (len == sizeof(uint32_t))
+				scan_freq_set_add(nd_freqs, l_get_u32(data));
+	}
+}
+
+/*
+ * Parses the SET_WOWLAN event sent by the kernel on resume.  Returns the
+ * reasons for the wakeup, or 0 if the system was not woken by WoWLAN.
+ * Frequencies on which net-detect found a match are added to @nd_freqs.
+ */
+uint32_t wowlan_parse_wakeup(struct l_genl_msg *msg,
+				struct scan_freq_set *nd_freqs)
+{
+	struct l_genl_attr attr;
+	struct l_genl_attr triggers;
+	struct l_genl_attr results;
+	struct l_genl_attr match;
+	uint16_t type, len;
+	const void *data;
+	uint32_t reasons = 0;
+	bool found = false;
+
+	if (!l_genl_attr_init(&attr, msg))
+		return 0;
+
+	while (!found && l_genl_attr_next(&attr, &type, &len, &data)) {
+		if (type != NL80211_ATTR_WOWLAN_TRIGGERS)
+			continue;
+
+		if (!l_genl_attr_recurse(&attr, &triggers))
+			return 0;
+
+		found = true;
+	}
+
+	if (!found)
+		return 0;
+
+	while (l_genl_attr_next(&triggers, &type, &len, &data)) {
+		switch (type) {
+		case NL80211_WOWLAN_TRIG_DISCONNECT:
+			reasons |= WOWLAN_TRIGGER_DISCONNECT;
+			break;
+		case NL80211_WOWLAN_TRIG_GTK_REKEY_FAILURE:
+			reasons |= WOWLAN_TRIGGER_GTK_REKEY_FAILURE;
+			break;
+		case NL80211_WOWLAN_TRIG_4WAY_HANDSHAKE:
+			reasons |= WOWLAN_TRIGGER_4WAY_HANDSHAKE;
+			break;
+		case NL80211_WOWLAN_TRIG_NET_DETECT_RESULTS:
+			reasons |= WOWLAN_TRIGGER_NET_DETECT;
+
+			if (!nd_freqs || !l_genl_attr_recurse(&triggers,
+								&results))
+				break;
+
+			while (l_genl_attr_next(&results, NULL, NULL, NULL))
+				if (l_genl_attr_recurse(&results, &match))
+					wowlan_parse_nd_match(&match,
+								nd_freqs);
+
+			break;
+		case NL80211_WOWLAN_TRIG_WAKEUP_PKT_80211:
+		case NL80211_WOWLAN_TRIG_WAKEUP_PKT_80211_LEN:
+		case NL80211_WOWLAN_TRIG_WAKEUP_PKT_8023:
+		case NL80211_WOWLAN_TRIG_WAKEUP_PKT_8023_LEN:
+			/* Details of the wakeup packet, not a reason */
+			break;
+		default:
+			reasons |= WOWLAN_TRIGGER_OTHER;
+			break;
+		}
+	}
+
+	return reasons;
+}
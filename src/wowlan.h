@@ -0,0 +1,57 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct l_genl_msg;
+struct l_genl_attr;
+struct scan_freq_set;
+struct sched_scan_request;
+
+/* Triggers iwd programs, also used to report the reason for a wakeup */
+enum wowlan_trigger {
+	WOWLAN_TRIGGER_DISCONNECT = 0x1,
+	WOWLAN_TRIGGER_GTK_REKEY_FAILURE = 0x2,
+	WOWLAN_TRIGGER_NET_DETECT = 0x4,
+	/* Wakeup reasons only */
+	WOWLAN_TRIGGER_4WAY_HANDSHAKE = 0x8,
+	WOWLAN_TRIGGER_OTHER = 0x10,
+};
+
+/* WoWLAN triggers advertised by the wiphy */
+struct wowlan_caps {
+	bool supported : 1;
+	bool disconnect : 1;
+	bool gtk_rekey_supported : 1;
+	bool gtk_rekey_failure : 1;
+	uint32_t max_nd_match_sets;
+};
+
+bool wowlan_caps_parse(struct wowlan_caps *caps, struct l_genl_attr *attr);
+uint32_t wowlan_caps_filter(const struct wowlan_caps *caps, uint32_t triggers);
+
+struct l_genl_msg *wowlan_build_set(uint32_t wiphy_id,
+					const struct wowlan_caps *caps,
+					uint32_t triggers,
+					const struct sched_scan_request *nd);
+struct l_genl_msg *wowlan_build_clear(uint32_t wiphy_id);
+
+uint32_t wowlan_parse_wakeup(struct l_genl_msg *msg,
+				struct scan_freq_set *nd_freqs);
@@ -489,7 +489,8 @@ static void wsc_try_credentials(struct wsc_station_dbus *wsc,
 
 		bss = network_bss_find_by_addr(network, creds[i].addr);
 
-		if (!bss)
+		/* cfg80211 doesn't know BSSes we expanded ourselves */
+		if (!bss || bss->mbssid_expanded)
 			bss = network_bss_select(network, true);
 
 		if (!bss)
@@ -1137,6 +1138,9 @@ static struct l_dbus_message *wsc_push_button(struct l_dbus *dbus,
 	if (wsc->pending_connect || wsc->pending_cancel)
 		return dbus_error_busy(message);
 
+	/* Precompute our DH keypair while looking for the registrar */
+	eap_wsc_prepare_keys();
+
 	wsc->pending_connect = l_dbus_message_ref(message);
 	wsc->connect(wsc, NULL);
 	return NULL;
@@ -1183,6 +1187,8 @@ static struct l_dbus_message *wsc_start_pin(struct l_dbus *dbus,
 	if (!wsc_pin_is_valid(pin))
 		return dbus_error_invalid_format(message);
 
+	eap_wsc_prepare_keys();
+
 	wsc->pending_connect = l_dbus_message_ref(message);
 	wsc->connect(wsc, pin);
 	return NULL;
@@ -21,6 +21,9 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -33,6 +36,7 @@
 
 #include "src/storage.h"
 #include "src/common.h"
+#include "tools/profile-batch.h"
 
 static void usage(void)
 {
@@ -40,7 +44,8 @@ static void usage(void)
 		"Usage:\n");
 	printf("\tdecrypt-profile [--pass | --file] [OPTIONS]\n");
 	printf("\n\tEither --pass or --file must be provided. The profile\n");
-	printf("\tshould be supplied using --infile.\n");
+	printf("\tshould be supplied using --infile, or a directory of\n");
+	printf("\tprofiles using --indir.\n");
 	printf("\tThe --name argument must be used if the name cannot be\n");
 	printf("\tinferred from the input file\n\n");
 	printf("Options:\n"
@@ -52,6 +57,13 @@ static void usage(void)
 		"\t                       this will be the SSID.\n"
 		"\t-i, --infile           Input profile\n"
 		"\t-o, --outfile          Output file for decrypted profile\n"
+		"\t-d, --indir            Decrypt all profiles below a\n"
+		"\t                       directory and report per-file\n"
+		"\t                       status\n"
+		"\t-D, --outdir           Output directory for decrypted\n"
+		"\t                       profiles when using --indir\n"
+		"\t-j, --jobs             Number of worker threads used with\n"
+		"\t                       --indir (default: one per CPU)\n"
 		"\t-h, --help             Show help options\n");
 	printf("\n");
 }
@@ -62,6 +74,9 @@ static const struct option main_options[] = {
 	{ "infile", required_argument,     NULL, 'i' },
 	{ "outfile", required_argument,    NULL, 'o' },
 	{ "name", required_argument,       NULL, 'n' },
+	{ "indir", required_argument,      NULL, 'd' },
+	{ "outdir", required_argument,     NULL, 'D' },
+	{ "jobs", required_argument,       NULL, 'j' },
 	{ "help", no_argument,             NULL, 'h' },
 	{ }
 };
@@ -97,6 +112,41 @@ static bool secret_from_file(const char *file)
 	return r;
 }
 
+static void batch_result(const char *path, int err, const char *data,
+				size_t len, bool encrypted, void *user_data)
+{
+	if (err < 0)
+		printf("FAIL %s: %s\n", path, strerror(-err));
+	else
+		printf("OK   %s%s\n", path,
+				encrypted ? "" : " (not encrypted)");
+}
+
+static int decrypt_directory(const char *indir, const char *outdir,
+				unsigned int jobs)
+{
+	int r;
+
+	if (!jobs) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+		jobs = n > 0 ? n : 1;
+	}
+
+	r = profile_batch_decrypt(indir, outdir, jobs, batch_result, NULL);
+	if (r < 0) {
+		printf("Unable to decrypt %s: %s\n", indir, strerror(-r));
+		return EXIT_FAILURE;
+	}
+
+	if (r > 0) {
+		printf("%d profile(s) failed to decrypt\n", r);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[])
 {
 	const char *pass = NULL;
@@ -104,6 +154,9 @@ int main(int argc, char *argv[])
 	const char *infile = NULL;
 	const char *outfile = NULL;
 	const char *name = NULL;
+	const char *indir = NULL;
+	const char *outdir = NULL;
+	unsigned int jobs = 0;
 	_auto_(l_free) char *decrypted = NULL;
 	_auto_(l_settings_free) struct l_settings *settings = NULL;
 	enum security sec;
@@ -114,7 +167,8 @@ int main(int argc, char *argv[])
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "pfhion", main_options, NULL);
+		opt = getopt_long(argc, argv, "p:f:hi:o:n:d:D:j:",
+					main_options, NULL);
 		if (opt < 0)
 			break;
 
@@ -134,6 +188,15 @@ int main(int argc, char *argv[])
 		case 'n':
 			name = optarg;
 			break;
+		case 'd':
+			indir = optarg;
+			break;
+		case 'D':
+			outdir = optarg;
+			break;
+		case 'j':
+			jobs = strtoul(optarg, NULL, 10);
+			break;
 		case 'h':
 			usage();
 			return EXIT_SUCCESS;
@@ -147,11 +210,24 @@ int main(int argc, char *argv[])
 		goto usage;
 	}
 
-	if (!infile) {
-		printf("--infile must be supplied\n\n");
+	if (!infile && !indir) {
+		printf("--infile or --indir must be supplied\n\n");
 		goto usage;
 	}
 
+	if (indir) {
+		/* The secret is derived once for the whole directory */
+		if (pass) {
+			if (!storage_init((const uint8_t *)pass, strlen(pass)))
+				goto failed;
+		} else if (!secret_from_file(file))
+			goto failed;
+
+		ret = decrypt_directory(indir, outdir, jobs);
+		storage_exit();
+		return ret;
+	}
+
 	if (!name) {
 		name = storage_network_ssid_from_path(infile, &sec);
 		if (!name) {
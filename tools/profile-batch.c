@@ -0,0 +1,302 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <ell/ell.h>
+
+#include "ell/useful.h"
+
+#include "src/storage.h"
+#include "src/common.h"
+#include "tools/profile-batch.h"
+
+/*
+ * Decrypts every profile found below a directory.  The system key is derived
+ * once by the caller (storage_init) and is only read from here on, so each
+ * profile can be loaded, decrypted and written out by any worker thread.
+ * Results are handed back to the caller from the calling thread in path
+ * order once all workers are done.
+ */
+
+struct profile_entry {
+	char *path;
+	char *name;
+	int err;
+	bool encrypted;
+	char *data;
+	size_t len;
+};
+
+struct profile_batch {
+	const char *indir;
+	const char *outdir;
+	struct profile_entry *entries;
+	unsigned int n_entries;
+	unsigned int next;
+};
+
+static void profile_entry_free(void *data)
+{
+	struct profile_entry *entry = data;
+
+	l_free(entry->path);
+	l_free(entry->name);
+	l_free(entry);
+}
+
+static int profile_entry_compare(const void *a, const void *b)
+{
+	const struct profile_entry *ea = a;
+	const struct profile_entry *eb = b;
+
+	return strcmp(ea->path, eb->path);
+}
+
+static void profile_batch_add(struct l_queue *found, const char *path)
+{
+	struct profile_entry *entry;
+	const char *ssid;
+	const char *ext;
+	enum security security;
+
+	ext = strrchr(path, '.');
+	if (!ext)
+		return;
+
+	ssid = storage_network_ssid_from_path(path, &security);
+
+	/*
+	 * Hotspot profiles are encrypted with the [Hotspot] Name, which is
+	 * only known once the profile has been loaded by the worker.
+	 */
+	if (!ssid && strcmp(ext, ".conf"))
+		return;
+
+	entry = l_new(struct profile_entry, 1);
+	entry->path = l_strdup(path);
+	entry->name = l_strdup(ssid);
+
+	l_queue_push_tail(found, entry);
+}
+
+static int profile_batch_scan(struct l_queue *found, const char *root,
+				const char *subdir)
+{
+	_auto_(l_free) char *dirpath = NULL;
+	struct dirent *dirent;
+	DIR *dir;
+	int r = 0;
+
+	dirpath = subdir ? l_strdup_printf("%s/%s", root, subdir) :
+				l_strdup(root);
+
+	dir = opendir(dirpath);
+	if (!dir)
+		return -errno;
+
+	while ((dirent = readdir(dir))) {
+		_auto_(l_free) char *path = NULL;
+		_auto_(l_free) char *full_path = NULL;
+		struct stat st;
+
+		if (dirent->d_name[0] == '.')
+			continue;
+
+		path = subdir ? l_strdup_printf("%s/%s", subdir,
+							dirent->d_name) :
+				l_strdup(dirent->d_name);
+		full_path = l_strdup_printf("%s/%s", root, path);
+
+		if (stat(full_path, &st) < 0)
+			continue;
+
+		if (S_ISDIR(st.st_mode)) {
+			r = profile_batch_scan(found, root, path);
+			if (r < 0)
+				break;
+		} else if (S_ISREG(st.st_mode))
+			profile_batch_add(found, path);
+	}
+
+	closedir(dir);
+
+	return r;
+}
+
+static void profile_batch_decrypt_one(struct profile_batch *batch,
+					struct profile_entry *entry)
+{
+	_auto_(l_settings_free) struct l_settings *settings = NULL;
+	_auto_(l_free) char *full_path = NULL;
+	_auto_(l_free) char *hotspot_name = NULL;
+	const char *name = entry->name;
+	int r;
+
+	full_path = l_strdup_printf("%s/%s", batch->indir, entry->path);
+	settings = l_settings_new();
+
+	if (!l_settings_load_from_file(settings, full_path)) {
+		entry->err = -EBADMSG;
+		return;
+	}
+
+	if (!name) {
+		hotspot_name = l_settings_get_string(settings, "Hotspot",
+							"Name");
+		if (!hotspot_name) {
+			entry->err = -ENOENT;
+			return;
+		}
+
+		name = hotspot_name;
+	}
+
+	entry->encrypted = l_settings_has_key(settings, "Security",
+						"EncryptedSecurity");
+
+	r = __storage_decrypt(settings, name, NULL);
+	if (r < 0) {
+		entry->err = r;
+		return;
+	}
+
+	entry->data = l_settings_to_data(settings, &entry->len);
+
+	if (!batch->outdir)
+		return;
+
+	if (write_file(entry->data, entry->len, false, "%s/%s",
+				batch->outdir, entry->path) < 0)
+		entry->err = -EIO;
+}
+
+static void *profile_batch_worker(void *user_data)
+{
+	struct profile_batch *batch = user_data;
+	unsigned int i;
+
+	while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) <
+			batch->n_entries)
+		profile_batch_decrypt_one(batch, &batch->entries[i]);
+
+	return NULL;
+}
+
+/*
+ * Returns the number of profiles that failed to decrypt, or a negative errno
+ * if the input or output directory could not be used.
+ */
+int profile_batch_decrypt(const char *indir, const char *outdir,
+				unsigned int n_workers,
+				profile_batch_result_func_t func,
+				void *user_data)
+{
+	struct profile_batch batch = { .indir = indir };
+	struct l_queue *found;
+	struct profile_entry *entry;
+	_auto_(l_free) pthread_t *threads = NULL;
+	char outdir_abs[PATH_MAX];
+	unsigned int started;
+	unsigned int i;
+	int failed = 0;
+	int r;
+
+	if (outdir) {
+		if (mkdir(outdir, 0700) < 0 && errno != EEXIST)
+			return -errno;
+
+		/* write_file only takes absolute paths */
+		if (!realpath(outdir, outdir_abs))
+			return -errno;
+
+		batch.outdir = outdir_abs;
+	}
+
+	found = l_queue_new();
+
+	r = profile_batch_scan(found, indir, NULL);
+	if (r < 0)
+		goto done;
+
+	batch.n_entries = l_queue_length(found);
+	batch.entries = l_new(struct profile_entry, batch.n_entries);
+
+	for (i = 0; (entry = l_queue_pop_head(found)); i++) {
+		batch.entries[i] = *entry;
+		l_free(entry);
+	}
+
+	qsort(batch.entries, batch.n_entries, sizeof(struct profile_entry),
+		profile_entry_compare);
+
+	/* The calling thread acts as one of the workers */
+	n_workers = minsize(n_workers, batch.n_entries);
+	threads = l_new(pthread_t, n_workers);
+
+	for (started = 0; started + 1 < n_workers; started++)
+		if (pthread_create(&threads[started], NULL,
+					profile_batch_worker, &batch))
+			break;
+
+	profile_batch_worker(&batch);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < batch.n_entries; i++) {
+		entry = &batch.entries[i];
+
+		if (entry->err)
+			failed++;
+
+		if (func)
+			func(entry->path, entry->err, entry->data, entry->len,
+				entry->encrypted, user_data);
+
+		if (entry->data) {
+			explicit_bzero(entry->data, entry->len);
+			l_free(entry->data);
+		}
+
+		l_free(entry->path);
+		l_free(entry->name);
+	}
+
+	l_free(batch.entries);
+	r = failed;
+
+done:
+	l_queue_destroy(found, profile_entry_free);
+	return r;
+}
@@ -0,0 +1,40 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Called once per profile, in path order, after all workers have finished.
+ * @path is relative to the input directory.  On success @err is 0 and @data
+ * holds the decrypted profile, @encrypted tells whether the profile was
+ * encrypted to begin with.
+ */
+typedef void (*profile_batch_result_func_t)(const char *path, int err,
+						const char *data, size_t len,
+						bool encrypted,
+						void *user_data);
+
+int profile_batch_decrypt(const char *indir, const char *outdir,
+				unsigned int n_workers,
+				profile_batch_result_func_t func,
+				void *user_data);
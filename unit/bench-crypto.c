@@ -0,0 +1,195 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Micro-benchmark for the key derivations done on every 4-Way Handshake,
+ * rekey and FT roam.  Each derivation is timed with a fresh HMAC context per
+ * call and with a per-key context cache, as used by struct handshake_state.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ell/ell.h>
+
+#include "src/crypto.h"
+
+#define DEFAULT_ITERATIONS 20000
+
+static const uint8_t pmk[48] = {
+	0x6f, 0xe8, 0x57, 0xc0, 0xb7, 0x42, 0xdf, 0xc2,
+	0xda, 0x8a, 0x1f, 0xe8, 0xb1, 0xb4, 0xb4, 0x62,
+	0x8d, 0x9f, 0xbb, 0xb0, 0x60, 0x82, 0x6b, 0x83,
+	0xcb, 0x43, 0xb6, 0x4b, 0x13, 0xe1, 0x03, 0xe8,
+	0x9e, 0x99, 0x88, 0xbd, 0xe2, 0xcb, 0xa7, 0x43,
+	0x95, 0xc0, 0x28, 0x9f, 0xfd, 0xa0, 0x7b, 0xc4,
+};
+
+static const uint8_t aa[6] = { 0x00, 0x14, 0x6c, 0x7e, 0x40, 0x80 };
+static const uint8_t spa[6] = { 0x00, 0x13, 0x46, 0xfe, 0x32, 0x0c };
+static const uint8_t ssid[] = { 'I', 'E', 'E', 'E' };
+static uint8_t anonce[32];
+static uint8_t snonce[32];
+
+struct bench {
+	const char *name;
+	enum l_checksum_type type;
+	bool ft;
+};
+
+static const struct bench benches[] = {
+	{ "PSK (PRF-SHA1)",		L_CHECKSUM_SHA1,	false },
+	{ "PSK-SHA256 / SAE",		L_CHECKSUM_SHA256,	false },
+	{ "FILS-SHA384 / OWE-P384",	L_CHECKSUM_SHA384,	false },
+	{ "FT-PSK / FT-SAE",		L_CHECKSUM_SHA256,	true },
+	{ "FT-SHA384",			L_CHECKSUM_SHA384,	true },
+	{ }
+};
+
+struct bench_cache {
+	struct crypto_hmac_cache *pmk;
+	struct crypto_hmac_cache *pmk_r0;
+	struct crypto_hmac_cache *pmk_r1;
+};
+
+static bool derive_once(const struct bench *b, struct bench_cache *c)
+{
+	bool sha384 = b->type == L_CHECKSUM_SHA384;
+	size_t pmk_len = sha384 ? 48 : 32;
+	uint8_t pmk_r0[48];
+	uint8_t pmk_r0_name[16];
+	uint8_t pmk_r1[48];
+	uint8_t pmk_r1_name[16];
+	uint8_t ptk_name[16];
+	uint8_t pmkid[16];
+	uint8_t ptk[88];
+
+	if (!b->ft)
+		return crypto_derive_pairwise_ptk_cached(c ? &c->pmk : NULL,
+						pmk, pmk_len, aa, spa,
+						anonce, snonce,
+						ptk, sizeof(ptk), b->type) &&
+			crypto_derive_pmkid_cached(c ? &c->pmk : NULL,
+						pmk, pmk_len, spa, aa, pmkid,
+						b->type);
+
+	return crypto_derive_pmk_r0_cached(c ? &c->pmk : NULL,
+						pmk, pmk_len, ssid,
+						sizeof(ssid), 0x1234,
+						aa, sizeof(aa), spa, sha384,
+						pmk_r0, pmk_r0_name) &&
+		crypto_derive_pmk_r1_cached(c ? &c->pmk_r0 : NULL,
+						pmk_r0, aa, spa,
+						pmk_r0_name, sha384,
+						pmk_r1, pmk_r1_name) &&
+		crypto_derive_ft_ptk_cached(c ? &c->pmk_r1 : NULL,
+						pmk_r1, pmk_r1_name, aa, spa,
+						snonce, anonce, sha384,
+						ptk, sizeof(ptk), ptk_name);
+}
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) +
+		(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double run(const struct bench *b, bool cached,
+					unsigned int iterations)
+{
+	struct bench_cache cache = {};
+	struct timespec start;
+	unsigned int i;
+	double secs;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < iterations; i++) {
+		/* Every handshake brings fresh nonces */
+		anonce[i % 32]++;
+		snonce[i % 32]--;
+
+		if (!derive_once(b, cached ? &cache : NULL))
+			break;
+	}
+
+	secs = elapsed(&start);
+
+	crypto_hmac_cache_free(cache.pmk);
+	crypto_hmac_cache_free(cache.pmk_r0);
+	crypto_hmac_cache_free(cache.pmk_r1);
+
+	if (i < iterations)
+		return -1;
+
+	return iterations / secs;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int iterations = DEFAULT_ITERATIONS;
+	const struct bench *b;
+
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+
+		if (!iterations) {
+			fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("%-24s %14s %14s %8s\n", "AKM", "uncached/s", "cached/s",
+		"speedup");
+
+	for (b = benches; b->name; b++) {
+		double uncached;
+		double cached;
+
+		if (!l_checksum_is_supported(b->type, true)) {
+			printf("%-24s %14s\n", b->name, "unsupported");
+			continue;
+		}
+
+		uncached = run(b, false, iterations);
+		cached = run(b, true, iterations);
+
+		if (uncached < 0 || cached < 0) {
+			printf("%-24s %14s\n", b->name, "failed");
+			continue;
+		}
+
+		printf("%-24s %14.0f %14.0f %7.2fx\n", b->name,
+			uncached, cached, cached / uncached);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Micro-benchmark for mpdu_validate on management frames typical of what is
+ * received while scanning, in AP mode and while associating.  Useful to
+ * compare revisions of the element validation code.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ell/ell.h>
+
+#include "src/mpdu.h"
+
+#define DEFAULT_ITERATIONS 1000000
+
+/* VHT/HE AP Beacon, 22 elements */
+static const uint8_t beacon[] = {
+	0x80, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00,
+	0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x60, 0x1e,
+	0x2d, 0x6b, 0x91, 0x2f, 0x05, 0x00, 0x00, 0x00, 0x64, 0x00, 0x11, 0x04,
+	0x00, 0x0e, 0x48, 0x6f, 0x6d, 0x65, 0x4e, 0x65, 0x74, 0x77, 0x6f, 0x72,
+	0x6b, 0x2d, 0x35, 0x47, 0x01, 0x08, 0x8c, 0x12, 0x98, 0x24, 0xb0, 0x48,
+	0x60, 0x6c, 0x03, 0x01, 0x24, 0x05, 0x04, 0x00, 0x01, 0x00, 0x00, 0x07,
+	0x09, 0x55, 0x53, 0x20, 0x24, 0x04, 0x17, 0x95, 0x05, 0x1e, 0x20, 0x01,
+	0x00, 0x30, 0x14, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00,
+	0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x0c, 0x00, 0x0b,
+	0x05, 0x03, 0x00, 0x12, 0x7a, 0x12, 0x2d, 0x1a, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46, 0x05,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x3d, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x7f, 0x08, 0x04, 0x00, 0x08, 0x00, 0x00,
+	0x00, 0x00, 0x40, 0xbf, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x05, 0x01, 0x2a, 0x00, 0x00, 0x00,
+	0xc3, 0x04, 0x02, 0x2e, 0x2e, 0x2e, 0xff, 0x1a, 0x23, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x07,
+	0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x0d, 0x26, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xdd, 0x18,
+	0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x80, 0x00, 0x03, 0xa4, 0x00, 0x00,
+	0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00,
+	0xdd, 0x0e, 0x00, 0x50, 0xf2, 0x04, 0x10, 0x4a, 0x00, 0x01, 0x10, 0x10,
+	0x44, 0x00, 0x01, 0x02, 0xdd, 0x07, 0x50, 0x6f, 0x9a, 0x16, 0x03, 0x01,
+	0x03, 0xdd, 0x09, 0x00, 0x10, 0x18, 0x02, 0x00, 0x00, 0xfc, 0x00, 0x00,
+};
+
+/* Association Request from a VHT/HE station, 12 elements */
+static const uint8_t assoc_req[] = {
+	0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00,
+	0x00, 0x00, 0x03, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x70, 0x1e,
+	0x11, 0x04, 0x0a, 0x00, 0x00, 0x0e, 0x48, 0x6f, 0x6d, 0x65, 0x4e, 0x65,
+	0x74, 0x77, 0x6f, 0x72, 0x6b, 0x2d, 0x35, 0x47, 0x01, 0x08, 0x8c, 0x12,
+	0x98, 0x24, 0xb0, 0x48, 0x60, 0x6c, 0x21, 0x02, 0x00, 0x14, 0x24, 0x08,
+	0x24, 0x04, 0x34, 0x04, 0x64, 0x0b, 0x95, 0x05, 0x30, 0x14, 0x01, 0x00,
+	0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00,
+	0x00, 0x0f, 0xac, 0x02, 0x0c, 0x00, 0x46, 0x05, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x3b, 0x0c, 0x80, 0x70, 0x73, 0x74, 0x75, 0x7c, 0x7d, 0x7e, 0x7f,
+	0x80, 0x81, 0x82, 0x2d, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7f, 0x08, 0x00, 0x00, 0x08,
+	0x00, 0x00, 0x00, 0x00, 0x40, 0xbf, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x1a, 0x23, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xdd,
+	0x07, 0x00, 0x50, 0xf2, 0x02, 0x00, 0x01, 0x00,
+};
+
+/* Probe Request with WPS and P2P elements */
+static const uint8_t probe_req[] = {
+	/* Header */
+	0x40, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00,
+	0x00, 0x00, 0x03, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x50, 0x64,
+	/*
+	 * SSID, Supported Rates, Extended Supported Rates, DSSS Parameter Set,
+	 * HT Capabilities, Vendor Specific, Vendor Specific
+	 */
+	0x00, 0x05, 0x74, 0x65, 0x73, 0x74, 0x31, 0x01, 0x08, 0x02, 0x04, 0x0b,
+	0x16, 0x0c, 0x12, 0x18, 0x24, 0x32, 0x04, 0x30, 0x48, 0x60, 0x6c, 0x03,
+	0x01, 0x06, 0x2d, 0x1a, 0x7e, 0x10, 0x1b, 0xff, 0xff, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xdd, 0x69, 0x00, 0x50, 0xf2, 0x04,
+	0x10, 0x4a, 0x00, 0x01, 0x10, 0x10, 0x3a, 0x00, 0x01, 0x00, 0x10, 0x08,
+	0x00, 0x02, 0x31, 0x48, 0x10, 0x47, 0x00, 0x10, 0xd9, 0xec, 0x65, 0xb2,
+	0x32, 0xe4, 0x53, 0x8d, 0xb2, 0x6c, 0x3f, 0x2b, 0x86, 0xf7, 0xa8, 0xd5,
+	0x10, 0x54, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x10, 0x3c, 0x00, 0x01, 0x03, 0x10, 0x02, 0x00, 0x02, 0x00, 0x00, 0x10,
+	0x09, 0x00, 0x02, 0x00, 0x00, 0x10, 0x12, 0x00, 0x02, 0x00, 0x00, 0x10,
+	0x21, 0x00, 0x01, 0x20, 0x10, 0x23, 0x00, 0x01, 0x20, 0x10, 0x24, 0x00,
+	0x01, 0x20, 0x10, 0x11, 0x00, 0x01, 0x20, 0x10, 0x49, 0x00, 0x06, 0x00,
+	0x37, 0x2a, 0x00, 0x01, 0x20, 0xdd, 0x11, 0x50, 0x6f, 0x9a, 0x09, 0x02,
+	0x02, 0x00, 0x25, 0x00, 0x06, 0x05, 0x00, 0x58, 0x58, 0x04, 0x51, 0x01,
+};
+
+struct bench {
+	const char *name;
+	const uint8_t *frame;
+	size_t len;
+};
+
+static const struct bench benches[] = {
+	{ "Beacon",		beacon,		sizeof(beacon) },
+	{ "Association Request",	assoc_req,	sizeof(assoc_req) },
+	{ "Probe Request",	probe_req,	sizeof(probe_req) },
+	{ }
+};
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) +
+		(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double run(const struct bench *b, unsigned int iterations)
+{
+	struct timespec start;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < iterations; i++)
+		if (!mpdu_validate(b->frame, b->len))
+			return -1;
+
+	return iterations / elapsed(&start);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int iterations = DEFAULT_ITERATIONS;
+	const struct bench *b;
+
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+
+		if (!iterations) {
+			fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("%-24s %8s %14s\n", "Frame", "bytes", "frames/s");
+
+	for (b = benches; b->name; b++) {
+		double rate = run(b, iterations);
+
+		if (rate < 0) {
+			printf("%-24s %8zu %14s\n", b->name, b->len,
+				"rejected");
+			continue;
+		}
+
+		printf("%-24s %8zu %14.0f\n", b->name, b->len, rate);
+	}
+
+	return EXIT_SUCCESS;
+}
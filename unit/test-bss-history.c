@@ -0,0 +1,169 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <ell/ell.h>
+
+#include "src/bss-history.h"
+
+#define SEC 1000000ULL
+#define NOW (1700000000ULL * SEC)
+#define HALF_LIFE (900 * SEC)
+
+static const uint8_t bss_a[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0a };
+static const uint8_t bss_b[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0b };
+
+static bool near(double a, double b)
+{
+	return a > b - 0.0001 && a < b + 0.0001;
+}
+
+static void test_penalty(const void *data)
+{
+	struct bss_history *history = bss_history_new(BSS_HISTORY_MAX_BSS,
+							HALF_LIFE);
+
+	/* Nothing known, full rank */
+	assert(near(bss_history_get_rank_factor(history, bss_a, NOW), 1.0));
+
+	bss_history_record(history, bss_a, BSS_HISTORY_CONNECTED, NOW);
+	assert(near(bss_history_get_penalty(history, bss_a, NOW), 0));
+
+	bss_history_record(history, bss_a, BSS_HISTORY_CONNECT_FAILED, NOW);
+	bss_history_record(history, bss_a, BSS_HISTORY_HANDSHAKE_FAILED, NOW);
+	assert(near(bss_history_get_penalty(history, bss_a, NOW), 2.0));
+	assert(near(bss_history_get_rank_factor(history, bss_a, NOW),
+			1.0 / 3));
+
+	/* Halves every half life, interpolated in between */
+	assert(near(bss_history_get_penalty(history, bss_a,
+						NOW + HALF_LIFE), 1.0));
+	assert(near(bss_history_get_penalty(history, bss_a,
+						NOW + HALF_LIFE / 2), 1.5));
+	assert(near(bss_history_get_penalty(history, bss_a,
+						NOW + 3 * HALF_LIFE), 0.25));
+	assert(near(bss_history_get_penalty(history, bss_a,
+						NOW + 16 * HALF_LIFE), 0));
+
+	/* Other BSSes are not affected */
+	assert(near(bss_history_get_penalty(history, bss_b, NOW), 0));
+
+	bss_history_free(history);
+}
+
+static void test_time_to_failure(const void *data)
+{
+	struct bss_history *history = bss_history_new(BSS_HISTORY_MAX_BSS,
+							HALF_LIFE);
+	uint64_t t = NOW;
+
+	/* Dropped right after connecting counts as much as not connecting */
+	bss_history_record(history, bss_a, BSS_HISTORY_CONNECTED, t);
+	bss_history_record(history, bss_a, BSS_HISTORY_DISCONNECTED,
+				t + 10 * SEC);
+	assert(near(bss_history_get_penalty(history, bss_a, t + 10 * SEC),
+			1.0));
+
+	/* Losing the connection after hours barely counts */
+	bss_history_record(history, bss_b, BSS_HISTORY_CONNECTED, t);
+	bss_history_record(history, bss_b, BSS_HISTORY_BEACON_LOSS,
+				t + 7200 * SEC);
+	assert(near(bss_history_get_penalty(history, bss_b, t + 7200 * SEC),
+			0.25));
+
+	bss_history_free(history);
+}
+
+struct foreach_data {
+	unsigned int n;
+	enum bss_history_event last;
+	uint64_t last_time;
+	uint64_t last_ttf;
+};
+
+static void foreach_record(enum bss_history_event event, uint64_t time,
+				uint64_t time_to_failure, void *user_data)
+{
+	struct foreach_data *fd = user_data;
+
+	/* Oldest first */
+	assert(time > fd->last_time);
+
+	fd->n++;
+	fd->last = event;
+	fd->last_time = time;
+	fd->last_ttf = time_to_failure;
+}
+
+static void test_bounds(const void *data)
+{
+	struct bss_history *history = bss_history_new(2, HALF_LIFE);
+	uint8_t addr[6] = { 0x02, 0x00, 0x00, 0x00, 0x01, 0x00 };
+	struct foreach_data fd = {};
+	unsigned int i;
+
+	for (i = 0; i < BSS_HISTORY_MAX_RECORDS + 3; i++)
+		bss_history_record(history, bss_a, i % 2 ?
+					BSS_HISTORY_DISCONNECTED :
+					BSS_HISTORY_CONNECTED,
+					NOW + i * SEC);
+
+	assert(bss_history_foreach(history, bss_a, foreach_record, &fd) ==
+					BSS_HISTORY_MAX_RECORDS);
+	assert(fd.n == BSS_HISTORY_MAX_RECORDS);
+	assert(fd.last == BSS_HISTORY_CONNECTED);
+	assert(fd.last_time == NOW + (BSS_HISTORY_MAX_RECORDS + 2) * SEC);
+
+	memset(&fd, 0, sizeof(fd));
+	bss_history_record(history, bss_a, BSS_HISTORY_DISCONNECTED,
+				NOW + 100 * SEC);
+	bss_history_foreach(history, bss_a, foreach_record, &fd);
+	assert(fd.last_ttf == (100 - BSS_HISTORY_MAX_RECORDS - 2) * SEC);
+
+	/* Only two BSSes are tracked, the least recently updated goes */
+	bss_history_record(history, bss_b, BSS_HISTORY_CONNECT_FAILED, NOW);
+	bss_history_record(history, bss_a, BSS_HISTORY_CONNECT_FAILED, NOW);
+	bss_history_record(history, addr, BSS_HISTORY_CONNECT_FAILED, NOW);
+
+	assert(!bss_history_foreach(history, bss_b, foreach_record, &fd));
+	assert(near(bss_history_get_penalty(history, bss_b, NOW), 0));
+	assert(bss_history_get_penalty(history, bss_a, NOW) > 0);
+	assert(bss_history_get_penalty(history, addr, NOW) > 0);
+
+	bss_history_free(history);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("/BSS history/Penalty", test_penalty, NULL);
+	l_test_add("/BSS history/Time to failure", test_time_to_failure, NULL);
+	l_test_add("/BSS history/Bounds", test_bounds, NULL);
+
+	return l_test_run();
+}
@@ -0,0 +1,196 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <ell/ell.h>
+
+#include "src/util.h"
+#include "src/channel-stats.h"
+
+static const uint32_t freqs_scanned[] = { 2412, 2437, 2462, 5180, 5200 };
+
+struct info_lookup {
+	uint32_t freq;
+	bool found;
+	struct channel_stats_info info;
+};
+
+static struct scan_freq_set *build_freqs(const uint32_t *list, size_t len)
+{
+	struct scan_freq_set *freqs = scan_freq_set_new();
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		assert(scan_freq_set_add(freqs, list[i]));
+
+	return freqs;
+}
+
+static void collect_freq(uint32_t freq, const struct channel_stats_info *info,
+				void *user_data)
+{
+	uint32_t **next = user_data;
+
+	*(*next)++ = freq;
+}
+
+static void lookup_info(uint32_t freq, const struct channel_stats_info *info,
+				void *user_data)
+{
+	struct info_lookup *lookup = user_data;
+
+	if (freq != lookup->freq)
+		return;
+
+	lookup->found = true;
+	lookup->info = *info;
+}
+
+static void test_update(const void *data)
+{
+	_auto_(scan_freq_set_free) struct scan_freq_set *scanned =
+			build_freqs(freqs_scanned, L_ARRAY_SIZE(freqs_scanned));
+	/* Two BSSes on 2437, one on 5180 and one on a channel not scanned */
+	static const uint32_t bss_freqs[] = { 2437, 2437, 5180, 5745 };
+	struct channel_stats *stats = channel_stats_new(4);
+	struct info_lookup lookup = { .freq = 2437 };
+	uint32_t order[8];
+	uint32_t *next = order;
+
+	channel_stats_add_scan(stats, scanned, bss_freqs,
+				L_ARRAY_SIZE(bss_freqs), 1000);
+	channel_stats_add_scan(stats, scanned, NULL, 0, 2000);
+	channel_stats_add_scan(stats, scanned, bss_freqs, 2, 3000);
+
+	/* Only scanned channels are tracked, in frequency order */
+	assert(channel_stats_foreach(stats, collect_freq, &next) == 5);
+	assert(next - order == 5);
+	assert(order[0] == 2412 && order[1] == 2437 && order[2] == 2462);
+	assert(order[3] == 5180 && order[4] == 5200);
+
+	channel_stats_foreach(stats, lookup_info, &lookup);
+	assert(lookup.found);
+	assert(lookup.info.scans == 3);
+	assert(lookup.info.occupied_scans == 2);
+	assert(lookup.info.empty_streak == 0);
+	assert(lookup.info.last_bss_count == 2);
+	assert(lookup.info.last_seen == 3000);
+	assert(lookup.info.last_scanned == 3000);
+	assert(lookup.info.occupancy > 0.2 && lookup.info.occupancy < 0.25);
+
+	/* 5180 was missed by the last scan */
+	lookup = (struct info_lookup) { .freq = 5180 };
+	channel_stats_foreach(stats, lookup_info, &lookup);
+	assert(lookup.info.occupied_scans == 1);
+	assert(lookup.info.empty_streak == 2);
+	assert(lookup.info.last_seen == 1000);
+
+	lookup = (struct info_lookup) { .freq = 5745 };
+	channel_stats_foreach(stats, lookup_info, &lookup);
+	assert(!lookup.found);
+
+	channel_stats_free(stats);
+}
+
+static void test_quiet(const void *data)
+{
+	_auto_(scan_freq_set_free) struct scan_freq_set *scanned =
+			build_freqs(freqs_scanned, L_ARRAY_SIZE(freqs_scanned));
+	_auto_(scan_freq_set_free) struct scan_freq_set *limit =
+							scan_freq_set_new();
+	struct scan_freq_set *quiet;
+	static const uint32_t bss_freqs[] = { 2412, 5200 };
+	struct channel_stats *stats = channel_stats_new(3);
+	uint64_t now = 0;
+	unsigned int i;
+
+	for (i = 0; i < 2; i++)
+		channel_stats_add_scan(stats, scanned, bss_freqs,
+					L_ARRAY_SIZE(bss_freqs), ++now);
+
+	/* Not enough empty scans yet */
+	quiet = channel_stats_get_quiet(stats, NULL);
+	assert(scan_freq_set_isempty(quiet));
+	scan_freq_set_free(quiet);
+
+	channel_stats_add_scan(stats, scanned, bss_freqs,
+				L_ARRAY_SIZE(bss_freqs), ++now);
+
+	assert(channel_stats_is_quiet(stats, 2437));
+	assert(channel_stats_is_quiet(stats, 5180));
+	assert(!channel_stats_is_quiet(stats, 2412));
+	/* Never scanned, nothing known about it */
+	assert(!channel_stats_is_quiet(stats, 5745));
+
+	quiet = channel_stats_get_quiet(stats, NULL);
+	assert(scan_freq_set_contains(quiet, 2437));
+	assert(scan_freq_set_contains(quiet, 2462));
+	assert(scan_freq_set_contains(quiet, 5180));
+	assert(!scan_freq_set_contains(quiet, 2412));
+	assert(!scan_freq_set_contains(quiet, 5200));
+	scan_freq_set_free(quiet);
+
+	/* Limited to the channels asked about */
+	scan_freq_set_add(limit, 2437);
+	scan_freq_set_add(limit, 2412);
+	quiet = channel_stats_get_quiet(stats, limit);
+	assert(scan_freq_set_contains(quiet, 2437));
+	assert(!scan_freq_set_contains(quiet, 2462));
+	assert(!scan_freq_set_contains(quiet, 2412));
+	scan_freq_set_free(quiet);
+
+	/* A single BSS, found by any scan, brings the channel back */
+	channel_stats_add_scan(stats, limit, (const uint32_t []) { 2437 }, 1,
+				++now);
+	assert(!channel_stats_is_quiet(stats, 2437));
+	assert(channel_stats_is_quiet(stats, 2462));
+
+	channel_stats_free(stats);
+
+	/* Zero disables skipping altogether */
+	stats = channel_stats_new(0);
+
+	for (i = 0; i < 16; i++)
+		channel_stats_add_scan(stats, scanned, NULL, 0, ++now);
+
+	assert(!channel_stats_is_quiet(stats, 2437));
+	quiet = channel_stats_get_quiet(stats, scanned);
+	assert(scan_freq_set_isempty(quiet));
+	scan_freq_set_free(quiet);
+
+	channel_stats_free(stats);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("/Channel stats/Update", test_update, NULL);
+	l_test_add("/Channel stats/Quiet channels", test_quiet, NULL);
+
+	return l_test_run();
+}
@@ -25,7 +25,10 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <getopt.h>
 #include <assert.h>
 #include <ell/ell.h>
 #include <readline/readline.h>
@@ -33,6 +36,7 @@
 #include "client/dbus-proxy.h"
 #include "client/network.h"
 #include "client/command.h"
+#include "client/display.h"
 
 struct command_line_data {
 	const char *command_line;
@@ -69,12 +73,308 @@ static void command_line_find_tokens_test(const void *data)
 	}
 }
 
+struct structured_output_data {
+	enum display_format format;
+	bool success;
+	const char *expected;
+};
+
+static const struct structured_output_data structured_json = {
+	.format = DISPLAY_FORMAT_JSON,
+	.success = true,
+	.expected = "{\"command\":\"device list\",\"success\":true,"
+		"\"tables\":[{\"name\":\"Devices\",\"rows\":["
+		"{\"Name\":\"wlan0\",\"Powered\":\"on\"},"
+		"{\"Name\":\"wl\\\"1\",\"Powered\":\"off\"}]},"
+		"{\"name\":\"Device wlan0\",\"properties\":{"
+		"\"Name\":\"wlan0\",\"ConnectedNetwork\":\"my net\"}}],"
+		"\"messages\":[\"Done\"]}\n",
+};
+
+static const struct structured_output_data structured_kv = {
+	.format = DISPLAY_FORMAT_KEY_VALUE,
+	.success = false,
+	.expected = "command=\"device list\"\n"
+		"table=\"Devices\"\n"
+		"Name=\"wlan0\" Powered=\"on\"\n"
+		"Name=\"wl\\\"1\" Powered=\"off\"\n"
+		"object=\"Device wlan0\"\n"
+		"Name=\"wlan0\"\n"
+		"ConnectedNetwork=\"my net\"\n"
+		"message=\"Done\"\n"
+		"success=false\n\n",
+};
+
+static void structured_output_test(const void *data)
+{
+	const struct structured_output_data *test = data;
+	char *out;
+
+	display_set_format(test->format);
+	display_structured_begin("device list");
+
+	/* The text table is not part of the structured output */
+	display_table_header("Devices", MARGIN "%-*s  %-*s",
+					20, "Name", 10, "Powered");
+	display_structured_table("Devices");
+	display_structured_row("Name", "wlan0", "Powered", "on", NULL);
+	display_table_row(MARGIN, 2, 20, "wlan0", 10, COLOR_GREEN("on"));
+	display_structured_row("Name", "wl\"1", "Powered", "off", NULL);
+	display_table_row(MARGIN, 2, 20, "wl\"1", 10, "off");
+	display_table_footer();
+
+	display_structured_object("Device wlan0");
+	display_structured_property("Name", "wlan0");
+	display_structured_property("ConnectedNetwork", "my net");
+
+	display("Done\n");
+
+	out = display_structured_end(test->success);
+	assert(!strcmp(out, test->expected));
+	l_free(out);
+
+	/* State is reset for the next command */
+	display_structured_begin("version");
+	out = display_structured_end(true);
+
+	if (test->format == DISPLAY_FORMAT_JSON)
+		assert(!strcmp(out, "{\"command\":\"version\","
+					"\"success\":true}\n"));
+	else
+		assert(!strcmp(out, "command=\"version\"\n"
+					"success=true\n\n"));
+
+	l_free(out);
+
+	display_set_format(DISPLAY_FORMAT_TEXT);
+}
+
+#define REFRESH_TEST_PATH "/net/connman/iwd/0/4"
+
+static unsigned int refresh_runs;
+
+static enum cmd_status refresh_test_cmd(const char *entity,
+						char **argv, int argc)
+{
+	struct l_queue *match;
+
+	refresh_runs++;
+
+	/* The objects looked up select the signals that cause a redraw */
+	match = proxy_interface_find_all(IWD_STATION_INTERFACE, NULL, NULL);
+	l_queue_destroy(match, NULL);
+
+	switch (refresh_runs) {
+	case 1:
+		display_table_header("Stations", MARGIN "%s", "Name");
+		display_table_footer();
+		return CMD_STATUS_DONE;
+	case 2:
+		/* As when the method call returns an error */
+		display_error("Operation failed");
+		display_refresh_notify(IWD_STATION_INTERFACE,
+							REFRESH_TEST_PATH);
+		return CMD_STATUS_TRIGGERED;
+	case 3:
+		/* Fails without any output, a signal arrives meanwhile */
+		display_refresh_notify(IWD_STATION_INTERFACE,
+							REFRESH_TEST_PATH);
+		return CMD_STATUS_INVALID_VALUE;
+	}
+
+	l_main_quit();
+
+	return CMD_STATUS_DONE;
+}
+
+static const struct command refresh_test_command = {
+	NULL, "list", NULL, refresh_test_cmd, "List stations", true
+};
+
+static void refresh_test_unwatched_expired(struct l_timeout *timeout,
+							void *user_data)
+{
+	/* A signal from an object the command doesn't show was ignored */
+	assert(refresh_runs == 1);
+
+	display_refresh_notify(IWD_STATION_INTERFACE, REFRESH_TEST_PATH);
+	l_timeout_remove(timeout);
+}
+
+static void refresh_test_timeout(struct l_timeout *timeout, void *user_data)
+{
+	assert(false);
+}
+
+static void display_refresh_failure_test(const void *data)
+{
+	char *cmd_argv[] = { "iwctl", NULL };
+	struct l_timeout *timeout;
+
+	assert(l_main_init());
+	assert(!command_init(cmd_argv, 1));
+	assert(command_is_interactive_mode());
+
+	refresh_runs = 0;
+	display_refresh_set_cmd("station", NULL, &refresh_test_command,
+								NULL, 0);
+	refresh_test_command.function(NULL, NULL, 0);
+
+	display_refresh_notify(IWD_ADAPTER_INTERFACE, "/net/connman/iwd/0");
+	l_timeout_create_ms(1200, refresh_test_unwatched_expired, NULL, NULL);
+
+	/* Failed re-runs must not stop further refreshes */
+	timeout = l_timeout_create(10, refresh_test_timeout, NULL, NULL);
+	l_main_run();
+	assert(refresh_runs == 4);
+
+	l_timeout_remove(timeout);
+	display_refresh_reset();
+	display_exit();
+	command_exit();
+	l_main_exit();
+}
+
+static enum cmd_status batch_test_list(const char *entity,
+						char **argv, int argc)
+{
+	display_table_header("Test Objects", MARGIN "%-*s  %-*s",
+					20, "Name", 10, "Mode");
+	display_structured_table("Test");
+
+	display_structured_row("Name", entity, "Mode", argv[0], NULL);
+	display_table_row(MARGIN, 2, 20, entity, 10, argv[0]);
+
+	display_table_footer();
+
+	return CMD_STATUS_DONE;
+}
+
+static enum cmd_status batch_test_fail(const char *entity,
+						char **argv, int argc)
+{
+	display_error("Operation failed");
+
+	return CMD_STATUS_INVALID_VALUE;
+}
+
+static const struct command batch_test_commands[] = {
+	{ "<name>", "list", "<mode>", batch_test_list, "List" },
+	{ NULL, "fail", NULL, batch_test_fail, "Fail" },
+	{ }
+};
+
+static const struct command_family batch_test_family = {
+	.caption = "Test",
+	.name = "test",
+	.command_list = batch_test_commands,
+};
+
+static const char batch_test_input[] =
+	"test obj0 list station\n"
+	"\n"
+	"# Comments and empty lines are skipped\n"
+	"  test \"obj 1\" list ap  \n"
+	"test fail\n"
+	"unknown command\n"
+	"test obj2 list \"unterminated\n"
+	"version\n";
+
+static const char batch_test_expected[] =
+	"{\"command\":\"test obj0 list station\",\"success\":true,"
+	"\"tables\":[{\"name\":\"Test\",\"rows\":["
+	"{\"Name\":\"obj0\",\"Mode\":\"station\"}]}]}\n"
+	"{\"command\":\"test obj 1 list ap\",\"success\":true,"
+	"\"tables\":[{\"name\":\"Test\",\"rows\":["
+	"{\"Name\":\"obj 1\",\"Mode\":\"ap\"}]}]}\n"
+	"{\"command\":\"test fail\",\"success\":false,"
+	"\"errors\":[\"Operation failed\"]}\n"
+	"{\"command\":\"unknown command\",\"success\":false,"
+	"\"errors\":[\"Invalid command\"]}\n"
+	"{\"command\":\"test obj2 list \\\"unterminated\",\"success\":false,"
+	"\"errors\":[\"Invalid command\"]}\n"
+	"{\"command\":\"version\",\"success\":true,"
+	"\"tables\":[{\"name\":\"\",\"properties\":{"
+	"\"Version\":\"" VERSION "\"}}],"
+	"\"messages\":[\"IWD version " VERSION "\"]}\n";
+
+static void batch_test_timeout(struct l_timeout *timeout, void *user_data)
+{
+	assert(false);
+}
+
+static void command_batch_test(const void *data)
+{
+	char batch_path[] = "/tmp/iwctl-batch-XXXXXX";
+	char *cmd_argv[] = { "iwctl", "--format", "json",
+					"--batch", batch_path, NULL };
+	struct l_timeout *timeout;
+	FILE *output;
+	char buf[2048];
+	size_t len;
+	int saved_stdout;
+	int fd;
+
+	fd = mkstemp(batch_path);
+	assert(fd >= 0);
+	assert(write(fd, batch_test_input, strlen(batch_test_input)) ==
+					(ssize_t) strlen(batch_test_input));
+	close(fd);
+
+	/* Capture the structured output written to stdout */
+	output = tmpfile();
+	assert(output);
+	fflush(stdout);
+	saved_stdout = dup(STDOUT_FILENO);
+	assert(saved_stdout >= 0);
+	assert(dup2(fileno(output), STDOUT_FILENO) == STDOUT_FILENO);
+
+	assert(l_main_init());
+
+	optind = 0;
+	assert(!command_init(cmd_argv, L_ARRAY_SIZE(cmd_argv) - 1));
+	assert(command_is_batch_mode());
+	command_family_register(&batch_test_family);
+
+	timeout = l_timeout_create(10, batch_test_timeout, NULL, NULL);
+	command_noninteractive_trigger();
+	l_main_run();
+	l_timeout_remove(timeout);
+
+	fflush(stdout);
+	assert(dup2(saved_stdout, STDOUT_FILENO) == STDOUT_FILENO);
+	close(saved_stdout);
+
+	rewind(output);
+	len = fread(buf, 1, sizeof(buf) - 1, output);
+	buf[len] = '\0';
+	fclose(output);
+
+	assert(!strcmp(buf, batch_test_expected));
+	assert(command_get_exit_status() == EXIT_FAILURE);
+
+	command_family_unregister(&batch_test_family);
+	command_set_exit_status(EXIT_SUCCESS);
+	display_set_format(DISPLAY_FORMAT_TEXT);
+	command_exit();
+	l_main_exit();
+	unlink(batch_path);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
 
 	l_test_add("/Command/Find tokens", command_line_find_tokens_test,
 							&command_line_data_1);
+	l_test_add("/Display/Structured output/JSON", structured_output_test,
+							&structured_json);
+	l_test_add("/Display/Structured output/Key value",
+				structured_output_test, &structured_kv);
+	l_test_add("/Display/Refresh/Failure", display_refresh_failure_test,
+									NULL);
+	l_test_add("/Command/Batch/Structured output", command_batch_test,
+									NULL);
 
 	return l_test_run();
 }
@@ -334,6 +334,61 @@ static void ptk_test(const void *data)
 	l_free(ptk);
 }
 
+static void cached_kdf_test(const void *data)
+{
+	static const struct ptk_data *tests[] = {
+		&ptk_test_1, &ptk_test_3, &ptk_test_4, &ptk_test_1,
+	};
+	static const enum l_checksum_type types[] = {
+		L_CHECKSUM_SHA1, L_CHECKSUM_SHA256, L_CHECKSUM_SHA384,
+	};
+	struct crypto_hmac_cache *cache = NULL;
+	unsigned int i;
+	unsigned int j;
+
+	/*
+	 * Each derivation through the cache must match the uncached one, both
+	 * when the cached contexts are reused and when the key changes.
+	 */
+	for (i = 0; i < L_ARRAY_SIZE(tests); i++) {
+		const struct ptk_data *test = tests[i];
+
+		for (j = 0; j < L_ARRAY_SIZE(types); j++) {
+			uint8_t ptk[64];
+			uint8_t cached_ptk[64];
+			uint8_t pmkid[16];
+			uint8_t cached_pmkid[16];
+
+			if (!l_checksum_is_supported(types[j], true))
+				continue;
+
+			assert(crypto_derive_pairwise_ptk(test->pmk, 32,
+						test->aa, test->spa,
+						test->anonce, test->snonce,
+						ptk, sizeof(ptk), types[j]));
+			assert(crypto_derive_pairwise_ptk_cached(&cache,
+						test->pmk, 32,
+						test->aa, test->spa,
+						test->anonce, test->snonce,
+						cached_ptk, sizeof(cached_ptk),
+						types[j]));
+			assert(cache);
+			assert(!memcmp(ptk, cached_ptk, sizeof(ptk)));
+
+			assert(crypto_derive_pmkid(test->pmk, 32, test->spa,
+							test->aa, pmkid,
+							types[j]));
+			assert(crypto_derive_pmkid_cached(&cache, test->pmk, 32,
+							test->spa, test->aa,
+							cached_pmkid,
+							types[j]));
+			assert(!memcmp(pmkid, cached_pmkid, sizeof(pmkid)));
+		}
+	}
+
+	crypto_hmac_cache_free(cache);
+}
+
 static void aes_wrap_test(const void *data)
 {
 	/* RFC3394 section 4.1 test vector */
@@ -432,6 +487,8 @@ int main(int argc, char *argv[])
 			ptk_test, &ptk_test_3);
 	l_test_add("/PTK Derivation/PTK Test Case 4",
 			ptk_test, &ptk_test_4);
+	l_test_add("/PTK Derivation/Cached HMAC contexts",
+			cached_kdf_test, NULL);
 
 	l_test_add("/AES Key-wrap/Wrap & unwrap",
 			aes_wrap_test, NULL);
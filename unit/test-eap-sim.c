@@ -26,9 +26,11 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <assert.h>
 #include <ell/ell.h>
 
+#include "src/util.h"
 #include "src/eap.h"
 #include "src/eap-private.h"
 #include "src/simutil.h"
@@ -354,6 +356,351 @@ static void test_aka_prf_prime(const void *data)
 	assert(memcmp(emsk, vals->emsk, EAP_SIM_EMSK_LEN) == 0);
 }
 
+static const uint8_t reauth_nonce_s[] = {
+		0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+		0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+
+static const uint8_t reauth_iv[] = {
+		0x9e, 0x18, 0xb0, 0xc2, 0x9a, 0x65, 0x22, 0x63,
+		0xc0, 0x6e, 0xfb, 0x54, 0xdd, 0x00, 0xa8, 0x95 };
+
+static void reauth_init(struct eap_sim_reauth *reauth, const char *id)
+{
+	memset(reauth, 0, sizeof(*reauth));
+	reauth->reauth_id = l_strdup(id);
+	memcpy(reauth->mk, ex_mk, EAP_SIM_MK_LEN);
+	memcpy(reauth->k_encr, ex_keys, EAP_SIM_K_ENCR_LEN);
+	memcpy(reauth->k_aut, ex_keys + EAP_SIM_K_ENCR_LEN, EAP_SIM_K_AUT_LEN);
+}
+
+static void aes_cbc(bool encrypt, const uint8_t *k_encr, const uint8_t *iv,
+			const uint8_t *in, uint8_t *out, size_t len)
+{
+	struct l_cipher *cipher = l_cipher_new(L_CIPHER_AES_CBC, k_encr,
+						EAP_SIM_K_ENCR_LEN);
+
+	assert(cipher);
+	assert(l_cipher_set_iv(cipher, iv, EAP_SIM_IV_LEN));
+
+	if (encrypt)
+		assert(l_cipher_encrypt(cipher, in, out, len));
+	else
+		assert(l_cipher_decrypt(cipher, in, out, len));
+
+	l_cipher_free(cipher);
+}
+
+/*
+ * Builds a server EAP-Request/SIM/<subtype> with AT_IV, AT_ENCR_DATA
+ * holding 'plain' and, if k_aut is given, AT_MAC.  Returns the full EAP
+ * packet length, the method data starts at pkt + 5.
+ */
+static size_t build_encr_request(uint8_t id, uint8_t subtype,
+					const uint8_t *k_encr,
+					const uint8_t *k_aut,
+					const uint8_t *plain, size_t plain_len,
+					uint8_t *pkt)
+{
+	uint8_t *pos = pkt + 5;
+	uint8_t *encr;
+
+	pkt[0] = 0x01;
+	pkt[1] = id;
+	pkt[4] = EAP_TYPE_SIM;
+	*pos++ = subtype;
+	*pos++ = 0;
+	*pos++ = 0;
+
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_IV, EAP_SIM_PAD_ZERO,
+					reauth_iv, EAP_SIM_IV_LEN);
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_ENCR_DATA,
+					EAP_SIM_PAD_ZERO, NULL, plain_len);
+	encr = pos - plain_len;
+	aes_cbc(true, k_encr, reauth_iv, plain, encr, plain_len);
+
+	if (k_aut)
+		pos += eap_sim_add_attribute(pos, EAP_SIM_AT_MAC,
+						EAP_SIM_PAD_ZERO, NULL,
+						EAP_SIM_MAC_LEN);
+
+	l_put_be16(pos - pkt, pkt + 2);
+
+	if (k_aut)
+		assert(eap_sim_derive_mac(EAP_TYPE_SIM, pkt, pos - pkt, k_aut,
+						pos - EAP_SIM_MAC_LEN));
+
+	return pos - pkt;
+}
+
+static size_t build_reauth_request(uint8_t id,
+					const struct eap_sim_reauth *reauth,
+					uint16_t counter, const char *next_id,
+					uint8_t *pkt)
+{
+	uint8_t plain[64];
+	uint8_t *pos = plain;
+	uint8_t counter_be[2];
+	size_t len;
+
+	l_put_be16(counter, counter_be);
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_COUNTER,
+					EAP_SIM_PAD_NONE, counter_be, 2);
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_NONCE_S,
+					EAP_SIM_PAD_ZERO, reauth_nonce_s,
+					EAP_SIM_NONCE_S_LEN);
+
+	if (next_id)
+		pos += eap_sim_add_attribute(pos, EAP_SIM_AT_NEXT_REAUTH_ID,
+						EAP_SIM_PAD_LENGTH,
+						(const uint8_t *) next_id,
+						strlen(next_id));
+
+	len = align_len(pos - plain, 16);
+	if (len > (size_t) (pos - plain))
+		eap_sim_add_attribute(pos, EAP_SIM_AT_PADDING,
+					EAP_SIM_PAD_NONE, NULL,
+					len - (pos - plain) - 2);
+
+	return build_encr_request(id, EAP_SIM_ST_REAUTHENTICATION,
+					reauth->k_encr, reauth->k_aut,
+					plain, len, pkt);
+}
+
+/* Check the response MAC and return the decrypted AT_COUNTER block */
+static void verify_reauth_response(const struct eap_sim_reauth *reauth,
+					uint8_t id, const uint8_t *resp,
+					size_t len, uint8_t *plain)
+{
+	uint8_t buf[EAP_SIM_REAUTH_RESPONSE_LEN + EAP_SIM_NONCE_S_LEN];
+	uint8_t mac[EAP_SIM_MAC_LEN];
+
+	assert(len == EAP_SIM_REAUTH_RESPONSE_LEN);
+	assert(resp[0] == 0x02 && resp[1] == id);
+	assert(l_get_be16(resp + 2) == len);
+	assert(resp[4] == EAP_TYPE_SIM);
+	assert(resp[5] == EAP_SIM_ST_REAUTHENTICATION);
+	assert(resp[8] == EAP_SIM_AT_IV);
+	assert(resp[28] == EAP_SIM_AT_ENCR_DATA);
+	assert(resp[48] == EAP_SIM_AT_MAC);
+
+	memcpy(buf, resp, len);
+	memset(buf + 52, 0, EAP_SIM_MAC_LEN);
+	memcpy(buf + len, reauth_nonce_s, EAP_SIM_NONCE_S_LEN);
+	assert(eap_sim_derive_mac(EAP_TYPE_SIM, buf, sizeof(buf),
+					reauth->k_aut, mac));
+	assert(!memcmp(mac, resp + 52, EAP_SIM_MAC_LEN));
+
+	aes_cbc(false, reauth->k_encr, resp + 12, resp + 32, plain, 16);
+}
+
+/* RFC 4186 Section 7, XKEY' = SHA1(Identity|counter|NONCE_S|MK) */
+static void derive_reauth_msk(const char *identity, uint16_t counter,
+				uint8_t *msk)
+{
+	struct l_checksum *sha1 = l_checksum_new(L_CHECKSUM_SHA1);
+	uint8_t counter_be[2];
+	uint8_t xkey[20];
+	uint8_t fk[160];
+
+	l_put_be16(counter, counter_be);
+	l_checksum_update(sha1, identity, strlen(identity));
+	l_checksum_update(sha1, counter_be, 2);
+	l_checksum_update(sha1, reauth_nonce_s, EAP_SIM_NONCE_S_LEN);
+	l_checksum_update(sha1, ex_mk, EAP_SIM_MK_LEN);
+	l_checksum_get_digest(sha1, xkey, sizeof(xkey));
+	l_checksum_free(sha1);
+
+	eap_sim_fips_prf(xkey, sizeof(xkey), fk, sizeof(fk));
+	memcpy(msk, fk, EAP_SIM_MSK_LEN);
+}
+
+static void test_reauth(const void *data)
+{
+	struct eap_state *eap = eap_new(NULL, NULL, NULL);
+	struct eap_sim_reauth reauth;
+	uint8_t pkt[256];
+	size_t pkt_len;
+	uint8_t resp[EAP_SIM_REAUTH_RESPONSE_LEN];
+	size_t resp_len;
+	uint8_t plain[16];
+	uint8_t msk[EAP_SIM_MSK_LEN];
+	uint8_t emsk[EAP_SIM_EMSK_LEN];
+	uint8_t expected_msk[EAP_SIM_MSK_LEN];
+	uint8_t session_id[EAP_SIM_REAUTH_SESSION_ID_LEN];
+	int r;
+
+	reauth_init(&reauth, "reauth1@example.com");
+	eap_restore_last_id(eap, 7);
+
+	/* Successful re-authentication, the server hands out a new ID */
+	pkt_len = build_reauth_request(7, &reauth, 1, "reauth2@example.com",
+					pkt);
+	r = eap_sim_reauth_respond(eap, EAP_TYPE_SIM, pkt + 5, pkt_len - 5,
+					&reauth, msk, emsk, session_id,
+					resp, &resp_len);
+	assert(r == EAP_SIM_REAUTH_RESPONSE_LEN);
+	assert(resp_len == EAP_SIM_REAUTH_RESPONSE_LEN);
+
+	verify_reauth_response(&reauth, 7, resp, resp_len, plain);
+	assert(plain[0] == EAP_SIM_AT_COUNTER && plain[1] == 1);
+	assert(l_get_be16(plain + 2) == 1);
+	assert(plain[4] == EAP_SIM_AT_PADDING);
+
+	/* Keys derive from the identity used in this exchange */
+	derive_reauth_msk("reauth1@example.com", 1, expected_msk);
+	assert(!memcmp(msk, expected_msk, EAP_SIM_MSK_LEN));
+
+	assert(session_id[0] == EAP_TYPE_SIM);
+	assert(!memcmp(session_id + 1, reauth_nonce_s, EAP_SIM_NONCE_S_LEN));
+	assert(!memcmp(session_id + 1 + EAP_SIM_NONCE_S_LEN,
+			pkt + pkt_len - EAP_SIM_MAC_LEN, EAP_SIM_MAC_LEN));
+
+	assert(reauth.counter == 1);
+	assert(!strcmp(reauth.reauth_id, "reauth2@example.com"));
+
+	/* A replayed counter gets AT_COUNTER_TOO_SMALL */
+	eap_restore_last_id(eap, 8);
+	pkt_len = build_reauth_request(8, &reauth, 1, NULL, pkt);
+	r = eap_sim_reauth_respond(eap, EAP_TYPE_SIM, pkt + 5, pkt_len - 5,
+					&reauth, msk, emsk, session_id,
+					resp, &resp_len);
+	assert(r == -ERANGE);
+
+	verify_reauth_response(&reauth, 8, resp, resp_len, plain);
+	assert(l_get_be16(plain + 2) == 1);
+	assert(plain[4] == EAP_SIM_AT_COUNTER_TOO_SMALL);
+	assert(plain[8] == EAP_SIM_AT_PADDING);
+
+	assert(reauth.counter == 1);
+	assert(!strcmp(reauth.reauth_id, "reauth2@example.com"));
+
+	/* A bad MAC is rejected without touching the state */
+	eap_restore_last_id(eap, 9);
+	pkt_len = build_reauth_request(9, &reauth, 2, NULL, pkt);
+	pkt[pkt_len - 1] ^= 0x01;
+	r = eap_sim_reauth_respond(eap, EAP_TYPE_SIM, pkt + 5, pkt_len - 5,
+					&reauth, msk, emsk, session_id,
+					resp, &resp_len);
+	assert(r == -EBADMSG);
+	assert(reauth.counter == 1);
+
+	/* No AT_NEXT_REAUTH_ID means no further re-authentication */
+	pkt[pkt_len - 1] ^= 0x01;
+	r = eap_sim_reauth_respond(eap, EAP_TYPE_SIM, pkt + 5, pkt_len - 5,
+					&reauth, msk, emsk, session_id,
+					resp, &resp_len);
+	assert(r == EAP_SIM_REAUTH_RESPONSE_LEN);
+	assert(reauth.counter == 2);
+	assert(!reauth.reauth_id);
+
+	eap_sim_reauth_clear(&reauth);
+	eap_free(eap);
+}
+
+static void test_reauth_update_ids(const void *data)
+{
+	struct eap_sim_reauth reauth;
+	uint8_t plain[32];
+	uint8_t *pos = plain;
+	uint8_t pkt[256];
+	size_t pkt_len;
+
+	reauth_init(&reauth, "old@example.com");
+
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_NEXT_PSEUDONYM,
+					EAP_SIM_PAD_LENGTH,
+					(const uint8_t *) "pseudo", 6);
+	pos += eap_sim_add_attribute(pos, EAP_SIM_AT_NEXT_REAUTH_ID,
+					EAP_SIM_PAD_LENGTH,
+					(const uint8_t *) "new@example.com",
+					15);
+	assert(pos == plain + sizeof(plain));
+
+	pkt_len = build_encr_request(1, 0x0b, reauth.k_encr, NULL, plain,
+					sizeof(plain), pkt);
+
+	assert(eap_sim_reauth_update_ids(&reauth, reauth.k_encr, pkt + 5,
+						pkt_len - 5));
+	assert(!strcmp(reauth.pseudonym, "pseudo"));
+	assert(!strcmp(reauth.reauth_id, "new@example.com"));
+
+	assert(!strcmp(eap_sim_reauth_select_identity(&reauth, 0, "perm"),
+			"new@example.com"));
+	assert(!strcmp(eap_sim_reauth_select_identity(&reauth,
+				EAP_SIM_AT_FULLAUTH_ID_REQ, "perm"), "pseudo"));
+	assert(!strcmp(eap_sim_reauth_select_identity(&reauth,
+				EAP_SIM_AT_PERMANENT_ID_REQ, "perm"), "perm"));
+
+	/* No AT_ENCR_DATA: keep the pseudonym, drop the re-auth ID */
+	pkt[5] = 0x0b;
+	pkt[6] = 0;
+	pkt[7] = 0;
+	assert(eap_sim_reauth_update_ids(&reauth, reauth.k_encr, pkt + 5, 3));
+	assert(!strcmp(reauth.pseudonym, "pseudo"));
+	assert(!reauth.reauth_id);
+
+	eap_sim_reauth_clear(&reauth);
+}
+
+static struct l_settings *reauth_cache;
+
+static struct l_settings *reauth_cache_load(void)
+{
+	return l_settings_clone(reauth_cache);
+}
+
+static void reauth_cache_sync(const struct l_settings *cache)
+{
+	l_settings_free(reauth_cache);
+	reauth_cache = l_settings_clone(cache);
+}
+
+static void test_reauth_cache(const void *data)
+{
+	struct eap_sim_reauth reauth;
+	struct eap_sim_reauth loaded = {};
+
+	reauth_cache = l_settings_new();
+	eap_sim_set_reauth_cache_ops(reauth_cache_load, reauth_cache_sync);
+
+	reauth_init(&reauth, "reauth@example.com");
+	reauth.pseudonym = l_strdup("pseudo");
+	reauth.counter = 5;
+
+	eap_sim_reauth_save("abcd", EAP_TYPE_SIM, &reauth);
+
+	/* Entries are per method */
+	assert(!eap_sim_reauth_load("abcd", EAP_TYPE_AKA, &loaded));
+	assert(!eap_sim_reauth_load("0123", EAP_TYPE_SIM, &loaded));
+
+	assert(eap_sim_reauth_load("abcd", EAP_TYPE_SIM, &loaded));
+	assert(!strcmp(loaded.pseudonym, "pseudo"));
+	assert(!strcmp(loaded.reauth_id, "reauth@example.com"));
+	assert(loaded.counter == 5);
+	assert(!memcmp(loaded.mk, reauth.mk, EAP_SIM_MK_LEN));
+	assert(!memcmp(loaded.k_encr, reauth.k_encr, EAP_SIM_K_ENCR_LEN));
+	assert(!memcmp(loaded.k_aut, reauth.k_aut, EAP_SIM_K_AUT_LEN));
+	eap_sim_reauth_clear(&loaded);
+
+	/* Without a re-auth ID only the pseudonym is kept */
+	l_free(l_steal_ptr(reauth.reauth_id));
+	eap_sim_reauth_save("abcd", EAP_TYPE_SIM, &reauth);
+	assert(!l_settings_has_key(reauth_cache, "abcd", "MasterKey"));
+
+	assert(eap_sim_reauth_load("abcd", EAP_TYPE_SIM, &loaded));
+	assert(!strcmp(loaded.pseudonym, "pseudo"));
+	assert(!loaded.reauth_id);
+	eap_sim_reauth_clear(&loaded);
+
+	eap_sim_forget_peer("abcd");
+	assert(!l_settings_has_group(reauth_cache, "abcd"));
+
+	eap_sim_reauth_clear(&reauth);
+	eap_sim_set_reauth_cache_ops(NULL, NULL);
+	l_settings_free(reauth_cache);
+	reauth_cache = NULL;
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -364,6 +711,10 @@ int main(int argc, char *argv[])
 	l_test_add("EAP-SIM PRNG test", test_prng, NULL);
 	l_test_add("EAP-AKA' Test Case 1", test_aka_prf_prime, &test_case_1);
 	l_test_add("EAP-AKA' Test Case 2", test_aka_prf_prime, &test_case_2);
+	l_test_add("EAP-SIM fast re-authentication", test_reauth, NULL);
+	l_test_add("EAP-SIM next pseudonym/re-auth ID", test_reauth_update_ids,
+			NULL);
+	l_test_add("EAP-SIM re-authentication cache", test_reauth_cache, NULL);
 
 	return l_test_run();
 }
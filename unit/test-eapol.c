@@ -36,6 +36,7 @@
 #include "src/ie.h"
 #include "src/eap.h"
 #include "src/eap-private.h"
+#include "src/eap-tls-common.h"
 #include "src/handshake.h"
 
 /* Our nonce to use + its size */
@@ -2740,6 +2741,8 @@ struct eapol_8021x_tls_test_state {
 
 	uint8_t method;
 	bool expect_handshake_fail;
+	/* Handshake steps are run on a worker, answered from the main loop */
+	bool offload;
 
 	struct l_tls *tls;
 	uint8_t last_id;
@@ -2886,6 +2889,19 @@ static void test_handshake_event(struct handshake_state *hs,
 	}
 }
 
+static void eapol_sm_test_tls_wait(struct eapol_8021x_tls_test_state *s,
+					struct test_handshake_state *ths)
+{
+	unsigned int i;
+
+	for (i = 0; s->offload && s->pending_req && i < 100; i++) {
+		if (ths->handshake_failed || s->disconnected)
+			break;
+
+		l_main_iterate(100);
+	}
+}
+
 static void eapol_sm_test_tls(struct eapol_8021x_tls_test_state *s,
 				struct l_settings *config)
 {
@@ -3019,6 +3035,7 @@ static void eapol_sm_test_tls(struct eapol_8021x_tls_test_state *s,
 
 		__eapol_rx_packet(1, ap_address, ETH_P_PAE,
 					tx_buf, tx_len, false);
+		eapol_sm_test_tls_wait(s, ths);
 
 		if (ths->handshake_failed || s->disconnected)
 			break;
@@ -3043,6 +3060,7 @@ static void eapol_sm_test_tls(struct eapol_8021x_tls_test_state *s,
 
 			__eapol_rx_packet(1, ap_address, ETH_P_PAE,
 						tx_buf, tx_len, false);
+			eapol_sm_test_tls_wait(s, ths);
 
 			if (ths->handshake_failed || s->disconnected)
 				break;
@@ -3169,6 +3187,42 @@ static void eapol_sm_test_eap_tls(const void *data)
 	l_settings_free(config);
 }
 
+static void eapol_sm_test_eap_tls_offload(const void *data)
+{
+	static const char *config_8021x = "[Security]\n"
+		"EAP-Method=TLS\n"
+		"EAP-Identity=abc@example.com\n"
+		"EAP-TLS-CACert=" CERTDIR "cert-ca.pem\n"
+		"EAP-TLS-ClientCert=" CERTDIR "cert-client.pem\n"
+		"EAP-TLS-ClientKey=" CERTDIR "cert-client-key-pkcs8.pem";
+	struct eapol_8021x_tls_test_state s = {};
+	struct l_settings* config = l_settings_new();
+	struct eap_tls_offload_stats stats;
+
+	l_settings_load_from_data(config, config_8021x, strlen(config_8021x));
+
+	s.app_data_cb = eapol_sm_test_tls_new_data;
+	s.ready_cb = eapol_sm_test_tls_test_ready;
+	s.disconnect_cb = eapol_sm_test_tls_test_disconnected;
+	s.method = EAP_TYPE_TLS;
+	s.offload = true;
+
+	assert(l_main_init());
+	__eap_tls_set_offload(true);
+	__eap_tls_reset_offload_stats();
+
+	eapol_sm_test_tls(&s, config);
+
+	/* No handshake record was processed on the main loop */
+	__eap_tls_get_offload_stats(&stats);
+	assert(stats.worker_steps > 0);
+	assert(stats.main_loop_handshake_steps == 0);
+
+	__eap_tls_set_offload(false);
+	l_main_exit();
+	l_settings_free(config);
+}
+
 static void eapol_sm_test_eap_tls_embedded(const void *data)
 {
 	struct eapol_8021x_tls_test_state s = {};
@@ -4021,6 +4075,8 @@ int main(int argc, char *argv[])
 						L_KEY_FEATURE_CRYPTO)) {
 		l_test_add("EAPoL/8021x EAP-TLS & 4-Way Handshake",
 					&eapol_sm_test_eap_tls, NULL);
+		l_test_add("EAPoL/8021x EAP-TLS on a worker thread",
+					&eapol_sm_test_eap_tls_offload, NULL);
 
 		l_test_add("EAPoL/8021x EAP-TTLS+EAP-MD5 & 4-Way Handshake",
 					&eapol_sm_test_eap_ttls_md5, NULL);
@@ -694,6 +694,220 @@ static void ie_test_encapsulate_wsc(const void *data)
 	l_free(packed);
 }
 
+static const unsigned char rnr_ie[] = {
+	0xc9, 0x40,
+	/* Two TBTT Information fields of 13 octets on 6 GHz channel 37 */
+	0x10, 0x0d, 0x83, 0x25,
+	0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0xee, 0xa3, 0xe4, 0xd1,
+	0x42, 0xfe,
+	0x10, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x78, 0x56, 0x34, 0x12,
+	0x20, 0xfe,
+	/* TBTT offset and BSS Parameters only, 5 GHz channel 36 */
+	0x00, 0x02, 0x73, 0x24, 0x05, 0x02,
+	/* Reserved TBTT Information Field Type */
+	0x01, 0x01, 0x83, 0x05, 0x00,
+	/* TBTT offset and Short SSID, 6 GHz channel 5 */
+	0x00, 0x05, 0x83, 0x05, 0x00, 0xee, 0xa3, 0xe4, 0xd1,
+	/* Reserved TBTT Information Length */
+	0x00, 0x0a, 0x83, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00,
+};
+
+static const unsigned char rnr_ie_truncated[] = {
+	0xc9, 0x05, 0x10, 0x0d, 0x83, 0x25, 0xff,
+};
+
+static const unsigned char rnr_ie_short_header[] = {
+	0xc9, 0x03, 0x00, 0x01, 0x83,
+};
+
+static int ie_test_parse_rnr(const unsigned char *ie, size_t len,
+				struct ie_rnr_info *out, size_t max,
+				size_t *n_out)
+{
+	struct ie_tlv_iter iter;
+
+	ie_tlv_iter_init(&iter, ie, len);
+	assert(ie_tlv_iter_next(&iter));
+	assert(ie_tlv_iter_get_tag(&iter) == IE_TYPE_REDUCED_NEIGHBOR_REPORT);
+
+	return ie_parse_reduced_neighbor_report(&iter, out, max, n_out);
+}
+
+static void ie_test_reduced_neighbor_report(const void *data)
+{
+	static const uint8_t addr1[6] = { 0x02, 0, 0, 0, 0, 0x01 };
+	static const uint8_t addr2[6] = { 0x02, 0, 0, 0, 0, 0x02 };
+	uint32_t home = ie_short_ssid((const uint8_t *) "Home", 4);
+	struct ie_rnr_info info[8];
+	size_t n;
+
+	assert(ie_test_parse_rnr(rnr_ie, sizeof(rnr_ie), info,
+					L_ARRAY_SIZE(info), &n) == 0);
+	assert(n == 4);
+
+	assert(info[0].oper_class == 131 && info[0].channel == 37);
+	assert(info[0].addr_present && !memcmp(info[0].addr, addr1, 6));
+	assert(info[0].short_ssid_present && info[0].short_ssid == home);
+	assert(info[0].bss_params_present);
+	assert(info[0].bss_params == (IE_RNR_BSS_PARAM_SAME_SSID |
+					IE_RNR_BSS_PARAM_COLOCATED_AP));
+
+	assert(info[1].oper_class == 131 && info[1].channel == 37);
+	assert(info[1].addr_present && !memcmp(info[1].addr, addr2, 6));
+	assert(info[1].short_ssid == 0x12345678);
+	assert(info[1].bss_params == IE_RNR_BSS_PARAM_20MHZ_PROBE_RESP);
+
+	assert(info[2].oper_class == 115 && info[2].channel == 36);
+	assert(!info[2].addr_present && !info[2].short_ssid_present);
+	assert(info[2].bss_params_present);
+	assert(info[2].bss_params == IE_RNR_BSS_PARAM_SAME_SSID);
+
+	assert(info[3].oper_class == 131 && info[3].channel == 5);
+	assert(!info[3].addr_present && !info[3].bss_params_present);
+	assert(info[3].short_ssid_present && info[3].short_ssid == home);
+
+	/* Entries beyond the output array are ignored */
+	assert(ie_test_parse_rnr(rnr_ie, sizeof(rnr_ie), info, 1, &n) == 0);
+	assert(n == 1);
+	assert(!memcmp(info[0].addr, addr1, 6));
+
+	assert(ie_test_parse_rnr(rnr_ie_truncated, sizeof(rnr_ie_truncated),
+					info, L_ARRAY_SIZE(info), &n) ==
+					-EINVAL);
+	assert(ie_test_parse_rnr(rnr_ie_short_header,
+					sizeof(rnr_ie_short_header),
+					info, L_ARRAY_SIZE(info), &n) ==
+					-EINVAL);
+}
+
+static void ie_test_short_ssid(const void *data)
+{
+	assert(ie_short_ssid((const uint8_t *) "123456789", 9) ==
+								0xcbf43926);
+	assert(ie_short_ssid((const uint8_t *) "Home", 4) == 0xd1e4a3ee);
+	assert(ie_short_ssid(NULL, 0) == 0);
+}
+
+/*
+ * Beacon of an AP hosting "Guest" and "IoT" behind the transmitted "Corp"
+ * BSS.  "Guest" drops the RSN element through its Non-Inheritance element,
+ * "IoT" overrides the RSN and WMM elements.  The third profile lacks the
+ * Nontransmitted BSSID Capability and must be ignored.
+ */
+static const unsigned char mbssid_beacon_ies[] = {
+	0x00, 0x04, 0x43, 0x6f, 0x72, 0x70, 0x01, 0x08, 0x82, 0x84, 0x8b, 0x96,
+	0x0c, 0x12, 0x18, 0x24, 0x03, 0x01, 0x06, 0x30, 0x14, 0x01, 0x00, 0x00,
+	0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00,
+	0x0f, 0xac, 0x02, 0x0c, 0x00, 0x47, 0x50, 0x02, 0x00, 0x16, 0x53, 0x02,
+	0x11, 0x04, 0x00, 0x05, 0x47, 0x75, 0x65, 0x73, 0x74, 0x55, 0x03, 0x01,
+	0x02, 0x00, 0xff, 0x04, 0x38, 0x01, 0x30, 0x00, 0x00, 0x2b, 0x53, 0x02,
+	0x11, 0x14, 0x00, 0x03, 0x49, 0x6f, 0x54, 0x55, 0x01, 0x03, 0x30, 0x14,
+	0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+	0x01, 0x00, 0x00, 0x0f, 0xac, 0x08, 0x0c, 0x00, 0xdd, 0x07, 0x00, 0x50,
+	0xf2, 0x02, 0x00, 0x01, 0x00, 0x00, 0x08, 0x00, 0x03, 0x42, 0x61, 0x64,
+	0x55, 0x01, 0x02, 0xdd, 0x07, 0x00, 0x50, 0xf2, 0x02, 0x00, 0x01, 0x80,
+	0x7f, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0xff, 0x03,
+	0x37, 0x02, 0x01,
+};
+
+static const unsigned char mbssid_profile1_ies[] = {
+	0x00, 0x05, 0x47, 0x75, 0x65, 0x73, 0x74, 0x01, 0x08, 0x82, 0x84, 0x8b,
+	0x96, 0x0c, 0x12, 0x18, 0x24, 0x03, 0x01, 0x06, 0xdd, 0x07, 0x00, 0x50,
+	0xf2, 0x02, 0x00, 0x01, 0x80, 0x7f, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x40, 0x55, 0x03, 0x01, 0x02, 0x00,
+};
+
+static const unsigned char mbssid_profile2_ies[] = {
+	0x00, 0x03, 0x49, 0x6f, 0x54, 0x01, 0x08, 0x82, 0x84, 0x8b, 0x96, 0x0c,
+	0x12, 0x18, 0x24, 0x03, 0x01, 0x06, 0x30, 0x14, 0x01, 0x00, 0x00, 0x0f,
+	0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f,
+	0xac, 0x08, 0x0c, 0x00, 0xdd, 0x07, 0x00, 0x50, 0xf2, 0x02, 0x00, 0x01,
+	0x00, 0x7f, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x55,
+	0x01, 0x03,
+};
+
+struct mbssid_results {
+	unsigned int n;
+	uint8_t bssid[4][6];
+	uint16_t capability[4];
+	uint8_t *ies[4];
+	size_t ies_len[4];
+};
+
+static void mbssid_profile(const uint8_t *bssid, uint16_t capability,
+				const uint8_t *ies, size_t ies_len,
+				void *user_data)
+{
+	struct mbssid_results *results = user_data;
+	unsigned int n = results->n++;
+
+	assert(n < L_ARRAY_SIZE(results->bssid));
+
+	memcpy(results->bssid[n], bssid, 6);
+	results->capability[n] = capability;
+	results->ies[n] = l_memdup(ies, ies_len);
+	results->ies_len[n] = ies_len;
+}
+
+static void mbssid_results_clear(struct mbssid_results *results)
+{
+	unsigned int i;
+
+	for (i = 0; i < results->n; i++)
+		l_free(results->ies[i]);
+
+	memset(results, 0, sizeof(*results));
+}
+
+static void ie_test_multiple_bssid(const void *data)
+{
+	static const uint8_t bssid[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x50 };
+	static const uint8_t bssid_wrap[6] = {
+		0x02, 0x11, 0x22, 0x33, 0x44, 0x53
+	};
+	struct mbssid_results results = {};
+
+	assert(ie_parse_multiple_bssid(mbssid_beacon_ies,
+					sizeof(mbssid_beacon_ies), bssid,
+					mbssid_profile, &results) == 2);
+	assert(results.n == 2);
+
+	assert(!memcmp(results.bssid[0],
+			(uint8_t []) { 0x02, 0x11, 0x22, 0x33, 0x44, 0x51 },
+			6));
+	assert(results.capability[0] == 0x0411);
+	assert(results.ies_len[0] == sizeof(mbssid_profile1_ies));
+	assert(!memcmp(results.ies[0], mbssid_profile1_ies,
+			sizeof(mbssid_profile1_ies)));
+
+	assert(!memcmp(results.bssid[1],
+			(uint8_t []) { 0x02, 0x11, 0x22, 0x33, 0x44, 0x53 },
+			6));
+	assert(results.capability[1] == 0x1411);
+	assert(results.ies_len[1] == sizeof(mbssid_profile2_ies));
+	assert(!memcmp(results.ies[1], mbssid_profile2_ies,
+			sizeof(mbssid_profile2_ies)));
+
+	mbssid_results_clear(&results);
+
+	/* The index is added modulo 2^MaxBSSID Indicator */
+	assert(ie_parse_multiple_bssid(mbssid_beacon_ies,
+					sizeof(mbssid_beacon_ies), bssid_wrap,
+					mbssid_profile, &results) == 2);
+	assert(results.bssid[0][5] == 0x50);
+	assert(results.bssid[1][5] == 0x52);
+	assert(!memcmp(results.bssid[1], bssid_wrap, 5));
+
+	mbssid_results_clear(&results);
+
+	/* No Multiple BSSID element, nothing to expand */
+	assert(ie_parse_multiple_bssid(mbssid_profile2_ies,
+					sizeof(mbssid_profile2_ies), bssid,
+					mbssid_profile, &results) == 0);
+	assert(results.n == 0);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -755,5 +969,13 @@ int main(int argc, char *argv[])
 				ie_test_encapsulate_wsc,
 				&ie_tlv_concat_test_data_1);
 
+	l_test_add("/ie/Reduced Neighbor Report/Parse",
+				ie_test_reduced_neighbor_report, NULL);
+	l_test_add("/ie/Reduced Neighbor Report/Short SSID",
+				ie_test_short_ssid, NULL);
+
+	l_test_add("/ie/Multiple BSSID/Expand profiles",
+				ie_test_multiple_bssid, NULL);
+
 	return l_test_run();
 }
@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <assert.h>
+#include <time.h>
 
 #include <ell/ell.h>
 
@@ -515,6 +516,144 @@ static void test_json_nested_arrays(const void *data)
 	json_contents_free(c);
 }
 
+/*
+ * Keys of a nested object are found even when it has more of them than the
+ * top level object
+ */
+static void test_json_nested_more_keys(const void *data)
+{
+	char json[] = "{\"obj\":{\"one\":1,\"two\":{\"x\":[1,2]},\"three\":3,"
+			"\"four\":\"4\"}}";
+	struct json_iter iter;
+	struct json_iter obj;
+	struct json_iter one;
+	struct json_iter three;
+	_auto_(l_free) char *four = NULL;
+	unsigned int u;
+	struct json_contents *c = json_contents_new(json, strlen(json));
+
+	json_iter_init(&iter, c);
+	assert(json_iter_parse(&iter,
+			JSON_MANDATORY("obj", JSON_OBJECT, &obj),
+			JSON_UNDEFINED));
+
+	assert(json_iter_parse(&obj,
+			JSON_MANDATORY("four", JSON_STRING, &four),
+			JSON_MANDATORY("three", JSON_PRIMITIVE, &three),
+			JSON_MANDATORY("one", JSON_PRIMITIVE, &one),
+			JSON_UNDEFINED));
+
+	assert(!strcmp(four, "4"));
+	assert(json_iter_get_uint(&three, &u) && u == 3);
+	assert(json_iter_get_uint(&one, &u) && u == 1);
+
+	/* "x" only exists below "two" */
+	assert(!json_iter_parse(&obj,
+			JSON_MANDATORY("x", JSON_ARRAY, NULL),
+			JSON_UNDEFINED));
+
+	json_contents_free(c);
+}
+
+#define DPP_BENCH_ITERATIONS 20000
+
+/* Configuration objects as sent by a DPP configurator */
+static const char *dpp_objects[] = {
+	"{\"wi-fi_tech\":\"infra\",\"discovery\":{\"ssid\":\"HomeNetwork\"},"
+		"\"cred\":{\"akm\":\"psk\",\"pass\":\"secret123\"}}",
+	"{\"wi-fi_tech\":\"infra\",\"discovery\":{\"ssid\":\"Office-5G\"},"
+		"\"cred\":{\"akm\":\"psk+sae\",\"psk\":\"0123456789abcdef"
+		"0123456789abcdef0123456789abcdef0123456789abcdef\"}}",
+	"{\"wi-fi_tech\":\"infra\",\"discovery\":{\"ssid\":\"Hidden\"},"
+		"\"cred\":{\"akm\":\"sae\",\"pass\":\"correct horse\"},"
+		"\"/net/connman/iwd\":{\"send_hostname\":true,"
+		"\"hidden\":true}}",
+};
+
+static bool parse_dpp_object(const char *json)
+{
+	struct json_contents *c = json_contents_new(json, strlen(json));
+	struct json_iter iter;
+	struct json_iter discovery;
+	struct json_iter cred;
+	struct json_iter extra;
+	struct json_iter hostname;
+	struct json_iter hidden;
+	_auto_(l_free) char *tech = NULL;
+	_auto_(l_free) char *ssid = NULL;
+	_auto_(l_free) char *akm = NULL;
+	_auto_(l_free) char *pass = NULL;
+	_auto_(l_free) char *psk = NULL;
+	bool r = false;
+
+	if (!c)
+		return false;
+
+	json_iter_init(&iter, c);
+
+	if (!json_iter_parse(&iter,
+			JSON_MANDATORY("wi-fi_tech", JSON_STRING, &tech),
+			JSON_MANDATORY("discovery", JSON_OBJECT, &discovery),
+			JSON_MANDATORY("cred", JSON_OBJECT, &cred),
+			JSON_OPTIONAL("/net/connman/iwd", JSON_OBJECT, &extra),
+			JSON_UNDEFINED))
+		goto done;
+
+	if (!json_iter_parse(&discovery,
+			JSON_MANDATORY("ssid", JSON_STRING, &ssid),
+			JSON_UNDEFINED))
+		goto done;
+
+	if (!json_iter_parse(&cred,
+			JSON_MANDATORY("akm", JSON_STRING, &akm),
+			JSON_OPTIONAL("pass", JSON_STRING, &pass),
+			JSON_OPTIONAL("psk", JSON_STRING, &psk),
+			JSON_UNDEFINED))
+		goto done;
+
+	if (!pass == !psk)
+		goto done;
+
+	if (json_iter_is_valid(&extra) && !json_iter_parse(&extra,
+			JSON_OPTIONAL("send_hostname", JSON_PRIMITIVE,
+					&hostname),
+			JSON_OPTIONAL("hidden", JSON_PRIMITIVE, &hidden),
+			JSON_UNDEFINED))
+		goto done;
+
+	r = !strcmp(tech, "infra") && ssid[0] && akm[0];
+
+done:
+	json_contents_free(c);
+	return r;
+}
+
+/*
+ * Not a pass/fail test, reports how many configuration objects can be parsed
+ * per second.  Useful to compare revisions of the parser.
+ */
+static void test_json_dpp_throughput(const void *data)
+{
+	unsigned int n = L_ARRAY_SIZE(dpp_objects);
+	struct timespec start;
+	struct timespec end;
+	unsigned int i;
+	double secs;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < DPP_BENCH_ITERATIONS; i++)
+		assert(parse_dpp_object(dpp_objects[i % n]));
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%u configuration objects in %.3fs, %.0f objects/s\n",
+		DPP_BENCH_ITERATIONS, secs, DPP_BENCH_ITERATIONS / secs);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -528,6 +667,10 @@ int main(int argc, char *argv[])
 	l_test_add("json test primitives", test_json_primitives, NULL);
 	l_test_add("json test arrays", test_json_arrays, NULL);
 	l_test_add("json test nested arrays", test_json_nested_arrays, NULL);
+	l_test_add("json nested object with more keys",
+			test_json_nested_more_keys, NULL);
+	l_test_add("json DPP configuration throughput",
+			test_json_dpp_throughput, NULL);
 
 	return l_test_run();
 }
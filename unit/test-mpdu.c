@@ -175,6 +175,201 @@ static void ie_order_test(const void *data)
 	assert(!!mpdu_validate(frame->data, frame->len) == frame->good);
 }
 
+/*
+ * Reference implementation of the element validation rules: any element
+ * that is part of the frame's element set must not be repeated, save for a
+ * few exceptions, and Resource Descriptors following a RIC Data element
+ * are skipped.  Each element is looked up and checked for duplicates with
+ * a linear search.
+ */
+static bool ref_skip_resource_req_resp(struct ie_tlv_iter *iter)
+{
+	struct ie_tlv_iter tmp;
+
+	memcpy(&tmp, iter, sizeof(tmp));
+
+	while (ie_tlv_iter_next(&tmp)) {
+		switch (ie_tlv_iter_get_tag(&tmp)) {
+		case IE_TYPE_TSPEC:
+		case IE_TYPE_TCLAS:
+		case IE_TYPE_TCLAS_PROCESSING:
+		case IE_TYPE_EXPEDITED_BANDWIDTH_REQUEST:
+		case IE_TYPE_SCHEDULE:
+		case IE_TYPE_TS_DELAY:
+		case IE_TYPE_RIC_DESCRIPTOR:
+		case IE_TYPE_VENDOR_SPECIFIC:
+			memcpy(iter, &tmp, sizeof(tmp));
+			continue;
+		default:
+			break;
+		}
+		break;
+	}
+
+	return true;
+}
+
+static bool ref_validate_ies(const uint8_t *ies, size_t ies_len,
+				const enum ie_type *tag_order,
+				unsigned int tag_count)
+{
+	struct ie_tlv_iter iter;
+	struct ie_tlv_iter clone;
+	unsigned int tag;
+	unsigned int i;
+
+	ie_tlv_iter_init(&iter, ies, ies_len);
+
+	while (ie_tlv_iter_next(&iter)) {
+		tag = ie_tlv_iter_get_tag(&iter);
+
+		for (i = 0; i < tag_count; i++)
+			if (tag_order[i] == tag)
+				break;
+
+		if (i == tag_count)
+			continue;
+
+		if (tag != IE_TYPE_VENDOR_SPECIFIC &&
+				tag != IE_TYPE_RIC_DATA) {
+			memcpy(&clone, &iter, sizeof(clone));
+
+			while (ie_tlv_iter_next(&clone))
+				if (ie_tlv_iter_get_tag(&clone) == tag)
+					return false;
+		}
+
+		if (tag == IE_TYPE_RIC_DATA)
+			ref_skip_resource_req_resp(&iter);
+	}
+
+	return true;
+}
+
+struct ie_fuzz_data {
+	const uint8_t *header;
+	size_t header_len;
+	/* Elements to pick from, some not valid in this frame type */
+	const unsigned int *pool;
+	unsigned int n_pool;
+	/* The subset of the pool valid in this frame type */
+	const enum ie_type *valid;
+	unsigned int n_valid;
+};
+
+static const uint8_t fuzz_probe_req_header[] = {
+	0x40, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00,
+	0x00, 0x00, 0x03, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x50, 0x64,
+};
+
+static const unsigned int fuzz_probe_req_pool[] = {
+	IE_TYPE_SSID, IE_TYPE_SUPPORTED_RATES,
+	IE_TYPE_EXTENDED_SUPPORTED_RATES, IE_TYPE_DSSS_PARAMETER_SET,
+	IE_TYPE_HT_CAPABILITIES, IE_TYPE_VENDOR_SPECIFIC,
+	IE_TYPE_FILS_REQUEST_PARAMETERS, IE_TYPE_TIM, IE_TYPE_RSN,
+	IE_TYPE_RIC_DATA, IE_TYPE_TSPEC, IE_TYPE_HE_CAPABILITIES,
+};
+
+static const enum ie_type fuzz_probe_req_valid[] = {
+	IE_TYPE_SSID, IE_TYPE_SUPPORTED_RATES,
+	IE_TYPE_EXTENDED_SUPPORTED_RATES, IE_TYPE_DSSS_PARAMETER_SET,
+	IE_TYPE_HT_CAPABILITIES, IE_TYPE_VENDOR_SPECIFIC,
+	IE_TYPE_FILS_REQUEST_PARAMETERS,
+};
+
+static const struct ie_fuzz_data ie_fuzz_probe_req = {
+	fuzz_probe_req_header, sizeof(fuzz_probe_req_header),
+	fuzz_probe_req_pool, L_ARRAY_SIZE(fuzz_probe_req_pool),
+	fuzz_probe_req_valid, L_ARRAY_SIZE(fuzz_probe_req_valid),
+};
+
+/* FT Authentication, transaction sequence 2, status success */
+static const uint8_t fuzz_ft_auth_header[] = {
+	0xb0, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+	0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x50, 0x64,
+	0x02, 0x00, 0x02, 0x00, 0x00, 0x00,
+};
+
+static const unsigned int fuzz_ft_auth_pool[] = {
+	IE_TYPE_RSN, IE_TYPE_MOBILITY_DOMAIN, IE_TYPE_FAST_BSS_TRANSITION,
+	IE_TYPE_TIMEOUT_INTERVAL, IE_TYPE_RIC_DATA, IE_TYPE_TSPEC,
+	IE_TYPE_TCLAS, IE_TYPE_RIC_DESCRIPTOR, IE_TYPE_MULTIBAND,
+	IE_TYPE_VENDOR_SPECIFIC, IE_TYPE_SSID,
+};
+
+static const enum ie_type fuzz_ft_auth_valid[] = {
+	IE_TYPE_RSN, IE_TYPE_MOBILITY_DOMAIN, IE_TYPE_FAST_BSS_TRANSITION,
+	IE_TYPE_TIMEOUT_INTERVAL, IE_TYPE_RIC_DATA, IE_TYPE_MULTIBAND,
+	IE_TYPE_VENDOR_SPECIFIC,
+};
+
+static const struct ie_fuzz_data ie_fuzz_ft_auth = {
+	fuzz_ft_auth_header, sizeof(fuzz_ft_auth_header),
+	fuzz_ft_auth_pool, L_ARRAY_SIZE(fuzz_ft_auth_pool),
+	fuzz_ft_auth_valid, L_ARRAY_SIZE(fuzz_ft_auth_valid),
+};
+
+static uint32_t fuzz_next(uint32_t *state)
+{
+	/* Fixed seed xorshift so that failures are reproducible */
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+static void ie_fuzz_test(const void *data)
+{
+	const struct ie_fuzz_data *test = data;
+	uint8_t frame[512];
+	uint32_t state = 0x1d872b41;
+	unsigned int n_good = 0;
+	unsigned int n;
+
+	memcpy(frame, test->header, test->header_len);
+
+	for (n = 0; n < 20000; n++) {
+		size_t len = test->header_len;
+		unsigned int n_ies = fuzz_next(&state) % 12;
+		bool expect;
+		bool good;
+
+		while (n_ies--) {
+			unsigned int tag = test->pool[fuzz_next(&state) %
+							test->n_pool];
+			unsigned int ie_len = fuzz_next(&state) % 8;
+
+			if (tag >= 256) {
+				frame[len++] = IE_TYPE_EXTENSION;
+				frame[len++] = ie_len + 1;
+				frame[len++] = tag - 256;
+			} else {
+				frame[len++] = tag;
+				frame[len++] = ie_len;
+			}
+
+			memset(frame + len, tag, ie_len);
+			len += ie_len;
+		}
+
+		/* Occasionally cut the last element short */
+		if (len > test->header_len && !(fuzz_next(&state) % 8))
+			len -= 1;
+
+		expect = ref_validate_ies(frame + test->header_len,
+						len - test->header_len,
+						test->valid, test->n_valid);
+		good = mpdu_validate(frame, len) != NULL;
+		assert(good == expect);
+
+		n_good += good;
+	}
+
+	/* Make sure both outcomes were exercised */
+	assert(n_good > 0 && n_good < n);
+}
+
 static void ie_sort_test(const void *data)
 {
 	static uint8_t ie_fils_session[] = { IE_TYPE_EXTENSION, 1, 4 };
@@ -230,6 +425,11 @@ int main(int argc, char *argv[])
 	l_test_add("/IE order/Good (Out of Order IE) 2", ie_order_test,
 				&probe_req_ie_out_of_order2_data);
 
+	l_test_add("/IE order/Fuzz Probe Request", ie_fuzz_test,
+				&ie_fuzz_probe_req);
+	l_test_add("/IE order/Fuzz FT Authentication", ie_fuzz_test,
+				&ie_fuzz_ft_auth);
+
 	l_test_add("/IE order/Sorting", ie_sort_test, NULL);
 
 	return l_test_run();
@@ -0,0 +1,324 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2022  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <assert.h>
+#include <ell/ell.h>
+
+#include "src/netconfig-batch.h"
+
+enum op_stage {
+	OP_ROUTE_DEL,
+	OP_ADDR_DEL,
+	OP_ADDR_ADD,
+	OP_ROUTE_ADD,
+};
+
+struct test_ops_data {
+	unsigned int count[4];
+	enum op_stage last;
+};
+
+static void test_op(struct test_ops_data *data, enum op_stage stage)
+{
+	/* Route removals first, route additions last */
+	assert(stage >= data->last);
+
+	data->last = stage;
+	data->count[stage]++;
+}
+
+static void test_address(bool add, const struct l_rtnl_address *addr,
+				void *user_data)
+{
+	test_op(user_data, add ? OP_ADDR_ADD : OP_ADDR_DEL);
+}
+
+static void test_route(bool add, const struct l_rtnl_route *rt,
+			void *user_data)
+{
+	test_op(user_data, add ? OP_ROUTE_ADD : OP_ROUTE_DEL);
+}
+
+static const struct netconfig_batch_ops test_ops = {
+	.address = test_address,
+	.route = test_route,
+};
+
+struct test_config {
+	struct l_rtnl_address *addr;
+	struct l_rtnl_route *routes[3];
+};
+
+static void test_config_init(struct test_config *config)
+{
+	config->addr = l_rtnl_address_new("192.168.1.10", 24);
+	l_rtnl_address_set_lifetimes(config->addr, 1800, 3600);
+
+	config->routes[0] = l_rtnl_route_new_gateway("192.168.1.1");
+	config->routes[1] = l_rtnl_route_new_prefix("192.168.1.0", 24);
+	config->routes[2] = l_rtnl_route_new_prefix("10.0.0.0", 8);
+	l_rtnl_route_set_priority(config->routes[2], 200);
+}
+
+static void test_config_free(struct test_config *config)
+{
+	unsigned int i;
+
+	l_rtnl_address_free(config->addr);
+
+	for (i = 0; i < L_ARRAY_SIZE(config->routes); i++)
+		l_rtnl_route_free(config->routes[i]);
+}
+
+static void test_config_queue_routes(struct test_config *config,
+					struct l_queue *queue)
+{
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(config->routes); i++)
+		l_queue_push_tail(queue, config->routes[i]);
+}
+
+static void test_run(struct netconfig_batch *batch,
+			const struct netconfig_batch_changes *addr_changes,
+			const struct netconfig_batch_changes *route_changes,
+			struct netconfig_batch_stats *stats,
+			struct test_ops_data *data)
+{
+	memset(data, 0, sizeof(*data));
+	netconfig_batch_commit(batch, addr_changes, route_changes,
+				&test_ops, data, stats);
+}
+
+/* Add or remove everything on the two lists */
+static void test_commit(struct netconfig_batch *batch, bool add,
+			struct l_queue *addrs, struct l_queue *routes,
+			struct netconfig_batch_stats *stats,
+			struct test_ops_data *data)
+{
+	struct netconfig_batch_changes addr_changes = {};
+	struct netconfig_batch_changes route_changes = {};
+
+	if (add) {
+		addr_changes.added = l_queue_get_entries(addrs);
+		route_changes.added = l_queue_get_entries(routes);
+	} else {
+		addr_changes.removed = l_queue_get_entries(addrs);
+		route_changes.removed = l_queue_get_entries(routes);
+	}
+
+	test_run(batch, &addr_changes, &route_changes, stats, data);
+}
+
+static void test_initial_commit(const void *test_data)
+{
+	struct netconfig_batch *batch = netconfig_batch_new();
+	struct test_config config;
+	struct l_queue *addrs = l_queue_new();
+	struct l_queue *routes = l_queue_new();
+	struct netconfig_batch_stats stats;
+	struct test_ops_data data;
+
+	test_config_init(&config);
+	l_queue_push_tail(addrs, config.addr);
+	test_config_queue_routes(&config, routes);
+
+	test_commit(batch, true, addrs, routes, &stats, &data);
+
+	assert(netconfig_batch_stats_msgs(&stats) == 4);
+	assert(stats.addr_add == 1);
+	assert(stats.route_add == 3);
+	assert(!stats.addr_del && !stats.route_del);
+	assert(!stats.skipped && !stats.replaced);
+	assert(data.count[OP_ADDR_ADD] == 1);
+	assert(data.count[OP_ROUTE_ADD] == 3);
+
+	l_queue_destroy(addrs, NULL);
+	l_queue_destroy(routes, NULL);
+	test_config_free(&config);
+	netconfig_batch_free(batch);
+}
+
+/* A DHCP renewal only refreshes the address lifetimes */
+static void test_renewal(const void *test_data)
+{
+	struct netconfig_batch *batch = netconfig_batch_new();
+	struct test_config config;
+	struct l_queue *addrs = l_queue_new();
+	struct l_queue *routes = l_queue_new();
+	struct netconfig_batch_changes addr_changes = {};
+	struct netconfig_batch_changes route_changes = {};
+	struct netconfig_batch_stats stats;
+	struct test_ops_data data;
+
+	test_config_init(&config);
+	l_queue_push_tail(addrs, config.addr);
+	test_config_queue_routes(&config, routes);
+
+	test_commit(batch, true, addrs, routes, &stats, &data);
+
+	l_rtnl_address_set_lifetimes(config.addr, 43200, 86400);
+	addr_changes.updated = l_queue_get_entries(addrs);
+	route_changes.updated = l_queue_get_entries(routes);
+
+	test_run(batch, &addr_changes, &route_changes, &stats, &data);
+
+	assert(netconfig_batch_stats_msgs(&stats) == 1);
+	assert(stats.addr_add == 1);
+	assert(stats.skipped == 3);
+	assert(data.count[OP_ADDR_ADD] == 1);
+	assert(!data.count[OP_ROUTE_ADD]);
+
+	/* Nothing changed at all, nothing is sent */
+	test_run(batch, &addr_changes, &route_changes, &stats, &data);
+	assert(netconfig_batch_stats_msgs(&stats) == 0);
+	assert(stats.skipped == 4);
+
+	/* A changed route attribute goes out again */
+	l_rtnl_route_set_mtu(config.routes[1], 1400);
+	test_run(batch, &addr_changes, &route_changes, &stats, &data);
+	assert(netconfig_batch_stats_msgs(&stats) == 1);
+	assert(stats.route_add == 1);
+
+	l_queue_destroy(addrs, NULL);
+	l_queue_destroy(routes, NULL);
+	test_config_free(&config);
+	netconfig_batch_free(batch);
+}
+
+/*
+ * A roam tears the configuration down and brings an identical one up, the
+ * removals should fold into the (replacing) adds.
+ */
+static void test_roam(const void *test_data)
+{
+	struct netconfig_batch *batch = netconfig_batch_new();
+	struct test_config old;
+	struct test_config new;
+	struct l_queue *addrs = l_queue_new();
+	struct l_queue *routes = l_queue_new();
+	struct l_queue *new_addrs = l_queue_new();
+	struct l_queue *new_routes = l_queue_new();
+	struct netconfig_batch_changes addr_changes = {};
+	struct netconfig_batch_changes route_changes = {};
+	struct netconfig_batch_stats stats;
+	struct test_ops_data data;
+
+	test_config_init(&old);
+	l_queue_push_tail(addrs, old.addr);
+	test_config_queue_routes(&old, routes);
+
+	test_commit(batch, true, addrs, routes, &stats, &data);
+
+	test_config_init(&new);
+	l_queue_push_tail(new_addrs, new.addr);
+	test_config_queue_routes(&new, new_routes);
+
+	/* Drop one of the old routes for good */
+	l_queue_remove(new_routes, new.routes[2]);
+
+	addr_changes.removed = l_queue_get_entries(addrs);
+	addr_changes.added = l_queue_get_entries(new_addrs);
+	route_changes.removed = l_queue_get_entries(routes);
+	route_changes.added = l_queue_get_entries(new_routes);
+
+	test_run(batch, &addr_changes, &route_changes, &stats, &data);
+
+	assert(stats.replaced == 3);
+	assert(stats.addr_del == 0);
+	assert(stats.route_del == 1);
+	assert(stats.addr_add == 1);
+	assert(stats.route_add == 2);
+	assert(netconfig_batch_stats_msgs(&stats) == 4);
+	assert(data.count[OP_ROUTE_DEL] == 1);
+
+	/* Tear down, everything left gets deleted */
+	test_commit(batch, false, new_addrs, new_routes, &stats, &data);
+	assert(stats.addr_del == 1);
+	assert(stats.route_del == 2);
+	assert(netconfig_batch_stats_msgs(&stats) == 3);
+
+	l_queue_destroy(addrs, NULL);
+	l_queue_destroy(routes, NULL);
+	l_queue_destroy(new_addrs, NULL);
+	l_queue_destroy(new_routes, NULL);
+	test_config_free(&old);
+	test_config_free(&new);
+	netconfig_batch_free(batch);
+}
+
+/* The kernel removes expired entries itself */
+static void test_expired(const void *test_data)
+{
+	struct netconfig_batch *batch = netconfig_batch_new();
+	struct test_config config;
+	struct l_queue *addrs = l_queue_new();
+	struct l_queue *routes = l_queue_new();
+	struct netconfig_batch_changes addr_changes = {};
+	struct netconfig_batch_changes route_changes = {};
+	struct netconfig_batch_stats stats;
+	struct test_ops_data data;
+
+	test_config_init(&config);
+	l_queue_push_tail(addrs, config.addr);
+	test_config_queue_routes(&config, routes);
+
+	test_commit(batch, true, addrs, routes, &stats, &data);
+
+	addr_changes.expired = l_queue_get_entries(addrs);
+	route_changes.expired = l_queue_get_entries(routes);
+
+	test_run(batch, &addr_changes, &route_changes, &stats, &data);
+	assert(netconfig_batch_stats_msgs(&stats) == 0);
+
+	/* Forgotten, so an update has to be sent in full */
+	memset(&addr_changes, 0, sizeof(addr_changes));
+	addr_changes.updated = l_queue_get_entries(addrs);
+	memset(&route_changes, 0, sizeof(route_changes));
+
+	test_run(batch, &addr_changes, &route_changes, &stats, &data);
+	assert(stats.addr_add == 1);
+	assert(!stats.skipped);
+
+	l_queue_destroy(addrs, NULL);
+	l_queue_destroy(routes, NULL);
+	test_config_free(&config);
+	netconfig_batch_free(batch);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("/netconfig-batch/initial commit", test_initial_commit,
+			NULL);
+	l_test_add("/netconfig-batch/renewal", test_renewal, NULL);
+	l_test_add("/netconfig-batch/roam", test_roam, NULL);
+	l_test_add("/netconfig-batch/expired", test_expired, NULL);
+
+	return l_test_run();
+}
@@ -0,0 +1,218 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ell/ell.h>
+
+#include "src/storage.h"
+#include "tools/profile-batch.h"
+
+#define N_PSK_PROFILES 64
+
+static const char *secret = "profile batch test secret";
+
+struct batch_results {
+	unsigned int ok;
+	unsigned int unencrypted;
+	unsigned int failed;
+	int wrong_name_err;
+	char *last_path;
+};
+
+static void write_profile(const char *dir, const char *file,
+				const char *name, const char *passphrase,
+				const char *hotspot_name)
+{
+	_auto_(l_settings_free) struct l_settings *settings = l_settings_new();
+	_auto_(l_free) char *data = NULL;
+	size_t len;
+
+	if (hotspot_name)
+		l_settings_set_string(settings, "Hotspot", "Name",
+					hotspot_name);
+
+	if (passphrase)
+		l_settings_set_string(settings, "Security", "Passphrase",
+					passphrase);
+	else
+		l_settings_set_bool(settings, "Settings", "AutoConnect", false);
+
+	data = __storage_encrypt(settings, name, &len);
+	assert(data);
+	assert(write_file(data, len, false, "%s/%s", dir, file) ==
+							(ssize_t) len);
+}
+
+static void check_decrypted(const char *data, size_t len,
+				const char *passphrase)
+{
+	_auto_(l_settings_free) struct l_settings *settings = l_settings_new();
+	_auto_(l_free) char *value = NULL;
+
+	assert(l_settings_load_from_data(settings, data, len));
+	assert(!l_settings_has_key(settings, "Security", "EncryptedSecurity"));
+
+	value = l_settings_get_string(settings, "Security", "Passphrase");
+	assert(value);
+	assert(!strcmp(value, passphrase));
+}
+
+static void batch_result(const char *path, int err, const char *data,
+				size_t len, bool encrypted, void *user_data)
+{
+	struct batch_results *results = user_data;
+
+	/* Results are reported in path order */
+	if (results->last_path)
+		assert(strcmp(results->last_path, path) < 0);
+
+	l_free(results->last_path);
+	results->last_path = l_strdup(path);
+
+	if (!strcmp(path, "Wrong.psk")) {
+		results->wrong_name_err = err;
+		results->failed++;
+		return;
+	}
+
+	assert(err == 0);
+	assert(data);
+
+	if (!strcmp(path, "Open.open")) {
+		assert(!encrypted);
+		results->unencrypted++;
+		return;
+	}
+
+	assert(encrypted);
+
+	if (!strcmp(path, "hotspot/example.conf"))
+		check_decrypted(data, len, "hotspot-secret");
+	else
+		check_decrypted(data, len, "correct horse");
+
+	results->ok++;
+}
+
+static void remove_tree(const char *dir)
+{
+	_auto_(l_free) char *cmd = l_strdup_printf("rm -rf '%s'", dir);
+
+	assert(system(cmd) == 0);
+}
+
+static void test_decrypt_directory(const void *data)
+{
+	unsigned int workers = L_PTR_TO_UINT(data);
+	char indir[] = "/tmp/iwd-profile-batch-XXXXXX";
+	_auto_(l_free) char *outdir = NULL;
+	struct batch_results results = {};
+	unsigned int i;
+	int r;
+
+	assert(mkdtemp(indir));
+	outdir = l_strdup_printf("%s.out", indir);
+
+	assert(storage_init((const uint8_t *) secret, strlen(secret)));
+
+	for (i = 0; i < N_PSK_PROFILES; i++) {
+		_auto_(l_free) char *ssid = l_strdup_printf("Net%02u", i);
+		_auto_(l_free) char *file = l_strdup_printf("%s.psk", ssid);
+
+		write_profile(indir, file, ssid, "correct horse", NULL);
+	}
+
+	write_profile(indir, "hotspot/example.conf", "Example",
+			"hotspot-secret", "Example");
+
+	/* No [Security] group, left unencrypted */
+	write_profile(indir, "Open.open", "Open", NULL, NULL);
+
+	/* Encrypted for a different SSID than the file name says */
+	write_profile(indir, "Wrong.psk", "Other", "correct horse", NULL);
+
+	/* Not a profile, must be skipped */
+	assert(write_file("x", 1, false, "%s/README", indir) == 1);
+
+	r = profile_batch_decrypt(indir, outdir, workers, batch_result,
+					&results);
+	assert(r == 1);
+	assert(results.ok == N_PSK_PROFILES + 1);
+	assert(results.unencrypted == 1);
+	assert(results.failed == 1);
+	assert(results.wrong_name_err == -ENOKEY);
+
+	/* Decrypted output mirrors the input tree */
+	for (i = 0; i < N_PSK_PROFILES; i += 7) {
+		_auto_(l_settings_free) struct l_settings *settings =
+							l_settings_new();
+		_auto_(l_free) char *path =
+			l_strdup_printf("%s/Net%02u.psk", outdir, i);
+		_auto_(l_free) char *value = NULL;
+
+		assert(l_settings_load_from_file(settings, path));
+		value = l_settings_get_string(settings, "Security",
+						"Passphrase");
+		assert(value && !strcmp(value, "correct horse"));
+	}
+
+	storage_exit();
+
+	assert(profile_batch_decrypt("/nonexistent-iwd-dir", NULL, workers,
+					NULL, NULL) == -ENOENT);
+
+	l_free(results.last_path);
+	remove_tree(indir);
+	remove_tree(outdir);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	if (!l_checksum_is_supported(L_CHECKSUM_SHA256, true)) {
+		printf("SHA256 support missing, skipping...\n");
+		goto done;
+	}
+
+	if (!l_cipher_is_supported(L_CIPHER_AES)) {
+		printf("AES support missing, skipping...\n");
+		goto done;
+	}
+
+	l_test_add("/Profile batch/Decrypt directory, 1 worker",
+			test_decrypt_directory, L_UINT_TO_PTR(1));
+	l_test_add("/Profile batch/Decrypt directory, 8 workers",
+			test_decrypt_directory, L_UINT_TO_PTR(8));
+
+done:
+	return l_test_run();
+}
@@ -24,6 +24,7 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <string.h>
 #include <assert.h>
 #include <ell/ell.h>
@@ -631,6 +632,128 @@ static void test_end_to_end(const void *arg)
 	l_free(td2);
 }
 
+struct responder_data {
+	uint8_t tx_packet[2][512];
+	size_t tx_packet_len[2];
+	unsigned int tx_count;
+};
+
+static void responder_tx_func(const uint8_t *frame, size_t len,
+				void *user_data)
+{
+	struct responder_data *rd = user_data;
+
+	assert(rd->tx_count < 2);
+
+	memcpy(rd->tx_packet[rd->tx_count], frame, len);
+	rd->tx_packet_len[rd->tx_count++] = len;
+}
+
+static void test_responder(const void *arg)
+{
+	struct auth_proto *ap1;
+	struct auth_proto *ap2;
+	struct test_data *td1 = l_new(struct test_data, 1);
+	struct responder_data *rd = l_new(struct responder_data, 1);
+	struct handshake_state *hs1 = test_handshake_state_new(1);
+	struct handshake_state *hs2 = test_handshake_state_new(2);
+	struct authenticate_frame *frame = alloca(
+				sizeof(struct authenticate_frame) + 512);
+	size_t frame_len;
+	uint8_t token[32];
+	uint8_t commit[512];
+	static const uint8_t vendor_ie[] = {
+		IE_TYPE_VENDOR_SPECIFIC, 4, 0x00, 0x50, 0xf2, 0xff,
+	};
+
+	memset(token, 0xde, sizeof(token));
+
+	handshake_state_set_supplicant_address(hs1, spa);
+	handshake_state_set_authenticator_address(hs1, aa);
+	handshake_state_set_passphrase(hs1, passphrase);
+
+	handshake_state_set_authenticator(hs2, true);
+	handshake_state_set_supplicant_address(hs2, spa);
+	handshake_state_set_authenticator_address(hs2, aa);
+	handshake_state_set_passphrase(hs2, passphrase);
+
+	ap1 = sae_sm_new(hs1, end_to_end_tx_func, test_tx_assoc_func, td1);
+	ap2 = sae_sm_new(hs2, responder_tx_func, NULL, rd);
+	sae_sm_require_token(ap2, token, sizeof(token));
+
+	auth_proto_start(ap1);
+
+	/* Commit without a token only gets the token request */
+	frame_len = setup_auth_frame(frame, spa, 1, 0, td1->tx_packet + 4,
+					td1->tx_packet_len - 4);
+	assert(auth_proto_rx_authenticate(ap2, (uint8_t *)frame,
+						frame_len) == -EAGAIN);
+	assert(rd->tx_count == 1);
+	assert(rd->tx_packet_len[0] == 6 + sizeof(token));
+	assert(l_get_le16(rd->tx_packet[0]) == 1);
+	assert(l_get_le16(rd->tx_packet[0] + 2) ==
+				MMPDU_STATUS_CODE_ANTI_CLOGGING_TOKEN_REQ);
+	assert(l_get_le16(rd->tx_packet[0] + 4) == 19);
+	assert(!memcmp(rd->tx_packet[0] + 6, token, sizeof(token)));
+
+	/* STA retransmits its Commit with the token included */
+	frame_len = setup_auth_frame(frame, aa, 1,
+				MMPDU_STATUS_CODE_ANTI_CLOGGING_TOKEN_REQ,
+				rd->tx_packet[0] + 4,
+				rd->tx_packet_len[0] - 4);
+	assert(auth_proto_rx_authenticate(ap1, (uint8_t *)frame,
+						frame_len) == -EAGAIN);
+	assert(td1->tx_packet_len == 134);
+
+	/*
+	 * Responder now sends both its Commit and its Confirm.  An element
+	 * following the Element field must not be taken as part of the token.
+	 */
+	memcpy(commit, td1->tx_packet + 4, td1->tx_packet_len - 4);
+	memcpy(commit + td1->tx_packet_len - 4, vendor_ie, sizeof(vendor_ie));
+
+	rd->tx_count = 0;
+	frame_len = setup_auth_frame(frame, spa, 1, 0, commit,
+				td1->tx_packet_len - 4 + sizeof(vendor_ie));
+	assert(auth_proto_rx_authenticate(ap2, (uint8_t *)frame,
+						frame_len) == 0);
+	assert(rd->tx_count == 2);
+	assert(l_get_le16(rd->tx_packet[0]) == 1);
+	assert(l_get_le16(rd->tx_packet[1]) == 2);
+
+	frame_len = setup_auth_frame(frame, aa, 1, 0, rd->tx_packet[0] + 4,
+					rd->tx_packet_len[0] - 4);
+	assert(auth_proto_rx_authenticate(ap1, (uint8_t *)frame,
+						frame_len) == 0);
+
+	frame_len = setup_auth_frame(frame, aa, 2, 0, rd->tx_packet[1] + 4,
+					rd->tx_packet_len[1] - 4);
+	assert(auth_proto_rx_authenticate(ap1, (uint8_t *)frame,
+						frame_len) == 0);
+	assert(td1->tx_assoc_called);
+
+	/* The responder must not send a second Confirm once Accepted */
+	frame_len = setup_auth_frame(frame, spa, 2, 0, td1->tx_packet + 4,
+					td1->tx_packet_len - 4);
+	assert(auth_proto_rx_authenticate(ap2, (uint8_t *)frame,
+						frame_len) == 0);
+	assert(rd->tx_count == 2);
+
+	assert(hs1->have_pmk && hs2->have_pmk);
+	assert(!memcmp(hs1->pmk, hs2->pmk, 32));
+	assert(hs1->have_pmkid && hs2->have_pmkid);
+	assert(!memcmp(hs1->pmkid, hs2->pmkid, 16));
+
+	handshake_state_free(hs1);
+	handshake_state_free(hs2);
+
+	auth_proto_free(ap1);
+	auth_proto_free(ap2);
+
+	l_free(td1);
+	l_free(rd);
+}
+
 static void test_pt_pwe(const void *data)
 {
 	static const char *ssid = "byteme";
@@ -893,6 +1016,7 @@ int main(int argc, char *argv[])
 	l_test_add("SAE bad confirm", test_bad_confirm, NULL);
 	l_test_add("SAE confirm after accept", test_confirm_after_accept, NULL);
 	l_test_add("SAE end-to-end", test_end_to_end, NULL);
+	l_test_add("SAE responder", test_responder, NULL);
 
 	l_test_add("SAE pt-pwe", test_pt_pwe, NULL);
 
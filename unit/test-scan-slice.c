@@ -0,0 +1,220 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <ell/ell.h>
+
+#include "src/util.h"
+#include "src/band.h"
+#include "src/scan.h"
+#include "src/scan-slice.h"
+
+static const uint32_t freqs_multiband[] = {
+	2412, 2437, 2462,
+	5180, 5200, 5220, 5240, 5260, 5280, 5300, 5320, 5500, 5745,
+	5955, 6035,
+};
+
+static struct scan_freq_set *build_freqs(const uint32_t *list, size_t len)
+{
+	struct scan_freq_set *freqs = scan_freq_set_new();
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		assert(scan_freq_set_add(freqs, list[i]));
+
+	return freqs;
+}
+
+static void count_freq(uint32_t freq, void *user_data)
+{
+	unsigned int *count = user_data;
+
+	(*count)++;
+}
+
+static unsigned int freq_set_count(const struct scan_freq_set *freqs)
+{
+	unsigned int count = 0;
+
+	scan_freq_set_foreach(freqs, count_freq, &count);
+
+	return count;
+}
+
+static void test_chunking(const void *data)
+{
+	_auto_(scan_freq_set_free) struct scan_freq_set *freqs =
+			build_freqs(freqs_multiband,
+					L_ARRAY_SIZE(freqs_multiband));
+	_auto_(scan_freq_set_free) struct scan_freq_set *all =
+							scan_freq_set_new();
+	struct scan_slice *slice;
+	unsigned int n_2ghz = 0;
+	unsigned int n_5ghz = 0;
+	unsigned int n_6ghz = 0;
+	unsigned int total = 0;
+	unsigned int i;
+
+	assert(!scan_slice_new(freqs, 0));
+
+	slice = scan_slice_new(freqs, 4);
+	assert(slice);
+
+	/* 3 x 2.4 GHz, 10 x 5 GHz split 4 + 4 + 2, 2 x 6 GHz */
+	assert(scan_slice_get_count(slice) == 5);
+	assert(!scan_slice_get(slice, 5));
+
+	for (i = 0; i < scan_slice_get_count(slice); i++) {
+		const struct scan_freq_set *chunk = scan_slice_get(slice, i);
+		unsigned int count = freq_set_count(chunk);
+		uint32_t bands = scan_freq_set_get_bands(chunk);
+
+		assert(count >= 1 && count <= 4);
+
+		/* A slice never spans bands */
+		switch (bands) {
+		case BAND_FREQ_2_4_GHZ:
+			n_2ghz += count;
+			break;
+		case BAND_FREQ_5_GHZ:
+			n_5ghz += count;
+			break;
+		case BAND_FREQ_6_GHZ:
+			n_6ghz += count;
+			break;
+		default:
+			assert(false);
+		}
+
+		total += count;
+		scan_freq_set_merge(all, chunk);
+	}
+
+	assert(n_2ghz == 3 && n_5ghz == 10 && n_6ghz == 2);
+	assert(total == L_ARRAY_SIZE(freqs_multiband));
+
+	/* Every frequency is scanned exactly once */
+	scan_freq_set_subtract(all, freqs);
+	assert(scan_freq_set_isempty(all));
+
+	scan_slice_free(slice);
+
+	/* A small enough set is a single slice */
+	slice = scan_slice_new(freqs, 16);
+	assert(scan_slice_get_count(slice) == 3);
+	scan_slice_free(slice);
+
+	scan_freq_set_free(freqs);
+	freqs = build_freqs(freqs_multiband, 3);
+	slice = scan_slice_new(freqs, 4);
+	assert(scan_slice_get_count(slice) == 1);
+	scan_slice_free(slice);
+
+	scan_freq_set_free(freqs);
+	freqs = scan_freq_set_new();
+	assert(!scan_slice_new(freqs, 4));
+}
+
+static struct scan_bss *bss_new(uint8_t last_octet, uint32_t frequency,
+				uint16_t rank, uint64_t time_stamp)
+{
+	struct scan_bss *bss = l_new(struct scan_bss, 1);
+
+	memcpy(bss->addr, (uint8_t []) { 0x02, 0, 0, 0, 0, last_octet }, 6);
+	bss->frequency = frequency;
+	bss->rank = rank;
+	bss->time_stamp = time_stamp;
+
+	return bss;
+}
+
+static int rank_compare(const void *a, const void *b, void *user_data)
+{
+	const struct scan_bss *new_bss = a, *bss = b;
+
+	return (bss->rank >= new_bss->rank) ? 1 : -1;
+}
+
+static void test_merge(const void *data)
+{
+	struct l_queue *merged = l_queue_new();
+	struct l_queue *slice1 = l_queue_new();
+	struct l_queue *slice2 = l_queue_new();
+	const struct l_queue_entry *entry;
+	struct scan_bss *bss;
+	uint16_t last_rank = UINT16_MAX;
+
+	l_queue_push_tail(slice1, bss_new(1, 2412, 500, 100));
+	l_queue_push_tail(slice1, bss_new(2, 2437, 300, 100));
+	l_queue_push_tail(slice1, bss_new(3, 2462, 100, 100));
+
+	scan_slice_merge_bss(merged, slice1, rank_compare, l_free);
+	assert(l_queue_isempty(slice1));
+	assert(l_queue_length(merged) == 3);
+
+	/* BSS 2 heard again later on the next slice, BSS 3 stale */
+	l_queue_push_tail(slice2, bss_new(4, 5180, 400, 200));
+	l_queue_push_tail(slice2, bss_new(2, 2437, 600, 200));
+	l_queue_push_tail(slice2, bss_new(3, 2462, 900, 50));
+
+	scan_slice_merge_bss(merged, slice2, rank_compare, l_free);
+	assert(l_queue_isempty(slice2));
+	assert(l_queue_length(merged) == 4);
+
+	for (entry = l_queue_get_entries(merged); entry;
+						entry = entry->next) {
+		bss = entry->data;
+
+		/* Still ordered best first */
+		assert(bss->rank <= last_rank);
+		last_rank = bss->rank;
+
+		if (bss->addr[5] == 2)
+			assert(bss->time_stamp == 200 && bss->rank == 600);
+
+		if (bss->addr[5] == 3)
+			assert(bss->time_stamp == 100 && bss->rank == 100);
+	}
+
+	bss = l_queue_peek_head(merged);
+	assert(bss->addr[5] == 2);
+
+	l_queue_destroy(slice1, NULL);
+	l_queue_destroy(slice2, NULL);
+	l_queue_destroy(merged, l_free);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("/Scan slice/Chunking", test_chunking, NULL);
+	l_test_add("/Scan slice/Merge results", test_merge, NULL);
+
+	return l_test_run();
+}
@@ -0,0 +1,281 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <ell/ell.h>
+
+#include "linux/nl80211.h"
+#include "src/sched-scan.h"
+
+static const struct sched_scan_caps caps_iwlwifi = {
+	.supported = true,
+	.max_ssids = 2,
+	.max_match_sets = 4,
+	.max_plans = 2,
+	.max_plan_interval = 65535,
+	.max_plan_iterations = 254,
+};
+
+static void test_caps_parse(const void *data)
+{
+	struct sched_scan_caps caps = {};
+	uint8_t u8 = 11;
+	uint32_t u32 = 3;
+
+	assert(!sched_scan_caps_usable(&caps));
+
+	assert(sched_scan_caps_parse_attr(&caps,
+					NL80211_ATTR_MAX_NUM_SCHED_SCAN_SSIDS,
+					&u8, sizeof(u8)));
+	assert(caps.max_ssids == 11);
+
+	assert(sched_scan_caps_parse_attr(&caps,
+					NL80211_ATTR_MAX_NUM_SCHED_SCAN_PLANS,
+					&u32, sizeof(u32)));
+	assert(caps.max_plans == 3);
+
+	/* Wrong sizes and unrelated attributes are rejected */
+	assert(!sched_scan_caps_parse_attr(&caps, NL80211_ATTR_MAX_MATCH_SETS,
+						&u32, sizeof(u32)));
+	assert(!sched_scan_caps_parse_attr(&caps,
+					NL80211_ATTR_MAX_SCAN_PLAN_INTERVAL,
+					&u8, sizeof(u8)));
+	assert(!sched_scan_caps_parse_attr(&caps,
+					NL80211_ATTR_MAX_NUM_SCAN_SSIDS,
+					&u8, sizeof(u8)));
+	assert(caps.max_match_sets == 0);
+
+	/* START_SCHED_SCAN support alone is not enough */
+	caps.supported = true;
+	assert(!sched_scan_caps_usable(&caps));
+	assert(!sched_scan_request_new(&caps, -80));
+
+	u8 = 8;
+	assert(sched_scan_caps_parse_attr(&caps, NL80211_ATTR_MAX_MATCH_SETS,
+						&u8, sizeof(u8)));
+	assert(sched_scan_caps_usable(&caps));
+
+	caps.supported = false;
+	assert(!sched_scan_caps_usable(&caps));
+}
+
+static void test_match_sets(const void *data)
+{
+	struct sched_scan_request *req;
+
+	req = sched_scan_request_new(&caps_iwlwifi, -80);
+	assert(req);
+
+	assert(sched_scan_request_add_ssid(req, "Home", false) == 0);
+	assert(sched_scan_request_add_ssid(req, "Office", true) == 0);
+	/* Same SSID, different security, only programmed once */
+	assert(sched_scan_request_add_ssid(req, "Home", false) == 0);
+	assert(sched_scan_request_get_match_sets(req) == 2);
+
+	assert(sched_scan_request_add_ssid(req, "", false) == -EINVAL);
+
+	assert(sched_scan_request_add_ssid(req, "Hidden", true) == 0);
+	/* Only two SSIDs can be probed for */
+	assert(sched_scan_request_add_ssid(req, "Hidden2", true) == -ENOSPC);
+	assert(sched_scan_request_get_match_sets(req) == 3);
+
+	assert(sched_scan_request_add_ssid(req, "Cafe", false) == 0);
+	/* Out of match sets */
+	assert(sched_scan_request_add_ssid(req, "Library", false) == -ENOSPC);
+	assert(sched_scan_request_get_match_sets(req) == 4);
+
+	sched_scan_request_free(req);
+}
+
+static void test_plans(const void *data)
+{
+	struct sched_scan_caps caps = caps_iwlwifi;
+	struct sched_scan_request *req;
+	uint32_t intervals[SCHED_SCAN_MAX_PLANS];
+	uint32_t iterations[SCHED_SCAN_MAX_PLANS];
+	unsigned int n;
+
+	caps.max_plans = 4;
+	req = sched_scan_request_new(&caps, -80);
+
+	sched_scan_request_set_intervals(req, 10, 300);
+	n = sched_scan_request_get_plans(req, intervals, iterations);
+	assert(n == 4);
+	assert(intervals[0] == 10 && iterations[0] == 1);
+	assert(intervals[1] == 20 && iterations[1] == 1);
+	assert(intervals[2] == 40 && iterations[2] == 1);
+	assert(intervals[3] == 300 && iterations[3] == 0);
+
+	/* Back-off shorter than the number of plans */
+	sched_scan_request_set_intervals(req, 100, 300);
+	n = sched_scan_request_get_plans(req, intervals, iterations);
+	assert(n == 3);
+	assert(intervals[0] == 100 && intervals[1] == 200);
+	assert(intervals[2] == 300 && iterations[2] == 0);
+	sched_scan_request_free(req);
+
+	/* Single plan wiphys stay at the initial interval */
+	caps.max_plans = 1;
+	req = sched_scan_request_new(&caps, -80);
+	sched_scan_request_set_intervals(req, 10, 300);
+	n = sched_scan_request_get_plans(req, intervals, iterations);
+	assert(n == 1);
+	assert(intervals[0] == 10 && iterations[0] == 0);
+	sched_scan_request_free(req);
+
+	/* Intervals are capped to what the wiphy supports */
+	caps.max_plans = 8;
+	caps.max_plan_interval = 60;
+	req = sched_scan_request_new(&caps, -80);
+	sched_scan_request_set_intervals(req, 30, 300);
+	n = sched_scan_request_get_plans(req, intervals, iterations);
+	assert(n == 5);
+	assert(intervals[0] == 30 && intervals[1] == 60);
+	assert(intervals[2] == 60 && intervals[3] == 60);
+	assert(intervals[4] == 60 && iterations[4] == 0);
+	sched_scan_request_free(req);
+}
+
+static void check_match_set(struct l_genl_attr *set, int32_t rssi)
+{
+	uint16_t type, len;
+	const void *payload;
+	bool have_ssid = false;
+	bool have_rssi = false;
+
+	while (l_genl_attr_next(set, &type, &len, &payload)) {
+		switch (type) {
+		case NL80211_SCHED_SCAN_MATCH_ATTR_SSID:
+			have_ssid = len > 0;
+			break;
+		case NL80211_SCHED_SCAN_MATCH_ATTR_RSSI:
+			assert(len == 4);
+			assert((int32_t) l_get_u32(payload) == rssi);
+			have_rssi = true;
+			break;
+		}
+	}
+
+	assert(have_ssid && have_rssi);
+}
+
+static void test_build_start(const void *data)
+{
+	struct sched_scan_request *req;
+	struct l_genl_msg *msg;
+	struct l_genl_attr attr;
+	struct l_genl_attr nested;
+	struct l_genl_attr set;
+	uint16_t type, len;
+	const void *payload;
+	uint64_t wdev_id = 0x100000001;
+	unsigned int n_match_sets = 0;
+	unsigned int n_ssids = 0;
+	unsigned int n_plans = 0;
+	bool socket_owner = false;
+
+	req = sched_scan_request_new(&caps_iwlwifi, -75);
+
+	/* Nothing to match on */
+	sched_scan_request_set_intervals(req, 10, 300);
+	assert(!sched_scan_build_start(wdev_id, req));
+
+	assert(sched_scan_request_add_ssid(req, "Home", false) == 0);
+	assert(sched_scan_request_add_ssid(req, "Hidden", true) == 0);
+
+	msg = sched_scan_build_start(wdev_id, req);
+	assert(msg);
+	assert(l_genl_msg_get_command(msg) == NL80211_CMD_START_SCHED_SCAN);
+	assert(l_genl_attr_init(&attr, msg));
+
+	while (l_genl_attr_next(&attr, &type, &len, &payload)) {
+		switch (type) {
+		case NL80211_ATTR_WDEV:
+			assert(l_get_u64(payload) == wdev_id);
+			break;
+		case NL80211_ATTR_SOCKET_OWNER:
+			socket_owner = true;
+			break;
+		case NL80211_ATTR_SCAN_SSIDS:
+			assert(l_genl_attr_recurse(&attr, &nested));
+
+			while (l_genl_attr_next(&nested, &type, &len,
+							&payload)) {
+				assert(len == 6);
+				assert(!memcmp(payload, "Hidden", 6));
+				n_ssids++;
+			}
+
+			break;
+		case NL80211_ATTR_SCHED_SCAN_MATCH:
+			assert(l_genl_attr_recurse(&attr, &nested));
+
+			while (l_genl_attr_next(&nested, &type, &len,
+							&payload)) {
+				assert(l_genl_attr_recurse(&nested, &set));
+				check_match_set(&set, -75);
+				n_match_sets++;
+			}
+
+			break;
+		case NL80211_ATTR_SCHED_SCAN_PLANS:
+			assert(l_genl_attr_recurse(&attr, &nested));
+
+			while (l_genl_attr_next(&nested, &type, &len,
+							&payload))
+				n_plans++;
+
+			break;
+		}
+	}
+
+	assert(socket_owner);
+	assert(n_ssids == 1);
+	assert(n_match_sets == 2);
+	assert(n_plans == 2);
+
+	l_genl_msg_unref(msg);
+	sched_scan_request_free(req);
+
+	msg = sched_scan_build_stop(wdev_id);
+	assert(l_genl_msg_get_command(msg) == NL80211_CMD_STOP_SCHED_SCAN);
+	l_genl_msg_unref(msg);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("/Scheduled scan/Capabilities", test_caps_parse, NULL);
+	l_test_add("/Scheduled scan/Match sets", test_match_sets, NULL);
+	l_test_add("/Scheduled scan/Scan plans", test_plans, NULL);
+	l_test_add("/Scheduled scan/Build START_SCHED_SCAN",
+			test_build_start, NULL);
+
+	return l_test_run();
+}
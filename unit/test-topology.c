@@ -0,0 +1,195 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <ell/ell.h>
+
+#include "src/util.h"
+#include "src/topology.h"
+
+#define NOW 1700000000
+
+static const uint8_t bss_a[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0a };
+static const uint8_t bss_b[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0b };
+static const uint8_t bss_c[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0c };
+static const uint8_t bss_d[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0d };
+
+static void test_eviction(const void *data)
+{
+	struct topology *topo = topology_new();
+	struct scan_freq_set *md = scan_freq_set_new();
+	struct scan_freq_set *other = scan_freq_set_new();
+	uint8_t addr[6] = { 0x02, 0x00, 0x00, 0x00, 0x01, 0x00 };
+	unsigned int i;
+
+	assert(topology_isempty(topo));
+
+	for (i = 0; i < TOPOLOGY_MAX_BSS; i++) {
+		addr[5] = i;
+		topology_bss_seen(topo, addr, i == 1 ? 2484 : 2412 + i % 13 * 5,
+					TOPOLOGY_NO_MD, -6000, NOW + i);
+	}
+
+	assert(topology_get_size(topo) == TOPOLOGY_MAX_BSS);
+
+	/* Seeing the oldest entry again keeps it over the next oldest */
+	addr[5] = 0;
+	topology_bss_seen(topo, addr, 5180, 0x1234, -5000, NOW + 100);
+
+	topology_bss_seen(topo, bss_a, 5200, 0x1234, -5000, NOW + 101);
+	assert(topology_get_size(topo) == TOPOLOGY_MAX_BSS);
+
+	assert(topology_get_roam_freqs(topo, NULL, 0x1234, md, other));
+	assert(scan_freq_set_contains(md, 5180));
+	assert(scan_freq_set_contains(md, 5200));
+
+	/* The entry seen second, the only one on 2484, is gone */
+	assert(!scan_freq_set_contains(other, 2484));
+	assert(scan_freq_set_contains(other, 2422));
+
+	scan_freq_set_free(md);
+	scan_freq_set_free(other);
+	topology_free(topo);
+}
+
+static void test_roam_freqs(const void *data)
+{
+	struct topology *topo = topology_new();
+	struct scan_freq_set *md = scan_freq_set_new();
+	struct scan_freq_set *other = scan_freq_set_new();
+
+	/* Nothing but the current BSS */
+	topology_bss_seen(topo, bss_a, 5180, 0x1234, -5500, NOW);
+	assert(!topology_get_roam_freqs(topo, bss_a, 0x1234, md, other));
+	assert(scan_freq_set_isempty(md) && scan_freq_set_isempty(other));
+
+	/* Reported in the MD, but the scan shows it is not */
+	topology_neighbor_reported(topo, bss_b, 5500, 0x1234, NOW);
+	topology_bss_seen(topo, bss_b, 5500, TOPOLOGY_NO_MD, -7000, NOW);
+	topology_neighbor_reported(topo, bss_b, 5500, 0x1234, NOW + 1);
+
+	/* Only known from a neighbor report, the MD bit is trusted */
+	topology_neighbor_reported(topo, bss_c, 5745, 0x1234, NOW);
+
+	/* Shares a channel with an MD neighbor */
+	topology_bss_seen(topo, bss_d, 5745, 0x4321, -6000, NOW);
+
+	assert(topology_get_roam_freqs(topo, bss_a, 0x1234, md, other));
+	assert(!scan_freq_set_contains(md, 5180));
+	assert(scan_freq_set_contains(md, 5745));
+	assert(scan_freq_set_contains(other, 5500));
+	assert(!scan_freq_set_contains(other, 5745));
+	scan_freq_set_free(md);
+	scan_freq_set_free(other);
+
+	/* Without FT everything is a non-MD candidate */
+	md = scan_freq_set_new();
+	other = scan_freq_set_new();
+	assert(topology_get_roam_freqs(topo, bss_a, TOPOLOGY_NO_MD, md,
+					other));
+	assert(scan_freq_set_isempty(md));
+	assert(scan_freq_set_contains(other, 5500));
+	assert(scan_freq_set_contains(other, 5745));
+
+	scan_freq_set_free(md);
+	scan_freq_set_free(other);
+	topology_free(topo);
+}
+
+static void test_persistence(const void *data)
+{
+	static const char *group = "0c0e1ee0-5a17-4b0b-9c41-31e1dcd8d6cd";
+	struct topology *topo = topology_new();
+	struct l_settings *settings = l_settings_new();
+	struct scan_freq_set *md = scan_freq_set_new();
+	struct scan_freq_set *other = scan_freq_set_new();
+	char *value;
+
+	topology_bss_seen(topo, bss_a, 5180, 0x1234, -5512, NOW);
+	topology_neighbor_reported(topo, bss_b, 5500, 0x1234, NOW - 10);
+	topology_bss_seen(topo, bss_c, 2437, TOPOLOGY_NO_MD, -8000,
+				NOW - TOPOLOGY_MAX_AGE - 1);
+
+	l_settings_set_value(settings, group, "stale", "1");
+	topology_save(topo, settings, group);
+	topology_free(topo);
+
+	assert(!l_settings_has_key(settings, group, "stale"));
+
+	value = l_settings_get_string(settings, group, "02000000000a");
+	assert(value && !strcmp(value, "5180 4660 -55 1700000000"));
+	l_free(value);
+
+	value = l_settings_get_string(settings, group, "02000000000b");
+	assert(value && !strcmp(value, "5500 4660 0 1699999990"));
+	l_free(value);
+
+	/* Entries that can't be parsed are skipped */
+	l_settings_set_value(settings, group, "name", "/var/lib/iwd/x.psk");
+	l_settings_set_value(settings, group, "02000000000d", "5745 -2 0 0");
+	l_settings_set_value(settings, group, "02000000000e", "5745");
+	l_settings_set_value(settings, group, "zz000000000e",
+				"5745 -1 0 1700000000");
+
+	topo = topology_new();
+	topology_load(topo, settings, group, NOW);
+
+	/* bss_c has aged out */
+	assert(topology_get_size(topo) == 2);
+	assert(topology_get_roam_freqs(topo, NULL, 0x1234, md, other));
+	assert(scan_freq_set_contains(md, 5180));
+	assert(scan_freq_set_contains(md, 5500));
+	assert(scan_freq_set_isempty(other));
+
+	/* Neighbor report only entries are still overridden by scans */
+	topology_bss_seen(topo, bss_b, 5500, TOPOLOGY_NO_MD, -6000, NOW);
+	topology_neighbor_reported(topo, bss_a, 5180, TOPOLOGY_NO_MD, NOW);
+	scan_freq_set_free(md);
+	scan_freq_set_free(other);
+	md = scan_freq_set_new();
+	other = scan_freq_set_new();
+	assert(topology_get_roam_freqs(topo, NULL, 0x1234, md, other));
+	assert(scan_freq_set_contains(md, 5180));
+	assert(scan_freq_set_contains(other, 5500));
+
+	scan_freq_set_free(md);
+	scan_freq_set_free(other);
+	topology_free(topo);
+	l_settings_free(settings);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("/Topology/Eviction", test_eviction, NULL);
+	l_test_add("/Topology/Roam frequencies", test_roam_freqs, NULL);
+	l_test_add("/Topology/Persistence", test_persistence, NULL);
+
+	return l_test_run();
+}
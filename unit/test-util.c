@@ -33,6 +33,7 @@
 
 #include "src/defs.h"
 #include "src/util.h"
+#include "src/band.h"
 
 struct ssid_test_data {
 	size_t len;
@@ -184,6 +185,98 @@ static void ip_prefix_test(const void *data)
 	}
 }
 
+static void scan_freq_plan_test(const void *data)
+{
+	struct band_freq_attrs attrs_2g[14 + 1] = {};
+	struct band_freq_attrs attrs_5g[196 + 1] = {};
+	struct band_freq_attrs attrs_6g[233 + 1] = {};
+	struct scan_freq_plan *plan;
+	struct scan_freq_set *all;
+	unsigned int i;
+
+	for (i = 1; i <= 13; i++)
+		attrs_2g[i].supported = true;
+
+	/* Channels 12 and 13 are NO-IR, 14 is not supported */
+	attrs_2g[12].no_ir = true;
+	attrs_2g[13].no_ir = true;
+
+	attrs_5g[36].supported = true;
+	attrs_5g[52].supported = true;
+	attrs_5g[52].no_ir = true;
+	attrs_5g[165].supported = true;
+	attrs_5g[165].disabled = true;
+
+	/* Channel 1 is not a PSC, 21 is NO-IR and 37 is disabled */
+	attrs_6g[1].supported = true;
+	attrs_6g[5].supported = true;
+	attrs_6g[21].supported = true;
+	attrs_6g[21].no_ir = true;
+	attrs_6g[37].supported = true;
+	attrs_6g[37].disabled = true;
+
+	assert(band_6ghz_channel_is_psc(5));
+	assert(band_6ghz_channel_is_psc(229));
+	assert(!band_6ghz_channel_is_psc(1));
+	assert(!band_6ghz_channel_is_psc(9));
+	assert(!band_6ghz_channel_is_psc(233));
+
+	plan = scan_freq_plan_new();
+	assert(plan->active_dwell);
+	assert(plan->passive_dwell > plan->active_dwell);
+	assert(plan->psc_dwell);
+
+	scan_freq_plan_add_band(plan, BAND_FREQ_2_4_GHZ, attrs_2g, 14);
+	scan_freq_plan_add_band(plan, BAND_FREQ_5_GHZ, attrs_5g, 196);
+	scan_freq_plan_add_band(plan, BAND_FREQ_6_GHZ, attrs_6g, 233);
+
+	assert(scan_freq_set_contains(plan->active, 2412));
+	assert(scan_freq_set_contains(plan->active, 2462));
+	assert(!scan_freq_set_contains(plan->active, 2467));
+	assert(!scan_freq_set_contains(plan->active, 2484));
+	assert(scan_freq_set_contains(plan->active, 5180));
+	assert(!scan_freq_set_contains(plan->active, 5260));
+	assert(scan_freq_set_get_bands(plan->active) ==
+				(BAND_FREQ_2_4_GHZ | BAND_FREQ_5_GHZ));
+
+	assert(scan_freq_set_contains(plan->passive, 2467));
+	assert(scan_freq_set_contains(plan->passive, 2472));
+	assert(scan_freq_set_contains(plan->passive, 5260));
+	assert(scan_freq_set_contains(plan->passive, 6055));
+	assert(!scan_freq_set_contains(plan->passive, 2412));
+
+	assert(scan_freq_set_contains(plan->psc, 5975));
+	assert(!scan_freq_set_contains(plan->psc, 5955));
+	assert(!scan_freq_set_contains(plan->psc, 6055));
+	assert(scan_freq_set_get_bands(plan->psc) == BAND_FREQ_6_GHZ);
+
+	all = scan_freq_plan_get_all(plan);
+	assert(!scan_freq_set_contains(all, 5825));
+	assert(!scan_freq_set_contains(all, 5955));
+	assert(!scan_freq_set_contains(all, 6135));
+	assert(scan_freq_set_contains(all, 2467));
+	assert(scan_freq_set_contains(all, 5975));
+	scan_freq_set_free(all);
+	scan_freq_plan_free(plan);
+
+	/* A regdom change lifting NO-IR moves the channels to active/PSC */
+	attrs_2g[12].no_ir = false;
+	attrs_5g[52].no_ir = false;
+	attrs_6g[21].no_ir = false;
+
+	plan = scan_freq_plan_new();
+	scan_freq_plan_add_band(plan, BAND_FREQ_2_4_GHZ, attrs_2g, 14);
+	scan_freq_plan_add_band(plan, BAND_FREQ_5_GHZ, attrs_5g, 196);
+	scan_freq_plan_add_band(plan, BAND_FREQ_6_GHZ, attrs_6g, 233);
+
+	assert(scan_freq_set_contains(plan->active, 2467));
+	assert(scan_freq_set_contains(plan->active, 5260));
+	assert(scan_freq_set_contains(plan->psc, 6055));
+	assert(!scan_freq_set_contains(plan->passive, 6055));
+	assert(scan_freq_set_contains(plan->passive, 2472));
+	scan_freq_plan_free(plan);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -192,6 +285,7 @@ int main(int argc, char *argv[])
 	l_test_add("/util/get_domain/", get_domain_test, NULL);
 	l_test_add("/util/get_username/", get_username_test, NULL);
 	l_test_add("/util/ip_prefix/", ip_prefix_test, NULL);
+	l_test_add("/util/scan_freq_plan/", scan_freq_plan_test, NULL);
 
 	return l_test_run();
 }
@@ -0,0 +1,293 @@
+/*
+ *
+ *  Wireless daemon for Linux
+ *
+ *  Copyright (C) 2024  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <ell/ell.h>
+
+#include "linux/nl80211.h"
+#include "src/util.h"
+#include "src/sched-scan.h"
+#include "src/wowlan.h"
+
+static const struct wowlan_caps caps_full = {
+	.supported = true,
+	.disconnect = true,
+	.gtk_rekey_supported = true,
+	.gtk_rekey_failure = true,
+	.max_nd_match_sets = 8,
+};
+
+static const struct sched_scan_caps sched_caps = {
+	.supported = true,
+	.max_ssids = 4,
+	.max_match_sets = 8,
+	.max_plans = 2,
+	.max_plan_interval = 65535,
+	.max_plan_iterations = 254,
+};
+
+static bool parse_caps(struct l_genl_msg *msg, struct wowlan_caps *caps)
+{
+	struct l_genl_attr attr;
+	struct l_genl_attr nested;
+	uint16_t type, len;
+	const void *data;
+
+	assert(l_genl_attr_init(&attr, msg));
+
+	while (l_genl_attr_next(&attr, &type, &len, &data)) {
+		if (type != NL80211_ATTR_WOWLAN_TRIGGERS_SUPPORTED)
+			continue;
+
+		assert(l_genl_attr_recurse(&attr, &nested));
+		return wowlan_caps_parse(caps, &nested);
+	}
+
+	return false;
+}
+
+static void test_caps(const void *data)
+{
+	struct l_genl_msg *msg;
+	struct wowlan_caps caps;
+	uint32_t max_nd = 11;
+	uint8_t bad = 1;
+	uint32_t all = WOWLAN_TRIGGER_DISCONNECT |
+			WOWLAN_TRIGGER_GTK_REKEY_FAILURE |
+			WOWLAN_TRIGGER_NET_DETECT;
+
+	msg = l_genl_msg_new(NL80211_CMD_NEW_WIPHY);
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_WOWLAN_TRIGGERS_SUPPORTED);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_MAGIC_PKT, 0, NULL);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_DISCONNECT, 0, NULL);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_GTK_REKEY_FAILURE,
+				0, NULL);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_NET_DETECT,
+				4, &max_nd);
+	l_genl_msg_leave_nested(msg);
+
+	assert(parse_caps(msg, &caps));
+	l_genl_msg_unref(msg);
+
+	assert(caps.supported);
+	assert(caps.disconnect);
+	assert(caps.gtk_rekey_failure);
+	assert(!caps.gtk_rekey_supported);
+	assert(caps.max_nd_match_sets == 11);
+
+	/* Rekey failure is useless without the rekey being offloaded */
+	assert(wowlan_caps_filter(&caps, all) ==
+			(WOWLAN_TRIGGER_DISCONNECT |
+			WOWLAN_TRIGGER_NET_DETECT));
+	assert(wowlan_caps_filter(&caps_full, all) == all);
+
+	caps.supported = false;
+	assert(wowlan_caps_filter(&caps, all) == 0);
+
+	msg = l_genl_msg_new(NL80211_CMD_NEW_WIPHY);
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_WOWLAN_TRIGGERS_SUPPORTED);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_NET_DETECT, 1, &bad);
+	l_genl_msg_leave_nested(msg);
+
+	assert(!parse_caps(msg, &caps));
+	l_genl_msg_unref(msg);
+}
+
+static uint32_t parse_set(struct l_genl_msg *msg, uint32_t wiphy_id,
+				unsigned int *nd_match_sets)
+{
+	struct l_genl_attr attr;
+	struct l_genl_attr triggers;
+	struct l_genl_attr nested;
+	uint16_t type, len;
+	const void *data;
+	uint32_t found = 0;
+	bool have_triggers = false;
+
+	assert(l_genl_msg_get_command(msg) == NL80211_CMD_SET_WOWLAN);
+	assert(l_genl_attr_init(&attr, msg));
+
+	while (l_genl_attr_next(&attr, &type, &len, &data)) {
+		switch (type) {
+		case NL80211_ATTR_WIPHY:
+			assert(l_get_u32(data) == wiphy_id);
+			break;
+		case NL80211_ATTR_WOWLAN_TRIGGERS:
+			assert(l_genl_attr_recurse(&attr, &triggers));
+			have_triggers = true;
+			break;
+		}
+	}
+
+	if (!have_triggers)
+		return 0;
+
+	while (l_genl_attr_next(&triggers, &type, &len, &data)) {
+		switch (type) {
+		case NL80211_WOWLAN_TRIG_DISCONNECT:
+			found |= WOWLAN_TRIGGER_DISCONNECT;
+			break;
+		case NL80211_WOWLAN_TRIG_GTK_REKEY_FAILURE:
+			found |= WOWLAN_TRIGGER_GTK_REKEY_FAILURE;
+			break;
+		case NL80211_WOWLAN_TRIG_NET_DETECT:
+			found |= WOWLAN_TRIGGER_NET_DETECT;
+			assert(l_genl_attr_recurse(&triggers, &nested));
+
+			while (l_genl_attr_next(&nested, &type, &len, &data))
+				if (type == NL80211_ATTR_SCHED_SCAN_MATCH)
+					(*nd_match_sets)++;
+
+			break;
+		default:
+			assert(false);
+		}
+	}
+
+	return found;
+}
+
+static void test_build_connected(const void *data)
+{
+	struct wowlan_caps caps = caps_full;
+	struct l_genl_msg *msg;
+	unsigned int nd = 0;
+
+	msg = wowlan_build_set(3, &caps, WOWLAN_TRIGGER_DISCONNECT |
+					WOWLAN_TRIGGER_GTK_REKEY_FAILURE |
+					WOWLAN_TRIGGER_NET_DETECT, NULL);
+	assert(msg);
+	/* No net-detect request, nothing to look for */
+	assert(parse_set(msg, 3, &nd) == (WOWLAN_TRIGGER_DISCONNECT |
+					WOWLAN_TRIGGER_GTK_REKEY_FAILURE));
+	assert(nd == 0);
+	l_genl_msg_unref(msg);
+
+	caps.disconnect = false;
+	caps.gtk_rekey_supported = false;
+	assert(!wowlan_build_set(3, &caps, WOWLAN_TRIGGER_DISCONNECT |
+					WOWLAN_TRIGGER_GTK_REKEY_FAILURE,
+					NULL));
+
+	msg = wowlan_build_clear(3);
+	assert(parse_set(msg, 3, &nd) == 0);
+	l_genl_msg_unref(msg);
+}
+
+static void test_build_net_detect(const void *data)
+{
+	struct wowlan_caps caps = caps_full;
+	struct sched_scan_request *req;
+	struct l_genl_msg *msg;
+	unsigned int nd = 0;
+
+	req = sched_scan_request_new(&sched_caps, -80);
+	assert(sched_scan_request_add_ssid(req, "Home", false) == 0);
+	assert(sched_scan_request_add_ssid(req, "Office", true) == 0);
+
+	sched_scan_request_set_intervals(req, 10, 300);
+
+	msg = wowlan_build_set(0, &caps, WOWLAN_TRIGGER_NET_DETECT, req);
+	assert(msg);
+	assert(parse_set(msg, 0, &nd) == WOWLAN_TRIGGER_NET_DETECT);
+	assert(nd == 1);
+	l_genl_msg_unref(msg);
+
+	/* Request does not fit into the net-detect match sets */
+	caps.max_nd_match_sets = 1;
+	assert(!wowlan_build_set(0, &caps, WOWLAN_TRIGGER_NET_DETECT, req));
+
+	caps.max_nd_match_sets = 0;
+	assert(!wowlan_build_set(0, &caps, WOWLAN_TRIGGER_NET_DETECT, req));
+
+	sched_scan_request_free(req);
+}
+
+static void test_wakeup(const void *data)
+{
+	struct l_genl_msg *msg;
+	struct scan_freq_set *freqs = scan_freq_set_new();
+	uint32_t wiphy_id = 0;
+	uint32_t freq;
+	uint8_t pkt[24] = {};
+
+	msg = l_genl_msg_new(NL80211_CMD_SET_WOWLAN);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_WIPHY, 4, &wiphy_id);
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_WOWLAN_TRIGGERS);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_WAKEUP_PKT_80211,
+				sizeof(pkt), pkt);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_GTK_REKEY_FAILURE,
+				0, NULL);
+	l_genl_msg_enter_nested(msg, NL80211_WOWLAN_TRIG_NET_DETECT_RESULTS);
+	l_genl_msg_enter_nested(msg, 0);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_SSID, 4, "Home");
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_SCAN_FREQUENCIES);
+	freq = 2412;
+	l_genl_msg_append_attr(msg, 0, 4, &freq);
+	freq = 5180;
+	l_genl_msg_append_attr(msg, 1, 4, &freq);
+	l_genl_msg_leave_nested(msg);
+	l_genl_msg_leave_nested(msg);
+	l_genl_msg_leave_nested(msg);
+	l_genl_msg_leave_nested(msg);
+
+	assert(wowlan_parse_wakeup(msg, freqs) ==
+			(WOWLAN_TRIGGER_GTK_REKEY_FAILURE |
+			WOWLAN_TRIGGER_NET_DETECT));
+	assert(scan_freq_set_contains(freqs, 2412));
+	assert(scan_freq_set_contains(freqs, 5180));
+	assert(!scan_freq_set_contains(freqs, 2437));
+	l_genl_msg_unref(msg);
+	scan_freq_set_free(freqs);
+
+	/* Not woken up by WoWLAN */
+	msg = l_genl_msg_new(NL80211_CMD_SET_WOWLAN);
+	l_genl_msg_append_attr(msg, NL80211_ATTR_WIPHY, 4, &wiphy_id);
+	assert(wowlan_parse_wakeup(msg, NULL) == 0);
+	l_genl_msg_unref(msg);
+
+	msg = l_genl_msg_new(NL80211_CMD_SET_WOWLAN);
+	l_genl_msg_enter_nested(msg, NL80211_ATTR_WOWLAN_TRIGGERS);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_MAGIC_PKT, 0, NULL);
+	l_genl_msg_append_attr(msg, NL80211_WOWLAN_TRIG_DISCONNECT, 0, NULL);
+	l_genl_msg_leave_nested(msg);
+	assert(wowlan_parse_wakeup(msg, NULL) ==
+			(WOWLAN_TRIGGER_OTHER | WOWLAN_TRIGGER_DISCONNECT));
+	l_genl_msg_unref(msg);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("/WoWLAN/Capabilities", test_caps, NULL);
+	l_test_add("/WoWLAN/Connected triggers", test_build_connected, NULL);
+	l_test_add("/WoWLAN/Net-detect trigger", test_build_net_detect, NULL);
+	l_test_add("/WoWLAN/Wakeup reasons", test_wakeup, NULL);
+
+	return l_test_run();
+}
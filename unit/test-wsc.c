@@ -2261,6 +2261,7 @@ struct test_ap_sta_data {
 	int to_ap_msg_cnt;
 	struct eapol_sm *ap_sm;
 	struct eapol_sm *sta_sm;
+	bool dh5_pool;
 };
 
 static int test_ap_sta_eapol_tx(uint32_t ifindex,
@@ -2297,6 +2298,10 @@ static void test_ap_sta_run(struct test_ap_sta_data *s)
 	eap_init();
 	eapol_init();
 	__eapol_set_tx_packet_func(test_ap_sta_eapol_tx);
+
+	if (s->dh5_pool)
+		assert(__eap_wsc_dh5_pool_fill() >= 2);
+
 	__eapol_set_tx_user_data(s);
 
 	s->to_sta_msg_cnt = 0;
@@ -2428,7 +2433,8 @@ static void test_ap_sta_hs_event_sta(struct handshake_state *hs,
 	va_end(args);
 }
 
-static void wsc_r_test_pbc_handshake(const void *data)
+static void wsc_r_run_pbc_handshake(const struct wsc_credential *expected_creds,
+					bool dh5_pool)
 {
 	static const unsigned char ap_rsne[] = {
 		0x30, 0x12, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
@@ -2454,8 +2460,8 @@ static void wsc_r_test_pbc_handshake(const void *data)
 		.sta_hs = test_ap_sta_hs_new(&s, 2),
 		.ap_address = { 0x02, 0x03, 0x04, 0x05, 0x06, 0x07 },
 		.sta_address = { 0x02, 0x03, 0x04, 0x05, 0x06, 0x08 },
+		.dh5_pool = dh5_pool,
 	};
-	const struct wsc_credential *expected_creds = data;
 	struct wsc_r_test_success_data wsc_data = {
 		.s = &s,
 		.expected_creds = *expected_creds,
@@ -2545,6 +2551,11 @@ static void wsc_r_test_pbc_handshake(const void *data)
 	assert(wsc_data.ap_eap_failed && wsc_data.credentials_sent);
 }
 
+static void wsc_r_test_pbc_handshake(const void *data)
+{
+	wsc_r_run_pbc_handshake(data, false);
+}
+
 struct wsc_credential wsc_r_test_wpa2_cred_passphrase = {
 	.ssid_len = 7,
 	.ssid = "thessid",
@@ -2572,6 +2583,46 @@ struct wsc_credential wsc_r_test_open_cred = {
 	.encryption_type = WSC_ENCRYPTION_TYPE_NONE,
 };
 
+#define DH5_POOL_TEST_ROUNDS 3
+
+static void wsc_r_test_dh5_pool(const void *data)
+{
+	struct eap_wsc_dh5_stats cold;
+	struct eap_wsc_dh5_stats warm;
+	uint64_t cold_us = UINT64_MAX;
+	uint64_t warm_us = UINT64_MAX;
+	unsigned int i;
+
+	/*
+	 * Compare the fastest of a few rounds on each side so that a run
+	 * preempted on a loaded machine doesn't decide the outcome.
+	 */
+	for (i = 0; i < DH5_POOL_TEST_ROUNDS; i++) {
+		/* Both sides generate their keypair while pairing */
+		__eap_wsc_reset_dh5_stats();
+		wsc_r_run_pbc_handshake(&wsc_r_test_wpa2_cred_passphrase,
+						false);
+		__eap_wsc_get_dh5_stats(&cold);
+		assert(cold.pool_hits == 0 && cold.pool_misses == 2);
+
+		if (cold.keypair_us < cold_us)
+			cold_us = cold.keypair_us;
+
+		/* Both sides take a precomputed keypair */
+		__eap_wsc_reset_dh5_stats();
+		wsc_r_run_pbc_handshake(&wsc_r_test_wpa2_cred_passphrase,
+						true);
+		__eap_wsc_get_dh5_stats(&warm);
+		assert(warm.pool_hits == 2 && warm.pool_misses == 0);
+
+		if (warm.keypair_us < warm_us)
+			warm_us = warm.keypair_us;
+	}
+
+	/* Taking from the pool moves both modexps out of the M1/M2 path */
+	assert(warm_us < cold_us);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -2694,6 +2745,8 @@ int main(int argc, char *argv[])
 	l_test_add("/wsc-r/handshake/PBC Handshake Open test",
 				wsc_r_test_pbc_handshake,
 				&wsc_r_test_open_cred);
+	l_test_add("/wsc-r/handshake/DH5 keypair pool",
+				wsc_r_test_dh5_pool, NULL);
 
 done:
 	return l_test_run();